@@ -0,0 +1,46 @@
+// Hashes the compiler's source into MAXIM_BUILD_ID, which is part of the key of every object in
+// the disk cache. This way objects built by a different version of the compiler are never loaded,
+// without anyone having to remember to bump a version number.
+use std::env;
+use std::fs;
+use std::path::{Path, PathBuf};
+
+const SOURCE_PATHS: [&str; 3] = ["Cargo.toml", "src", "llvmmaxim"];
+
+fn collect_files(path: &Path, files: &mut Vec<PathBuf>) {
+    if path.is_dir() {
+        let entries = fs::read_dir(path).unwrap();
+        for entry in entries {
+            collect_files(&entry.unwrap().path(), files);
+        }
+    } else {
+        files.push(path.to_path_buf());
+    }
+}
+
+fn main() {
+    let manifest_dir = PathBuf::from(env::var("CARGO_MANIFEST_DIR").unwrap());
+    let mut files = Vec::new();
+    for source_path in SOURCE_PATHS.iter() {
+        collect_files(&manifest_dir.join(source_path), &mut files);
+    }
+    files.sort();
+
+    // FNV-1a over the path and contents of each file
+    let mut hash: u64 = 0xcbf2_9ce4_8422_2325;
+    for file in &files {
+        println!("cargo:rerun-if-changed={}", file.display());
+
+        let relative_path = file
+            .strip_prefix(&manifest_dir)
+            .unwrap()
+            .to_string_lossy()
+            .replace('\\', "/");
+        let contents = fs::read(file).unwrap();
+        for &byte in relative_path.as_bytes().iter().chain(&[0]).chain(&contents) {
+            hash = (hash ^ u64::from(byte)).wrapping_mul(0x0000_0100_0000_01b3);
+        }
+    }
+
+    println!("cargo:rustc-env=MAXIM_BUILD_ID={:016x}", hash);
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/raw_ostream.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Stores compiled objects on disk so modules that haven't changed don't need to be compiled again. Only modules with
+// an identifier starting with `CACHE_PREFIX` are cached - the frontend is responsible for making sure these
+// identifiers are unique to the module's contents. Objects are stored in a subdirectory for the host triple, CPU
+// and features, since they're compiled for the host.
+//
+// Objects are touched whenever they're used. When the directory is set, objects that haven't been used for
+// `MAX_OBJECT_AGE` are deleted, as are the least recently used ones once the host's objects are over `MAX_CACHE_BYTES`.
+class DiskObjectCache : public llvm::ObjectCache {
+public:
+    static constexpr const char *CACHE_PREFIX = "maxim.cache.";
+
+    static constexpr std::chrono::hours MAX_OBJECT_AGE = std::chrono::hours(24 * 30);
+
+    static constexpr uint64_t MAX_CACHE_BYTES = 256 * 1024 * 1024;
+
+    static DiskObjectCache &instance() {
+        static DiskObjectCache cache;
+        return cache;
+    }
+
+    void setDirectory(llvm::StringRef path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        loadedObjects.clear();
+
+        if (path.empty()) {
+            directory.clear();
+            return;
+        }
+
+        llvm::SmallString<256> hostPath(path);
+        llvm::sys::path::append(hostPath, hostName());
+        if (llvm::sys::fs::create_directories(hostPath)) {
+            directory.clear();
+        } else {
+            directory = hostPath.str();
+            prune();
+        }
+    }
+
+    // Returns true if the object for a module is in the cache. The object is loaded now and kept until the module is
+    // compiled, so it can't be lost to another instance pruning the cache in the meantime. If the object can't be
+    // read, this returns false so the module is compiled normally.
+    bool contains(llvm::StringRef identifier) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (loadedObjects.count(identifier.str())) return true;
+
+        auto path = objectPath(identifier);
+        if (path.empty()) return false;
+
+        auto buffer = llvm::MemoryBuffer::getFile(path, -1, false);
+        if (!buffer) return false;
+
+        touch(path);
+        loadedObjects.emplace(identifier.str(), std::move(*buffer));
+        return true;
+    }
+
+    void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto path = objectPath(module->getModuleIdentifier());
+        if (path.empty()) return;
+
+        // write to a temporary file first, so other instances never see a partially written object
+        auto tempPath = path + ".tmp";
+        std::error_code error;
+        {
+            llvm::raw_fd_ostream stream(tempPath, error, llvm::sys::fs::F_None);
+            if (error) return;
+            stream << object.getBuffer();
+        }
+        if (auto renameError = llvm::sys::fs::rename(tempPath, path)) {
+            // the object is still used from memory, it'll just be compiled again next time
+            llvm::errs() << "Failed to add " << path << " to the object cache: " << renameError.message() << "\n";
+            llvm::sys::fs::remove(tempPath);
+        }
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *module) override {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto loadedObject = loadedObjects.find(module->getModuleIdentifier());
+        if (loadedObject != loadedObjects.end()) {
+            auto buffer = std::move(loadedObject->second);
+            loadedObjects.erase(loadedObject);
+            return buffer;
+        }
+
+        auto path = objectPath(module->getModuleIdentifier());
+        if (path.empty()) return nullptr;
+
+        auto buffer = llvm::MemoryBuffer::getFile(path, -1, false);
+        if (!buffer) return nullptr;
+        touch(path);
+        return std::move(*buffer);
+    }
+
+    // The triple, CPU and a hash of the features of the host, which objects are compiled for.
+    static std::string hostName() {
+        llvm::StringMap<bool> features;
+        llvm::sys::getHostCPUFeatures(features);
+
+        std::vector<std::string> featureNames;
+        for (const auto &feature : features) {
+            featureNames.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+        }
+        std::sort(featureNames.begin(), featureNames.end());
+
+        // FNV-1a, so the name is the same between runs and builds
+        uint64_t featureHash = 14695981039346656037ULL;
+        for (const auto &name : featureNames) {
+            for (auto c : name) {
+                featureHash = (featureHash ^ (uint8_t) c) * 1099511628211ULL;
+            }
+        }
+
+        return llvm::sys::getProcessTriple() + "-" + llvm::sys::getHostCPUName().str() + "-" +
+               llvm::utohexstr(featureHash);
+    }
+
+private:
+    struct CachedFile {
+        std::string path;
+        llvm::sys::TimePoint<> lastUsed;
+        uint64_t size;
+    };
+
+    std::mutex mutex;
+    std::string directory;
+    std::map<std::string, std::unique_ptr<llvm::MemoryBuffer>> loadedObjects;
+
+    DiskObjectCache() = default;
+
+    // Marks an object as used, so it's kept by `prune`.
+    static void touch(const std::string &path) {
+        int fd;
+        if (llvm::sys::fs::openFileForWrite(path, fd, llvm::sys::fs::F_Append)) return;
+        llvm::sys::fs::setLastModificationAndAccessTime(fd, std::chrono::system_clock::now());
+        llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    }
+
+    void prune() {
+        std::vector<CachedFile> files;
+        std::error_code error;
+        for (llvm::sys::fs::directory_iterator file(directory, error), end; !error && file != end;
+             file.increment(error)) {
+            llvm::sys::fs::file_status status;
+            if (llvm::sys::fs::status(file->path(), status) ||
+                status.type() != llvm::sys::fs::file_type::regular_file) {
+                continue;
+            }
+            files.push_back({file->path(), status.getLastModificationTime(), status.getSize()});
+        }
+
+        // keep the most recently used files that fit
+        std::sort(files.begin(), files.end(),
+                  [](const CachedFile &a, const CachedFile &b) { return a.lastUsed > b.lastUsed; });
+        auto now = std::chrono::system_clock::now();
+        uint64_t keptBytes = 0;
+        for (const auto &file : files) {
+            keptBytes += file.size;
+            if (now - file.lastUsed > MAX_OBJECT_AGE || keptBytes > MAX_CACHE_BYTES) {
+                llvm::sys::fs::remove(file.path);
+            }
+        }
+    }
+
+    std::string objectPath(llvm::StringRef identifier) const {
+        if (directory.empty() || !identifier.startswith(CACHE_PREFIX)) return "";
+
+        llvm::SmallString<256> path(directory);
+        llvm::sys::path::append(path, identifier.substr(strlen(CACHE_PREFIX)) + ".o");
+        return path.str();
+    }
+};
@@ -3,7 +3,9 @@
 #include <llvm-c/TargetMachine.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/IR/IRBuilder.h>
+#include <atomic>
 
+#include "DiskObjectCache.h"
 #include "OrcJit.h"
 
 DEFINE_SIMPLE_CONVERSION_FUNCTIONS(std::shared_ptr<llvm::Module>, LLVMSharedModuleRef)
@@ -15,6 +17,23 @@ DEFINE_SIMPLE_CONVERSION_FUNCTIONS(llvm::TargetMachine, LLVMTargetMachineRef)
 #define SINCOSF ::sincosf
 #endif
 
+// Spreads a chunk of the root's voices across the frontend's worker pool, see `codegen::parallel`.
+using ParallelDispatchFunc = uint8_t (*)(void *pool, uint32_t voices);
+static ParallelDispatchFunc parallelDispatch = nullptr;
+
+static uint8_t maximParallelDispatch(void *pool, uint32_t voices) {
+    if (!parallelDispatch) return 0;
+    return parallelDispatch(pool, voices);
+}
+
+// Voices can sleep on several threads at once, so the frontend's counter of skipped updates is added to atomically,
+// see `codegen::voice_sleep`.
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "atomic counters must match the counter global");
+
+static void maximAddSleptUpdates(uint64_t *counter, uint64_t count) {
+    reinterpret_cast<std::atomic<uint64_t> *>(counter)->fetch_add(count, std::memory_order_relaxed);
+}
+
 extern "C" {
 int __umoddi3(int a, int b);
 
@@ -75,6 +94,8 @@ OrcJit *LLVMAxiomOrcCreateInstance(LLVMTargetMachineRef targetMachine) {
     jit->addBuiltin("free", (uint64_t) & ::free);
     jit->addBuiltin("memset", (uint64_t) & ::memset);
     jit->addBuiltin("__umoddi3", (uint64_t) & ::__umoddi3);
+    jit->addBuiltin("maxim_parallel_dispatch", (uint64_t) &maximParallelDispatch);
+    jit->addBuiltin("maxim_add_slept_updates", (uint64_t) &maximAddSleptUpdates);
 
 #ifdef APPLE
     jit->addBuiltin("__sincosf_stret", (uint64_t) & ::__sincosf_stret);
@@ -88,6 +109,10 @@ void LLVMAxiomOrcAddBuiltin(OrcJit *jit, const char *name, LLVMOrcTargetAddress
     jit->addBuiltin(name, address);
 }
 
+void LLVMAxiomSetParallelDispatch(ParallelDispatchFunc dispatch) {
+    parallelDispatch = dispatch;
+}
+
 LLVMOrcModuleHandle LLVMAxiomOrcAddModule(OrcJit *jit, LLVMSharedModuleRef module) {
     return jit->addModule(std::move(*unwrap(module)));
 }
@@ -103,4 +128,18 @@ LLVMOrcTargetAddress LLVMAxiomOrcGetSymbolAddress(OrcJit *jit, const char *name)
 void LLVMAxiomOrcDisposeInstance(OrcJit *jit) {
     delete jit;
 }
+
+// Object cache functions
+void LLVMAxiomSetObjectCacheDirectory(const char *path) {
+    DiskObjectCache::instance().setDirectory(path);
+}
+
+bool LLVMAxiomObjectCacheContains(const char *identifier) {
+    return DiskObjectCache::instance().contains(identifier);
+}
+
+const char *LLVMAxiomObjectCacheHostName() {
+    static const std::string hostName = DiskObjectCache::hostName();
+    return hostName.c_str();
+}
 }
@@ -9,6 +9,8 @@
 #include <llvm/IR/Mangler.h>
 #include <unordered_map>
 
+#include "DiskObjectCache.h"
+
 namespace llvm {
     class Module;
 }
@@ -22,7 +24,7 @@ public:
     explicit OrcJit(llvm::TargetMachine &targetMachine)
         : dataLayout(targetMachine.createDataLayout()),
           objectLayer([]() { return std::make_shared<llvm::SectionMemoryManager>(); }),
-          compileLayer(objectLayer, llvm::orc::SimpleCompiler(targetMachine)) {}
+          compileLayer(objectLayer, llvm::orc::SimpleCompiler(targetMachine, &DiskObjectCache::instance())) {}
 
     using ModuleKey = unsigned;
 
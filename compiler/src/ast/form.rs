@@ -29,6 +29,27 @@ impl Form {
     }
 }
 
+impl FormType {
+    /// Returns the form with the given discriminant, or None if there isn't one. Used for forms
+    /// passed in from outside of Rust, which can't be trusted to be in range.
+    pub fn from_u8(value: u8) -> Option<FormType> {
+        match value {
+            0 => Some(FormType::None),
+            1 => Some(FormType::Control),
+            2 => Some(FormType::Oscillator),
+            3 => Some(FormType::Note),
+            4 => Some(FormType::Frequency),
+            5 => Some(FormType::Beats),
+            6 => Some(FormType::Seconds),
+            7 => Some(FormType::Samples),
+            8 => Some(FormType::Db),
+            9 => Some(FormType::Amplitude),
+            10 => Some(FormType::Q),
+            _ => None,
+        }
+    }
+}
+
 impl fmt::Display for FormType {
     fn fmt(&self, f: &mut fmt::Formatter) -> Result<(), fmt::Error> {
         match self {
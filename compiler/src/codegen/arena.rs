@@ -0,0 +1,747 @@
+use codegen::{build_context_function, intrinsics, util, BuilderContext, TargetProperties};
+use inkwell::context::Context;
+use inkwell::module::{Linkage, Module};
+use inkwell::types::StructType;
+use inkwell::values::{FunctionValue, IntValue, PointerValue};
+use inkwell::{AddressSpace, IntPredicate};
+
+pub const ARENA_GLOBAL_NAME: &str = "maxim.arena";
+pub const ALLOC_FUNC_NAME: &str = "maxim.arena.alloc";
+pub const FREE_FUNC_NAME: &str = "maxim.arena.free";
+pub const MEMORY_GLOBAL_NAME: &str = "maxim.arena.memory";
+pub const FREE_MAP_GLOBAL_NAME: &str = "maxim.arena.freemap";
+
+/// Blocks are a power of two bytes, so each size gets its own free list. A block always starts at
+/// a multiple of its size from the start of the arena, so when it's freed it can be merged with
+/// the other half of the block it was split from (its buddy), if that's free too.
+pub const SIZE_CLASS_COUNT: usize = 64;
+
+/// Blocks are never smaller than a cache line, so blocks handed out from the arena never share
+/// one.
+pub const MIN_BLOCK_BYTES: u64 = 64;
+
+/// The arena that dynamically sized function state (like delay buffers) is allocated from, laid
+/// out the same as `frontend::arena::ArenaState`:
+///  - Pointer to the start of the arena's memory
+///  - Size of the arena's memory in bytes
+///  - Bytes of the arena that have been handed out so far
+///  - Number of blocks that didn't fit in the arena and were allocated from the heap instead
+///  - The head of the free list for each size class
+///  - Pointer to the free map, which has a byte for every `MIN_BLOCK_BYTES` of the arena. The
+///    byte for the start of a free block is its size class plus one, and every other byte is zero.
+///
+/// Free blocks start with pointers to the next and previous blocks in their free list, so a block
+/// can be taken out of the middle of its list when it's merged with its buddy.
+pub fn get_arena_type(context: &Context) -> StructType {
+    let byte_ptr_type = context.i8_type().ptr_type(AddressSpace::Generic);
+    context.struct_type(
+        &[
+            &byte_ptr_type,
+            &context.i64_type(),
+            &context.i64_type(),
+            &context.i64_type(),
+            &byte_ptr_type.array_type(SIZE_CLASS_COUNT as u32),
+            &byte_ptr_type,
+        ],
+        false,
+    )
+}
+
+/// Returns the number of bytes in the free map of an arena with the given capacity.
+pub fn get_free_map_bytes(capacity: u64) -> u64 {
+    capacity / MIN_BLOCK_BYTES
+}
+
+pub fn get_arena(module: &Module) -> PointerValue {
+    util::get_or_create_global(
+        module,
+        ARENA_GLOBAL_NAME,
+        &get_arena_type(&module.get_context()),
+    ).as_pointer_value()
+}
+
+/// Returns a block of at least the given number of bytes. The block isn't cleared.
+pub fn get_alloc_func(module: &Module) -> FunctionValue {
+    util::get_or_create_func(module, ALLOC_FUNC_NAME, true, &|| {
+        let context = module.get_context();
+        (
+            Linkage::ExternalLinkage,
+            context
+                .i8_type()
+                .ptr_type(AddressSpace::Generic)
+                .fn_type(&[&context.i64_type()], false),
+        )
+    })
+}
+
+/// Returns a block from the alloc function to its free list. The size must be the same as it was
+/// allocated with. Null pointers are ignored.
+pub fn get_free_func(module: &Module) -> FunctionValue {
+    util::get_or_create_func(module, FREE_FUNC_NAME, true, &|| {
+        let context = module.get_context();
+        (
+            Linkage::ExternalLinkage,
+            context.void_type().fn_type(
+                &[
+                    &context.i8_type().ptr_type(AddressSpace::Generic),
+                    &context.i64_type(),
+                ],
+                false,
+            ),
+        )
+    })
+}
+
+pub fn build_funcs(module: &Module, target: &TargetProperties) {
+    let arena_global = util::get_or_create_global(
+        module,
+        ARENA_GLOBAL_NAME,
+        &get_arena_type(&module.get_context()),
+    );
+    arena_global.set_initializer(&get_arena_type(&module.get_context()).const_null());
+
+    build_alloc_func(module, target);
+    build_free_func(module, target);
+}
+
+/// Gives the arena its own `capacity` bytes of memory in a zero-initialized global, for code
+/// that's exported without a runtime to allocate the memory. The memory is rounded up to whole
+/// blocks, and is made of vectors so it's at least as aligned as anything stored in it.
+pub fn build_static_memory(module: &Module, capacity: u64) {
+    let context = module.get_context();
+    let vec_type = context.f32_type().vec_type(4);
+    let vec_count = (capacity + MIN_BLOCK_BYTES - 1) / MIN_BLOCK_BYTES * MIN_BLOCK_BYTES / 16;
+    let memory_type = vec_type.array_type(vec_count as u32);
+    let memory_global = util::get_or_create_global(module, MEMORY_GLOBAL_NAME, &memory_type);
+    memory_global.set_initializer(&memory_type.const_null());
+
+    let byte_ptr_type = context.i8_type().ptr_type(AddressSpace::Generic);
+    let base_ptr = unsafe {
+        memory_global
+            .as_pointer_value()
+            .const_in_bounds_gep(&[
+                context.i64_type().const_int(0, false),
+                context.i64_type().const_int(0, false),
+            ]).const_cast(&byte_ptr_type)
+    };
+    let free_lists = byte_ptr_type
+        .array_type(SIZE_CLASS_COUNT as u32)
+        .const_null();
+
+    let free_map_type = context
+        .i8_type()
+        .array_type(get_free_map_bytes(vec_count * 16) as u32);
+    let free_map_global = util::get_or_create_global(module, FREE_MAP_GLOBAL_NAME, &free_map_type);
+    free_map_global.set_initializer(&free_map_type.const_null());
+    let free_map_ptr = unsafe {
+        free_map_global.as_pointer_value().const_in_bounds_gep(&[
+            context.i64_type().const_int(0, false),
+            context.i64_type().const_int(0, false),
+        ])
+    };
+
+    let arena_global =
+        util::get_or_create_global(module, ARENA_GLOBAL_NAME, &get_arena_type(&context));
+    arena_global.set_initializer(&context.const_struct(
+        &[
+            &base_ptr,
+            &context.i64_type().const_int(vec_count * 16, false),
+            &context.i64_type().const_int(0, false),
+            &context.i64_type().const_int(0, false),
+            &free_lists,
+            &free_map_ptr,
+        ],
+        false,
+    ));
+}
+
+fn build_is_not_null(ctx: &mut BuilderContext, ptr: PointerValue, name: &str) -> IntValue {
+    let i64_type = ctx.context.i64_type();
+    let ptr_int = ctx.b.build_ptr_to_int(ptr, i64_type, "");
+    ctx.b
+        .build_int_compare(IntPredicate::NE, ptr_int, i64_type.const_int(0, false), name)
+}
+
+fn build_if(
+    ctx: &mut BuilderContext,
+    condition: IntValue,
+    name: &str,
+    cb: &mut FnMut(&mut BuilderContext),
+) {
+    let true_block = ctx.context.append_basic_block(&ctx.func, name);
+    let end_block = ctx
+        .context
+        .append_basic_block(&ctx.func, &format!("{}.end", name));
+    ctx.b
+        .build_conditional_branch(&condition, &true_block, &end_block);
+    ctx.b.position_at_end(&true_block);
+    cb(ctx);
+    ctx.b.build_unconditional_branch(&end_block);
+    ctx.b.position_at_end(&end_block);
+}
+
+// Returns the size class of a block that's a power of two bytes, which is the index of its only
+// set bit.
+fn build_class_of(ctx: &mut BuilderContext, block_size: IntValue) -> IntValue {
+    let leading_zeros = ctx
+        .b
+        .build_call(
+            &intrinsics::ctlz_i64(ctx.module),
+            &[&block_size, &ctx.context.bool_type().const_int(1, false)],
+            "leadingzeros",
+            false,
+        ).left()
+        .unwrap()
+        .into_int_value();
+    ctx.b.build_int_sub(
+        ctx.context.i64_type().const_int(63, false),
+        leading_zeros,
+        "sizeclass",
+    )
+}
+
+// Returns the rounded up size of a block and its size class.
+fn build_size_class(ctx: &mut BuilderContext, bytes: IntValue) -> (IntValue, IntValue) {
+    let next_power_intrinsic = intrinsics::next_power_i64(ctx.module);
+    let i64_type = ctx.context.i64_type();
+
+    let min_bytes = i64_type.const_int(MIN_BLOCK_BYTES, false);
+    let is_small = ctx
+        .b
+        .build_int_compare(IntPredicate::ULT, bytes, min_bytes, "issmall");
+    let clamped_bytes = ctx
+        .b
+        .build_select(is_small, min_bytes, bytes, "clampedbytes")
+        .into_int_value();
+    let block_size = ctx
+        .b
+        .build_call(&next_power_intrinsic, &[&clamped_bytes], "blocksize", false)
+        .left()
+        .unwrap()
+        .into_int_value();
+    let size_class = build_class_of(ctx, block_size);
+    (block_size, size_class)
+}
+
+fn get_free_list_ptr(ctx: &mut BuilderContext, size_class: IntValue) -> PointerValue {
+    unsafe {
+        ctx.b.build_in_bounds_gep(
+            &get_arena(ctx.module),
+            &[
+                ctx.context.i32_type().const_int(0, false),
+                ctx.context.i32_type().const_int(4, false),
+                size_class,
+            ],
+            "freelist.ptr",
+        )
+    }
+}
+
+fn get_base(ctx: &mut BuilderContext) -> PointerValue {
+    let arena_ptr = get_arena(ctx.module);
+    let base_ptr = unsafe { ctx.b.build_struct_gep(&arena_ptr, 0, "base.ptr") };
+    ctx.b.build_load(&base_ptr, "base").into_pointer_value()
+}
+
+fn get_block_ptr(ctx: &mut BuilderContext, offset: IntValue) -> PointerValue {
+    let base = get_base(ctx);
+    unsafe { ctx.b.build_in_bounds_gep(&base, &[offset], "block") }
+}
+
+fn get_block_offset(ctx: &mut BuilderContext, block: PointerValue) -> IntValue {
+    let i64_type = ctx.context.i64_type();
+    let base = get_base(ctx);
+    ctx.b.build_int_sub(
+        ctx.b.build_ptr_to_int(block, i64_type, ""),
+        ctx.b.build_ptr_to_int(base, i64_type, ""),
+        "offset",
+    )
+}
+
+// Returns a pointer to the free map's entry for the block at an offset into the arena.
+fn get_free_map_entry_ptr(ctx: &mut BuilderContext, offset: IntValue) -> PointerValue {
+    let arena_ptr = get_arena(ctx.module);
+    let free_map_ptr = unsafe { ctx.b.build_struct_gep(&arena_ptr, 5, "freemap.ptr") };
+    let free_map = ctx
+        .b
+        .build_load(&free_map_ptr, "freemap")
+        .into_pointer_value();
+    let index = ctx.b.build_right_shift(
+        offset,
+        ctx.context
+            .i64_type()
+            .const_int(u64::from(MIN_BLOCK_BYTES.trailing_zeros()), false),
+        false,
+        "freemapindex",
+    );
+    unsafe {
+        ctx.b
+            .build_in_bounds_gep(&free_map, &[index], "freemapentry.ptr")
+    }
+}
+
+fn build_set_free_map_entry(ctx: &mut BuilderContext, offset: IntValue, entry: IntValue) {
+    let entry_ptr = get_free_map_entry_ptr(ctx, offset);
+    let entry_byte = ctx
+        .b
+        .build_int_truncate(entry, ctx.context.i8_type(), "freemapentry");
+    ctx.b.build_store(&entry_ptr, &entry_byte);
+}
+
+// Returns pointers to the next and previous links at the start of a free block.
+fn get_links(ctx: &mut BuilderContext, block: PointerValue) -> (PointerValue, PointerValue) {
+    let byte_ptr_type = ctx.context.i8_type().ptr_type(AddressSpace::Generic);
+    let next_ptr = ctx.b.build_pointer_cast(
+        block,
+        byte_ptr_type.ptr_type(AddressSpace::Generic),
+        "next.ptr",
+    );
+    let prev_ptr = unsafe {
+        ctx.b.build_in_bounds_gep(
+            &next_ptr,
+            &[ctx.context.i64_type().const_int(1, false)],
+            "prev.ptr",
+        )
+    };
+    (next_ptr, prev_ptr)
+}
+
+/// Builds code that is equivalent to the following C++:
+/// ```cpp
+/// auto block = arena.base + offset;
+/// auto &freeList = arena.freeLists[sizeClass];
+/// block->next = freeList;
+/// block->prev = nullptr;
+/// if (freeList) freeList->prev = block;
+/// freeList = block;
+/// arena.freeMap[offset / MIN_BLOCK_BYTES] = sizeClass + 1;
+/// ```
+fn build_push_free(ctx: &mut BuilderContext, offset: IntValue, size_class: IntValue) {
+    let byte_ptr_type = ctx.context.i8_type().ptr_type(AddressSpace::Generic);
+    let block = get_block_ptr(ctx, offset);
+    let free_list_ptr = get_free_list_ptr(ctx, size_class);
+    let head = ctx
+        .b
+        .build_load(&free_list_ptr, "head")
+        .into_pointer_value();
+
+    let (next_ptr, prev_ptr) = get_links(ctx, block);
+    ctx.b.build_store(&next_ptr, &head);
+    ctx.b.build_store(&prev_ptr, &byte_ptr_type.const_null());
+    let has_head = build_is_not_null(ctx, head, "hashead");
+    build_if(ctx, has_head, "hashead.true", &mut |ctx| {
+        let (_, head_prev_ptr) = get_links(ctx, head);
+        ctx.b.build_store(&head_prev_ptr, &block);
+    });
+    ctx.b.build_store(&free_list_ptr, &block);
+
+    let entry = ctx.b.build_int_add(
+        size_class,
+        ctx.context.i64_type().const_int(1, false),
+        "entry",
+    );
+    build_set_free_map_entry(ctx, offset, entry);
+}
+
+/// Builds code that is equivalent to the following C++:
+/// ```cpp
+/// auto block = arena.base + offset;
+/// if (block->prev) block->prev->next = block->next;
+/// else arena.freeLists[sizeClass] = block->next;
+/// if (block->next) block->next->prev = block->prev;
+/// arena.freeMap[offset / MIN_BLOCK_BYTES] = 0;
+/// ```
+fn build_remove_free(ctx: &mut BuilderContext, offset: IntValue, size_class: IntValue) {
+    let block = get_block_ptr(ctx, offset);
+    let (next_ptr, prev_ptr) = get_links(ctx, block);
+    let next = ctx.b.build_load(&next_ptr, "next").into_pointer_value();
+    let prev = ctx.b.build_load(&prev_ptr, "prev").into_pointer_value();
+
+    // the previous block's link is only stored to if there is one
+    let has_prev = build_is_not_null(ctx, prev, "hasprev");
+    let (prev_next_ptr, _) = get_links(ctx, prev);
+    let free_list_ptr = get_free_list_ptr(ctx, size_class);
+    let next_store_ptr = ctx
+        .b
+        .build_select(has_prev, prev_next_ptr, free_list_ptr, "nextstore.ptr")
+        .into_pointer_value();
+    ctx.b.build_store(&next_store_ptr, &next);
+
+    let has_next = build_is_not_null(ctx, next, "hasnext");
+    build_if(ctx, has_next, "hasnext.true", &mut |ctx| {
+        let (_, next_prev_ptr) = get_links(ctx, next);
+        ctx.b.build_store(&next_prev_ptr, &prev);
+    });
+
+    build_set_free_map_entry(ctx, offset, ctx.context.i64_type().const_int(0, false));
+}
+
+/// Builds a function that is equivalent to the following C++:
+/// ```cpp
+/// void *alloc(uint64_t bytes) {
+///     auto blockSize = calculateNextPowerOfTwo(max(bytes, MIN_BLOCK_BYTES));
+///     auto sizeClass = log2(blockSize);
+///
+///     // split the smallest free block that's big enough
+///     for (auto searchClass = sizeClass; searchClass < SIZE_CLASS_COUNT; searchClass++) {
+///         auto block = arena.freeLists[searchClass];
+///         if (!block) continue;
+///
+///         auto offset = block - arena.base;
+///         removeFree(offset, searchClass);
+///         while (searchClass > sizeClass) {
+///             searchClass--;
+///             pushFree(offset + (1 << searchClass), searchClass);
+///         }
+///         return block;
+///     }
+///
+///     // blocks start at a multiple of their size, and the gap before one is kept as free blocks
+///     auto start = (arena.used + blockSize - 1) & ~(blockSize - 1);
+///     if (start + blockSize <= arena.capacity) {
+///         for (auto gap = arena.used; gap < start; gap += gap & -gap) {
+///             pushFree(gap, log2(gap & -gap));
+///         }
+///         arena.used = start + blockSize;
+///         return arena.base + start;
+///     }
+///
+///     arena.heapAllocs++;
+///     return realloc(nullptr, blockSize);
+/// }
+/// ```
+fn build_alloc_func(module: &Module, target: &TargetProperties) {
+    let func = get_alloc_func(module);
+    build_context_function(module, func, target, &|mut ctx: BuilderContext| {
+        let target_data = target.machine.get_data();
+        let realloc_intrinsic = intrinsics::realloc(ctx.module, &target_data);
+        let byte_ptr_type = ctx.context.i8_type().ptr_type(AddressSpace::Generic);
+        let i64_type = ctx.context.i64_type();
+        let const_one = i64_type.const_int(1, false);
+
+        let search_check_block = ctx.context.append_basic_block(&ctx.func, "search.check");
+        let search_run_block = ctx.context.append_basic_block(&ctx.func, "search.run");
+        let search_next_block = ctx.context.append_basic_block(&ctx.func, "search.next");
+        let found_block = ctx.context.append_basic_block(&ctx.func, "found");
+        let split_check_block = ctx.context.append_basic_block(&ctx.func, "split.check");
+        let split_run_block = ctx.context.append_basic_block(&ctx.func, "split.run");
+        let split_end_block = ctx.context.append_basic_block(&ctx.func, "split.end");
+        let bump_block = ctx.context.append_basic_block(&ctx.func, "bump");
+        let gap_check_block = ctx.context.append_basic_block(&ctx.func, "gap.check");
+        let gap_run_block = ctx.context.append_basic_block(&ctx.func, "gap.run");
+        let gap_end_block = ctx.context.append_basic_block(&ctx.func, "gap.end");
+        let fits_false_block = ctx.context.append_basic_block(&ctx.func, "fits.false");
+
+        let bytes = ctx.func.get_nth_param(0).unwrap().into_int_value();
+        let (block_size, size_class) = build_size_class(&mut ctx, bytes);
+        let arena_ptr = get_arena(ctx.module);
+
+        // for (auto searchClass = sizeClass; searchClass < SIZE_CLASS_COUNT; searchClass++) {
+        let search_class_ptr = ctx.allocb.build_alloca(&i64_type, "searchclass.ptr");
+        ctx.b.build_store(&search_class_ptr, &size_class);
+        ctx.b.build_unconditional_branch(&search_check_block);
+
+        ctx.b.position_at_end(&search_check_block);
+        let search_class = ctx
+            .b
+            .build_load(&search_class_ptr, "searchclass")
+            .into_int_value();
+        let can_search = ctx.b.build_int_compare(
+            IntPredicate::ULT,
+            search_class,
+            i64_type.const_int(SIZE_CLASS_COUNT as u64, false),
+            "cansearch",
+        );
+        ctx.b
+            .build_conditional_branch(&can_search, &search_run_block, &bump_block);
+
+        ctx.b.position_at_end(&search_run_block);
+        let search_list_ptr = get_free_list_ptr(&mut ctx, search_class);
+        let free_block = ctx
+            .b
+            .build_load(&search_list_ptr, "freeblock")
+            .into_pointer_value();
+        let has_free = build_is_not_null(&mut ctx, free_block, "hasfree");
+        ctx.b
+            .build_conditional_branch(&has_free, &found_block, &search_next_block);
+
+        ctx.b.position_at_end(&search_next_block);
+        let next_class = ctx.b.build_int_add(search_class, const_one, "nextclass");
+        ctx.b.build_store(&search_class_ptr, &next_class);
+        ctx.b.build_unconditional_branch(&search_check_block);
+
+        // removeFree(offset, searchClass);
+        ctx.b.position_at_end(&found_block);
+        let free_offset = get_block_offset(&mut ctx, free_block);
+        build_remove_free(&mut ctx, free_offset, search_class);
+        ctx.b.build_unconditional_branch(&split_check_block);
+
+        // while (searchClass > sizeClass) {
+        ctx.b.position_at_end(&split_check_block);
+        let split_class = ctx
+            .b
+            .build_load(&search_class_ptr, "splitclass")
+            .into_int_value();
+        let can_split =
+            ctx.b
+                .build_int_compare(IntPredicate::UGT, split_class, size_class, "cansplit");
+        ctx.b
+            .build_conditional_branch(&can_split, &split_run_block, &split_end_block);
+
+        ctx.b.position_at_end(&split_run_block);
+        let half_class = ctx.b.build_int_sub(split_class, const_one, "halfclass");
+        let half_size = ctx.b.build_left_shift(const_one, half_class, "halfsize");
+        let half_offset = ctx.b.build_int_add(free_offset, half_size, "halfoffset");
+        build_push_free(&mut ctx, half_offset, half_class);
+        ctx.b.build_store(&search_class_ptr, &half_class);
+        ctx.b.build_unconditional_branch(&split_check_block);
+
+        ctx.b.position_at_end(&split_end_block);
+        ctx.b.build_return(Some(&free_block));
+
+        // if (start + blockSize <= arena.capacity) {
+        ctx.b.position_at_end(&bump_block);
+        let capacity_ptr = unsafe { ctx.b.build_struct_gep(&arena_ptr, 1, "capacity.ptr") };
+        let used_ptr = unsafe { ctx.b.build_struct_gep(&arena_ptr, 2, "used.ptr") };
+        let used = ctx.b.build_load(&used_ptr, "used").into_int_value();
+        let capacity = ctx
+            .b
+            .build_load(&capacity_ptr, "capacity")
+            .into_int_value();
+        let size_mask = ctx.b.build_int_sub(block_size, const_one, "sizemask");
+        let start = ctx.b.build_and(
+            ctx.b.build_int_nuw_add(used, size_mask, ""),
+            ctx.b.build_not(&size_mask, ""),
+            "start",
+        );
+        let new_used = ctx.b.build_int_nuw_add(start, block_size, "newused");
+        let fits = ctx
+            .b
+            .build_int_compare(IntPredicate::ULE, new_used, capacity, "fits");
+        let gap_ptr = ctx.allocb.build_alloca(&i64_type, "gap.ptr");
+        ctx.b.build_store(&gap_ptr, &used);
+        ctx.b
+            .build_conditional_branch(&fits, &gap_check_block, &fits_false_block);
+
+        // for (auto gap = arena.used; gap < start; gap += gap & -gap) {
+        ctx.b.position_at_end(&gap_check_block);
+        let gap = ctx.b.build_load(&gap_ptr, "gap").into_int_value();
+        let has_gap = ctx
+            .b
+            .build_int_compare(IntPredicate::ULT, gap, start, "hasgap");
+        ctx.b
+            .build_conditional_branch(&has_gap, &gap_run_block, &gap_end_block);
+
+        ctx.b.position_at_end(&gap_run_block);
+        let gap_size = ctx.b.build_and(
+            gap,
+            ctx.b
+                .build_int_sub(i64_type.const_int(0, false), gap, ""),
+            "gapsize",
+        );
+        let gap_class = build_class_of(&mut ctx, gap_size);
+        build_push_free(&mut ctx, gap, gap_class);
+        let next_gap = ctx.b.build_int_add(gap, gap_size, "nextgap");
+        ctx.b.build_store(&gap_ptr, &next_gap);
+        ctx.b.build_unconditional_branch(&gap_check_block);
+
+        ctx.b.position_at_end(&gap_end_block);
+        ctx.b.build_store(&used_ptr, &new_used);
+        let arena_block = get_block_ptr(&mut ctx, start);
+        ctx.b.build_return(Some(&arena_block));
+
+        // arena.heapAllocs++;
+        ctx.b.position_at_end(&fits_false_block);
+        let heap_allocs_ptr = unsafe { ctx.b.build_struct_gep(&arena_ptr, 3, "heapallocs.ptr") };
+        let heap_allocs = ctx
+            .b
+            .build_load(&heap_allocs_ptr, "heapallocs")
+            .into_int_value();
+        ctx.b.build_store(
+            &heap_allocs_ptr,
+            &ctx.b.build_int_add(heap_allocs, const_one, ""),
+        );
+        let heap_block = ctx
+            .b
+            .build_call(
+                &realloc_intrinsic,
+                &[
+                    &byte_ptr_type.const_null(),
+                    &ctx.b.build_int_cast(
+                        block_size,
+                        target_data.int_ptr_type_in_context(ctx.context),
+                        "",
+                    ),
+                ],
+                "heapblock",
+                false,
+            ).left()
+            .unwrap();
+        ctx.b.build_return(Some(&heap_block));
+    });
+}
+
+/// Builds a function that is equivalent to the following C++:
+/// ```cpp
+/// void free(void *block, uint64_t bytes) {
+///     if (!block) return;
+///
+///     // blocks that didn't fit in the arena go straight back to the heap
+///     auto offset = block - arena.base;
+///     if (offset >= arena.capacity) {
+///         ::free(block);
+///         return;
+///     }
+///
+///     // merge with the block's buddy for as long as it's free
+///     auto sizeClass = log2(calculateNextPowerOfTwo(max(bytes, MIN_BLOCK_BYTES)));
+///     while (sizeClass < SIZE_CLASS_COUNT - 1) {
+///         auto buddy = offset ^ (1 << sizeClass);
+///         if (buddy + (1 << sizeClass) > arena.used) break;
+///         if (arena.freeMap[buddy / MIN_BLOCK_BYTES] != sizeClass + 1) break;
+///
+///         removeFree(buddy, sizeClass);
+///         offset &= ~(1 << sizeClass);
+///         sizeClass++;
+///     }
+///
+///     // a block at the end of the used memory is given back, so it can be allocated again bigger
+///     if (offset + (1 << sizeClass) == arena.used) arena.used = offset;
+///     else pushFree(offset, sizeClass);
+/// }
+/// ```
+fn build_free_func(module: &Module, target: &TargetProperties) {
+    let func = get_free_func(module);
+    build_context_function(module, func, target, &|mut ctx: BuilderContext| {
+        let i64_type = ctx.context.i64_type();
+        let const_one = i64_type.const_int(1, false);
+
+        let not_null_block = ctx.context.append_basic_block(&ctx.func, "notnull");
+        let in_arena_true_block = ctx.context.append_basic_block(&ctx.func, "inarena.true");
+        let in_arena_false_block = ctx.context.append_basic_block(&ctx.func, "inarena.false");
+        let merge_check_block = ctx.context.append_basic_block(&ctx.func, "merge.check");
+        let merge_buddy_block = ctx.context.append_basic_block(&ctx.func, "merge.buddy");
+        let merge_run_block = ctx.context.append_basic_block(&ctx.func, "merge.run");
+        let merge_end_block = ctx.context.append_basic_block(&ctx.func, "merge.end");
+        let is_top_true_block = ctx.context.append_basic_block(&ctx.func, "istop.true");
+        let is_top_false_block = ctx.context.append_basic_block(&ctx.func, "istop.false");
+        let end_block = ctx.context.append_basic_block(&ctx.func, "end");
+
+        let block = ctx.func.get_nth_param(0).unwrap().into_pointer_value();
+        let bytes = ctx.func.get_nth_param(1).unwrap().into_int_value();
+        let arena_ptr = get_arena(ctx.module);
+
+        let is_not_null = build_is_not_null(&mut ctx, block, "isnotnull");
+        ctx.b
+            .build_conditional_branch(&is_not_null, &not_null_block, &end_block);
+
+        // if (offset >= arena.capacity) {
+        ctx.b.position_at_end(&not_null_block);
+        let capacity_ptr = unsafe { ctx.b.build_struct_gep(&arena_ptr, 1, "capacity.ptr") };
+        let capacity = ctx
+            .b
+            .build_load(&capacity_ptr, "capacity")
+            .into_int_value();
+        let offset = get_block_offset(&mut ctx, block);
+
+        // the offset wraps around when the block is below the base, so one comparison does both
+        let in_arena = ctx
+            .b
+            .build_int_compare(IntPredicate::ULT, offset, capacity, "inarena");
+        ctx.b
+            .build_conditional_branch(&in_arena, &in_arena_true_block, &in_arena_false_block);
+
+        ctx.b.position_at_end(&in_arena_false_block);
+        ctx.b.build_free(&block);
+        ctx.b.build_unconditional_branch(&end_block);
+
+        ctx.b.position_at_end(&in_arena_true_block);
+        let (_, size_class) = build_size_class(&mut ctx, bytes);
+        let used_ptr = unsafe { ctx.b.build_struct_gep(&arena_ptr, 2, "used.ptr") };
+        let merge_offset_ptr = ctx.allocb.build_alloca(&i64_type, "mergeoffset.ptr");
+        let merge_class_ptr = ctx.allocb.build_alloca(&i64_type, "mergeclass.ptr");
+        ctx.b.build_store(&merge_offset_ptr, &offset);
+        ctx.b.build_store(&merge_class_ptr, &size_class);
+        ctx.b.build_unconditional_branch(&merge_check_block);
+
+        // while (sizeClass < SIZE_CLASS_COUNT - 1) {
+        ctx.b.position_at_end(&merge_check_block);
+        let merge_offset = ctx
+            .b
+            .build_load(&merge_offset_ptr, "mergeoffset")
+            .into_int_value();
+        let merge_class = ctx
+            .b
+            .build_load(&merge_class_ptr, "mergeclass")
+            .into_int_value();
+        let merge_size = ctx.b.build_left_shift(const_one, merge_class, "mergesize");
+        let buddy = ctx.b.build_xor(merge_offset, merge_size, "buddy");
+        let used = ctx.b.build_load(&used_ptr, "used").into_int_value();
+        let can_grow = ctx.b.build_int_compare(
+            IntPredicate::ULT,
+            merge_class,
+            i64_type.const_int(SIZE_CLASS_COUNT as u64 - 1, false),
+            "cangrow",
+        );
+        let buddy_is_used = ctx.b.build_int_compare(
+            IntPredicate::ULE,
+            ctx.b.build_int_add(buddy, merge_size, "buddyend"),
+            used,
+            "buddyisused",
+        );
+        let can_merge = ctx.b.build_and(can_grow, buddy_is_used, "canmerge");
+        ctx.b
+            .build_conditional_branch(&can_merge, &merge_buddy_block, &merge_end_block);
+
+        // if (arena.freeMap[buddy / MIN_BLOCK_BYTES] != sizeClass + 1) break;
+        ctx.b.position_at_end(&merge_buddy_block);
+        let buddy_entry_ptr = get_free_map_entry_ptr(&mut ctx, buddy);
+        let buddy_entry = ctx
+            .b
+            .build_load(&buddy_entry_ptr, "buddyentry")
+            .into_int_value();
+        let buddy_is_free = ctx.b.build_int_compare(
+            IntPredicate::EQ,
+            ctx.b
+                .build_int_z_extend(buddy_entry, i64_type, "buddyentry.wide"),
+            ctx.b.build_int_add(merge_class, const_one, ""),
+            "buddyisfree",
+        );
+        ctx.b
+            .build_conditional_branch(&buddy_is_free, &merge_run_block, &merge_end_block);
+
+        ctx.b.position_at_end(&merge_run_block);
+        build_remove_free(&mut ctx, buddy, merge_class);
+        let merged_offset = ctx.b.build_and(
+            merge_offset,
+            ctx.b.build_not(&merge_size, ""),
+            "mergedoffset",
+        );
+        ctx.b.build_store(&merge_offset_ptr, &merged_offset);
+        let merged_class = ctx.b.build_int_add(merge_class, const_one, "mergedclass");
+        ctx.b.build_store(&merge_class_ptr, &merged_class);
+        ctx.b.build_unconditional_branch(&merge_check_block);
+
+        // if (offset + (1 << sizeClass) == arena.used) arena.used = offset;
+        ctx.b.position_at_end(&merge_end_block);
+        let is_top = ctx.b.build_int_compare(
+            IntPredicate::EQ,
+            ctx.b.build_int_add(merge_offset, merge_size, "mergeend"),
+            used,
+            "istop",
+        );
+        ctx.b
+            .build_conditional_branch(&is_top, &is_top_true_block, &is_top_false_block);
+
+        ctx.b.position_at_end(&is_top_true_block);
+        ctx.b.build_store(&used_ptr, &merge_offset);
+        ctx.b.build_unconditional_branch(&end_block);
+
+        ctx.b.position_at_end(&is_top_false_block);
+        build_push_free(&mut ctx, merge_offset, merge_class);
+        ctx.b.build_unconditional_branch(&end_block);
+
+        ctx.b.position_at_end(&end_block);
+        ctx.b.build_return(None);
+    });
+}
@@ -5,7 +5,7 @@ use inkwell::values::PointerValue;
 pub struct BlockContext<'a> {
     pub ctx: BuilderContext<'a>,
     pub layout: &'a BlockLayout,
-    statement_ptrs: Vec<PointerValue>,
+    statement_ptrs: Vec<Option<PointerValue>>,
     pointers_ptr: PointerValue,
 }
 
@@ -31,11 +31,19 @@ impl<'a> BlockContext<'a> {
     }
 
     pub fn push_statement(&mut self, ptr: PointerValue) {
-        self.statement_ptrs.push(ptr)
+        self.statement_ptrs.push(Some(ptr))
+    }
+
+    // Statements can be generated out of order when control-rate statements are hoisted.
+    pub fn set_statement(&mut self, index: usize, ptr: PointerValue) {
+        if self.statement_ptrs.len() <= index {
+            self.statement_ptrs.resize(index + 1, None);
+        }
+        self.statement_ptrs[index] = Some(ptr);
     }
 
     pub fn get_statement(&self, index: usize) -> PointerValue {
-        self.statement_ptrs[index]
+        self.statement_ptrs[index].unwrap()
     }
 
     pub fn get_control_ptrs(&self, index: usize, include_ui: bool) -> ControlPointers {
@@ -1,6 +1,6 @@
 use super::BlockContext;
 use ast::OperatorType;
-use codegen::intrinsics;
+use codegen::math::{self, MathAccuracy};
 use codegen::values::NumValue;
 use inkwell::types::IntType;
 use inkwell::values::{PointerValue, VectorValue};
@@ -12,7 +12,7 @@ pub fn gen_math_op_statement(
     rhs: usize,
     node: &mut BlockContext,
 ) -> PointerValue {
-    let pow_intrinsic = intrinsics::pow_v2f32(node.ctx.module);
+    let pow_func = math::pow_v2f32(node.ctx.module, MathAccuracy::Precise);
     let left_num = NumValue::new(node.get_statement(lhs));
     let right_num = NumValue::new(node.get_statement(rhs));
     let result_num = NumValue::new_undef(node.ctx.context, node.ctx.allocb);
@@ -46,7 +46,7 @@ pub fn gen_math_op_statement(
         OperatorType::Power => node
             .ctx
             .b
-            .build_call(&pow_intrinsic, &[&left_vec, &right_vec], "", false)
+            .build_call(&pow_func, &[&left_vec, &right_vec], "", false)
             .left()
             .unwrap()
             .into_vector_value(),
@@ -12,6 +12,7 @@ mod gen_store_control;
 mod gen_unary_op;
 
 use self::block_context::BlockContext;
+use codegen::control_rate::{self, ControlRateLayout};
 use codegen::{
     build_context_function, controls, functions, util, BuilderContext, LifecycleFunc, ObjectCache,
 };
@@ -64,13 +65,46 @@ fn gen_statement(index: usize, statement: &Statement, node: &mut BlockContext) -
     }
 }
 
+pub fn get_migrate_global_name(block: BlockRef, version: u64) -> String {
+    format!("maxim.block.{}.{:x}.migrate", block, version)
+}
+
+// When the runtime moves a block's state to a new commit, it sets the block's migrate flag so the
+// state isn't destructed with the old code or reconstructed with the new code.
+fn build_migrate_check(ctx: &mut BuilderContext, block: BlockRef, version: u64) {
+    let flag_type = ctx.context.bool_type();
+    let migrate_global = util::get_or_create_global(
+        ctx.module,
+        &get_migrate_global_name(block, version),
+        &flag_type,
+    );
+    migrate_global.set_initializer(&flag_type.const_int(0, false));
+
+    let is_migrating = ctx
+        .b
+        .build_load(&migrate_global.as_pointer_value(), "migrating")
+        .into_int_value();
+    let migrate_block = ctx.context.append_basic_block(&ctx.func, "migrate");
+    let run_block = ctx.context.append_basic_block(&ctx.func, "run");
+    ctx.b
+        .build_conditional_branch(&is_migrating, &migrate_block, &run_block);
+    ctx.b.position_at_end(&migrate_block);
+    ctx.b.build_return(None);
+    ctx.b.position_at_end(&run_block);
+}
+
 fn get_lifecycle_func(
     module: &Module,
     cache: &ObjectCache,
     block: BlockRef,
     lifecycle: LifecycleFunc,
 ) -> FunctionValue {
-    let func_name = format!("maxim.block.{}.{}", block, lifecycle);
+    let func_name = format!(
+        "maxim.block.{}.{:x}.{}",
+        block,
+        cache.block_version(block),
+        lifecycle
+    );
     util::get_or_create_func(module, &func_name, true, &|| {
         let context = module.get_context();
         let layout = cache.block_layout(block).unwrap();
@@ -100,7 +134,11 @@ fn build_lifecycle_func(
     cb: &Fn(&mut BlockContext),
 ) {
     let func = get_lifecycle_func(module, cache, block, lifecycle);
-    build_context_function(module, func, cache.target(), &|ctx: BuilderContext| {
+    build_context_function(module, func, cache.target(), &|mut ctx: BuilderContext| {
+        if lifecycle != LifecycleFunc::Update {
+            build_migrate_check(&mut ctx, block, cache.block_version(block));
+        }
+
         let layout = cache.block_layout(block).unwrap();
         let pointers_ptr = ctx.func.get_nth_param(0).unwrap().into_pointer_value();
         let mut ctx = BlockContext::new(ctx, layout, pointers_ptr);
@@ -190,14 +228,89 @@ pub fn build_update_func(module: &Module, cache: &ObjectCache, block: &Block) {
                 }
             }
 
-            for (statement_index, statement) in block.statements.iter().enumerate() {
-                let statement_result = gen_statement(statement_index, statement, block_ctx);
-                block_ctx.push_statement(statement_result);
+            let layout = block_ctx.layout;
+            match layout.control_rate {
+                Some(ref control_rate) => {
+                    build_rate_split_statements(block, control_rate, block_ctx)
+                }
+                None => {
+                    for (statement_index, statement) in block.statements.iter().enumerate() {
+                        let statement_result = gen_statement(statement_index, statement, block_ctx);
+                        block_ctx.push_statement(statement_result);
+                    }
+                }
             }
         },
     )
 }
 
+// Control-rate statements are moved behind a check so they only run when a value they read has
+// changed, and at most once every control-rate interval. Their results are kept in the block's
+// scratch, which is where audio-rate statements read them from.
+fn build_rate_split_statements(
+    block: &Block,
+    layout: &ControlRateLayout,
+    block_ctx: &mut BlockContext,
+) {
+    for (statement_index, statement) in block.statements.iter().enumerate() {
+        if layout.eager[statement_index] {
+            let statement_result = gen_statement(statement_index, statement, block_ctx);
+            block_ctx.set_statement(statement_index, statement_result);
+        }
+    }
+
+    let cache_ptr = block_ctx.get_function_ptr(layout.cache_index);
+    let key_ptrs: Vec<_> = layout
+        .keys
+        .iter()
+        .map(|&index| block_ctx.get_statement(index))
+        .collect();
+    let needs_update =
+        control_rate::build_needs_update(&mut block_ctx.ctx, block, layout, cache_ptr, &key_ptrs);
+
+    let update_block = block_ctx
+        .ctx
+        .context
+        .append_basic_block(&block_ctx.ctx.func, "controlrate.update");
+    let run_block = block_ctx
+        .ctx
+        .context
+        .append_basic_block(&block_ctx.ctx.func, "controlrate.run");
+    block_ctx
+        .ctx
+        .b
+        .build_conditional_branch(&needs_update, &update_block, &run_block);
+
+    block_ctx.ctx.b.position_at_end(&update_block);
+    for (statement_index, statement) in block.statements.iter().enumerate() {
+        if layout.is_hoisted(statement_index) {
+            let statement_result = gen_statement(statement_index, statement, block_ctx);
+            block_ctx.set_statement(statement_index, statement_result);
+        }
+    }
+    let output_ptrs: Vec<_> = layout
+        .outputs
+        .iter()
+        .map(|&index| block_ctx.get_statement(index))
+        .collect();
+    control_rate::build_update_cache(&mut block_ctx.ctx, cache_ptr, &key_ptrs, &output_ptrs);
+    block_ctx.ctx.b.build_unconditional_branch(&run_block);
+
+    // values computed in the update block don't exist on the other path, so outputs are always
+    // read back from the cache
+    block_ctx.ctx.b.position_at_end(&run_block);
+    for (output_index, &statement_index) in layout.outputs.iter().enumerate() {
+        let output_ptr = control_rate::get_output_ptr(&mut block_ctx.ctx, cache_ptr, output_index);
+        block_ctx.set_statement(statement_index, output_ptr);
+    }
+    for (statement_index, statement) in block.statements.iter().enumerate() {
+        if !layout.eager[statement_index] && !layout.is_hoisted(statement_index) {
+            let statement_result = gen_statement(statement_index, statement, block_ctx);
+            block_ctx.set_statement(statement_index, statement_result);
+        }
+    }
+}
+
 pub fn build_destruct_func(module: &Module, cache: &ObjectCache, block: &Block) {
     build_lifecycle_func(
         module,
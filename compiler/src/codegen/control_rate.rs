@@ -0,0 +1,349 @@
+use ast::{AudioField, ControlField, ControlType};
+use codegen::values::{remap_type, NumValue, TupleValue};
+use codegen::{globals, util, BuilderContext};
+use inkwell::context::Context;
+use inkwell::types::{BasicType, StructType};
+use inkwell::values::{IntValue, PointerValue};
+use inkwell::{AddressSpace, IntPredicate};
+use mir::block::{Function, Statement};
+use mir::{Block, VarType};
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord)]
+pub enum StatementRate {
+    /// The statement always has the same value.
+    Constant,
+    /// The statement only changes when a control value, global or MIDI note it reads changes.
+    Control,
+    /// The statement has to run every sample.
+    Audio,
+}
+
+/// Describes how the statements in a block are split by rate.
+///
+///  - `eager` statements run every sample before the cache is checked: constants, the `keys` that
+///    decide if the cached values are stale, and anything the keys read from.
+///  - Control-rate statements that aren't eager only run when the cache is stale.
+///  - `outputs` are the control-rate statements that audio-rate statements read, which are kept in
+///    the cache between updates.
+#[derive(Debug, Clone)]
+pub struct ControlRateLayout {
+    pub rates: Vec<StatementRate>,
+    pub eager: Vec<bool>,
+    pub keys: Vec<usize>,
+    pub outputs: Vec<usize>,
+    pub cache_index: usize,
+}
+
+impl ControlRateLayout {
+    pub fn is_hoisted(&self, statement: usize) -> bool {
+        self.rates[statement] == StatementRate::Control && !self.eager[statement]
+    }
+}
+
+fn reads_unwritten_control(block: &Block, statement: usize) -> bool {
+    match block.statements[statement] {
+        Statement::LoadControl { control, .. } => !block.controls[control].value_written,
+        _ => false,
+    }
+}
+
+fn get_rate(block: &Block, rates: &[StatementRate], statement: &Statement) -> StatementRate {
+    match statement {
+        Statement::Constant(_) => StatementRate::Constant,
+        Statement::Global(_) => StatementRate::Control,
+
+        // Knob values that aren't connected or exposed only change when the editor sets them
+        // between buffers. Anything else could be driven by another block every sample.
+        Statement::LoadControl {
+            control,
+            field: ControlField::Audio(AudioField::Value),
+        } if block.controls[*control].control_type == ControlType::Audio
+            && block.controls[*control].value_static
+            && !block.controls[*control].value_written =>
+        {
+            StatementRate::Control
+        }
+        Statement::LoadControl { .. } | Statement::StoreControl { .. } => StatementRate::Audio,
+
+        // The note function has to see every MIDI event, but its outputs only change on a note
+        Statement::CallFunc {
+            function: Function::Note,
+            args,
+            ..
+        } if reads_unwritten_control(block, args[0]) => StatementRate::Control,
+        Statement::CallFunc { function, .. } if !function.is_pure() => StatementRate::Audio,
+
+        // Converters between time-based forms read the BPM and sample rate globals themselves,
+        // which aren't keys, so a cached conversion wouldn't see them change.
+        Statement::NumConvert { .. } => StatementRate::Audio,
+
+        _ => statement
+            .refs()
+            .into_iter()
+            .map(|index| rates[index])
+            .max()
+            .unwrap_or(StatementRate::Constant),
+    }
+}
+
+fn is_key(statement: &Statement) -> bool {
+    match statement {
+        Statement::Global(_) | Statement::LoadControl { .. } => true,
+        Statement::CallFunc {
+            function: Function::Note,
+            ..
+        } => true,
+        _ => false,
+    }
+}
+
+pub fn classify_statements(block: &Block) -> Vec<StatementRate> {
+    let mut rates = Vec::with_capacity(block.statements.len());
+    for statement in &block.statements {
+        let rate = get_rate(block, &rates, statement);
+        rates.push(rate);
+    }
+    rates
+}
+
+/// Returns how to split the block's statements by rate, or None if there's no control-rate work
+/// worth moving out of the audio-rate path.
+pub fn build_layout(block: &Block) -> Option<ControlRateLayout> {
+    let rates = classify_statements(block);
+    let keys: Vec<_> = block
+        .statements
+        .iter()
+        .enumerate()
+        .filter(|(index, statement)| rates[*index] == StatementRate::Control && is_key(statement))
+        .map(|(index, _)| index)
+        .collect();
+
+    // keys only ever read from statements without inputs, so this doesn't need to be transitive
+    let mut eager: Vec<_> = rates
+        .iter()
+        .map(|&rate| rate == StatementRate::Constant)
+        .collect();
+    for &key in &keys {
+        eager[key] = true;
+        for input in block.statements[key].refs() {
+            eager[input] = true;
+        }
+    }
+
+    let mut layout = ControlRateLayout {
+        rates,
+        eager,
+        keys,
+        outputs: Vec::new(),
+        cache_index: 0,
+    };
+    let mut is_output = vec![false; block.statements.len()];
+    for (index, statement) in block.statements.iter().enumerate() {
+        if layout.eager[index] || layout.is_hoisted(index) {
+            continue;
+        }
+
+        for input in statement.refs() {
+            if layout.is_hoisted(input) {
+                is_output[input] = true;
+            }
+        }
+    }
+    layout.outputs = (0..block.statements.len())
+        .filter(|&index| is_output[index])
+        .collect();
+
+    if layout.outputs.is_empty() {
+        None
+    } else {
+        Some(layout)
+    }
+}
+
+// The cache is kept in the block's scratch, so it starts zeroed and invalid:
+//  - Samples until the next update is allowed
+//  - If the cached values have been set
+//  - The key values from the last update
+//  - The output values from the last update
+pub fn get_cache_type(context: &Context, block: &Block, layout: &ControlRateLayout) -> StructType {
+    let get_struct = |statements: &[usize]| {
+        let types: Vec<_> = statements
+            .iter()
+            .map(|&index| remap_type(context, &VarType::of_statement(block, index)))
+            .collect();
+        let type_refs: Vec<_> = types.iter().map(|t| t as &BasicType).collect();
+        context.struct_type(&type_refs, false)
+    };
+
+    context.struct_type(
+        &[
+            &context.i32_type(),
+            &context.bool_type(),
+            &get_struct(&layout.keys),
+            &get_struct(&layout.outputs),
+        ],
+        false,
+    )
+}
+
+fn get_cached_ptr(
+    ctx: &mut BuilderContext,
+    cache_ptr: PointerValue,
+    group: u32,
+    index: usize,
+) -> PointerValue {
+    unsafe {
+        ctx.b.build_in_bounds_gep(
+            &cache_ptr,
+            &[
+                ctx.context.i32_type().const_int(0, false),
+                ctx.context.i32_type().const_int(group as u64, false),
+                ctx.context.i32_type().const_int(index as u64, false),
+            ],
+            "controlrate.cached.ptr",
+        )
+    }
+}
+
+pub fn get_output_ptr(
+    ctx: &mut BuilderContext,
+    cache_ptr: PointerValue,
+    output: usize,
+) -> PointerValue {
+    get_cached_ptr(ctx, cache_ptr, 3, output)
+}
+
+// Values are compared bit-for-bit, so changes that compare equal as floats (like -0 to 0) are
+// still seen.
+fn build_value_changed(
+    ctx: &mut BuilderContext,
+    value_type: &VarType,
+    new_ptr: PointerValue,
+    cached_ptr: PointerValue,
+) -> IntValue {
+    match value_type {
+        VarType::Num => {
+            let new_num = NumValue::new(new_ptr);
+            let cached_num = NumValue::new(cached_ptr);
+            let bits_ptr_type = ctx.context.i64_type().ptr_type(AddressSpace::Generic);
+
+            let new_vec_ptr = new_num.get_vec_ptr(ctx.b);
+            let new_bits_ptr = ctx.b.build_pointer_cast(new_vec_ptr, bits_ptr_type, "");
+            let new_bits = ctx.b.build_load(&new_bits_ptr, "new.bits").into_int_value();
+            let cached_vec_ptr = cached_num.get_vec_ptr(ctx.b);
+            let cached_bits_ptr = ctx.b.build_pointer_cast(cached_vec_ptr, bits_ptr_type, "");
+            let cached_bits = ctx
+                .b
+                .build_load(&cached_bits_ptr, "cached.bits")
+                .into_int_value();
+            let vec_changed =
+                ctx.b
+                    .build_int_compare(IntPredicate::NE, new_bits, cached_bits, "vecchanged");
+
+            let new_form = new_num.get_form(ctx.b);
+            let cached_form = cached_num.get_form(ctx.b);
+            let form_changed =
+                ctx.b
+                    .build_int_compare(IntPredicate::NE, new_form, cached_form, "formchanged");
+            ctx.b.build_or(vec_changed, form_changed, "changed")
+        }
+        VarType::Tuple(items) => {
+            let new_tuple = TupleValue::new(new_ptr);
+            let cached_tuple = TupleValue::new(cached_ptr);
+            let mut changed = ctx.context.bool_type().const_int(0, false);
+            for (index, item_type) in items.iter().enumerate() {
+                let new_item_ptr = new_tuple.get_item_ptr(ctx.b, index);
+                let cached_item_ptr = cached_tuple.get_item_ptr(ctx.b, index);
+                let item_changed =
+                    build_value_changed(ctx, item_type, new_item_ptr, cached_item_ptr);
+                changed = ctx.b.build_or(changed, item_changed, "changed");
+            }
+            changed
+        }
+        _ => unreachable!("Only numbers and tuples of numbers can be control-rate keys"),
+    }
+}
+
+/// Returns if the hoisted statements need to run this sample. They run when any key has changed
+/// since the last update, but at most once every control-rate interval.
+pub fn build_needs_update(
+    ctx: &mut BuilderContext,
+    block: &Block,
+    layout: &ControlRateLayout,
+    cache_ptr: PointerValue,
+    key_ptrs: &[PointerValue],
+) -> IntValue {
+    let countdown_ptr = unsafe { ctx.b.build_struct_gep(&cache_ptr, 0, "countdown.ptr") };
+    let countdown = ctx
+        .b
+        .build_load(&countdown_ptr, "countdown")
+        .into_int_value();
+    let is_due = ctx.b.build_int_compare(
+        IntPredicate::EQ,
+        countdown,
+        ctx.context.i32_type().const_int(0, false),
+        "isdue",
+    );
+    let valid_ptr = unsafe { ctx.b.build_struct_gep(&cache_ptr, 1, "valid.ptr") };
+    let is_valid = ctx.b.build_load(&valid_ptr, "valid").into_int_value();
+    let mut is_stale = ctx.b.build_not(&is_valid, "stale");
+    for (key_index, &statement) in layout.keys.iter().enumerate() {
+        let cached_ptr = get_cached_ptr(ctx, cache_ptr, 2, key_index);
+        let key_changed = build_value_changed(
+            ctx,
+            &VarType::of_statement(block, statement),
+            key_ptrs[key_index],
+            cached_ptr,
+        );
+        is_stale = ctx.b.build_or(is_stale, key_changed, "stale");
+    }
+
+    // the countdown only restarts when an update runs, otherwise a change seen once the block is
+    // due gets picked up straight away
+    let needs_update = ctx.b.build_and(is_due, is_stale, "needsupdate");
+    let interval = ctx
+        .b
+        .build_load(
+            &globals::get_control_rate_interval(ctx.module).as_pointer_value(),
+            "interval",
+        ).into_int_value();
+    let one = ctx.context.i32_type().const_int(1, false);
+    let restart_countdown = ctx.b.build_int_sub(interval, one, "restartcountdown");
+    let next_countdown = ctx.b.build_int_sub(countdown, one, "nextcountdown");
+    let idle_countdown = ctx.b.build_select(
+        is_due,
+        ctx.context.i32_type().const_int(0, false),
+        next_countdown,
+        "idlecountdown",
+    );
+    let new_countdown = ctx.b.build_select(
+        needs_update,
+        restart_countdown,
+        idle_countdown.into_int_value(),
+        "newcountdown",
+    );
+    ctx.b.build_store(&countdown_ptr, &new_countdown);
+
+    needs_update
+}
+
+/// Stores the current keys and the freshly computed outputs in the cache.
+pub fn build_update_cache(
+    ctx: &mut BuilderContext,
+    cache_ptr: PointerValue,
+    key_ptrs: &[PointerValue],
+    output_ptrs: &[PointerValue],
+) {
+    for (key_index, &key_ptr) in key_ptrs.iter().enumerate() {
+        let cached_ptr = get_cached_ptr(ctx, cache_ptr, 2, key_index);
+        util::copy_ptr(ctx.b, ctx.module, key_ptr, cached_ptr);
+    }
+    for (output_index, &output_ptr) in output_ptrs.iter().enumerate() {
+        let cached_ptr = get_output_ptr(ctx, cache_ptr, output_index);
+        util::copy_ptr(ctx.b, ctx.module, output_ptr, cached_ptr);
+    }
+
+    let valid_ptr = unsafe { ctx.b.build_struct_gep(&cache_ptr, 1, "valid.ptr") };
+    ctx.b
+        .build_store(&valid_ptr, &ctx.context.bool_type().const_int(1, false));
+}
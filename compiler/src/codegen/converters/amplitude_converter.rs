@@ -1,10 +1,12 @@
 use super::ConvertGenerator;
 use ast::FormType;
-use codegen::{intrinsics, util};
+use codegen::math::{self, MathAccuracy};
+use codegen::util;
 use inkwell::builder::Builder;
 use inkwell::context::Context;
 use inkwell::module::Module;
 use inkwell::values::VectorValue;
+use std::f32::consts;
 
 pub fn amplitude(generator: &mut ConvertGenerator) {
     generator.generate(FormType::Db, &amplitude_from_db);
@@ -16,14 +18,16 @@ fn amplitude_from_db(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let pow_intrinsic = intrinsics::pow_v2f32(module);
+    // 10^(x/20) = 2^(x * log2(10) / 20)
+    let exp2_func = math::exp2_v2f32(module, MathAccuracy::Precise);
     builder
         .build_call(
-            &pow_intrinsic,
-            &[
-                &util::get_vec_spread(context, 10.),
-                &builder.build_float_div(val, util::get_vec_spread(context, 20.), ""),
-            ],
+            &exp2_func,
+            &[&builder.build_float_mul(
+                val,
+                util::get_vec_spread(context, consts::LOG2_10 / 20.),
+                "",
+            )],
             "",
             false,
         ).left()
@@ -1,6 +1,6 @@
 use super::ConvertGenerator;
 use ast::FormType;
-use codegen::intrinsics;
+use codegen::math::{self, MathAccuracy};
 use codegen::{globals, util};
 use inkwell::builder::Builder;
 use inkwell::context::Context;
@@ -34,16 +34,18 @@ fn control_from_db(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let pow_intrinsic = intrinsics::pow_v2f32(module);
+    // 10^(x/20) = 2^(x * log2(10) / 20)
+    let exp2_func = math::exp2_v2f32(module, MathAccuracy::Fast);
 
     builder.build_float_div(
         builder
             .build_call(
-                &pow_intrinsic,
-                &[
-                    &util::get_vec_spread(context, 10.),
-                    &builder.build_float_div(val, util::get_vec_spread(context, 20.), ""),
-                ],
+                &exp2_func,
+                &[&builder.build_float_mul(
+                    val,
+                    util::get_vec_spread(context, consts::LOG2_10 / 20.),
+                    "",
+                )],
                 "",
                 false,
             ).left()
@@ -60,19 +62,19 @@ fn control_from_frequency(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let log_intrinsic = intrinsics::log_v2f32(module);
+    let log2_func = math::log2_v2f32(module, MathAccuracy::Fast);
 
     builder.build_float_div(
         builder
             .build_call(
-                &log_intrinsic,
+                &log2_func,
                 &[&builder.build_float_add(val, util::get_vec_spread(context, 1.), "")],
                 "",
                 false,
             ).left()
             .unwrap()
             .into_vector_value(),
-        util::get_vec_spread(context, (20000 as f32).log(consts::E)),
+        util::get_vec_spread(context, (20000 as f32).log2()),
         "",
     )
 }
@@ -1,11 +1,12 @@
 use super::ConvertGenerator;
 use ast::FormType;
-use codegen::intrinsics;
+use codegen::math::{self, MathAccuracy};
 use codegen::util;
 use inkwell::builder::Builder;
 use inkwell::context::Context;
 use inkwell::module::Module;
 use inkwell::values::VectorValue;
+use std::f32::consts;
 
 pub fn db(generator: &mut ConvertGenerator) {
     generator.generate(FormType::Amplitude, &db_from_amplitude);
@@ -18,15 +19,16 @@ fn db_from_amplitude(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let log10_intrinsic = intrinsics::log10_v2f32(module);
+    // 20 log10(x) = 20 log10(2) log2(x)
+    let log2_func = math::log2_v2f32(module, MathAccuracy::Fast);
 
     builder.build_float_mul(
         builder
-            .build_call(&log10_intrinsic, &[&val], "", false)
+            .build_call(&log2_func, &[&val], "", false)
             .left()
             .unwrap()
             .into_vector_value(),
-        util::get_vec_spread(context, 20.),
+        util::get_vec_spread(context, 20. * consts::LOG10_2),
         "",
     )
 }
@@ -37,19 +39,19 @@ fn db_from_control(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let log10_intrinsic = intrinsics::log10_v2f32(module);
+    let log2_func = math::log2_v2f32(module, MathAccuracy::Fast);
 
     builder.build_float_mul(
         builder
             .build_call(
-                &log10_intrinsic,
+                &log2_func,
                 &[&builder.build_float_mul(val, util::get_vec_spread(context, 2.), "")],
                 "",
                 false,
             ).left()
             .unwrap()
             .into_vector_value(),
-        util::get_vec_spread(context, 20.),
+        util::get_vec_spread(context, 20. * consts::LOG10_2),
         "",
     )
 }
@@ -1,7 +1,7 @@
 use super::ConvertGenerator;
 use ast::FormType;
-use codegen::intrinsics;
-use codegen::{globals, util};
+use codegen::math::{self, MathAccuracy};
+use codegen::{globals, intrinsics, util};
 use inkwell::builder::Builder;
 use inkwell::context::Context;
 use inkwell::module::Module;
@@ -36,16 +36,16 @@ fn frequency_from_control(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let pow_intrinsic = intrinsics::pow_v2f32(module);
+    // 20000^x = 2^(x * log2(20000))
+    let exp2_func = math::exp2_v2f32(module, MathAccuracy::Precise);
     let min_intrinsic = intrinsics::minnum_v2f32(module);
 
     builder.build_float_sub(
         builder
             .build_call(
-                &pow_intrinsic,
-                &[
-                    &util::get_vec_spread(context, 20000.),
-                    &builder
+                &exp2_func,
+                &[&builder.build_float_mul(
+                    builder
                         .build_call(
                             &min_intrinsic,
                             &[&val, &util::get_vec_spread(context, 8.)],
@@ -54,7 +54,9 @@ fn frequency_from_control(
                         ).left()
                         .unwrap()
                         .into_vector_value(),
-                ],
+                    util::get_vec_spread(context, (20000 as f32).log2()),
+                    "",
+                )],
                 "",
                 false,
             ).left()
@@ -71,21 +73,18 @@ fn frequency_from_note(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let pow_intrinsic = intrinsics::pow_v2f32(module);
+    let exp2_func = math::exp2_v2f32(module, MathAccuracy::Precise);
 
     builder.build_float_mul(
         util::get_vec_spread(context, 440.),
         builder
             .build_call(
-                &pow_intrinsic,
-                &[
-                    &util::get_vec_spread(context, 2.),
-                    &builder.build_float_div(
-                        builder.build_float_sub(val, util::get_vec_spread(context, 69.), ""),
-                        util::get_vec_spread(context, 12.),
-                        "",
-                    ),
-                ],
+                &exp2_func,
+                &[&builder.build_float_div(
+                    builder.build_float_sub(val, util::get_vec_spread(context, 69.), ""),
+                    util::get_vec_spread(context, 12.),
+                    "",
+                )],
                 "",
                 false,
             ).left()
@@ -1,6 +1,7 @@
 use super::ConvertGenerator;
 use ast::FormType;
-use codegen::{intrinsics, util};
+use codegen::math::{self, MathAccuracy};
+use codegen::util;
 use inkwell::builder::Builder;
 use inkwell::context::Context;
 use inkwell::module::Module;
@@ -26,7 +27,7 @@ fn note_from_frequency(
     builder: &mut Builder,
     val: VectorValue,
 ) -> VectorValue {
-    let log2_intrinsic = intrinsics::log2_v2f32(module);
+    let log2_func = math::log2_v2f32(module, MathAccuracy::Precise);
 
     builder.build_float_add(
         util::get_vec_spread(context, 69.),
@@ -34,7 +35,7 @@ fn note_from_frequency(
             util::get_vec_spread(context, 12.),
             builder
                 .build_call(
-                    &log2_intrinsic,
+                    &log2_func,
                     &[&builder.build_float_div(val, util::get_vec_spread(context, 440.), "")],
                     "",
                     false,
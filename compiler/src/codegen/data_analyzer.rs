@@ -1,5 +1,6 @@
 use codegen::TargetProperties;
-use codegen::{controls, functions, values, ObjectCache};
+use codegen::control_rate::{self, ControlRateLayout};
+use codegen::{controls, functions, values, voice_sleep, ObjectCache};
 use inkwell::context::Context;
 use inkwell::types::{BasicType, BasicTypeEnum, StructType};
 use inkwell::values::{BasicValue, StructValue};
@@ -54,6 +55,7 @@ pub struct BlockLayout {
     pub pointer_struct: StructType,
     pub pointer_sources: Vec<PointerSource>,
     pub functions: Vec<Function>,
+    pub control_rate: Option<ControlRateLayout>,
     control_count: usize,
     func_indexes: HashMap<usize, usize>,
 }
@@ -66,6 +68,9 @@ pub struct SurfaceLayout {
     pub pointer_struct: StructType,
     pub pointer_sources: Vec<PointerSource>,
     pub node_layouts: Vec<NodeLayout>,
+
+    // Where each of the surface's value groups is stored.
+    pub group_pointers: Vec<PointerSource>,
     node_scratch_offset: usize,
     node_initializer_offset: usize,
 }
@@ -175,7 +180,7 @@ pub fn build_node_layout(
             // Note: we put the underlying surface's pointers first, as this enables value
             // read-back to read the first instance without any special behavior.
             // For the editor, we also want a pointer to the actual active state of the surface,
-            // which we'll put in the scratch.
+            // which we'll put in the scratch. Voice sleeping keeps its state in the scratch too.
             //
             // This array must match the struct defined below as `pointer_struct`.
             let pointer_sources = vec![
@@ -207,6 +212,7 @@ pub fn build_node_layout(
                         .collect(),
                 ),
                 PointerSource::Scratch(vec![1]),
+                PointerSource::Scratch(vec![2]),
             ];
 
             let source_socket_types: Vec<_> = source_sockets
@@ -239,6 +245,7 @@ pub fn build_node_layout(
                         .scratch_struct
                         .array_type(values::ARRAY_CAPACITY as u32),
                     &context.i32_type(),
+                    &voice_sleep::get_state_type(context),
                 ],
                 false,
             );
@@ -252,6 +259,7 @@ pub fn build_node_layout(
                     &context.struct_type(&source_type_refs, false) as &BasicType,
                     &context.struct_type(&dest_type_refs, false) as &BasicType,
                     &context.i32_type().ptr_type(AddressSpace::Generic),
+                    &voice_sleep::get_state_type(context).ptr_type(AddressSpace::Generic),
                 ],
                 false,
             );
@@ -323,6 +331,7 @@ fn map_extract_pointer_source(
 ///     - UI ptr    (points to scratch)
 ///  - Functions
 ///     - Data (points to scratch)
+///  - Control-rate cache (points to scratch, only if the block has control-rate statements)
 pub fn build_block_layout(
     context: &Context,
     block: &Block,
@@ -406,6 +415,16 @@ pub fn build_block_layout(
         }
     }
 
+    let mut control_rate = control_rate::build_layout(block);
+    if let Some(ref mut control_rate) = control_rate {
+        control_rate.cache_index = pointer_sources.len();
+        let cache_type = control_rate::get_cache_type(context, block, control_rate);
+        let scratch_index = scratch_types.len();
+        scratch_types.push(cache_type);
+        pointer_sources.push(PointerSource::Scratch(vec![scratch_index]));
+        pointer_types.push(cache_type.ptr_type(AddressSpace::Generic).into());
+    }
+
     let scratch_type_refs: Vec<_> = scratch_types.iter().map(|x| x as &BasicType).collect();
     let shared_type_refs: Vec<_> = shared_types.iter().map(|x| x as &BasicType).collect();
     let pointer_type_refs: Vec<_> = pointer_types.iter().map(|x| x as &BasicType).collect();
@@ -416,6 +435,7 @@ pub fn build_block_layout(
         pointer_struct: context.struct_type(&pointer_type_refs, false),
         pointer_sources,
         functions,
+        control_rate,
         control_count: block.controls.len(),
         func_indexes,
     }
@@ -520,6 +540,7 @@ pub fn build_surface_layout(cache: &ObjectCache, surface: &Surface) -> SurfaceLa
         pointer_struct: context.struct_type(&pointer_type_refs, false),
         node_layouts,
         pointer_sources,
+        group_pointers,
         node_scratch_offset,
         node_initializer_offset,
     }
@@ -631,6 +652,14 @@ impl SurfaceLayout {
         self.node_scratch_offset + node
     }
 
+    pub fn node_initialized_index(&self, node: usize) -> usize {
+        self.node_initializer_offset + node
+    }
+
+    pub fn node_shared_index(&self, node: usize) -> usize {
+        node
+    }
+
     pub fn node_ptr_index(&self, node: usize) -> usize {
         node
     }
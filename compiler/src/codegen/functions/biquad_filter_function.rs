@@ -1,4 +1,5 @@
 use super::{Function, FunctionContext, VarArgs};
+use codegen::math::{self, MathAccuracy};
 use codegen::values::NumValue;
 use codegen::{
     build_context_function, globals, intrinsics, util, BuilderContext, TargetProperties,
@@ -147,8 +148,8 @@ fn gen_biquad_call(
     generate_coefficients: &GenerateCoefficientsFn,
 ) {
     let max_intrinsic = intrinsics::maxnum_v2f32(func.ctx.module);
-    let sin_intrinsic = intrinsics::sin_v2f32(func.ctx.module);
-    let cos_intrinsic = intrinsics::cos_v2f32(func.ctx.module);
+    let sin_func = math::sin_v2f32(func.ctx.module, MathAccuracy::Precise);
+    let cos_func = math::cos_v2f32(func.ctx.module, MathAccuracy::Precise);
     let internal_biquad_func = get_internal_biquad_func(func.ctx.module);
 
     let a1_ptr = unsafe { func.ctx.b.build_struct_gep(&func.data_ptr, 0, "a1.ptr") };
@@ -311,7 +312,7 @@ fn gen_biquad_call(
     let alpha = func.ctx.b.build_float_div(
         func.ctx
             .b
-            .build_call(&sin_intrinsic, &[&w0], "", false)
+            .build_call(&sin_func, &[&w0], "", false)
             .left()
             .unwrap()
             .into_vector_value(),
@@ -325,7 +326,7 @@ fn gen_biquad_call(
     let cos_w0 = func
         .ctx
         .b
-        .build_call(&cos_intrinsic, &[&w0], "", false)
+        .build_call(&cos_func, &[&w0], "", false)
         .left()
         .unwrap()
         .into_vector_value();
@@ -1,5 +1,6 @@
 use super::{Function, FunctionContext, VarArgs};
 use ast::FormType;
+use codegen::math::{self, MathAccuracy};
 use codegen::values::NumValue;
 use codegen::{globals, intrinsics, util, BuilderContext};
 use inkwell::context::Context;
@@ -50,7 +51,7 @@ impl Function for AmplitudeFunction {
         result: PointerValue,
     ) {
         let abs_intrinsic = intrinsics::fabs_v2f32(func.ctx.module);
-        let exp_intrinsic = intrinsics::exp_v2f32(func.ctx.module);
+        let exp_func = math::exp_v2f32(func.ctx.module, MathAccuracy::Precise);
 
         let current_estimate_ptr = unsafe {
             func.ctx
@@ -81,7 +82,7 @@ impl Function for AmplitudeFunction {
             func.ctx
                 .b
                 .build_call(
-                    &exp_intrinsic,
+                    &exp_func,
                     &[&func.ctx.b.build_float_div(
                         util::get_vec_spread(func.ctx.context, -1.),
                         func.ctx.b.build_float_mul(
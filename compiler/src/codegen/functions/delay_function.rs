@@ -1,7 +1,7 @@
 use super::{Function, FunctionContext, VarArgs};
 use codegen::values::NumValue;
 use codegen::{
-    build_context_function, globals, intrinsics, util, BuilderContext, TargetProperties,
+    arena, build_context_function, globals, intrinsics, util, BuilderContext, TargetProperties,
 };
 use inkwell::context::Context;
 use inkwell::module::{Linkage, Module};
@@ -21,7 +21,7 @@ impl DelayFunction {
                     &[
                         &context.i64_type().ptr_type(AddressSpace::Generic), // current position pointer
                         &context.i64_type().ptr_type(AddressSpace::Generic), // current size pointer
-                        &context.i64_type(),                                 // delay sample count
+                        &context.f32_type(),                                 // delay sample count
                         &context.i64_type(),                                 // reserve sample count
                         &context
                             .f32_type()
@@ -37,34 +37,36 @@ impl DelayFunction {
 
     /// Builds a function that is equivalent to the following C++:
     /// ```cpp
-    /// float channelUpdate(uint64_t *currentPos, uint64_t *currentSize, uint64_t delaySamples, uint64_t reserveSamples, float **buffer, float input) {
-    ///     float resultVal;
+    /// float channelUpdate(uint64_t *currentPos, uint64_t *currentSize, float delaySamples, uint64_t reserveSamples, float **buffer, float input) {
+    ///     // the buffer only ever grows, so changing the reserve back and forth doesn't keep
+    ///     // reallocating it. Two extra samples leave room to interpolate at the full delay.
+    ///     auto bufferSize = calculateNextPowerOfTwo(reserveSamples + 2);
+    ///     if (bufferSize > *currentSize) {
+    ///         float *newBuffer = arenaAlloc(bufferSize * sizeof(float));
+    ///         memset(newBuffer, 0, bufferSize * sizeof(float));
     ///
-    ///     if (*currentSize) {
-    ///         uint64_t loadedCurrentPos = *currentPos;
-    ///         *currentPos = (loadedCurrentPos + 1) % *currentSize;
+    ///         // the samples behind the write position go at the end of the new buffer, so
+    ///         // they're still the same distance behind it
+    ///         auto tailStart = min(*currentPos + 1, *currentSize);
+    ///         auto tailLength = *currentSize - tailStart;
+    ///         memcpy(newBuffer, *buffer, tailStart * sizeof(float));
+    ///         memcpy(newBuffer + bufferSize - tailLength, *buffer + tailStart, tailLength * sizeof(float));
     ///
-    ///         if (delaySamples == 0) {
-    ///             resultVal = input;
-    ///         } else {
-    ///             auto readPosition = (loadedCurrentPos + *currentSize - delaySamples) % *currentSize;
-    ///             resultVal = (*buffer)[readPosition];
-    ///         }
-    ///
-    ///         (*buffer)[loadedCurrentPos] = input;
-    ///     } else {
-    ///         resultVal = input;
-    ///     }
-    ///
-    ///     auto bufferSize = calculateNextPowerOfTwo(reserveSamples);
-    ///     if (bufferSize != *currentSize) {
-    ///         *buffer = realloc(*buffer, bufferSize * sizeof(float));
-    ///         if (bufferSize == 0) *buffer = nullptr;
-    ///         else memset(*buffer + *currentSize, 0, (bufferSize - *currentSize) * sizeof(float));
+    ///         arenaFree(*buffer, *currentSize * sizeof(float));
+    ///         *buffer = newBuffer;
     ///         *currentSize = bufferSize;
     ///     }
     ///
-    ///     return resultVal;
+    ///     auto mask = *currentSize - 1;
+    ///     uint64_t writePos = *currentPos;
+    ///     (*buffer)[writePos] = input;
+    ///     *currentPos = (writePos + 1) & mask;
+    ///
+    ///     uint64_t wholeSamples = (uint64_t) delaySamples;
+    ///     float fraction = delaySamples - (float) wholeSamples;
+    ///     float newer = (*buffer)[(writePos - wholeSamples) & mask];
+    ///     float older = (*buffer)[(writePos - wholeSamples - 1) & mask];
+    ///     return newer + (older - newer) * fraction;
     /// }
     /// ```
     fn build_channel_update_func(module: &Module, target: &TargetProperties) {
@@ -72,294 +74,261 @@ impl DelayFunction {
         build_context_function(module, func, target, &|ctx: BuilderContext| {
             let target_data = target.machine.get_data();
             let next_power_intrinsic = intrinsics::next_power_i64(ctx.module);
-            let realloc_intrinsic = intrinsics::realloc(ctx.module, &target_data);
+            let alloc_func = arena::get_alloc_func(ctx.module);
+            let free_func = arena::get_free_func(ctx.module);
             let memset_intrinsic = intrinsics::memset(ctx.module, &target_data);
+            let memcpy_intrinsic = intrinsics::memcpy(ctx.module);
 
             let current_pos_ptr = ctx.func.get_nth_param(0).unwrap().into_pointer_value();
             let current_size_ptr = ctx.func.get_nth_param(1).unwrap().into_pointer_value();
-            let delay_samples = ctx.func.get_nth_param(2).unwrap().into_int_value();
+            let delay_samples = ctx.func.get_nth_param(2).unwrap().into_float_value();
             let reserve_samples = ctx.func.get_nth_param(3).unwrap().into_int_value();
             let buffer_ptr_ptr = ctx.func.get_nth_param(4).unwrap().into_pointer_value();
             let input_num = ctx.func.get_nth_param(5).unwrap().into_float_value();
 
-            let has_buffer_true_block = ctx.context.append_basic_block(&ctx.func, "hasbuffer.true");
-            let has_samples_true_block =
-                ctx.context.append_basic_block(&ctx.func, "hassamples.true");
-            let has_samples_false_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "hassamples.false");
-            let has_samples_continue_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "hassamples.continue");
-            let has_buffer_false_block =
-                ctx.context.append_basic_block(&ctx.func, "hasbuffer.false");
-            let has_buffer_continue_block = ctx
+            let needs_grow_true_block = ctx.context.append_basic_block(&ctx.func, "needsgrow.true");
+            let needs_grow_continue_block = ctx
                 .context
-                .append_basic_block(&ctx.func, "hasbuffer.continue");
-            let needs_realloc_true_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "needsrealloc.true");
-            let size_zero_true_block = ctx.context.append_basic_block(&ctx.func, "sizezero.true");
-            let size_zero_false_block = ctx.context.append_basic_block(&ctx.func, "sizezero.false");
-            let size_increase_true_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "sizeincrease.true");
-            let size_increase_continue_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "sizeincrease.continue");
-            let size_zero_continue_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "sizezero.continue");
-            let needs_realloc_continue_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "needsrealloc.continue");
+                .append_basic_block(&ctx.func, "needsgrow.continue");
 
-            let result_ptr = ctx
-                .allocb
-                .build_alloca(&ctx.context.f32_type(), "resultval");
-            let buffer_ptr = ctx
-                .b
-                .build_load(&buffer_ptr_ptr, "bufferptr")
-                .into_pointer_value();
+            let i64_type = ctx.context.i64_type();
+            let size_type = target_data.int_ptr_type_in_context(ctx.context);
+            let byte_ptr_type = ctx.context.i8_type().ptr_type(AddressSpace::Generic);
+            let buffer_ptr_type = ctx.context.f32_type().ptr_type(AddressSpace::Generic);
+            let float_size = ctx.context.f32_type().size_of().const_cast(&i64_type, false);
 
-            // if (*currentSize) {
             let current_size = ctx
                 .b
                 .build_load(&current_size_ptr, "currentsize")
                 .into_int_value();
-            let has_buffer = ctx.b.build_int_compare(
-                IntPredicate::UGT,
-                current_size,
-                ctx.context.i64_type().const_int(0, false),
-                "hasbuffer",
-            );
-            ctx.b.build_conditional_branch(
-                &has_buffer,
-                &has_buffer_true_block,
-                &has_buffer_false_block,
-            );
-
-            ctx.b.position_at_end(&has_buffer_true_block);
-
-            // uint64_t loadedCurrentPos = *currentPos;
             let current_pos = ctx
                 .b
                 .build_load(&current_pos_ptr, "currentpos")
                 .into_int_value();
 
-            // *currentPos = (loadedCurrentPos + 1) % *currentSize;
-            let new_pos = ctx.b.build_int_unsigned_rem(
-                ctx.b.build_int_nuw_add(
-                    current_pos,
-                    ctx.context.i64_type().const_int(1, false),
-                    "newpos.unbounded",
-                ),
-                current_size,
-                "newpos",
-            );
-            ctx.b.build_store(&current_pos_ptr, &new_pos);
-
-            // if (delaySamples == 0) {
-            let has_samples = ctx.b.build_int_compare(
-                IntPredicate::NE,
-                delay_samples,
-                ctx.context.i64_type().const_int(0, false),
-                "hassamples",
-            );
-            ctx.b.build_conditional_branch(
-                &has_samples,
-                &has_samples_true_block,
-                &has_samples_false_block,
-            );
-
-            ctx.b.position_at_end(&has_samples_true_block);
-
-            // auto readPosition = (loadedCurrentPos + *currentSize - delaySamples) % delaySamples;
-            let read_position = ctx.b.build_int_unsigned_rem(
-                ctx.b.build_int_sub(
-                    ctx.b.build_int_add(current_pos, current_size, ""),
-                    delay_samples,
-                    "",
-                ),
-                current_size,
-                "readposition",
-            );
-
-            // resultVal = (*buffer)[readPosition];
-            let result_val = ctx
-                .b
-                .build_load(
-                    &unsafe {
-                        ctx.b
-                            .build_in_bounds_gep(&buffer_ptr, &[read_position], "result.ptr")
-                    },
-                    "result",
-                ).into_float_value();
-            ctx.b.build_store(&result_ptr, &result_val);
-            ctx.b
-                .build_unconditional_branch(&has_samples_continue_block);
-
-            // } else {
-            ctx.b.position_at_end(&has_samples_false_block);
-
-            // resultVal = input;
-            ctx.b.build_store(&result_ptr, &input_num);
-            ctx.b
-                .build_unconditional_branch(&has_samples_continue_block);
-
-            // }
-            ctx.b.position_at_end(&has_samples_continue_block);
-
-            // (*buffer)[loadedCurrentPos] = input;
-            ctx.b.build_store(
-                &unsafe {
-                    ctx.b
-                        .build_in_bounds_gep(&buffer_ptr, &[current_pos], "write.ptr")
-                },
-                &input_num,
-            );
-            ctx.b.build_unconditional_branch(&has_buffer_continue_block);
-
-            ctx.b.position_at_end(&has_buffer_false_block);
-
-            // resultVal = input;
-            ctx.b.build_store(&result_ptr, &input_num);
-            ctx.b.build_unconditional_branch(&has_buffer_continue_block);
-
-            ctx.b.position_at_end(&has_buffer_continue_block);
-
-            // auto bufferSize = calculateNextPowerOfTwo(reserveSamples);
+            // auto bufferSize = calculateNextPowerOfTwo(reserveSamples + 2);
             let new_buffer_size = ctx
                 .b
                 .build_call(
                     &next_power_intrinsic,
-                    &[&reserve_samples],
+                    &[&ctx.b.build_int_nuw_add(
+                        reserve_samples,
+                        i64_type.const_int(2, false),
+                        "",
+                    )],
                     "newbuffersize",
                     false,
                 ).left()
                 .unwrap()
                 .into_int_value();
 
-            // if (bufferSize != *currentSize) {
-            let needs_realloc = ctx.b.build_int_compare(
-                IntPredicate::NE,
+            // if (bufferSize > *currentSize) {
+            let needs_grow = ctx.b.build_int_compare(
+                IntPredicate::UGT,
                 new_buffer_size,
                 current_size,
-                "needsrealloc",
+                "needsgrow",
             );
             ctx.b.build_conditional_branch(
-                &needs_realloc,
-                &needs_realloc_true_block,
-                &needs_realloc_continue_block,
+                &needs_grow,
+                &needs_grow_true_block,
+                &needs_grow_continue_block,
             );
 
-            ctx.b.position_at_end(&needs_realloc_true_block);
+            ctx.b.position_at_end(&needs_grow_true_block);
 
-            // *buffer = realloc(*buffer, bufferSize * sizeof(float));
-            let size_type = target_data.int_ptr_type_in_context(ctx.context);
-            let float_size = ctx
-                .context
-                .f32_type()
-                .size_of()
-                .const_cast(&size_type, false);
-            let realloc_size = ctx.b.build_int_mul(
-                ctx.b.build_int_cast(new_buffer_size, size_type, ""),
-                float_size,
-                "",
-            );
-            let realloc_ptr = ctx
+            // float *newBuffer = arenaAlloc(bufferSize * sizeof(float));
+            // memset(newBuffer, 0, bufferSize * sizeof(float));
+            let old_buffer_ptr = ctx
                 .b
-                .build_call(
-                    &realloc_intrinsic,
-                    &[
-                        &ctx.b.build_pointer_cast(
-                            buffer_ptr,
-                            ctx.context.i8_type().ptr_type(AddressSpace::Generic),
-                            "",
-                        ),
-                        &realloc_size,
-                    ],
-                    "",
-                    false,
-                ).left()
+                .build_load(&buffer_ptr_ptr, "oldbufferptr")
+                .into_pointer_value();
+            let old_bytes_ptr = ctx.b.build_pointer_cast(old_buffer_ptr, byte_ptr_type, "");
+            let new_size_bytes =
+                ctx.b
+                    .build_int_mul(new_buffer_size, float_size, "newsizebytes");
+            let current_size_bytes =
+                ctx.b
+                    .build_int_mul(current_size, float_size, "currentsizebytes");
+            let new_bytes_ptr = ctx
+                .b
+                .build_call(&alloc_func, &[&new_size_bytes], "newbuffer", false)
+                .left()
                 .unwrap()
                 .into_pointer_value();
-
-            // if (bufferSize == 0) *buffer = nullptr;
-            let size_is_zero = ctx.b.build_int_compare(
-                IntPredicate::EQ,
-                realloc_size,
-                size_type.const_int(0, false),
-                "sizezero",
-            );
-            ctx.b.build_conditional_branch(
-                &size_is_zero,
-                &size_zero_true_block,
-                &size_zero_false_block,
+            ctx.b.build_call(
+                &memset_intrinsic,
+                &[
+                    &new_bytes_ptr,
+                    &ctx.context.i8_type().const_int(0, false),
+                    &ctx.b.build_int_cast(new_size_bytes, size_type, ""),
+                    &ctx.context.i32_type().const_int(0, false),
+                    &ctx.context.bool_type().const_int(0, false),
+                ],
+                "",
+                false,
             );
 
-            let buffer_ptr_type = ctx.context.f32_type().ptr_type(AddressSpace::Generic);
-
-            ctx.b.position_at_end(&size_zero_true_block);
-            ctx.b
-                .build_store(&buffer_ptr_ptr, &buffer_ptr_type.const_null());
-            ctx.b.build_unconditional_branch(&size_zero_continue_block);
+            // auto tailStart = min(*currentPos + 1, *currentSize);
+            // auto tailLength = *currentSize - tailStart;
+            let tail_start = ctx
+                .b
+                .build_int_nuw_add(current_pos, i64_type.const_int(1, false), "");
+            let tail_start_in_buffer =
+                ctx.b
+                    .build_int_compare(IntPredicate::ULT, tail_start, current_size, "");
+            let tail_start = ctx
+                .b
+                .build_select(tail_start_in_buffer, tail_start, current_size, "tailstart")
+                .into_int_value();
+            let tail_length = ctx
+                .b
+                .build_int_sub(current_size, tail_start, "taillength");
+            let tail_start_bytes = ctx.b.build_int_mul(tail_start, float_size, "");
+            let tail_length_bytes = ctx.b.build_int_mul(tail_length, float_size, "");
 
-            // else if (bufferSize > *currentSize) memset(*buffer + *currentSize, 0, (bufferSize - *currentSize) * sizeof(float));
-            ctx.b.position_at_end(&size_zero_false_block);
-            let size_increase = ctx.b.build_int_compare(
-                IntPredicate::UGT,
-                new_buffer_size,
-                current_size,
-                "sizeincrease",
-            );
-            ctx.b.build_conditional_branch(
-                &size_increase,
-                &size_increase_true_block,
-                &size_increase_continue_block,
+            // memcpy(newBuffer, *buffer, tailStart * sizeof(float));
+            ctx.b.build_call(
+                &memcpy_intrinsic,
+                &[
+                    &new_bytes_ptr,
+                    &old_bytes_ptr,
+                    &tail_start_bytes,
+                    &ctx.context.i32_type().const_int(0, false),
+                    &ctx.context.bool_type().const_int(0, false),
+                ],
+                "",
+                false,
             );
 
-            ctx.b.position_at_end(&size_increase_true_block);
-            let current_size_bytes = ctx.b.build_int_mul(
-                ctx.b.build_int_cast(current_size, size_type, ""),
-                float_size,
-                "currentsizebytes",
-            );
+            // memcpy(newBuffer + bufferSize - tailLength, *buffer + tailStart, tailLength * sizeof(float));
             ctx.b.build_call(
-                &memset_intrinsic,
+                &memcpy_intrinsic,
                 &[
+                    &unsafe {
+                        ctx.b.build_in_bounds_gep(
+                            &new_bytes_ptr,
+                            &[ctx.b.build_int_sub(new_size_bytes, tail_length_bytes, "")],
+                            "newtail.ptr",
+                        )
+                    },
                     &unsafe {
                         ctx.b
-                            .build_in_bounds_gep(&realloc_ptr, &[current_size_bytes], "offsetptr")
+                            .build_in_bounds_gep(&old_bytes_ptr, &[tail_start_bytes], "tail.ptr")
                     },
-                    &ctx.context.i8_type().const_int(0, false),
-                    &ctx.b.build_int_sub(realloc_size, current_size_bytes, ""),
+                    &tail_length_bytes,
                     &ctx.context.i32_type().const_int(0, false),
                     &ctx.context.bool_type().const_int(0, false),
                 ],
                 "",
                 false,
             );
-            ctx.b
-                .build_unconditional_branch(&size_increase_continue_block);
 
-            ctx.b.position_at_end(&size_increase_continue_block);
+            // arenaFree(*buffer, *currentSize * sizeof(float));
+            // *buffer = newBuffer;
+            ctx.b
+                .build_call(&free_func, &[&old_bytes_ptr, &current_size_bytes], "", false);
             ctx.b.build_store(
                 &buffer_ptr_ptr,
                 &ctx.b
-                    .build_pointer_cast(realloc_ptr, buffer_ptr_type, "newbufferptr"),
+                    .build_pointer_cast(new_bytes_ptr, buffer_ptr_type, "newbufferptr"),
             );
-            ctx.b.build_unconditional_branch(&size_zero_continue_block);
-
-            ctx.b.position_at_end(&size_zero_continue_block);
-
             // *currentSize = bufferSize;
             ctx.b.build_store(&current_size_ptr, &new_buffer_size);
-            ctx.b
-                .build_unconditional_branch(&needs_realloc_continue_block);
+            ctx.b.build_unconditional_branch(&needs_grow_continue_block);
+
+            ctx.b.position_at_end(&needs_grow_continue_block);
 
-            ctx.b.position_at_end(&needs_realloc_continue_block);
-            ctx.b.build_return(Some(&ctx.b.build_load(&result_ptr, "")));
+            // auto mask = *currentSize - 1;
+            let buffer_size = ctx
+                .b
+                .build_load(&current_size_ptr, "buffersize")
+                .into_int_value();
+            let mask = ctx
+                .b
+                .build_int_sub(buffer_size, i64_type.const_int(1, false), "mask");
+            let buffer_ptr = ctx
+                .b
+                .build_load(&buffer_ptr_ptr, "bufferptr")
+                .into_pointer_value();
+
+            // (*buffer)[writePos] = input;
+            ctx.b.build_store(
+                &unsafe {
+                    ctx.b
+                        .build_in_bounds_gep(&buffer_ptr, &[current_pos], "write.ptr")
+                },
+                &input_num,
+            );
+
+            // *currentPos = (writePos + 1) & mask;
+            let new_pos = ctx.b.build_and(
+                ctx.b
+                    .build_int_add(current_pos, i64_type.const_int(1, false), ""),
+                mask,
+                "newpos",
+            );
+            ctx.b.build_store(&current_pos_ptr, &new_pos);
+
+            // uint64_t wholeSamples = (uint64_t) delaySamples;
+            // float fraction = delaySamples - (float) wholeSamples;
+            let whole_samples =
+                ctx.b
+                    .build_float_to_unsigned_int(delay_samples, i64_type, "wholesamples");
+            let fraction = ctx.b.build_float_sub(
+                delay_samples,
+                ctx.b.build_unsigned_int_to_float(
+                    whole_samples,
+                    ctx.context.f32_type(),
+                    "",
+                ),
+                "fraction",
+            );
+
+            // float newer = (*buffer)[(writePos - wholeSamples) & mask];
+            let newer_pos = ctx.b.build_and(
+                ctx.b.build_int_sub(current_pos, whole_samples, ""),
+                mask,
+                "newerpos",
+            );
+            let newer = ctx
+                .b
+                .build_load(
+                    &unsafe {
+                        ctx.b
+                            .build_in_bounds_gep(&buffer_ptr, &[newer_pos], "newer.ptr")
+                    },
+                    "newer",
+                ).into_float_value();
+
+            // float older = (*buffer)[(writePos - wholeSamples - 1) & mask];
+            let older_pos = ctx.b.build_and(
+                ctx.b
+                    .build_int_sub(newer_pos, i64_type.const_int(1, false), ""),
+                mask,
+                "olderpos",
+            );
+            let older = ctx
+                .b
+                .build_load(
+                    &unsafe {
+                        ctx.b
+                            .build_in_bounds_gep(&buffer_ptr, &[older_pos], "older.ptr")
+                    },
+                    "older",
+                ).into_float_value();
+
+            // return newer + (older - newer) * fraction;
+            let result = ctx.b.build_float_add(
+                newer,
+                ctx.b.build_float_mul(
+                    ctx.b.build_float_sub(older, newer, ""),
+                    fraction,
+                    "",
+                ),
+                "result",
+            );
+            ctx.b.build_return(Some(&result));
         });
     }
 }
@@ -508,11 +477,6 @@ impl Function for DelayFunction {
             reserve_samples_float,
             "delaysamples.float",
         );
-        let delay_samples = func.ctx.b.build_float_to_unsigned_int(
-            delay_samples_float,
-            func.ctx.context.i64_type().vec_type(2),
-            "delaysamples.int",
-        );
 
         // update the buffer
         let input_vec = input_num.get_vec(func.ctx.b);
@@ -528,7 +492,7 @@ impl Function for DelayFunction {
                     &func
                         .ctx
                         .b
-                        .build_extract_element(&delay_samples, &left_element, ""),
+                        .build_extract_element(&delay_samples_float, &left_element, ""),
                     &func
                         .ctx
                         .b
@@ -557,7 +521,7 @@ impl Function for DelayFunction {
                     &func
                         .ctx
                         .b
-                        .build_extract_element(&delay_samples, &right_element, ""),
+                        .build_extract_element(&delay_samples_float, &right_element, ""),
                     &func
                         .ctx
                         .b
@@ -598,29 +562,47 @@ impl Function for DelayFunction {
     }
 
     fn gen_destruct(func: &mut FunctionContext) {
-        let left_buffer_ptr = func
+        let free_func = arena::get_free_func(func.ctx.module);
+        let byte_ptr_type = func.ctx.context.i8_type().ptr_type(AddressSpace::Generic);
+        let float_size = func
             .ctx
-            .b
-            .build_load(
-                &unsafe {
-                    func.ctx
-                        .b
-                        .build_struct_gep(&func.data_ptr, 4, "leftbuffer.ptr")
-                },
-                "leftbuffer",
-            ).into_pointer_value();
-        let right_buffer_ptr = func
-            .ctx
-            .b
-            .build_load(
-                &unsafe {
-                    func.ctx
-                        .b
-                        .build_struct_gep(&func.data_ptr, 5, "rightbuffer.ptr")
-                },
-                "rightbuffer",
-            ).into_pointer_value();
-        func.ctx.b.build_free(&left_buffer_ptr);
-        func.ctx.b.build_free(&right_buffer_ptr);
+            .context
+            .f32_type()
+            .size_of()
+            .const_cast(&func.ctx.context.i64_type(), false);
+
+        for (buffer_index, length_index) in [(4, 2), (5, 3)].iter().cloned() {
+            let buffer_ptr = func
+                .ctx
+                .b
+                .build_load(
+                    &unsafe {
+                        func.ctx
+                            .b
+                            .build_struct_gep(&func.data_ptr, buffer_index, "buffer.ptr")
+                    },
+                    "buffer",
+                ).into_pointer_value();
+            let buffer_length = func
+                .ctx
+                .b
+                .build_load(
+                    &unsafe {
+                        func.ctx
+                            .b
+                            .build_struct_gep(&func.data_ptr, length_index, "bufferlength.ptr")
+                    },
+                    "bufferlength",
+                ).into_int_value();
+            func.ctx.b.build_call(
+                &free_func,
+                &[
+                    &func.ctx.b.build_pointer_cast(buffer_ptr, byte_ptr_type, ""),
+                    &func.ctx.b.build_int_mul(buffer_length, float_size, ""),
+                ],
+                "",
+                false,
+            );
+        }
     }
 }
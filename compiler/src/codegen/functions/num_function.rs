@@ -1,6 +1,7 @@
 use super::{Function, FunctionContext, VarArgs};
 use ast::FormType;
 use codegen::values::{ArrayValue, NumValue, ARRAY_CAPACITY};
+use codegen::math::{self, MathAccuracy};
 use codegen::{intrinsics, util};
 use inkwell::module::Linkage;
 use inkwell::types::VectorType;
@@ -148,8 +149,7 @@ impl Function for PanFunction {
         let min_intrinsic = intrinsics::minnum_v2f32(func.ctx.module);
         let max_intrinsic = intrinsics::maxnum_v2f32(func.ctx.module);
         let sqrt_intrinsic = intrinsics::sqrt_v2f32(func.ctx.module);
-        let cos_intrinsic = intrinsics::cos_f32(func.ctx.module);
-        let sin_intrinsic = intrinsics::sin_f32(func.ctx.module);
+        let sin_func = math::sin_v2f32(func.ctx.module, MathAccuracy::Precise);
 
         let x_num = NumValue::new(args[0]);
         let pan_num = NumValue::new(args[1]);
@@ -183,88 +183,69 @@ impl Function for PanFunction {
             .unwrap()
             .into_vector_value();
 
+        // both channels are panned by the left pan value, and cos(angle) = sin(angle + pi/2), so
+        // the gains for both channels come from one call
         let left_index = func.ctx.context.i32_type().const_int(0, false);
+        let right_index = func.ctx.context.i32_type().const_int(1, false);
         let left_pan = func
             .ctx
             .b
             .build_extract_element(&clamped_pan, &left_index, "pan.left")
             .into_float_value();
-        let left_base = func.ctx.b.build_float_mul(
-            func.ctx
-                .b
-                .build_float_sub(func.ctx.context.f32_type().const_float(1.), left_pan, ""),
-            func.ctx
-                .b
-                .build_call(
-                    &cos_intrinsic,
-                    &[&func.ctx.b.build_float_mul(
-                        func.ctx
-                            .context
-                            .f32_type()
-                            .const_float(consts::PI as f64 / 4.),
-                        func.ctx.b.build_float_add(
-                            left_pan,
-                            func.ctx.context.f32_type().const_float(1.),
-                            "",
-                        ),
-                        "",
-                    )],
-                    "",
-                    false,
-                ).left()
-                .unwrap()
-                .into_float_value(),
-            "",
-        );
-
-        let right_index = func.ctx.context.i32_type().const_int(1, false);
         let right_pan = func
             .ctx
             .b
             .build_extract_element(&clamped_pan, &right_index, "pan.right")
             .into_float_value();
-        let right_base = func.ctx.b.build_float_mul(
-            func.ctx
-                .b
-                .build_float_add(func.ctx.context.f32_type().const_float(1.), right_pan, ""),
-            func.ctx
-                .b
-                .build_call(
-                    &sin_intrinsic,
-                    &[&func.ctx.b.build_float_mul(
-                        func.ctx
-                            .context
-                            .f32_type()
-                            .const_float(consts::PI as f64 / 4.),
-                        func.ctx.b.build_float_add(
-                            left_pan,
-                            func.ctx.context.f32_type().const_float(1.),
-                            "",
-                        ),
-                        "",
-                    )],
-                    "",
-                    false,
-                ).left()
-                .unwrap()
-                .into_float_value(),
+        let pan_angle = func.ctx.b.build_float_mul(
+            util::get_vec_spread(func.ctx.context, consts::PI / 4.),
+            func.ctx.b.build_float_add(
+                util::splat_vector(func.ctx.b, left_pan, "pan.left"),
+                util::get_vec_spread(func.ctx.context, 1.),
+                "",
+            ),
+            "",
+        );
+        let pan_angle = func.ctx.b.build_float_add(
+            pan_angle,
+            util::get_const_vec(func.ctx.context, consts::PI / 2., 0.),
             "",
         );
+        let pan_gain = func
+            .ctx
+            .b
+            .build_call(&sin_func, &[&pan_angle], "", false)
+            .left()
+            .unwrap()
+            .into_vector_value();
 
-        let base_vec = func
+        let side_vec = func
             .ctx
             .b
             .build_insert_element(
                 &func.ctx.context.f32_type().vec_type(2).get_undef(),
-                &left_base,
+                &func.ctx.b.build_float_sub(
+                    func.ctx.context.f32_type().const_float(1.),
+                    left_pan,
+                    "",
+                ),
                 &left_index,
                 "",
             ).into_vector_value();
-        let base_vec = func
+        let side_vec = func
             .ctx
             .b
-            .build_insert_element(&base_vec, &right_base, &right_index, "")
-            .into_vector_value();
+            .build_insert_element(
+                &side_vec,
+                &func.ctx.b.build_float_add(
+                    func.ctx.context.f32_type().const_float(1.),
+                    right_pan,
+                    "",
+                ),
+                &right_index,
+                "",
+            ).into_vector_value();
+        let base_vec = func.ctx.b.build_float_mul(side_vec, pan_gain, "");
 
         let multiplier_vec = func
             .ctx
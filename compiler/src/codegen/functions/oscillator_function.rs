@@ -1,10 +1,12 @@
 use super::{Function, FunctionContext, VarArgs};
 use ast::FormType;
+use codegen::math::{self, MathAccuracy};
 use codegen::values::NumValue;
 use codegen::{globals, intrinsics, util, BuilderContext};
+use inkwell::builder::Builder;
 use inkwell::context::Context;
 use inkwell::types::StructType;
-use inkwell::values::{PointerValue, VectorValue};
+use inkwell::values::{BasicValue, FunctionValue, PointerValue, VectorValue};
 use inkwell::FloatPredicate;
 use mir::block;
 use std::f32::consts;
@@ -31,11 +33,118 @@ fn periodic_data_type(context: &Context) -> StructType {
     context.struct_type(&[&context.f32_type().vec_type(2)], false)
 }
 
+fn build_fract(ctx: &mut BuilderContext, val: VectorValue, name: &str) -> VectorValue {
+    let floor_intrinsic = intrinsics::floor_v2f32(ctx.module);
+    let floored = ctx
+        .b
+        .build_call(&floor_intrinsic, &[&val], "", false)
+        .left()
+        .unwrap()
+        .into_vector_value();
+    ctx.b.build_float_sub(val, floored, name)
+}
+
+fn build_call_v2f32(
+    builder: &Builder,
+    func: FunctionValue,
+    args: &[&BasicValue],
+    name: &str,
+) -> VectorValue {
+    builder
+        .build_call(&func, args, name, false)
+        .left()
+        .unwrap()
+        .into_vector_value()
+}
+
+// Returns how close `phase` is to a discontinuity at zero, from 1 at the discontinuity down to 0
+// one sample or more away from it.
+fn build_edge_closeness(
+    ctx: &mut BuilderContext,
+    phase: VectorValue,
+    phase_step: VectorValue,
+) -> VectorValue {
+    let max_intrinsic = intrinsics::maxnum_v2f32(ctx.module);
+    let one = util::get_vec_spread(ctx.context, 1.);
+
+    let after_closeness = ctx.b.build_float_sub(
+        one,
+        ctx.b.build_float_div(phase, phase_step, ""),
+        "aftercloseness",
+    );
+    let before_closeness = ctx.b.build_float_sub(
+        one,
+        ctx.b
+            .build_float_div(ctx.b.build_float_sub(one, phase, ""), phase_step, ""),
+        "beforecloseness",
+    );
+
+    // when the step is zero the divisions give infinities or NaNs, which maxnum filters out
+    let closeness = build_call_v2f32(
+        ctx.b,
+        max_intrinsic,
+        &[&after_closeness, &before_closeness],
+        "",
+    );
+    build_call_v2f32(
+        ctx.b,
+        max_intrinsic,
+        &[&closeness, &util::get_vec_spread(ctx.context, 0.)],
+        "closeness",
+    )
+}
+
+// PolyBLEP: the difference between a band-limited and a naive unit step at phase zero,
+// approximated with a two-sample polynomial.
+fn build_poly_blep(
+    ctx: &mut BuilderContext,
+    phase: VectorValue,
+    phase_step: VectorValue,
+) -> VectorValue {
+    let closeness = build_edge_closeness(ctx, phase, phase_step);
+    let residual = ctx.b.build_float_mul(
+        util::get_vec_spread(ctx.context, 0.5),
+        ctx.b.build_float_mul(closeness, closeness, ""),
+        "residual",
+    );
+    let is_after = ctx.b.build_float_compare(
+        FloatPredicate::OLT,
+        phase,
+        util::get_vec_spread(ctx.context, 0.5),
+        "isafter",
+    );
+    ctx.b
+        .build_select(
+            is_after,
+            ctx.b.build_float_neg(&residual, ""),
+            residual,
+            "polyblep",
+        ).into_vector_value()
+}
+
+// PolyBLAMP: the integral of the PolyBLEP residual, used to round off a change in slope.
+fn build_poly_blamp(
+    ctx: &mut BuilderContext,
+    phase: VectorValue,
+    phase_step: VectorValue,
+) -> VectorValue {
+    let closeness = build_edge_closeness(ctx, phase, phase_step);
+    ctx.b.build_float_mul(
+        util::get_vec_spread(ctx.context, 1. / 6.),
+        ctx.b.build_float_mul(
+            closeness,
+            ctx.b.build_float_mul(closeness, closeness, ""),
+            "",
+        ),
+        "polyblamp",
+    )
+}
+
 fn gen_periodic_call(
     func: &mut FunctionContext,
     args: &[PointerValue],
     result: PointerValue,
-    next_val: &Fn(&mut FunctionContext, VectorValue, &[PointerValue]) -> VectorValue,
+    next_val: &Fn(&mut FunctionContext, VectorValue, VectorValue, &[PointerValue]) -> VectorValue,
 ) {
     let phase_ptr = unsafe { func.ctx.b.build_struct_gep(&func.data_ptr, 0, "phase.ptr") };
 
@@ -45,7 +154,8 @@ fn gen_periodic_call(
 
     let freq_vec = freq_num.get_vec(func.ctx.b);
 
-    // offset phase and store new value
+    // offset phase and store new value, wrapping with floor instead of frem since that's a libm
+    // call per channel
     let phase = func
         .ctx
         .b
@@ -58,26 +168,35 @@ fn gen_periodic_call(
             &globals::get_sample_rate(func.ctx.module).as_pointer_value(),
             "samplerate",
         ).into_vector_value();
-    let phase_offset = func
+    let phase_step = func
         .ctx
         .b
-        .build_float_div(freq_vec, samplerate, "phaseoffset");
-    let new_phase = func.ctx.b.build_float_add(phase, phase_offset, "newphase");
-    let mod_phase = func.ctx.b.build_float_rem(
-        new_phase,
-        util::get_vec_spread(func.ctx.context, 2.),
-        "modphase",
-    );
+        .build_float_div(freq_vec, samplerate, "phasestep");
+    let new_phase = func.ctx.b.build_float_add(phase, phase_step, "newphase");
+    let mod_phase = build_fract(&mut func.ctx, new_phase, "modphase");
     func.ctx.b.build_store(&phase_ptr, &mod_phase);
 
-    // calculate result
+    // calculate result from the phase in [0, 1), and how far it moves per sample for
+    // band-limiting. Steps over half a cycle are clamped so the corrections for neighbouring
+    // edges don't overlap.
     let phase_offset_vec = phase_offset_num.get_vec(func.ctx.b);
     let input_phase = func
         .ctx
         .b
         .build_float_add(phase_offset_vec, phase, "inputphase");
+    let wrapped_phase = build_fract(&mut func.ctx, input_phase, "wrappedphase");
 
-    let result_vec = next_val(func, input_phase, &args[2..]);
+    let abs_intrinsic = intrinsics::fabs_v2f32(func.ctx.module);
+    let min_intrinsic = intrinsics::minnum_v2f32(func.ctx.module);
+    let abs_step = build_call_v2f32(func.ctx.b, abs_intrinsic, &[&phase_step], "");
+    let clamped_step = build_call_v2f32(
+        func.ctx.b,
+        min_intrinsic,
+        &[&abs_step, &util::get_vec_spread(func.ctx.context, 0.5)],
+        "clampedstep",
+    );
+
+    let result_vec = next_val(func, wrapped_phase, clamped_step, &args[2..]);
 
     result_num.set_vec(func.ctx.b, &result_vec);
     result_num.set_form(
@@ -108,29 +227,28 @@ macro_rules! define_periodic_func (
     )
 );
 
+// A sine has no harmonics to alias, but it goes straight to the output, so it uses the precise
+// sine: the fast one's error puts harmonics only around 76dB below the fundamental.
 fn sin_next_value(
     func: &mut FunctionContext,
     phase: VectorValue,
+    _phase_step: VectorValue,
     _extra_args: &[PointerValue],
 ) -> VectorValue {
-    let sin_intrinsic = intrinsics::sin_v2f32(func.ctx.module);
+    let sin_func = math::sin_v2f32(func.ctx.module, MathAccuracy::Precise);
     let sin_phase = func.ctx.b.build_float_mul(
         phase,
         util::get_vec_spread(func.ctx.context, consts::PI * 2.),
         "sinphase",
     );
-    func.ctx
-        .b
-        .build_call(&sin_intrinsic, &[&sin_phase], "result", false)
-        .left()
-        .unwrap()
-        .into_vector_value()
+    build_call_v2f32(func.ctx.b, sin_func, &[&sin_phase], "result")
 }
 define_periodic_func!(SinOscFunction: block::Function::SinOsc, false => sin_next_value);
 
 fn sqr_next_value(
     func: &mut FunctionContext,
     phase: VectorValue,
+    phase_step: VectorValue,
     extra_args: &[PointerValue],
 ) -> VectorValue {
     let pulse_width = NumValue::new(extra_args[0]);
@@ -138,39 +256,55 @@ fn sqr_next_value(
 
     let is_positive = func.ctx.b.build_float_compare(
         FloatPredicate::OLT,
-        func.ctx.b.build_float_rem(
-            phase,
-            util::get_vec_spread(func.ctx.context, 1.),
-            "inputmod",
-        ),
+        phase,
         pulse_width_vec,
-        "isneg",
+        "ispositive",
     );
-
-    func.ctx
+    let naive = func
+        .ctx
         .b
         .build_select(
             is_positive,
             util::get_vec_spread(func.ctx.context, 1.),
             util::get_vec_spread(func.ctx.context, -1.),
-            "result",
-        ).into_vector_value()
+            "naive",
+        ).into_vector_value();
+
+    // rising edge of 2 at the start of the cycle, falling edge of 2 at the pulse width
+    let rise_blep = build_poly_blep(&mut func.ctx, phase, phase_step);
+    let fall_phase = func.ctx.b.build_float_sub(phase, pulse_width_vec, "");
+    let fall_phase = build_fract(&mut func.ctx, fall_phase, "fallphase");
+    let fall_blep = build_poly_blep(&mut func.ctx, fall_phase, phase_step);
+    let correction = func.ctx.b.build_float_mul(
+        func.ctx.b.build_float_sub(rise_blep, fall_blep, ""),
+        util::get_vec_spread(func.ctx.context, 2.),
+        "correction",
+    );
+    func.ctx.b.build_float_add(naive, correction, "result")
 }
 define_periodic_func!(SqrOscFunction: block::Function::SqrOsc, true => sqr_next_value);
 
 fn saw_next_value(
     func: &mut FunctionContext,
     phase: VectorValue,
+    phase_step: VectorValue,
     _extra_args: &[PointerValue],
 ) -> VectorValue {
-    let normal_period = util::get_vec_spread(func.ctx.context, 2.);
-    func.ctx.b.build_float_sub(
-        func.ctx.b.build_float_rem(
-            func.ctx.b.build_float_mul(phase, normal_period, "inputval"),
-            normal_period,
-            "inputmod",
-        ),
+    let naive = func.ctx.b.build_float_sub(
+        func.ctx
+            .b
+            .build_float_mul(phase, util::get_vec_spread(func.ctx.context, 2.), ""),
         util::get_vec_spread(func.ctx.context, 1.),
+        "naive",
+    );
+
+    // falling edge of 2 at the start of the cycle
+    let blep = build_poly_blep(&mut func.ctx, phase, phase_step);
+    func.ctx.b.build_float_sub(
+        naive,
+        func.ctx
+            .b
+            .build_float_mul(blep, util::get_vec_spread(func.ctx.context, 2.), ""),
         "result",
     )
 }
@@ -179,49 +313,69 @@ define_periodic_func!(SawOscFunction: block::Function::SawOsc, false => saw_next
 fn tri_next_value(
     func: &mut FunctionContext,
     phase: VectorValue,
+    phase_step: VectorValue,
     _extra_args: &[PointerValue],
 ) -> VectorValue {
     let abs_intrinsic = intrinsics::fabs_v2f32(func.ctx.module);
 
-    let normal_period = util::get_vec_spread(func.ctx.context, 4.);
-    func.ctx.b.build_float_sub(
+    let normalized = func.ctx.b.build_float_sub(
         func.ctx
             .b
-            .build_call(
-                &abs_intrinsic,
-                &[&func.ctx.b.build_float_sub(
-                    func.ctx.b.build_float_rem(
-                        func.ctx.b.build_float_mul(phase, normal_period, "inputval"),
-                        normal_period,
-                        "inputmod",
-                    ),
-                    util::get_vec_spread(func.ctx.context, 2.),
-                    "inputsub",
-                )],
-                "normalized",
-                false,
-            ).left()
-            .unwrap()
-            .into_vector_value(),
+            .build_float_mul(phase, util::get_vec_spread(func.ctx.context, 4.), ""),
+        util::get_vec_spread(func.ctx.context, 2.),
+        "normalized",
+    );
+    let abs_normalized = build_call_v2f32(func.ctx.b, abs_intrinsic, &[&normalized], "");
+    let naive = func.ctx.b.build_float_sub(
+        abs_normalized,
         util::get_vec_spread(func.ctx.context, 1.),
-        "result",
-    )
+        "naive",
+    );
+
+    // the slope changes by -8 per cycle at the peak at the start of the cycle, and by 8 at the
+    // trough half way through, which is a change of 8 * step per sample
+    let peak_blamp = build_poly_blamp(&mut func.ctx, phase, phase_step);
+    let trough_phase = func.ctx.b.build_float_add(
+        phase,
+        util::get_vec_spread(func.ctx.context, 0.5),
+        "",
+    );
+    let trough_phase = build_fract(&mut func.ctx, trough_phase, "troughphase");
+    let trough_blamp = build_poly_blamp(&mut func.ctx, trough_phase, phase_step);
+    let correction = func.ctx.b.build_float_mul(
+        func.ctx.b.build_float_sub(trough_blamp, peak_blamp, ""),
+        func.ctx.b.build_float_mul(
+            phase_step,
+            util::get_vec_spread(func.ctx.context, 8.),
+            "",
+        ),
+        "correction",
+    );
+    func.ctx.b.build_float_add(naive, correction, "result")
 }
 define_periodic_func!(TriOscFunction: block::Function::TriOsc, false => tri_next_value);
 
 fn rmp_next_value(
     func: &mut FunctionContext,
     phase: VectorValue,
+    phase_step: VectorValue,
     _extra_args: &[PointerValue],
 ) -> VectorValue {
-    let normal_period = util::get_vec_spread(func.ctx.context, 2.);
-    func.ctx.b.build_float_sub(
+    let naive = func.ctx.b.build_float_sub(
         util::get_vec_spread(func.ctx.context, 1.),
-        func.ctx.b.build_float_rem(
-            func.ctx.b.build_float_mul(phase, normal_period, "inputval"),
-            normal_period,
-            "inputmod",
-        ),
+        func.ctx
+            .b
+            .build_float_mul(phase, util::get_vec_spread(func.ctx.context, 2.), ""),
+        "naive",
+    );
+
+    // rising edge of 2 at the start of the cycle
+    let blep = build_poly_blep(&mut func.ctx, phase, phase_step);
+    func.ctx.b.build_float_add(
+        naive,
+        func.ctx
+            .b
+            .build_float_mul(blep, util::get_vec_spread(func.ctx.context, 2.), ""),
         "result",
     )
 }
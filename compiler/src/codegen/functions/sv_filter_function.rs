@@ -1,4 +1,5 @@
 use super::{Function, FunctionContext, VarArgs};
+use codegen::math::{self, MathAccuracy};
 use codegen::values::{NumValue, TupleValue};
 use codegen::{globals, intrinsics, util};
 use inkwell::context::Context;
@@ -33,9 +34,9 @@ impl Function for SvFilterFunction {
         _varargs: Option<VarArgs>,
         result: PointerValue,
     ) {
-        let sin_intrinsic = intrinsics::sin_v2f32(func.ctx.module);
+        let sin_func = math::sin_v2f32(func.ctx.module, MathAccuracy::Precise);
         let min_intrinsic = intrinsics::minnum_v2f32(func.ctx.module);
-        let pow_intrinsic = intrinsics::pow_v2f32(func.ctx.module);
+        let pow_func = math::pow_v2f32(func.ctx.module, MathAccuracy::Precise);
 
         let notch_ptr = unsafe { func.ctx.b.build_struct_gep(&func.data_ptr, 0, "notch.ptr") };
         let low_ptr = unsafe { func.ctx.b.build_struct_gep(&func.data_ptr, 1, "low.ptr") };
@@ -53,7 +54,7 @@ impl Function for SvFilterFunction {
             func.ctx
                 .b
                 .build_call(
-                    &sin_intrinsic,
+                    &sin_func,
                     &[&func.ctx.b.build_float_mul(
                         freq_vec,
                         func.ctx.b.build_float_div(
@@ -90,7 +91,7 @@ impl Function for SvFilterFunction {
                 func.ctx
                     .b
                     .build_call(
-                        &pow_intrinsic,
+                        &pow_func,
                         &[
                             &func.ctx.b.build_float_sub(
                                 util::get_vec_spread(func.ctx.context, 1.),
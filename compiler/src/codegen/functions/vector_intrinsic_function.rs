@@ -1,5 +1,6 @@
 use super::{Function, FunctionContext, VarArgs};
 use codegen::intrinsics;
+use codegen::math::{self, MathAccuracy};
 use codegen::values::NumValue;
 use inkwell::values::{BasicValue, FunctionValue, PointerValue};
 use mir::block;
@@ -42,14 +43,29 @@ macro_rules! define_vector_intrinsic (
     );
 );
 
-define_vector_intrinsic!(CosFunction: block::Function::Cos => intrinsics::cos_v2f32);
-define_vector_intrinsic!(SinFunction: block::Function::Sin => intrinsics::sin_v2f32);
-define_vector_intrinsic!(LogFunction: block::Function::Log => intrinsics::log_v2f32);
-define_vector_intrinsic!(Log2Function: block::Function::Log2 => intrinsics::log2_v2f32);
-define_vector_intrinsic!(Log10Function: block::Function::Log10 => intrinsics::log10_v2f32);
 define_vector_intrinsic!(SqrtFunction: block::Function::Sqrt => intrinsics::sqrt_v2f32);
 define_vector_intrinsic!(CeilFunction: block::Function::Ceil => intrinsics::ceil_v2f32);
 define_vector_intrinsic!(FloorFunction: block::Function::Floor => intrinsics::floor_v2f32);
 define_vector_intrinsic!(AbsFunction: block::Function::Abs => intrinsics::fabs_v2f32);
 define_vector_intrinsic!(MinFunction: block::Function::Min => intrinsics::minnum_v2f32);
 define_vector_intrinsic!(MaxFunction: block::Function::Max => intrinsics::maxnum_v2f32);
+
+macro_rules! define_math_function (
+    ($func_name:ident: $func_type:expr => $math_func_name:expr) => (
+        pub struct $func_name {}
+        impl Function for $func_name {
+            fn function_type() -> block::Function { $func_type }
+            fn gen_call(func: &mut FunctionContext, args: &[PointerValue], _varargs: Option<VarArgs>, result: PointerValue) {
+                let math_func = $math_func_name(func.ctx.module, MathAccuracy::Precise);
+                gen_intrinsic_call(func, args, result, math_func)
+            }
+        }
+    );
+);
+
+define_math_function!(CosFunction: block::Function::Cos => math::cos_v2f32);
+define_math_function!(SinFunction: block::Function::Sin => math::sin_v2f32);
+define_math_function!(TanFunction: block::Function::Tan => math::tan_v2f32);
+define_math_function!(LogFunction: block::Function::Log => math::log_v2f32);
+define_math_function!(Log2Function: block::Function::Log2 => math::log2_v2f32);
+define_math_function!(Log10Function: block::Function::Log10 => math::log10_v2f32);
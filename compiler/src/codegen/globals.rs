@@ -1,9 +1,19 @@
 use codegen::util;
 use inkwell::module::Module;
 use inkwell::values::GlobalValue;
+use inkwell::AddressSpace;
 
 pub const SAMPLERATE_GLOBAL_NAME: &str = "maxim.samplerate";
 pub const BPM_GLOBAL_NAME: &str = "maxim.bpm";
+pub const SLEEP_THRESHOLD_GLOBAL_NAME: &str = "maxim.sleep.threshold";
+pub const SLEEP_SAMPLES_GLOBAL_NAME: &str = "maxim.sleep.samples";
+pub const SLEPT_UPDATES_GLOBAL_NAME: &str = "maxim.sleep.skippedupdates";
+pub const CONTROL_RATE_INTERVAL_GLOBAL_NAME: &str = "maxim.controlrate.interval";
+pub const PARALLEL_POOL_GLOBAL_NAME: &str = "maxim.parallel.pool";
+
+pub const DEFAULT_SLEEP_THRESHOLD: f32 = 0.0001;
+pub const DEFAULT_SLEEP_SAMPLES: u32 = 4096;
+pub const DEFAULT_CONTROL_RATE_INTERVAL: u32 = 1;
 
 pub fn get_sample_rate(module: &Module) -> GlobalValue {
     util::get_or_create_global(
@@ -21,7 +31,78 @@ pub fn get_bpm(module: &Module) -> GlobalValue {
     )
 }
 
+/// The level both channels of a voice's outputs must stay below for it to be considered silent.
+pub fn get_sleep_threshold(module: &Module) -> GlobalValue {
+    util::get_or_create_global(
+        module,
+        SLEEP_THRESHOLD_GLOBAL_NAME,
+        &module.get_context().f32_type(),
+    )
+}
+
+/// How many samples a voice must be silent for before it's put to sleep, or zero to never sleep.
+pub fn get_sleep_samples(module: &Module) -> GlobalValue {
+    util::get_or_create_global(
+        module,
+        SLEEP_SAMPLES_GLOBAL_NAME,
+        &module.get_context().i32_type(),
+    )
+}
+
+/// The number of voice updates that have been skipped because the voice was asleep.
+pub fn get_slept_updates(module: &Module) -> GlobalValue {
+    util::get_or_create_global(
+        module,
+        SLEPT_UPDATES_GLOBAL_NAME,
+        &module.get_context().i64_type(),
+    )
+}
+
+/// The most samples control-rate statements can go between updates. Always at least one.
+pub fn get_control_rate_interval(module: &Module) -> GlobalValue {
+    util::get_or_create_global(
+        module,
+        CONTROL_RATE_INTERVAL_GLOBAL_NAME,
+        &module.get_context().i32_type(),
+    )
+}
+
+/// The worker pool voices are spread across, or null to update every voice on the audio thread.
+pub fn get_parallel_pool(module: &Module) -> GlobalValue {
+    util::get_or_create_global(
+        module,
+        PARALLEL_POOL_GLOBAL_NAME,
+        &module
+            .get_context()
+            .i8_type()
+            .ptr_type(AddressSpace::Generic),
+    )
+}
+
 pub fn build_globals(module: &Module) {
-    get_sample_rate(module).set_initializer(&util::get_vec_spread(&module.get_context(), 44100.));
-    get_bpm(module).set_initializer(&util::get_vec_spread(&module.get_context(), 60.));
+    let context = module.get_context();
+    get_sample_rate(module).set_initializer(&util::get_vec_spread(&context, 44100.));
+    get_bpm(module).set_initializer(&util::get_vec_spread(&context, 60.));
+    get_sleep_threshold(module).set_initializer(
+        &context
+            .f32_type()
+            .const_float(DEFAULT_SLEEP_THRESHOLD as f64),
+    );
+    get_sleep_samples(module).set_initializer(
+        &context
+            .i32_type()
+            .const_int(DEFAULT_SLEEP_SAMPLES as u64, false),
+    );
+    get_slept_updates(module).set_initializer(&context.i64_type().const_int(0, false));
+    get_control_rate_interval(module).set_initializer(
+        &context
+            .i32_type()
+            .const_int(DEFAULT_CONTROL_RATE_INTERVAL as u64, false),
+    );
+    get_parallel_pool(module).set_initializer(
+        &context
+            .i8_type()
+            .ptr_type(AddressSpace::Generic)
+            .const_null(),
+    );
 }
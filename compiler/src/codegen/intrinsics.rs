@@ -67,17 +67,6 @@ pub fn memset(module: &Module, target: &TargetData) -> FunctionValue {
     })
 }
 
-pub fn pow_v2f32(module: &Module) -> FunctionValue {
-    util::get_or_create_func(module, "llvm.pow.v2f32", false, &|| {
-        let context = module.get_context();
-        let v2f32_type = context.f32_type().vec_type(2);
-        (
-            Linkage::ExternalLinkage,
-            v2f32_type.fn_type(&[&v2f32_type, &v2f32_type], false),
-        )
-    })
-}
-
 pub fn pow_f32(module: &Module) -> FunctionValue {
     util::get_or_create_func(module, "llvm.pow.f32", false, &|| {
         let context = module.get_context();
@@ -89,89 +78,6 @@ pub fn pow_f32(module: &Module) -> FunctionValue {
     })
 }
 
-pub fn exp_v2f32(module: &Module) -> FunctionValue {
-    util::get_or_create_func(module, "llvm.exp.v2f32", false, &|| {
-        let v2f32_type = module.get_context().f32_type().vec_type(2);
-        (
-            Linkage::ExternalLinkage,
-            v2f32_type.fn_type(&[&v2f32_type], false),
-        )
-    })
-}
-
-pub fn log_v2f32(module: &Module) -> FunctionValue {
-    util::get_or_create_func(module, "llvm.log.v2f32", false, &|| {
-        let context = module.get_context();
-        let v2f32_type = context.f32_type().vec_type(2);
-        (
-            Linkage::ExternalLinkage,
-            v2f32_type.fn_type(&[&v2f32_type], false),
-        )
-    })
-}
-
-pub fn log10_v2f32(module: &Module) -> FunctionValue {
-    util::get_or_create_func(module, "llvm.log10.v2f32", false, &|| {
-        let context = module.get_context();
-        let v2f32_type = context.f32_type().vec_type(2);
-        (
-            Linkage::ExternalLinkage,
-            v2f32_type.fn_type(&[&v2f32_type], false),
-        )
-    })
-}
-
-pub fn log2_v2f32(module: &Module) -> FunctionValue {
-    util::get_or_create_func(module, "llvm.log2.v2f32", false, &|| {
-        let context = module.get_context();
-        let v2f32_type = context.f32_type().vec_type(2);
-        (
-            Linkage::ExternalLinkage,
-            v2f32_type.fn_type(&[&v2f32_type], false),
-        )
-    })
-}
-
-pub fn cos_v2f32(module: &Module) -> FunctionValue {
-    util::get_or_create_func(module, "llvm.cos.v2f32", false, &|| {
-        let v2f32_type = module.get_context().f32_type().vec_type(2);
-        (
-            Linkage::ExternalLinkage,
-            v2f32_type.fn_type(&[&v2f32_type], false),
-        )
-    })
-}
-
-pub fn cos_f32(module: &Module) -> FunctionValue {
-    util::get_or_create_func(module, "llvm.cos.f32", false, &|| {
-        let f32_type = module.get_context().f32_type();
-        (
-            Linkage::ExternalLinkage,
-            f32_type.fn_type(&[&f32_type], false),
-        )
-    })
-}
-
-pub fn sin_v2f32(module: &Module) -> FunctionValue {
-    util::get_or_create_func(module, "llvm.sin.v2f32", false, &|| {
-        let v2f32_type = module.get_context().f32_type().vec_type(2);
-        (
-            Linkage::ExternalLinkage,
-            v2f32_type.fn_type(&[&v2f32_type], false),
-        )
-    })
-}
-
-pub fn sin_f32(module: &Module) -> FunctionValue {
-    util::get_or_create_func(module, "llvm.sin.f32", false, &|| {
-        let f32_type = module.get_context().f32_type();
-        (
-            Linkage::ExternalLinkage,
-            f32_type.fn_type(&[&f32_type], false),
-        )
-    })
-}
-
 pub fn sqrt_v2f32(module: &Module) -> FunctionValue {
     util::get_or_create_func(module, "llvm.sqrt.v2f32", false, &|| {
         let v2f32_type = module.get_context().f32_type().vec_type(2);
@@ -262,6 +168,26 @@ pub fn ctlz_i64(module: &Module) -> FunctionValue {
     })
 }
 
+pub fn cttz_i32(module: &Module) -> FunctionValue {
+    util::get_or_create_func(module, "llvm.cttz.i32", false, &|| {
+        let i32_type = module.get_context().i32_type();
+        (
+            Linkage::ExternalLinkage,
+            i32_type.fn_type(&[&i32_type, &module.get_context().bool_type()], false),
+        )
+    })
+}
+
+pub fn ctpop_i32(module: &Module) -> FunctionValue {
+    util::get_or_create_func(module, "llvm.ctpop.i32", false, &|| {
+        let i32_type = module.get_context().i32_type();
+        (
+            Linkage::ExternalLinkage,
+            i32_type.fn_type(&[&i32_type], false),
+        )
+    })
+}
+
 pub fn copysign_v2f32(module: &Module) -> FunctionValue {
     util::get_or_create_func(module, "llvm.copysign.v2f32", false, &|| {
         let v2f32_type = module.get_context().f32_type().vec_type(2);
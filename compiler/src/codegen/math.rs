@@ -0,0 +1,662 @@
+use codegen::{intrinsics, util};
+use inkwell::builder::Builder;
+use inkwell::context::Context;
+use inkwell::module::{Linkage, Module};
+use inkwell::types::{BasicType, VectorType};
+use inkwell::values::{BasicValue, FunctionValue, PointerValue, VectorValue};
+use inkwell::{AddressSpace, FloatPredicate, IntPredicate};
+use std::f64::consts;
+use std::{fmt, iter};
+
+// Vectorized math functions that are built into the library module, so calls don't have to be
+// split into a libm call for each channel.
+//
+// Everything is built from range reduction and a polynomial:
+//  - sin/cos are reduced to a quarter turn and evaluated with an odd polynomial.
+//  - exp2 is split into an integer part that's put straight into the exponent bits, and a
+//    polynomial for the fraction.
+//  - log2 takes the exponent from the bits, and uses the atanh series for the mantissa.
+//  - Everything else is built from those.
+//
+// Over the ranges audio code uses, precise functions stay within 3e-5 of libm for sin, cos, log,
+// log2, log10 and tanh, and within a relative error of 1e-5 for tan, exp, exp2 and pow. Fast
+// functions have errors up to 6e-4, which is fine for values that only shape parameters. The
+// benchmark's --math mode checks these limits for each function.
+//
+// Unlike libm, exp2 (and so exp, pow and tanh) flushes results that would be denormal to zero.
+// Inputs are clamped before anything is converted to an int, since the conversion gives an
+// undefined result for values out of range, and infinities and NaNs are handled separately.
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum MathAccuracy {
+    Fast,
+    Precise,
+}
+
+impl fmt::Display for MathAccuracy {
+    fn fmt(&self, f: &mut fmt::Formatter) -> Result<(), fmt::Error> {
+        match self {
+            MathAccuracy::Fast => write!(f, "fast"),
+            MathAccuracy::Precise => write!(f, "precise"),
+        }
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum MathFunction {
+    Sin,
+    Cos,
+    Tan,
+    Exp,
+    Exp2,
+    Log,
+    Log2,
+    Log10,
+    Pow,
+    Tanh,
+}
+
+pub const MATH_FUNCTIONS: [MathFunction; 10] = [
+    MathFunction::Sin,
+    MathFunction::Cos,
+    MathFunction::Tan,
+    MathFunction::Exp,
+    MathFunction::Exp2,
+    MathFunction::Log,
+    MathFunction::Log2,
+    MathFunction::Log10,
+    MathFunction::Pow,
+    MathFunction::Tanh,
+];
+
+impl MathFunction {
+    pub fn from_name(name: &str) -> Option<MathFunction> {
+        MATH_FUNCTIONS
+            .iter()
+            .find(|function| function.to_string() == name)
+            .cloned()
+    }
+
+    pub fn arg_count(&self) -> usize {
+        match self {
+            MathFunction::Pow => 2,
+            _ => 1,
+        }
+    }
+}
+
+impl fmt::Display for MathFunction {
+    fn fmt(&self, f: &mut fmt::Formatter) -> Result<(), fmt::Error> {
+        match self {
+            MathFunction::Sin => write!(f, "sin"),
+            MathFunction::Cos => write!(f, "cos"),
+            MathFunction::Tan => write!(f, "tan"),
+            MathFunction::Exp => write!(f, "exp"),
+            MathFunction::Exp2 => write!(f, "exp2"),
+            MathFunction::Log => write!(f, "log"),
+            MathFunction::Log2 => write!(f, "log2"),
+            MathFunction::Log10 => write!(f, "log10"),
+            MathFunction::Pow => write!(f, "pow"),
+            MathFunction::Tanh => write!(f, "tanh"),
+        }
+    }
+}
+
+pub fn get_func(module: &Module, function: MathFunction, accuracy: MathAccuracy) -> FunctionValue {
+    let func_name = format!("maxim.math.{}.{}.v2f32", function, accuracy);
+    util::get_or_create_func(module, &func_name, true, &|| {
+        let v2f32_type = module.get_context().f32_type().vec_type(2);
+        let arg_types: Vec<_> = iter::repeat(&v2f32_type as &BasicType)
+            .take(function.arg_count())
+            .collect();
+        (
+            Linkage::ExternalLinkage,
+            v2f32_type.fn_type(&arg_types, false),
+        )
+    })
+}
+
+/// Returns the name of a function that runs a math function over arrays, for checking the library
+/// from outside of generated code. It takes pointers to the first and second arguments (the second
+/// is ignored for single-argument functions), a pointer to the results, and a number of pairs of
+/// values to process.
+pub fn get_array_func_name(function: MathFunction, accuracy: MathAccuracy) -> String {
+    format!("maxim.math.{}.{}.array", function, accuracy)
+}
+
+pub fn sin_v2f32(module: &Module, accuracy: MathAccuracy) -> FunctionValue {
+    get_func(module, MathFunction::Sin, accuracy)
+}
+
+pub fn cos_v2f32(module: &Module, accuracy: MathAccuracy) -> FunctionValue {
+    get_func(module, MathFunction::Cos, accuracy)
+}
+
+pub fn tan_v2f32(module: &Module, accuracy: MathAccuracy) -> FunctionValue {
+    get_func(module, MathFunction::Tan, accuracy)
+}
+
+pub fn exp_v2f32(module: &Module, accuracy: MathAccuracy) -> FunctionValue {
+    get_func(module, MathFunction::Exp, accuracy)
+}
+
+pub fn exp2_v2f32(module: &Module, accuracy: MathAccuracy) -> FunctionValue {
+    get_func(module, MathFunction::Exp2, accuracy)
+}
+
+pub fn log_v2f32(module: &Module, accuracy: MathAccuracy) -> FunctionValue {
+    get_func(module, MathFunction::Log, accuracy)
+}
+
+pub fn log2_v2f32(module: &Module, accuracy: MathAccuracy) -> FunctionValue {
+    get_func(module, MathFunction::Log2, accuracy)
+}
+
+pub fn log10_v2f32(module: &Module, accuracy: MathAccuracy) -> FunctionValue {
+    get_func(module, MathFunction::Log10, accuracy)
+}
+
+pub fn pow_v2f32(module: &Module, accuracy: MathAccuracy) -> FunctionValue {
+    get_func(module, MathFunction::Pow, accuracy)
+}
+
+pub fn tanh_v2f32(module: &Module, accuracy: MathAccuracy) -> FunctionValue {
+    get_func(module, MathFunction::Tanh, accuracy)
+}
+
+pub fn build_funcs(module: &Module) {
+    for &accuracy in &[MathAccuracy::Fast, MathAccuracy::Precise] {
+        for &function in &MATH_FUNCTIONS {
+            build_func(module, function, accuracy);
+            build_array_func(module, function, accuracy);
+        }
+    }
+}
+
+struct MathBuilder<'a> {
+    context: Context,
+    module: &'a Module,
+    b: Builder,
+    accuracy: MathAccuracy,
+}
+
+impl<'a> MathBuilder<'a> {
+    fn vec(&self, val: f64) -> VectorValue {
+        util::get_vec_spread(&self.context, val as f32)
+    }
+
+    fn int_vec(&self, val: i32) -> VectorValue {
+        let int_val = self.context.i32_type().const_int(val as u64, true);
+        VectorType::const_vector(&[&int_val, &int_val])
+    }
+
+    fn int_vec_type(&self) -> VectorType {
+        self.context.i32_type().vec_type(2)
+    }
+
+    fn float_vec_type(&self) -> VectorType {
+        self.context.f32_type().vec_type(2)
+    }
+
+    fn call(&self, func: FunctionValue, args: &[&BasicValue]) -> VectorValue {
+        self.b
+            .build_call(&func, args, "", false)
+            .left()
+            .unwrap()
+            .into_vector_value()
+    }
+
+    // Values are reinterpreted through memory, which LLVM turns back into a bitcast.
+    fn reinterpret(&self, val: VectorValue, target_type: VectorType) -> VectorValue {
+        let val_ptr = self.b.build_alloca(&val.get_type(), "reinterpret");
+        self.b.build_store(&val_ptr, &val);
+        let target_ptr =
+            self.b
+                .build_pointer_cast(val_ptr, target_type.ptr_type(AddressSpace::Generic), "");
+        self.b.build_load(&target_ptr, "").into_vector_value()
+    }
+
+    // Coefficients are in order of increasing power.
+    fn polynomial(&self, x: VectorValue, coefficients: &[f64]) -> VectorValue {
+        let mut result = self.vec(*coefficients.last().unwrap());
+        for &coefficient in coefficients.iter().rev().skip(1) {
+            result = self.b.build_float_add(
+                self.b.build_float_mul(result, x, ""),
+                self.vec(coefficient),
+                "",
+            );
+        }
+        result
+    }
+
+    fn select(&self, condition: VectorValue, a: VectorValue, b: VectorValue) -> VectorValue {
+        self.b.build_select(condition, a, b, "").into_vector_value()
+    }
+
+    fn compare(&self, predicate: FloatPredicate, a: VectorValue, b: VectorValue) -> VectorValue {
+        self.b.build_float_compare(predicate, a, b, "")
+    }
+
+    fn is_nan(&self, x: VectorValue) -> VectorValue {
+        self.compare(FloatPredicate::UNO, x, x)
+    }
+
+    fn clamp(&self, x: VectorValue, min: f64, max: f64) -> VectorValue {
+        let min_intrinsic = intrinsics::minnum_v2f32(self.module);
+        let max_intrinsic = intrinsics::maxnum_v2f32(self.module);
+        let x = self.call(max_intrinsic, &[&x, &self.vec(min)]);
+        self.call(min_intrinsic, &[&x, &self.vec(max)])
+    }
+
+    // Reduces an angle in turns to a quarter turn either side of zero, and evaluates sin.
+    fn build_sin_turns(&self, original_turns: VectorValue) -> VectorValue {
+        let fabs_intrinsic = intrinsics::fabs_v2f32(self.module);
+        let copysign_intrinsic = intrinsics::copysign_v2f32(self.module);
+
+        // floats from 2^23 up are always whole turns, so clamping to that keeps the conversion to
+        // an int in range without changing the result
+        let turns = self.clamp(original_turns, -8_388_608., 8_388_608.);
+
+        // round to the nearest whole turn, converting to an int truncates towards zero
+        let half_turn = self.call(copysign_intrinsic, &[&self.vec(0.5), &turns]);
+        let whole_turns = self.b.build_float_to_signed_int(
+            self.b.build_float_add(turns, half_turn, ""),
+            self.int_vec_type(),
+            "",
+        );
+        let whole_turns =
+            self.b
+                .build_signed_int_to_float(whole_turns, self.float_vec_type(), "");
+        let turns = self.b.build_float_sub(turns, whole_turns, "");
+
+        // sin is symmetric around a quarter turn
+        let abs_turns = self.call(fabs_intrinsic, &[&turns]);
+        let half_turn = self.call(copysign_intrinsic, &[&self.vec(0.5), &turns]);
+        let mirrored_turns = self.b.build_float_sub(half_turn, turns, "");
+        let turns = self.select(
+            self.compare(FloatPredicate::OGT, abs_turns, self.vec(0.25)),
+            mirrored_turns,
+            turns,
+        );
+
+        let x = self
+            .b
+            .build_float_mul(turns, self.vec(consts::PI * 2.), "");
+        let x2 = self.b.build_float_mul(x, x, "");
+        let coefficients: &[f64] = match self.accuracy {
+            MathAccuracy::Fast => &[1., -1. / 6., 1. / 120., -1. / 5040.],
+            MathAccuracy::Precise => &[
+                1.,
+                -1. / 6.,
+                1. / 120.,
+                -1. / 5040.,
+                1. / 362_880.,
+                -1. / 39_916_800.,
+            ],
+        };
+        let result = self
+            .b
+            .build_float_mul(x, self.polynomial(x2, coefficients), "");
+
+        // infinities and NaNs were clamped to a whole turn above, but have no sine
+        let is_finite = self.compare(
+            FloatPredicate::OLT,
+            self.call(fabs_intrinsic, &[&original_turns]),
+            self.vec(f64::INFINITY),
+        );
+        self.select(is_finite, result, self.vec(f64::NAN))
+    }
+
+    fn build_sin(&self, x: VectorValue) -> VectorValue {
+        let turns = self
+            .b
+            .build_float_mul(x, self.vec(1. / (consts::PI * 2.)), "");
+        self.build_sin_turns(turns)
+    }
+
+    fn build_cos(&self, x: VectorValue) -> VectorValue {
+        let turns = self.b.build_float_add(
+            self.b
+                .build_float_mul(x, self.vec(1. / (consts::PI * 2.)), ""),
+            self.vec(0.25),
+            "",
+        );
+        self.build_sin_turns(turns)
+    }
+
+    fn build_tan(&self, x: VectorValue) -> VectorValue {
+        self.b
+            .build_float_div(self.build_sin(x), self.build_cos(x), "")
+    }
+
+    fn build_exp2(&self, original_x: VectorValue) -> VectorValue {
+        // -127 gives a zero exponent and 128 gives infinity, so these fall out of the bit tricks
+        let x = self.clamp(original_x, -127., 128.);
+
+        // floor by truncating, then stepping down for negative values with a fraction
+        let whole = self
+            .b
+            .build_float_to_signed_int(x, self.int_vec_type(), "");
+        let whole_float = self
+            .b
+            .build_signed_int_to_float(whole, self.float_vec_type(), "");
+        let was_rounded_up = self.compare(FloatPredicate::OLT, x, whole_float);
+        let whole = self.b.build_int_add(
+            whole,
+            self.b
+                .build_int_s_extend(was_rounded_up, self.int_vec_type(), ""),
+            "",
+        );
+        let whole_float = self
+            .b
+            .build_signed_int_to_float(whole, self.float_vec_type(), "");
+
+        // the fraction is centered on zero to keep the polynomial short, with the sqrt(2) this
+        // takes off folded into the coefficients
+        let fraction = self.b.build_float_sub(
+            self.b.build_float_sub(x, whole_float, ""),
+            self.vec(0.5),
+            "",
+        );
+        let coefficients: Vec<_> = match self.accuracy {
+            MathAccuracy::Fast => vec![
+                1.,
+                0.693_147_180_559_945_3,
+                0.240_226_506_959_100_7,
+                0.055_504_108_664_821_58,
+                0.009_618_129_107_628_477,
+            ],
+            MathAccuracy::Precise => vec![
+                1.,
+                0.693_147_180_559_945_3,
+                0.240_226_506_959_100_7,
+                0.055_504_108_664_821_58,
+                0.009_618_129_107_628_477,
+                0.001_333_355_814_642_844_3,
+                0.000_154_035_303_933_816_06,
+            ],
+        }.into_iter()
+        .map(|coefficient| coefficient * consts::SQRT_2)
+        .collect();
+        let fraction_exp = self.polynomial(fraction, &coefficients);
+
+        let exponent_bits = self.b.build_left_shift(
+            self.b.build_int_add(whole, self.int_vec(127), ""),
+            self.int_vec(23),
+            "",
+        );
+        let whole_exp = self.reinterpret(exponent_bits, self.float_vec_type());
+        let result = self.b.build_float_mul(fraction_exp, whole_exp, "");
+
+        // the clamp turns NaNs into -127
+        self.select(self.is_nan(original_x), self.vec(f64::NAN), result)
+    }
+
+    fn build_exp(&self, x: VectorValue) -> VectorValue {
+        self.build_exp2(self.b.build_float_mul(x, self.vec(consts::LOG2_E), ""))
+    }
+
+    fn build_log2(&self, x: VectorValue) -> VectorValue {
+        // denormals don't have the implicit leading one in their mantissa, so they're scaled up
+        // into the normal range first and the exponent is corrected afterwards
+        let is_denormal = self.compare(
+            FloatPredicate::OLT,
+            x,
+            self.vec(f64::from(::std::f32::MIN_POSITIVE)),
+        );
+        let normal_x = self.select(
+            is_denormal,
+            self.b.build_float_mul(x, self.vec(16_777_216.), ""),
+            x,
+        );
+        let exponent_bias = self.select(is_denormal, self.int_vec(127 + 24), self.int_vec(127));
+
+        let bits = self.reinterpret(normal_x, self.int_vec_type());
+        let exponent = self.b.build_int_sub(
+            self.b.build_right_shift(bits, self.int_vec(23), false, ""),
+            exponent_bias,
+            "",
+        );
+        let mantissa_bits = self.b.build_or(
+            self.b.build_and(bits, self.int_vec(0x007F_FFFF), ""),
+            self.int_vec(0x3F80_0000),
+            "",
+        );
+        let mantissa = self.reinterpret(mantissa_bits, self.float_vec_type());
+
+        // move the mantissa from [1, 2) to [sqrt(1/2), sqrt(2)) so the series converges quickly
+        let is_large = self.compare(FloatPredicate::OGT, mantissa, self.vec(consts::SQRT_2));
+        let mantissa = self.select(
+            is_large,
+            self.b.build_float_mul(mantissa, self.vec(0.5), ""),
+            mantissa,
+        );
+        let exponent = self.b.build_int_add(
+            exponent,
+            self.b
+                .build_int_z_extend(is_large, self.int_vec_type(), ""),
+            "",
+        );
+        let exponent = self
+            .b
+            .build_signed_int_to_float(exponent, self.float_vec_type(), "");
+
+        // ln(m) = 2 atanh(s) where s = (m - 1) / (m + 1)
+        let s = self.b.build_float_div(
+            self.b.build_float_sub(mantissa, self.vec(1.), ""),
+            self.b.build_float_add(mantissa, self.vec(1.), ""),
+            "",
+        );
+        let s2 = self.b.build_float_mul(s, s, "");
+        let series: &[f64] = match self.accuracy {
+            MathAccuracy::Fast => &[1., 1. / 3.],
+            MathAccuracy::Precise => &[1., 1. / 3., 1. / 5., 1. / 7.],
+        };
+        let coefficients: Vec<_> = series
+            .iter()
+            .map(|coefficient| coefficient * 2. * consts::LOG2_E)
+            .collect();
+        let mantissa_log = self
+            .b
+            .build_float_mul(s, self.polynomial(s2, &coefficients), "");
+        let result = self.b.build_float_add(exponent, mantissa_log, "");
+
+        let is_positive = self.compare(FloatPredicate::OGT, x, self.vec(0.));
+        let is_zero = self.compare(FloatPredicate::OEQ, x, self.vec(0.));
+        let is_infinite = self.compare(FloatPredicate::OEQ, x, self.vec(f64::INFINITY));
+        let result = self.select(is_infinite, self.vec(f64::INFINITY), result);
+        let invalid_result = self.select(is_zero, self.vec(f64::NEG_INFINITY), self.vec(f64::NAN));
+        self.select(is_positive, result, invalid_result)
+    }
+
+    fn build_log(&self, x: VectorValue) -> VectorValue {
+        self.b
+            .build_float_mul(self.build_log2(x), self.vec(consts::LN_2), "")
+    }
+
+    fn build_log10(&self, x: VectorValue) -> VectorValue {
+        self.b
+            .build_float_mul(self.build_log2(x), self.vec(consts::LOG10_2), "")
+    }
+
+    fn build_pow(&self, base: VectorValue, exponent: VectorValue) -> VectorValue {
+        let fabs_intrinsic = intrinsics::fabs_v2f32(self.module);
+
+        let abs_base = self.call(fabs_intrinsic, &[&base]);
+        let result = self.build_exp2(self.b.build_float_mul(
+            exponent,
+            self.build_log2(abs_base),
+            "",
+        ));
+
+        // a negative base only has a real result for whole exponents, which is negative if the
+        // exponent is odd. Floats from 2^24 up are all even, so clamping to that keeps the
+        // conversion to an int in range.
+        let clamped_exponent = self.clamp(exponent, -16_777_216., 16_777_216.);
+        let whole_exponent =
+            self.b
+                .build_float_to_signed_int(clamped_exponent, self.int_vec_type(), "");
+        let is_whole = self.compare(
+            FloatPredicate::OEQ,
+            self.b
+                .build_signed_int_to_float(whole_exponent, self.float_vec_type(), ""),
+            clamped_exponent,
+        );
+        let is_odd = self.b.build_int_compare(
+            IntPredicate::NE,
+            self.b.build_and(whole_exponent, self.int_vec(1), ""),
+            self.int_vec(0),
+            "",
+        );
+        let negative_result = self.select(
+            is_whole,
+            self.select(is_odd, self.b.build_float_neg(&result, ""), result),
+            self.vec(f64::NAN),
+        );
+        let result = self.select(
+            self.compare(FloatPredicate::OLT, base, self.vec(0.)),
+            negative_result,
+            result,
+        );
+
+        // anything to the power of zero is one, even zero or NaN, and so is one to any power
+        let is_one = self.b.build_or(
+            self.compare(FloatPredicate::OEQ, exponent, self.vec(0.)),
+            self.compare(FloatPredicate::OEQ, base, self.vec(1.)),
+            "",
+        );
+        self.select(is_one, self.vec(1.), result)
+    }
+
+    fn build_tanh(&self, x: VectorValue) -> VectorValue {
+        let fabs_intrinsic = intrinsics::fabs_v2f32(self.module);
+        let copysign_intrinsic = intrinsics::copysign_v2f32(self.module);
+
+        // tanh(x) = 1 - 2 / (e^2x + 1), which goes to 1 as e^2x overflows
+        let abs_x = self.call(fabs_intrinsic, &[&x]);
+        let exp_2x = self.build_exp2(self.b.build_float_mul(
+            abs_x,
+            self.vec(2. * consts::LOG2_E),
+            "",
+        ));
+        let abs_result = self.b.build_float_sub(
+            self.vec(1.),
+            self.b.build_float_div(
+                self.vec(2.),
+                self.b.build_float_add(exp_2x, self.vec(1.), ""),
+                "",
+            ),
+            "",
+        );
+        self.call(copysign_intrinsic, &[&abs_result, &x])
+    }
+
+    fn build_function(&self, function: MathFunction, args: &[VectorValue]) -> VectorValue {
+        match function {
+            MathFunction::Sin => self.build_sin(args[0]),
+            MathFunction::Cos => self.build_cos(args[0]),
+            MathFunction::Tan => self.build_tan(args[0]),
+            MathFunction::Exp => self.build_exp(args[0]),
+            MathFunction::Exp2 => self.build_exp2(args[0]),
+            MathFunction::Log => self.build_log(args[0]),
+            MathFunction::Log2 => self.build_log2(args[0]),
+            MathFunction::Log10 => self.build_log10(args[0]),
+            MathFunction::Pow => self.build_pow(args[0], args[1]),
+            MathFunction::Tanh => self.build_tanh(args[0]),
+        }
+    }
+}
+
+// Fast-math flags aren't set on these builders, since the range checks rely on infinities and
+// NaNs being handled properly.
+fn build_func(module: &Module, function: MathFunction, accuracy: MathAccuracy) {
+    let func = get_func(module, function, accuracy);
+    let context = module.get_context();
+    let entry_block = context.append_basic_block(&func, "entry");
+    let builder = context.create_builder();
+    builder.position_at_end(&entry_block);
+
+    let args: Vec<_> = (0..function.arg_count())
+        .map(|index| func.get_nth_param(index as u32).unwrap().into_vector_value())
+        .collect();
+    let math_builder = MathBuilder {
+        context,
+        module,
+        b: builder,
+        accuracy,
+    };
+    let result = math_builder.build_function(function, &args);
+    math_builder.b.build_return(Some(&result));
+}
+
+fn build_array_func(module: &Module, function: MathFunction, accuracy: MathAccuracy) {
+    let math_func = get_func(module, function, accuracy);
+    let context = module.get_context();
+    let v2f32_ptr_type = context
+        .f32_type()
+        .vec_type(2)
+        .ptr_type(AddressSpace::Generic);
+    let f32_ptr_type = context.f32_type().ptr_type(AddressSpace::Generic);
+    let func = util::get_or_create_func(
+        module,
+        &get_array_func_name(function, accuracy),
+        true,
+        &|| {
+            (
+                Linkage::ExternalLinkage,
+                context.void_type().fn_type(
+                    &[
+                        &f32_ptr_type,
+                        &f32_ptr_type,
+                        &f32_ptr_type,
+                        &context.i32_type(),
+                    ],
+                    false,
+                ),
+            )
+        },
+    );
+
+    let entry_block = context.append_basic_block(&func, "entry");
+    let loop_check_block = context.append_basic_block(&func, "loopcheck");
+    let loop_body_block = context.append_basic_block(&func, "loopbody");
+    let end_block = context.append_basic_block(&func, "end");
+    let builder = context.create_builder();
+    builder.position_at_end(&entry_block);
+
+    let pair_ptrs: Vec<_> = (0..3)
+        .map(|index| {
+            builder.build_pointer_cast(
+                func.get_nth_param(index).unwrap().into_pointer_value(),
+                v2f32_ptr_type,
+                "",
+            )
+        }).collect();
+    let pair_count = func.get_nth_param(3).unwrap().into_int_value();
+    let index_ptr = builder.build_alloca(&context.i32_type(), "index.ptr");
+    builder.build_store(&index_ptr, &context.i32_type().const_int(0, false));
+    builder.build_unconditional_branch(&loop_check_block);
+
+    builder.position_at_end(&loop_check_block);
+    let index = builder.build_load(&index_ptr, "index").into_int_value();
+    let can_continue = builder.build_int_compare(IntPredicate::ULT, index, pair_count, "");
+    builder.build_conditional_branch(&can_continue, &loop_body_block, &end_block);
+
+    builder.position_at_end(&loop_body_block);
+    let get_pair_ptr = |base_ptr: &PointerValue| unsafe { builder.build_in_bounds_gep(base_ptr, &[index], "") };
+    let args: Vec<_> = (0..function.arg_count())
+        .map(|arg| builder.build_load(&get_pair_ptr(&pair_ptrs[arg]), "arg"))
+        .collect();
+    let arg_refs: Vec<_> = args.iter().map(|arg| arg as &BasicValue).collect();
+    let result = builder
+        .build_call(&math_func, &arg_refs, "result", false)
+        .left()
+        .unwrap();
+    builder.build_store(&get_pair_ptr(&pair_ptrs[2]), &result);
+    let next_index = builder.build_int_add(index, context.i32_type().const_int(1, false), "");
+    builder.build_store(&index_ptr, &next_index);
+    builder.build_unconditional_branch(&loop_check_block);
+
+    builder.position_at_end(&end_block);
+    builder.build_return(None);
+}
@@ -1,5 +1,7 @@
+pub mod arena;
 pub mod block;
 mod builder_context;
+mod control_rate;
 pub mod controls;
 pub mod converters;
 pub mod data_analyzer;
@@ -7,13 +9,17 @@ pub mod editor;
 pub mod functions;
 pub mod globals;
 pub mod intrinsics;
+pub mod math;
 mod object_cache;
 mod optimizer;
+pub mod parallel;
 pub mod root;
 pub mod surface;
 mod target_properties;
 pub mod util;
 pub mod values;
+pub mod voice_lanes;
+pub mod voice_sleep;
 
 pub use self::builder_context::{build_context_function, BuilderContext};
 pub use self::object_cache::ObjectCache;
@@ -14,4 +14,15 @@ pub trait ObjectCache {
     fn block_mir(&self, id: BlockRef) -> Option<&Block>;
 
     fn block_layout(&self, id: BlockRef) -> Option<&data_analyzer::BlockLayout>;
+
+    /// The version of a surface's code, which is part of the names of its symbols. The runtime
+    /// uses this to deploy a new build of a surface while the old one is still running.
+    fn surface_version(&self, _id: SurfaceRef) -> u64 {
+        0
+    }
+
+    /// The version of a block's code, see `surface_version`.
+    fn block_version(&self, _id: BlockRef) -> u64 {
+        0
+    }
 }
@@ -0,0 +1,745 @@
+use ast::ControlType;
+use codegen::data_analyzer::SurfaceLayout;
+use codegen::root::remap_pointer_source;
+use codegen::surface::{self, ExtractedVoices};
+use codegen::values::{remap_type, ARRAY_CAPACITY};
+use codegen::{
+    build_context_function, globals, intrinsics, util, voice_lanes, BuilderContext, LifecycleFunc,
+    ObjectCache, TargetProperties,
+};
+use inkwell::module::{Linkage, Module};
+use inkwell::types::StructType;
+use inkwell::values::{FunctionValue, GlobalValue, IntValue, PointerValue};
+use inkwell::{AddressSpace, IntPredicate};
+use mir::block::{Function, Statement};
+use mir::{NodeData, Surface, SurfaceRef, ValueGroupSource, VarType};
+
+/// Registered with the JIT as a builtin, which forwards to the frontend's worker pool.
+pub const DISPATCH_FUNC_NAME: &str = "maxim_parallel_dispatch";
+
+/// The most frames the root runs on either side of a split at a time, see `VoiceSplit`. The worker
+/// pool is handed one chunk at a time, so bigger chunks mean less time spent waking and waiting
+/// for workers, but every value that crosses the split has to be kept for each frame in a chunk.
+pub const CHUNK_FRAMES: u32 = 64;
+
+/// Runs the voices set in a bitmap for a chunk of frames, spread across the worker pool. The pool
+/// calls the root's voices function, see `SplitBuilder`, once for each voice. The arguments are:
+///  - The worker pool
+///  - The bitmap of voices to run
+///
+/// Returns zero without running anything if the voices should be run on the calling thread
+/// instead, for example because the pool is already busy.
+pub fn get_dispatch_func(module: &Module) -> FunctionValue {
+    util::get_or_create_func(module, DISPATCH_FUNC_NAME, false, &|| {
+        let context = module.get_context();
+        let byte_ptr_type = context.i8_type().ptr_type(AddressSpace::Generic);
+        (
+            Linkage::ExternalLinkage,
+            context
+                .i8_type()
+                .fn_type(&[&byte_ptr_type, &context.i32_type()], false),
+        )
+    })
+}
+
+/// Defines the dispatch function to always decline, for code that runs outside of the JIT and so
+/// has no worker pool to forward to.
+pub fn build_serial_dispatch_func(module: &Module, target: &TargetProperties) {
+    let func = get_dispatch_func(module);
+    build_context_function(module, func, target, &|ctx: BuilderContext| {
+        ctx.b
+            .build_return(Some(&ctx.context.i8_type().const_int(0, false)));
+    });
+}
+
+// Controls that only read and write their own sockets, so voices using them can't touch each
+// other's data.
+fn is_control_voice_local(control_type: ControlType) -> bool {
+    match control_type {
+        ControlType::Audio
+        | ControlType::Midi
+        | ControlType::AudioExtract
+        | ControlType::MidiExtract => true,
+        ControlType::Graph | ControlType::Roll | ControlType::Scope => false,
+    }
+}
+
+// Functions that share state between every voice: delays allocate from the arena, and noise
+// comes from libc's random number generator.
+fn is_function_voice_local(function: Function) -> bool {
+    match function {
+        Function::Delay | Function::Noise => false,
+        _ => true,
+    }
+}
+
+/// Returns if the voices of an extracted group using this surface can update on different threads
+/// at the same time. Voices can't share anything they write to: delays allocate from the arena,
+/// noise shares libc's generator, and the state of graphs, rolls and scopes is shared between
+/// every voice.
+pub fn can_run_in_parallel(cache: &ObjectCache, surface: SurfaceRef) -> bool {
+    let surface_mir = match cache.surface_mir(surface) {
+        Some(surface_mir) => surface_mir,
+        None => return false,
+    };
+
+    surface_mir.nodes.iter().all(|node| match &node.data {
+        NodeData::Dummy => true,
+        NodeData::Custom(block_id) => match cache.block_mir(*block_id) {
+            Some(block) => {
+                block
+                    .controls
+                    .iter()
+                    .all(|control| is_control_voice_local(control.control_type))
+                    && block.statements.iter().all(|statement| match statement {
+                        Statement::CallFunc { function, .. } => is_function_voice_local(*function),
+                        _ => true,
+                    })
+            }
+            None => false,
+        },
+        NodeData::Group(surface_id) => can_run_in_parallel(cache, *surface_id),
+        NodeData::ExtractGroup {
+            surface: surface_id,
+            ..
+        } => can_run_in_parallel(cache, *surface_id),
+    })
+}
+
+/// An extract group in the root surface whose voices are updated a chunk of frames at a time,
+/// instead of a frame at a time along with the rest of the graph. The root's nodes are split
+/// around it: the nodes before it run for every frame in the chunk, then the voices run for every
+/// frame, spread across the worker pool, then the nodes after it run for every frame. Values that
+/// cross the split are kept for each frame, so every node sees what it would have a frame at a
+/// time.
+///
+/// That only holds if nothing flows backwards across the split, so a surface is only split if:
+///  - Nothing before the group reads or writes a value written by the group or anything after it.
+///  - The group's sources aren't written by it or anything after it.
+///  - Anything else the voices read is never written, since it's shared by every voice.
+#[derive(Debug, Clone)]
+pub struct VoiceSplit {
+    pub node: usize,
+    pub voice_surface: SurfaceRef,
+
+    // Value groups written before the split that are read after it, including by the host.
+    pub kept_groups: Vec<usize>,
+}
+
+#[derive(Debug, Clone, Copy, Default)]
+struct GroupAccess {
+    written_before: bool,
+    read_before: bool,
+    written_after: bool,
+    read_after: bool,
+}
+
+/// Finds the first extract group in a surface that can be split around, see `VoiceSplit`. Groups
+/// whose voices can be updated together in lanes aren't split around, since a batch of voices is
+/// cheaper to run on one thread than to hand out one at a time, see `voice_lanes`.
+pub fn find_split(cache: &ObjectCache, surface: &Surface) -> Option<VoiceSplit> {
+    let node_index = surface.nodes.iter().position(|node| match node.data {
+        NodeData::ExtractGroup { surface, .. } => {
+            can_run_in_parallel(cache, surface) && !voice_lanes::can_run_in_lanes(cache, surface)
+        }
+        _ => false,
+    })?;
+    let split_node = &surface.nodes[node_index];
+    let (voice_surface, source_sockets, dest_sockets) = match split_node.data {
+        NodeData::ExtractGroup {
+            surface,
+            ref source_sockets,
+            ref dest_sockets,
+        } => (surface, source_sockets, dest_sockets),
+        _ => unreachable!(),
+    };
+
+    let mut accesses = vec![GroupAccess::default(); surface.groups.len()];
+    for (index, node) in surface.nodes.iter().enumerate() {
+        if index == node_index {
+            continue;
+        }
+
+        for socket in &node.sockets {
+            let access = &mut accesses[socket.group_id];
+            if index < node_index {
+                access.written_before |= socket.value_written;
+                access.read_before |= socket.value_read;
+            } else {
+                access.written_after |= socket.value_written;
+                access.read_after |= socket.value_read;
+            }
+        }
+    }
+
+    let can_split = accesses.iter().all(|access| {
+        !access.written_after || (!access.read_before && !access.written_before)
+    }) && split_node
+        .sockets
+        .iter()
+        .enumerate()
+        .all(|(socket_index, socket)| {
+            let access = &accesses[socket.group_id];
+            if dest_sockets.contains(&socket_index) {
+                !access.read_before && !access.written_before && !access.written_after
+            } else if source_sockets.contains(&socket_index) {
+                !socket.value_written && !access.written_after
+            } else {
+                let is_portal = match surface.groups[socket.group_id].source {
+                    ValueGroupSource::Socket(_) => true,
+                    _ => false,
+                };
+                !socket.value_written
+                    && !access.written_before
+                    && !access.written_after
+                    && !is_portal
+            }
+        });
+    if !can_split {
+        return None;
+    }
+
+    let kept_groups = surface
+        .groups
+        .iter()
+        .zip(accesses.iter())
+        .enumerate()
+        .filter(|(_, (group, access))| {
+            let is_portal = match group.source {
+                ValueGroupSource::Socket(_) => true,
+                _ => false,
+            };
+            access.written_before && (access.read_after || is_portal)
+        }).map(|(group_index, _)| group_index)
+        .collect();
+
+    Some(VoiceSplit {
+        node: node_index,
+        voice_surface,
+        kept_groups,
+    })
+}
+
+fn get_item_type(cache: &ObjectCache, surface: &Surface, group: usize) -> StructType {
+    match surface.groups[group].value_type {
+        VarType::Array(ref inner_type) => remap_type(cache.context(), inner_type),
+        _ => panic!("Extracted sockets must be arrays"),
+    }
+}
+
+fn build_chunk_global(module: &Module, name: &str, item_type: StructType) -> GlobalValue {
+    let chunk_type = item_type.array_type(CHUNK_FRAMES);
+    let global = util::get_or_create_global(module, name, &chunk_type);
+    global.set_linkage(Linkage::InternalLinkage);
+    global.set_initializer(&chunk_type.const_null());
+    global
+}
+
+fn build_voice_chunk_global(module: &Module, name: &str, item_type: StructType) -> GlobalValue {
+    let chunk_type = item_type
+        .array_type(ARRAY_CAPACITY as u32)
+        .array_type(CHUNK_FRAMES);
+    let global = util::get_or_create_global(module, name, &chunk_type);
+    global.set_linkage(Linkage::InternalLinkage);
+    global.set_initializer(&chunk_type.const_null());
+    global
+}
+
+fn build_bitmap_chunk_global(module: &Module, name: &str) -> GlobalValue {
+    let chunk_type = module.get_context().i32_type().array_type(CHUNK_FRAMES);
+    let global = util::get_or_create_global(module, name, &chunk_type);
+    global.set_linkage(Linkage::InternalLinkage);
+    global.set_initializer(&chunk_type.const_null());
+    global
+}
+
+fn get_frame_ptr(ctx: &mut BuilderContext, chunk: GlobalValue, frame: IntValue) -> PointerValue {
+    unsafe {
+        ctx.b.build_in_bounds_gep(
+            &chunk.as_pointer_value(),
+            &[ctx.context.i32_type().const_int(0, false), frame],
+            "frame.ptr",
+        )
+    }
+}
+
+fn get_voice_frame_ptr(
+    ctx: &mut BuilderContext,
+    chunk: GlobalValue,
+    frame: IntValue,
+    voice: IntValue,
+) -> PointerValue {
+    unsafe {
+        ctx.b.build_in_bounds_gep(
+            &chunk.as_pointer_value(),
+            &[ctx.context.i32_type().const_int(0, false), frame, voice],
+            "voiceframe.ptr",
+        )
+    }
+}
+
+/// Builds the code the root runs for a split, see `VoiceSplit`. The values kept between the parts
+/// of a chunk are globals private to the root's module, so they're never shared between
+/// instances of the root.
+///
+/// The voices are updated by a function named `voices_name`, which takes the index of a voice and
+/// updates it for every frame of the chunk. The worker pool is handed its address when the root
+/// is deployed.
+pub struct SplitBuilder<'a> {
+    cache: &'a ObjectCache,
+    surface: &'a Surface,
+    split: &'a VoiceSplit,
+    node_pointers: PointerValue,
+    kept_pointers: Vec<PointerValue>,
+
+    frame_count: GlobalValue,
+    active_chunk: GlobalValue,
+    run_chunk: GlobalValue,
+    source_chunks: Vec<GlobalValue>,
+    dest_chunks: Vec<GlobalValue>,
+    kept_chunks: Vec<GlobalValue>,
+
+    before_func: FunctionValue,
+    voices_func: FunctionValue,
+    after_func: FunctionValue,
+}
+
+impl<'a> SplitBuilder<'a> {
+    pub fn new(
+        module: &Module,
+        cache: &'a ObjectCache,
+        surface: &'a Surface,
+        split: &'a VoiceSplit,
+        voices_name: &str,
+        initialized: PointerValue,
+        scratch: PointerValue,
+        sockets: PointerValue,
+        pointers: PointerValue,
+    ) -> Self {
+        let context = module.get_context();
+        let layout: &SurfaceLayout = cache.surface_layout(surface.id.id).unwrap();
+        let node_pointers = unsafe {
+            pointers.const_in_bounds_gep(&[
+                context.i32_type().const_int(0, false),
+                context
+                    .i32_type()
+                    .const_int(layout.node_ptr_index(split.node) as u64, false),
+            ])
+        };
+        let kept_pointers: Vec<_> = split
+            .kept_groups
+            .iter()
+            .map(|&group| {
+                remap_pointer_source(
+                    &context,
+                    &layout.group_pointers[group],
+                    initialized,
+                    scratch,
+                    sockets,
+                ).into_pointer_value()
+            }).collect();
+
+        let (source_sockets, dest_sockets) = match surface.nodes[split.node].data {
+            NodeData::ExtractGroup {
+                ref source_sockets,
+                ref dest_sockets,
+                ..
+            } => (source_sockets, dest_sockets),
+            _ => unreachable!(),
+        };
+        let socket_group = |socket: usize| surface.nodes[split.node].sockets[socket].group_id;
+        let source_chunks = source_sockets
+            .iter()
+            .enumerate()
+            .map(|(index, &socket)| {
+                build_voice_chunk_global(
+                    module,
+                    &format!("maxim.split.source.{}", index),
+                    get_item_type(cache, surface, socket_group(socket)),
+                )
+            }).collect();
+        let dest_chunks = dest_sockets
+            .iter()
+            .enumerate()
+            .map(|(index, &socket)| {
+                build_voice_chunk_global(
+                    module,
+                    &format!("maxim.split.dest.{}", index),
+                    get_item_type(cache, surface, socket_group(socket)),
+                )
+            }).collect();
+        let kept_chunks = split
+            .kept_groups
+            .iter()
+            .enumerate()
+            .map(|(index, &group)| {
+                build_chunk_global(
+                    module,
+                    &format!("maxim.split.kept.{}", index),
+                    remap_type(&context, &surface.groups[group].value_type),
+                )
+            }).collect();
+
+        let frame_count =
+            util::get_or_create_global(module, "maxim.split.framecount", &context.i32_type());
+        frame_count.set_linkage(Linkage::InternalLinkage);
+        frame_count.set_initializer(&context.i32_type().const_int(0, false));
+
+        let before_func = surface::build_update_nodes_func(
+            module,
+            cache,
+            surface,
+            0..split.node,
+            "maxim.split.before",
+            pointers,
+        );
+        let after_func = surface::build_update_nodes_func(
+            module,
+            cache,
+            surface,
+            split.node + 1..surface.nodes.len(),
+            "maxim.split.after",
+            pointers,
+        );
+        let voices_func = util::get_or_create_func(module, voices_name, true, &|| {
+            (
+                Linkage::ExternalLinkage,
+                context
+                    .void_type()
+                    .fn_type(&[&context.i32_type()], false),
+            )
+        });
+
+        let builder = SplitBuilder {
+            cache,
+            surface,
+            split,
+            node_pointers,
+            kept_pointers,
+            frame_count,
+            active_chunk: build_bitmap_chunk_global(module, "maxim.split.active"),
+            run_chunk: build_bitmap_chunk_global(module, "maxim.split.run"),
+            source_chunks,
+            dest_chunks,
+            kept_chunks,
+            before_func,
+            voices_func,
+            after_func,
+        };
+        builder.build_voices_func(module);
+        builder
+    }
+
+    // Builds the function that updates one voice for every frame of a chunk it's running in. Each
+    // call only touches its own voice's items in the source and destination arrays, so voices can
+    // be run on different threads at the same time.
+    fn build_voices_func(&self, module: &Module) {
+        build_context_function(
+            module,
+            self.voices_func,
+            self.cache.target(),
+            &|mut ctx: BuilderContext| {
+                let voice = ctx.func.get_nth_param(0).unwrap().into_int_value();
+                let voices = ExtractedVoices::new(
+                    &mut ctx,
+                    self.surface,
+                    &self.surface.nodes[self.split.node],
+                    self.node_pointers,
+                );
+                let frame_count = ctx
+                    .b
+                    .build_load(&self.frame_count.as_pointer_value(), "framecount")
+                    .into_int_value();
+
+                build_frame_loop(&mut ctx, frame_count, &mut |ctx, frame| {
+                    let run_ptr = get_frame_ptr(ctx, self.run_chunk, frame);
+                    let run = ctx.b.build_load(&run_ptr, "run").into_int_value();
+                    let is_running = util::get_bit(ctx.b, run, voice);
+
+                    let update_block = ctx.context.append_basic_block(&ctx.func, "voice.update");
+                    let end_block = ctx.context.append_basic_block(&ctx.func, "voice.end");
+                    ctx.b
+                        .build_conditional_branch(&is_running, &update_block, &end_block);
+                    ctx.b.position_at_end(&update_block);
+
+                    for (source, &chunk) in self.source_chunks.iter().enumerate() {
+                        let kept_ptr = get_voice_frame_ptr(ctx, chunk, frame, voice);
+                        let item_ptr = voices.get_source(ctx, source).get_item_ptr(ctx.b, voice);
+                        util::copy_ptr(ctx.b, ctx.module, kept_ptr, item_ptr);
+                    }
+                    let voice_pointers = voices.get_voice_pointers(ctx, voice);
+                    surface::build_lifecycle_call(
+                        ctx.module,
+                        self.cache,
+                        ctx.b,
+                        self.split.voice_surface,
+                        LifecycleFunc::Update,
+                        voice_pointers,
+                    );
+                    for (dest, &chunk) in self.dest_chunks.iter().enumerate() {
+                        let item_ptr = voices.get_dest(ctx, dest).get_item_ptr(ctx.b, voice);
+                        let kept_ptr = get_voice_frame_ptr(ctx, chunk, frame, voice);
+                        util::copy_ptr(ctx.b, ctx.module, item_ptr, kept_ptr);
+                    }
+
+                    ctx.b.build_unconditional_branch(&end_block);
+                    ctx.b.position_at_end(&end_block);
+                });
+
+                ctx.b.build_return(None);
+            },
+        );
+    }
+
+    /// Sets how many frames are in the chunk being built, which must be at most `CHUNK_FRAMES`.
+    pub fn build_set_frame_count(&self, ctx: &mut BuilderContext, frame_count: IntValue) {
+        ctx.b
+            .build_store(&self.frame_count.as_pointer_value(), &frame_count);
+    }
+
+    /// Runs the nodes before the split for one frame of the chunk and keeps everything the voices
+    /// and the nodes after the split read from them. Returns the voices that need to run this
+    /// frame.
+    pub fn build_before(&self, ctx: &mut BuilderContext, frame: IntValue) -> IntValue {
+        ctx.b.build_call(&self.before_func, &[], "", false);
+
+        let voices = ExtractedVoices::new(
+            ctx,
+            self.surface,
+            &self.surface.nodes[self.split.node],
+            self.node_pointers,
+        );
+        let bitmaps = voices.build_bitmaps(ctx);
+        let active_ptr = get_frame_ptr(ctx, self.active_chunk, frame);
+        ctx.b.build_store(&active_ptr, &bitmaps.active);
+        let run_ptr = get_frame_ptr(ctx, self.run_chunk, frame);
+        ctx.b.build_store(&run_ptr, &bitmaps.run);
+
+        surface::build_voice_loop(ctx, bitmaps.run, &mut |ctx, voice| {
+            for (source, &chunk) in self.source_chunks.iter().enumerate() {
+                let item_ptr = voices.get_source(ctx, source).get_item_ptr(ctx.b, voice);
+                let kept_ptr = get_voice_frame_ptr(ctx, chunk, frame, voice);
+                util::copy_ptr(ctx.b, ctx.module, item_ptr, kept_ptr);
+            }
+        });
+        for (&group_ptr, &chunk) in self.kept_pointers.iter().zip(self.kept_chunks.iter()) {
+            let kept_ptr = get_frame_ptr(ctx, chunk, frame);
+            util::copy_ptr(ctx.b, ctx.module, group_ptr, kept_ptr);
+        }
+
+        bitmaps.run
+    }
+
+    /// Runs every voice in the bitmap for the whole chunk, on the worker pool if there's one.
+    pub fn build_voices(&self, ctx: &mut BuilderContext, voices: IntValue) {
+        let pool = ctx
+            .b
+            .build_load(
+                &globals::get_parallel_pool(ctx.module).as_pointer_value(),
+                "pool",
+            ).into_pointer_value();
+        let pool_address = ctx
+            .b
+            .build_ptr_to_int(pool, ctx.context.i64_type(), "pooladdress");
+        let has_pool = ctx.b.build_int_compare(
+            IntPredicate::NE,
+            pool_address,
+            ctx.context.i64_type().const_int(0, false),
+            "haspool",
+        );
+
+        // there's nothing to gain from the pool with less than two voices
+        let voice_count = ctx
+            .b
+            .build_call(
+                &intrinsics::ctpop_i32(ctx.module),
+                &[&voices],
+                "voicecount",
+                false,
+            ).left()
+            .unwrap()
+            .into_int_value();
+        let has_voices = ctx.b.build_int_compare(
+            IntPredicate::UGT,
+            voice_count,
+            ctx.context.i32_type().const_int(1, false),
+            "hasvoices",
+        );
+        let should_dispatch = ctx.b.build_and(has_pool, has_voices, "shoulddispatch");
+
+        let dispatch_block = ctx
+            .context
+            .append_basic_block(&ctx.func, "parallel.dispatch");
+        let serial_block = ctx.context.append_basic_block(&ctx.func, "parallel.serial");
+        let end_block = ctx.context.append_basic_block(&ctx.func, "parallel.end");
+        ctx.b
+            .build_conditional_branch(&should_dispatch, &dispatch_block, &serial_block);
+
+        ctx.b.position_at_end(&dispatch_block);
+        let dispatch_result = ctx
+            .b
+            .build_call(
+                &get_dispatch_func(ctx.module),
+                &[&pool, &voices],
+                "dispatchresult",
+                false,
+            ).left()
+            .unwrap()
+            .into_int_value();
+        let dispatched = ctx.b.build_int_compare(
+            IntPredicate::NE,
+            dispatch_result,
+            ctx.context.i8_type().const_int(0, false),
+            "dispatched",
+        );
+        ctx.b
+            .build_conditional_branch(&dispatched, &end_block, &serial_block);
+
+        ctx.b.position_at_end(&serial_block);
+        surface::build_voice_loop(ctx, voices, &mut |ctx, voice| {
+            ctx.b.build_call(&self.voices_func, &[&voice], "", false);
+        });
+        ctx.b.build_unconditional_branch(&end_block);
+
+        ctx.b.position_at_end(&end_block);
+    }
+
+    /// Puts back everything kept for one frame of the chunk, then runs the nodes after the split
+    /// for it.
+    pub fn build_after(&self, ctx: &mut BuilderContext, frame: IntValue) {
+        for (&group_ptr, &chunk) in self.kept_pointers.iter().zip(self.kept_chunks.iter()) {
+            let kept_ptr = get_frame_ptr(ctx, chunk, frame);
+            util::copy_ptr(ctx.b, ctx.module, kept_ptr, group_ptr);
+        }
+
+        // Silence is tracked here rather than by each voice, since the sleep state is shared by
+        // every voice. A voice that goes quiet is put to sleep from the next chunk.
+        let voices = ExtractedVoices::new(
+            ctx,
+            self.surface,
+            &self.surface.nodes[self.split.node],
+            self.node_pointers,
+        );
+        let run_ptr = get_frame_ptr(ctx, self.run_chunk, frame);
+        let run = ctx.b.build_load(&run_ptr, "run").into_int_value();
+        surface::build_voice_loop(ctx, run, &mut |ctx, voice| {
+            for (source, &chunk) in self.source_chunks.iter().enumerate() {
+                let kept_ptr = get_voice_frame_ptr(ctx, chunk, frame, voice);
+                let item_ptr = voices.get_source(ctx, source).get_item_ptr(ctx.b, voice);
+                util::copy_ptr(ctx.b, ctx.module, kept_ptr, item_ptr);
+            }
+            for (dest, &chunk) in self.dest_chunks.iter().enumerate() {
+                let kept_ptr = get_voice_frame_ptr(ctx, chunk, frame, voice);
+                let item_ptr = voices.get_dest(ctx, dest).get_item_ptr(ctx.b, voice);
+                util::copy_ptr(ctx.b, ctx.module, kept_ptr, item_ptr);
+            }
+            voices.build_track_silence(ctx, voice);
+        });
+        let active_ptr = get_frame_ptr(ctx, self.active_chunk, frame);
+        let active = ctx.b.build_load(&active_ptr, "active").into_int_value();
+        voices.build_set_dest_bitmaps(ctx, active);
+
+        ctx.b.build_call(&self.after_func, &[], "", false);
+    }
+}
+
+/// Builds a loop that runs once for each frame from zero up to `frame_count`.
+pub fn build_frame_loop(
+    ctx: &mut BuilderContext,
+    frame_count: IntValue,
+    cb: &mut FnMut(&mut BuilderContext, IntValue),
+) {
+    let index_ptr = ctx
+        .allocb
+        .build_alloca(&ctx.context.i32_type(), "frameindex.ptr");
+    ctx.b
+        .build_store(&index_ptr, &ctx.context.i32_type().const_int(0, false));
+
+    let check_block = ctx.context.append_basic_block(&ctx.func, "frame.check");
+    let run_block = ctx.context.append_basic_block(&ctx.func, "frame.run");
+    let end_block = ctx.context.append_basic_block(&ctx.func, "frame.end");
+
+    ctx.b.build_unconditional_branch(&check_block);
+    ctx.b.position_at_end(&check_block);
+    let current_index = ctx.b.build_load(&index_ptr, "frameindex").into_int_value();
+    let can_continue_loop = ctx.b.build_int_compare(
+        IntPredicate::ULT,
+        current_index,
+        frame_count,
+        "cancontinue",
+    );
+    ctx.b
+        .build_conditional_branch(&can_continue_loop, &run_block, &end_block);
+    ctx.b.position_at_end(&run_block);
+
+    cb(ctx, current_index);
+
+    let next_index = ctx.b.build_int_add(
+        current_index,
+        ctx.context.i32_type().const_int(1, false),
+        "nextindex",
+    );
+    ctx.b.build_store(&index_ptr, &next_index);
+    ctx.b.build_unconditional_branch(&check_block);
+
+    ctx.b.position_at_end(&end_block);
+}
+
+/// Builds a loop that splits `frame_count` frames into chunks of at most `CHUNK_FRAMES`, and runs
+/// once for each with the index of the chunk's first frame and the number of frames in it.
+pub fn build_chunk_loop(
+    ctx: &mut BuilderContext,
+    frame_count: IntValue,
+    cb: &mut FnMut(&mut BuilderContext, IntValue, IntValue),
+) {
+    let chunk_frames = ctx
+        .context
+        .i32_type()
+        .const_int(u64::from(CHUNK_FRAMES), false);
+    let start_ptr = ctx
+        .allocb
+        .build_alloca(&ctx.context.i32_type(), "chunkstart.ptr");
+    ctx.b
+        .build_store(&start_ptr, &ctx.context.i32_type().const_int(0, false));
+
+    let check_block = ctx.context.append_basic_block(&ctx.func, "chunk.check");
+    let run_block = ctx.context.append_basic_block(&ctx.func, "chunk.run");
+    let end_block = ctx.context.append_basic_block(&ctx.func, "chunk.end");
+
+    ctx.b.build_unconditional_branch(&check_block);
+    ctx.b.position_at_end(&check_block);
+    let current_start = ctx.b.build_load(&start_ptr, "chunkstart").into_int_value();
+    let can_continue_loop = ctx.b.build_int_compare(
+        IntPredicate::ULT,
+        current_start,
+        frame_count,
+        "cancontinue",
+    );
+    ctx.b
+        .build_conditional_branch(&can_continue_loop, &run_block, &end_block);
+    ctx.b.position_at_end(&run_block);
+
+    let remaining_frames = ctx
+        .b
+        .build_int_sub(frame_count, current_start, "remainingframes");
+    let is_last_chunk = ctx.b.build_int_compare(
+        IntPredicate::ULT,
+        remaining_frames,
+        chunk_frames,
+        "islastchunk",
+    );
+    let current_frames = ctx
+        .b
+        .build_select(is_last_chunk, remaining_frames, chunk_frames, "chunkframes")
+        .into_int_value();
+
+    cb(ctx, current_start, current_frames);
+
+    let next_start = ctx
+        .b
+        .build_int_add(current_start, chunk_frames, "nextstart");
+    ctx.b.build_store(&start_ptr, &next_start);
+    ctx.b.build_unconditional_branch(&check_block);
+
+    ctx.b.position_at_end(&end_block);
+}
@@ -1,12 +1,15 @@
+use ast::FormType;
 use codegen::data_analyzer::{PointerSource, PointerSourceAggregateType};
-use codegen::values::remap_type;
-use codegen::{build_context_function, surface, util, BuilderContext, LifecycleFunc, ObjectCache};
+use codegen::values::{remap_type, NumValue};
+use codegen::{
+    build_context_function, parallel, surface, util, BuilderContext, LifecycleFunc, ObjectCache,
+};
 use inkwell::context::Context;
 use inkwell::module::{Linkage, Module};
 use inkwell::types::BasicType;
 use inkwell::values::{BasicValue, BasicValueEnum, GlobalValue, IntValue, PointerValue};
-use inkwell::AddressSpace;
-use mir::{Root, SurfaceRef};
+use inkwell::{AddressSpace, IntPredicate};
+use mir::{Root, SurfaceRef, VarType};
 use std::iter;
 
 fn get_gep_indices(context: &Context, path: impl IntoIterator<Item = u64>) -> Vec<IntValue> {
@@ -228,3 +231,322 @@ pub fn build_funcs(
         pointers,
     );
 }
+
+struct BlockBuffer {
+    left: PointerValue,
+    right: PointerValue,
+    is_active: IntValue,
+}
+
+// Loads the left/right planar buffer pointers for a socket out of a buffer array, along with a
+// flag signifying if they were provided. Buffers are laid out as two pointers per root socket.
+fn load_block_buffer(
+    ctx: &mut BuilderContext,
+    buffers: PointerValue,
+    socket: usize,
+) -> BlockBuffer {
+    let left_ptr = unsafe {
+        ctx.b.build_in_bounds_gep(
+            &buffers,
+            &[ctx.context.i64_type().const_int(socket as u64 * 2, false)],
+            "buffer.left.ptr",
+        )
+    };
+    let right_ptr = unsafe {
+        ctx.b.build_in_bounds_gep(
+            &buffers,
+            &[ctx.context.i64_type().const_int(socket as u64 * 2 + 1, false)],
+            "buffer.right.ptr",
+        )
+    };
+    let left = ctx
+        .b
+        .build_load(&left_ptr, "buffer.left")
+        .into_pointer_value();
+    let right = ctx
+        .b
+        .build_load(&right_ptr, "buffer.right")
+        .into_pointer_value();
+    let left_int = ctx
+        .b
+        .build_ptr_to_int(left, ctx.context.i64_type(), "buffer.left.int");
+    let is_active = ctx.b.build_int_compare(
+        IntPredicate::NE,
+        left_int,
+        ctx.context.i64_type().const_int(0, false),
+        "buffer.active",
+    );
+
+    BlockBuffer {
+        left,
+        right,
+        is_active,
+    }
+}
+
+fn build_buffer_branch(
+    ctx: &mut BuilderContext,
+    buffer: &BlockBuffer,
+    name: &str,
+    cb: &mut FnMut(&mut BuilderContext),
+) {
+    let run_block = ctx.context.append_basic_block(&ctx.func, name);
+    let end_block = ctx
+        .context
+        .append_basic_block(&ctx.func, &format!("{}.end", name));
+    ctx.b
+        .build_conditional_branch(&buffer.is_active, &run_block, &end_block);
+    ctx.b.position_at_end(&run_block);
+    cb(ctx);
+    ctx.b.build_unconditional_branch(&end_block);
+    ctx.b.position_at_end(&end_block);
+}
+
+// A root number socket that's streamed from and to planar sample buffers.
+struct SocketBuffers {
+    socket: NumValue,
+    input: BlockBuffer,
+    output: BlockBuffer,
+}
+
+fn build_load_inputs(ctx: &mut BuilderContext, buffers: &[SocketBuffers], frame: IntValue) {
+    let oscillator_form = ctx
+        .context
+        .i8_type()
+        .const_int(FormType::Oscillator as u64, false);
+    for socket_buffers in buffers {
+        let input = &socket_buffers.input;
+        build_buffer_branch(ctx, input, "input", &mut |ctx| {
+            let left_ptr = unsafe { ctx.b.build_in_bounds_gep(&input.left, &[frame], "") };
+            let right_ptr = unsafe { ctx.b.build_in_bounds_gep(&input.right, &[frame], "") };
+            let left = ctx.b.build_load(&left_ptr, "left");
+            let right = ctx.b.build_load(&right_ptr, "right");
+            let vec = ctx
+                .b
+                .build_insert_element(
+                    &ctx.b
+                        .build_insert_element(
+                            &ctx.context.f32_type().vec_type(2).get_undef(),
+                            &left,
+                            &ctx.context.i32_type().const_int(0, false),
+                            "",
+                        ).into_vector_value(),
+                    &right,
+                    &ctx.context.i32_type().const_int(1, false),
+                    "vec",
+                ).into_vector_value();
+            socket_buffers.socket.set_vec(ctx.b, &vec);
+            socket_buffers.socket.set_form(ctx.b, &oscillator_form);
+        });
+    }
+}
+
+fn build_store_outputs(ctx: &mut BuilderContext, buffers: &[SocketBuffers], frame: IntValue) {
+    for socket_buffers in buffers {
+        let output = &socket_buffers.output;
+        build_buffer_branch(ctx, output, "output", &mut |ctx| {
+            let vec = socket_buffers.socket.get_vec(ctx.b);
+            let left = ctx.b.build_extract_element(
+                &vec,
+                &ctx.context.i32_type().const_int(0, false),
+                "left",
+            );
+            let right = ctx.b.build_extract_element(
+                &vec,
+                &ctx.context.i32_type().const_int(1, false),
+                "right",
+            );
+            let left_ptr = unsafe { ctx.b.build_in_bounds_gep(&output.left, &[frame], "") };
+            let right_ptr = unsafe { ctx.b.build_in_bounds_gep(&output.right, &[frame], "") };
+            ctx.b.build_store(&left_ptr, &left);
+            ctx.b.build_store(&right_ptr, &right);
+        });
+    }
+}
+
+// Builds a function that runs the update lifecycle function for a number of frames, reading
+// number sockets from and writing them to planar sample buffers. This avoids a call across the FFI
+// boundary for every sample, and allows LLVM to inline the update function into the loop.
+//
+// If the root has an extract group whose voices can be spread across the worker pool, the block is
+// run a chunk at a time instead, so the pool is only woken once per chunk, see
+// `parallel::VoiceSplit`. The function that updates the voices is named `voices_name`.
+pub fn build_update_block_func(
+    module: &Module,
+    cache: &ObjectCache,
+    root: &Root,
+    name: &str,
+    update_name: &str,
+    voices_name: &str,
+    initialized: PointerValue,
+    scratch: PointerValue,
+    sockets: PointerValue,
+    pointers: PointerValue,
+) {
+    let context = module.get_context();
+    let buffer_ptr_type = context
+        .f32_type()
+        .ptr_type(AddressSpace::Generic)
+        .ptr_type(AddressSpace::Generic);
+    let func = util::get_or_create_func(module, name, true, &|| {
+        (
+            Linkage::ExternalLinkage,
+            context.void_type().fn_type(
+                &[
+                    &context.i32_type(), // frame count
+                    &buffer_ptr_type,    // input buffers
+                    &buffer_ptr_type,    // output buffers
+                ],
+                false,
+            ),
+        )
+    });
+    let update_func = util::get_or_create_func(module, update_name, true, &|| {
+        (
+            Linkage::ExternalLinkage,
+            context.void_type().fn_type(&[], false),
+        )
+    });
+
+    let surface = cache.surface_mir(0);
+    let split = surface.and_then(|surface| parallel::find_split(cache, surface));
+    let split_builder = split.as_ref().map(|split| {
+        parallel::SplitBuilder::new(
+            module,
+            cache,
+            surface.unwrap(),
+            split,
+            voices_name,
+            initialized,
+            scratch,
+            sockets,
+            pointers,
+        )
+    });
+
+    build_context_function(module, func, cache.target(), &|mut ctx: BuilderContext| {
+        let frame_count = ctx.func.get_nth_param(0).unwrap().into_int_value();
+        let input_buffers = ctx.func.get_nth_param(1).unwrap().into_pointer_value();
+        let output_buffers = ctx.func.get_nth_param(2).unwrap().into_pointer_value();
+
+        // only number sockets can be streamed from buffers, MIDI must still be pushed by the host
+        let buffers: Vec<_> = root
+            .sockets
+            .iter()
+            .enumerate()
+            .filter(|(_, vartype)| **vartype == VarType::Num)
+            .map(|(socket_index, _)| {
+                let socket = NumValue::new(unsafe {
+                    ctx.b.build_in_bounds_gep(
+                        &sockets,
+                        &[
+                            ctx.context.i64_type().const_int(0, false),
+                            ctx.context.i32_type().const_int(socket_index as u64, false),
+                        ],
+                        "socket",
+                    )
+                });
+                let input = load_block_buffer(&mut ctx, input_buffers, socket_index);
+                let output = load_block_buffer(&mut ctx, output_buffers, socket_index);
+                SocketBuffers {
+                    socket,
+                    input,
+                    output,
+                }
+            }).collect();
+
+        match split_builder {
+            Some(ref split_builder) => {
+                parallel::build_chunk_loop(&mut ctx, frame_count, &mut |ctx, start, frames| {
+                    split_builder.build_set_frame_count(ctx, frames);
+
+                    // the voices that run in any frame of the chunk
+                    let voices_ptr = ctx
+                        .allocb
+                        .build_alloca(&ctx.context.i32_type(), "voices.ptr");
+                    ctx.b
+                        .build_store(&voices_ptr, &ctx.context.i32_type().const_int(0, false));
+
+                    parallel::build_frame_loop(ctx, frames, &mut |ctx, frame| {
+                        let index = ctx.b.build_int_add(start, frame, "index");
+                        build_load_inputs(ctx, &buffers, index);
+                        let run = split_builder.build_before(ctx, frame);
+                        let voices = ctx.b.build_load(&voices_ptr, "voices").into_int_value();
+                        let new_voices = ctx.b.build_or(voices, run, "newvoices");
+                        ctx.b.build_store(&voices_ptr, &new_voices);
+                    });
+
+                    let voices = ctx.b.build_load(&voices_ptr, "voices").into_int_value();
+                    split_builder.build_voices(ctx, voices);
+
+                    parallel::build_frame_loop(ctx, frames, &mut |ctx, frame| {
+                        let index = ctx.b.build_int_add(start, frame, "index");
+                        build_load_inputs(ctx, &buffers, index);
+                        split_builder.build_after(ctx, frame);
+                        build_store_outputs(ctx, &buffers, index);
+                    });
+                });
+            }
+            None => {
+                parallel::build_frame_loop(&mut ctx, frame_count, &mut |ctx, index| {
+                    build_load_inputs(ctx, &buffers, index);
+                    ctx.b.build_call(&update_func, &[], "", false);
+                    build_store_outputs(ctx, &buffers, index);
+                });
+            }
+        }
+
+        ctx.b.build_return(None);
+    });
+}
+
+// Builds a function that returns a pointer to a root socket given its index, or null if there's no
+// socket with that index. Code that links against an exported object uses this to find portals
+// without knowing the layout of the sockets.
+pub fn build_get_portal_func(
+    module: &Module,
+    cache: &ObjectCache,
+    root: &Root,
+    name: &str,
+    socket_ptrs: PointerValue,
+) {
+    let context = module.get_context();
+    let void_ptr_type = context.i8_type().ptr_type(AddressSpace::Generic);
+    let func = util::get_or_create_func(module, name, true, &|| {
+        (
+            Linkage::ExternalLinkage,
+            void_ptr_type.fn_type(&[&context.i32_type()], false),
+        )
+    });
+
+    build_context_function(module, func, cache.target(), &|ctx: BuilderContext| {
+        let socket_index = ctx.func.get_nth_param(0).unwrap().into_int_value();
+        let is_valid = ctx.b.build_int_compare(
+            IntPredicate::ULT,
+            socket_index,
+            ctx.context
+                .i32_type()
+                .const_int(root.sockets.len() as u64, false),
+            "isvalid",
+        );
+
+        let valid_block = ctx.context.append_basic_block(&ctx.func, "valid");
+        let invalid_block = ctx.context.append_basic_block(&ctx.func, "invalid");
+        ctx.b
+            .build_conditional_branch(&is_valid, &valid_block, &invalid_block);
+
+        ctx.b.position_at_end(&valid_block);
+        let socket_ptr_ptr = unsafe {
+            ctx.b.build_in_bounds_gep(
+                &socket_ptrs,
+                &[ctx.context.i32_type().const_int(0, false), socket_index],
+                "socketptr.ptr",
+            )
+        };
+        let socket_ptr = ctx.b.build_load(&socket_ptr_ptr, "socketptr");
+        ctx.b.build_return(Some(&socket_ptr));
+
+        ctx.b.position_at_end(&invalid_block);
+        ctx.b.build_return(Some(&void_ptr_type.const_null()));
+    });
+}
@@ -1,11 +1,22 @@
+use codegen::values::ArrayValue;
 use codegen::{
-    block, build_context_function, util, values, BuilderContext, LifecycleFunc, ObjectCache,
+    block, build_context_function, intrinsics, util, voice_lanes, voice_sleep, BuilderContext,
+    LifecycleFunc, ObjectCache,
 };
 use inkwell::builder::Builder;
 use inkwell::module::{Linkage, Module};
-use inkwell::values::{FunctionValue, PointerValue};
+use inkwell::values::{FunctionValue, IntValue, PointerValue};
 use inkwell::{AddressSpace, IntPredicate};
 use mir::{Node, NodeData, Surface, SurfaceRef};
+use std::ops::Range;
+
+fn get_lifecycle_func_name(
+    surface: SurfaceRef,
+    version: u64,
+    lifecycle: LifecycleFunc,
+) -> String {
+    format!("maxim.surface.{}.{:x}.{}", surface, version, lifecycle)
+}
 
 fn get_lifecycle_func(
     module: &Module,
@@ -13,7 +24,7 @@ fn get_lifecycle_func(
     surface: SurfaceRef,
     lifecycle: LifecycleFunc,
 ) -> FunctionValue {
-    let func_name = format!("maxim.surface.{}.{}", surface, lifecycle);
+    let func_name = get_lifecycle_func_name(surface, cache.surface_version(surface), lifecycle);
     util::get_or_create_func(module, &func_name, true, &|| {
         let context = module.get_context();
         let layout = cache.surface_layout(surface).unwrap();
@@ -30,6 +41,7 @@ fn get_lifecycle_func(
 fn build_node_call(
     ctx: &mut BuilderContext,
     cache: &ObjectCache,
+    surface: &Surface,
     node: &Node,
     lifecycle: LifecycleFunc,
     pointers_ptr: PointerValue,
@@ -58,158 +70,285 @@ fn build_node_call(
         }
         NodeData::ExtractGroup {
             surface: surface_id,
-            source_sockets,
-            dest_sockets,
+            ..
         } => {
-            let voice_pointers = unsafe { ctx.b.build_struct_gep(&pointers_ptr, 0, "voices.ptr") };
-            let source_socket_pointers =
-                unsafe { ctx.b.build_struct_gep(&pointers_ptr, 1, "sources.ptr") };
-            let dest_socket_pointers =
-                unsafe { ctx.b.build_struct_gep(&pointers_ptr, 2, "dests.ptr") };
-            let bitmap_pointer =
-                unsafe { ctx.b.build_struct_gep(&pointers_ptr, 3, "bitmap.ptr.ptr") };
-
-            // if this is the update lifecycle function and there are source groups, generate a
-            // bitmap of which indices are valid
-            let valid_bitmap = if lifecycle == LifecycleFunc::Update && !source_sockets.is_empty() {
-                let first_array = values::ArrayValue::new(
-                    ctx.b
-                        .build_load(
-                            &unsafe { ctx.b.build_struct_gep(&source_socket_pointers, 0, "") },
-                            "",
-                        ).into_pointer_value(),
-                );
-                let first_bitmap = first_array.get_bitmap(ctx.b);
-
-                let active_bitmap =
-                    (1..source_sockets.len()).fold(first_bitmap, |acc, socket_index| {
-                        let nth_array = values::ArrayValue::new(
-                            ctx.b
-                                .build_load(
-                                    &unsafe {
-                                        ctx.b.build_struct_gep(
-                                            &source_socket_pointers,
-                                            socket_index as u32,
-                                            "",
-                                        )
-                                    },
-                                    "",
-                                ).into_pointer_value(),
-                        );
-                        let nth_bitmap = nth_array.get_bitmap(ctx.b);
-                        ctx.b.build_and(acc, nth_bitmap, "")
+            let voices = ExtractedVoices::new(ctx, surface, node, pointers_ptr);
+            if lifecycle == LifecycleFunc::Construct {
+                voice_sleep::build_reset(ctx, voices.sleep_state);
+            }
+
+            // lifecycle functions other than update visit every voice
+            if lifecycle != LifecycleFunc::Update {
+                let all_voices = get_all_voices(ctx);
+                build_voice_loop(ctx, all_voices, &mut |ctx, voice| {
+                    let voice_pointers = voices.get_voice_pointers(ctx, voice);
+                    build_lifecycle_call(
+                        ctx.module,
+                        cache,
+                        ctx.b,
+                        *surface_id,
+                        lifecycle,
+                        voice_pointers,
+                    );
+                });
+                return;
+            }
+
+            let bitmaps = voices.build_bitmaps(ctx);
+            if voice_lanes::can_run_in_lanes(cache, *surface_id) {
+                voice_lanes::build_update(ctx, cache, &voices, bitmaps.run);
+                if voices.tracks_silence() {
+                    build_voice_loop(ctx, bitmaps.run, &mut |ctx, voice| {
+                        voices.build_track_silence(ctx, voice);
                     });
-                ctx.b.build_store(
-                    &ctx.b
-                        .build_load(&bitmap_pointer, "bitmap.ptr")
-                        .into_pointer_value(),
-                    &active_bitmap,
+                }
+                voices.build_set_dest_bitmaps(ctx, bitmaps.active);
+                return;
+            }
+
+            build_voice_loop(ctx, bitmaps.run, &mut |ctx, voice| {
+                let voice_pointers = voices.get_voice_pointers(ctx, voice);
+                build_lifecycle_call(
+                    ctx.module,
+                    cache,
+                    ctx.b,
+                    *surface_id,
+                    lifecycle,
+                    voice_pointers,
                 );
+                voices.build_track_silence(ctx, voice);
+            });
+            voices.build_set_dest_bitmaps(ctx, bitmaps.active);
+        }
+    }
+}
 
-                Some(active_bitmap)
-            } else {
-                None
-            };
+fn get_all_voices(ctx: &mut BuilderContext) -> IntValue {
+    ctx.b
+        .build_not(&ctx.context.i32_type().const_int(0, false), "allvoices")
+}
 
-            // build a for loop to iterate over each instance
-            let index_ptr = ctx
-                .allocb
-                .build_alloca(&ctx.context.i8_type(), "voiceindex.ptr");
-            ctx.b
-                .build_store(&index_ptr, &ctx.context.i8_type().const_int(0, false));
-
-            let check_block = ctx.context.append_basic_block(&ctx.func, "voice.check");
-            let check_active_block = ctx
-                .context
-                .append_basic_block(&ctx.func, "voice.checkactive");
-            let run_block = ctx.context.append_basic_block(&ctx.func, "voice.run");
-            let end_block = ctx.context.append_basic_block(&ctx.func, "voice.end");
-
-            ctx.b.build_unconditional_branch(&check_block);
-            ctx.b.position_at_end(&check_block);
-
-            let current_index = ctx.b.build_load(&index_ptr, "voiceindex").into_int_value();
-            let iter_limit = ctx
-                .context
-                .i8_type()
-                .const_int(values::ARRAY_CAPACITY as u64, false);
-            let can_continue_loop = ctx.b.build_int_compare(
-                IntPredicate::ULT,
-                current_index,
-                iter_limit,
-                "cancontinue",
-            );
+/// Builds a loop that visits each set bit of a voice bitmap, lowest first. Voices that aren't
+/// playing cost nothing, instead of a check for each of the 32 slots.
+pub fn build_voice_loop(
+    ctx: &mut BuilderContext,
+    voices: IntValue,
+    cb: &mut FnMut(&mut BuilderContext, IntValue),
+) {
+    let remaining_ptr = ctx
+        .allocb
+        .build_alloca(&ctx.context.i32_type(), "remainingvoices.ptr");
+    ctx.b.build_store(&remaining_ptr, &voices);
+
+    let check_block = ctx.context.append_basic_block(&ctx.func, "voice.check");
+    let run_block = ctx.context.append_basic_block(&ctx.func, "voice.run");
+    let end_block = ctx.context.append_basic_block(&ctx.func, "voice.end");
 
+    ctx.b.build_unconditional_branch(&check_block);
+    ctx.b.position_at_end(&check_block);
+
+    let remaining_voices = ctx
+        .b
+        .build_load(&remaining_ptr, "remainingvoices")
+        .into_int_value();
+    let can_continue_loop = ctx.b.build_int_compare(
+        IntPredicate::NE,
+        remaining_voices,
+        ctx.context.i32_type().const_int(0, false),
+        "cancontinue",
+    );
+    ctx.b
+        .build_conditional_branch(&can_continue_loop, &run_block, &end_block);
+    ctx.b.position_at_end(&run_block);
+
+    let index_32 = ctx
+        .b
+        .build_call(
+            &intrinsics::cttz_i32(ctx.module),
+            &[
+                &remaining_voices,
+                &ctx.context.bool_type().const_int(1, false),
+            ],
+            "voiceindex",
+            false,
+        ).left()
+        .unwrap()
+        .into_int_value();
+
+    // clear the lowest set bit, which is the voice we're about to run
+    let next_remaining = ctx.b.build_and(
+        remaining_voices,
+        ctx.b.build_int_sub(
+            remaining_voices,
+            ctx.context.i32_type().const_int(1, false),
+            "",
+        ),
+        "nextremaining",
+    );
+    ctx.b.build_store(&remaining_ptr, &next_remaining);
+
+    cb(ctx, index_32);
+
+    ctx.b.build_unconditional_branch(&check_block);
+    ctx.b.position_at_end(&end_block);
+}
+
+/// The voices an extract group node should update, see `ExtractedVoices::build_bitmaps`.
+pub struct VoiceBitmaps {
+    /// Voices that have a value in every source array, or every voice if there are no sources.
+    pub active: IntValue,
+    /// The active voices that aren't asleep.
+    pub run: IntValue,
+}
+
+/// The pointers of an extract group node, and the parts of its update that work on the group as
+/// a whole rather than one voice. They're kept apart from the update of each voice so the root
+/// can run them a frame at a time around voices that are run a chunk at a time, see
+/// `parallel::VoiceSplit`.
+pub struct ExtractedVoices {
+    pub surface: SurfaceRef,
+    pub source_count: usize,
+    pub dest_count: usize,
+    voices: PointerValue,
+    sources: PointerValue,
+    dests: PointerValue,
+    bitmap: PointerValue,
+    sleep_state: PointerValue,
+    sleep_output_kinds: Option<Vec<voice_sleep::OutputKind>>,
+}
+
+impl ExtractedVoices {
+    pub fn new(
+        ctx: &mut BuilderContext,
+        surface: &Surface,
+        node: &Node,
+        pointers_ptr: PointerValue,
+    ) -> Self {
+        let (voice_surface, source_count, dest_count) = match node.data {
+            NodeData::ExtractGroup {
+                surface,
+                ref source_sockets,
+                ref dest_sockets,
+            } => (surface, source_sockets.len(), dest_sockets.len()),
+            _ => panic!("Node isn't an extract group"),
+        };
+
+        let voices = unsafe { ctx.b.build_struct_gep(&pointers_ptr, 0, "voices.ptr") };
+        let sources = unsafe { ctx.b.build_struct_gep(&pointers_ptr, 1, "sources.ptr") };
+        let dests = unsafe { ctx.b.build_struct_gep(&pointers_ptr, 2, "dests.ptr") };
+        let bitmap = ctx
+            .b
+            .build_load(
+                &unsafe { ctx.b.build_struct_gep(&pointers_ptr, 3, "bitmap.ptr.ptr") },
+                "bitmap.ptr",
+            ).into_pointer_value();
+        let sleep_state = ctx
+            .b
+            .build_load(
+                &unsafe { ctx.b.build_struct_gep(&pointers_ptr, 4, "sleep.ptr.ptr") },
+                "sleep.ptr",
+            ).into_pointer_value();
+
+        ExtractedVoices {
+            surface: voice_surface,
+            source_count,
+            dest_count,
+            voices,
+            sources,
+            dests,
+            bitmap,
+            sleep_state,
+            sleep_output_kinds: voice_sleep::get_output_kinds(surface, node),
+        }
+    }
+
+    fn get_array(&self, ctx: &mut BuilderContext, arrays: PointerValue, index: usize) -> ArrayValue {
+        ArrayValue::new(
             ctx.b
-                .build_conditional_branch(&can_continue_loop, &check_active_block, &end_block);
-            ctx.b.position_at_end(&check_active_block);
-
-            // increment the stored value
-            let next_index = ctx.b.build_int_add(
-                current_index,
-                ctx.context.i8_type().const_int(1, false),
-                "nextindex",
-            );
-            ctx.b.build_store(&index_ptr, &next_index);
-
-            let index_32 = ctx
-                .b
-                .build_int_z_extend(current_index, ctx.context.i32_type(), "");
-            if let Some(active_bitmap) = valid_bitmap {
-                // check if this iteration is active according to the bitmap
-                let active_bit = util::get_bit(ctx.b, active_bitmap, index_32);
-                ctx.b
-                    .build_conditional_branch(&active_bit, &run_block, &check_block);
-            } else {
-                ctx.b.build_unconditional_branch(&run_block);
-            }
+                .build_load(
+                    &unsafe { ctx.b.build_struct_gep(&arrays, index as u32, "") },
+                    "",
+                ).into_pointer_value(),
+        )
+    }
 
-            ctx.b.position_at_end(&run_block);
+    pub fn get_source(&self, ctx: &mut BuilderContext, source: usize) -> ArrayValue {
+        self.get_array(ctx, self.sources, source)
+    }
 
-            let const_zero = ctx.context.i32_type().const_int(0, false);
-            let voice_pointers_ptr = unsafe {
-                ctx.b
-                    .build_in_bounds_gep(&voice_pointers, &[const_zero, index_32], "pointersptr")
+    pub fn get_dest(&self, ctx: &mut BuilderContext, dest: usize) -> ArrayValue {
+        self.get_array(ctx, self.dests, dest)
+    }
+
+    pub fn get_voice_pointers(&self, ctx: &mut BuilderContext, voice: IntValue) -> PointerValue {
+        let const_zero = ctx.context.i32_type().const_int(0, false);
+        unsafe {
+            ctx.b
+                .build_in_bounds_gep(&self.voices, &[const_zero, voice], "pointersptr")
+        }
+    }
+
+    /// Works out which voices to update this frame. Voices that have been silent for long enough
+    /// are skipped until they get a MIDI event.
+    pub fn build_bitmaps(&self, ctx: &mut BuilderContext) -> VoiceBitmaps {
+        if self.source_count == 0 {
+            let all_voices = get_all_voices(ctx);
+            return VoiceBitmaps {
+                active: all_voices,
+                run: all_voices,
             };
+        }
 
-            build_lifecycle_call(
-                ctx.module,
-                cache,
-                ctx.b,
-                *surface_id,
-                lifecycle,
-                voice_pointers_ptr,
+        let first_bitmap = self.get_source(ctx, 0).get_bitmap(ctx.b);
+        let active = (1..self.source_count).fold(first_bitmap, |acc, source| {
+            let nth_bitmap = self.get_source(ctx, source).get_bitmap(ctx.b);
+            ctx.b.build_and(acc, nth_bitmap, "")
+        });
+        ctx.b.build_store(&self.bitmap, &active);
+
+        let run = if self.sleep_output_kinds.is_some() {
+            voice_sleep::build_wake(
+                ctx,
+                self.sleep_state,
+                self.sources,
+                self.source_count,
+                active,
+            )
+        } else {
+            active
+        };
+
+        VoiceBitmaps { active, run }
+    }
+
+    /// Returns if voices can go to sleep, which needs a source to wake them up again.
+    pub fn tracks_silence(&self) -> bool {
+        self.source_count != 0 && self.sleep_output_kinds.is_some()
+    }
+
+    /// Tracks if a voice that's just been updated has gone silent, see
+    /// `voice_sleep::build_track_silence`.
+    pub fn build_track_silence(&self, ctx: &mut BuilderContext, voice: IntValue) {
+        if !self.tracks_silence() {
+            return;
+        }
+        if let Some(ref output_kinds) = self.sleep_output_kinds {
+            voice_sleep::build_track_silence(
+                ctx,
+                self.sleep_state,
+                self.sources,
+                self.source_count,
+                self.dests,
+                output_kinds,
+                voice,
             );
+        }
+    }
 
-            ctx.b.build_unconditional_branch(&check_block);
-            ctx.b.position_at_end(&end_block);
-
-            // set the bitmaps of all output arrays to be this input
-            if lifecycle == LifecycleFunc::Update {
-                let active_bitmap = if let Some(active_bitmap) = valid_bitmap {
-                    active_bitmap
-                } else {
-                    ctx.b
-                        .build_not(&ctx.context.i32_type().const_int(0, false), "")
-                };
-
-                for dest_socket_index in 0..dest_sockets.len() {
-                    let dest_array = values::ArrayValue::new(
-                        ctx.b
-                            .build_load(
-                                &unsafe {
-                                    ctx.b.build_struct_gep(
-                                        &dest_socket_pointers,
-                                        dest_socket_index as u32,
-                                        "",
-                                    )
-                                },
-                                "",
-                            ).into_pointer_value(),
-                    );
-                    dest_array.set_bitmap(ctx.b, &active_bitmap);
-                }
-            }
+    /// Sets the bitmaps of all output arrays to the voices that were active.
+    pub fn build_set_dest_bitmaps(&self, ctx: &mut BuilderContext, active: IntValue) {
+        for dest in 0..self.dest_count {
+            self.get_dest(ctx, dest).set_bitmap(ctx.b, &active);
         }
     }
 }
@@ -232,13 +371,55 @@ pub fn build_lifecycle_func(
                     .build_struct_gep(&pointers_ptr, layout_ptr_index as u32, "")
             };
 
-            build_node_call(&mut ctx, cache, node, lifecycle, node_pointers_ptr);
+            build_node_call(&mut ctx, cache, surface, node, lifecycle, node_pointers_ptr);
         }
 
         ctx.b.build_return(None);
     })
 }
 
+/// Builds a function that updates a range of a surface's nodes, so the root can run the nodes on
+/// either side of a split separately, see `parallel::VoiceSplit`. `pointers` is the surface's
+/// pointer struct, which must be a constant.
+pub fn build_update_nodes_func(
+    module: &Module,
+    cache: &ObjectCache,
+    surface: &Surface,
+    nodes: Range<usize>,
+    name: &str,
+    pointers: PointerValue,
+) -> FunctionValue {
+    let func = util::get_or_create_func(module, name, true, &|| {
+        (
+            Linkage::InternalLinkage,
+            module.get_context().void_type().fn_type(&[], false),
+        )
+    });
+    build_context_function(module, func, cache.target(), &|mut ctx: BuilderContext| {
+        let layout = cache.surface_layout(surface.id.id).unwrap();
+
+        for node_index in nodes.clone() {
+            let layout_ptr_index = layout.node_ptr_index(node_index);
+            let node_pointers_ptr = unsafe {
+                ctx.b
+                    .build_struct_gep(&pointers, layout_ptr_index as u32, "")
+            };
+
+            build_node_call(
+                &mut ctx,
+                cache,
+                surface,
+                &surface.nodes[node_index],
+                LifecycleFunc::Update,
+                node_pointers_ptr,
+            );
+        }
+
+        ctx.b.build_return(None);
+    });
+    func
+}
+
 pub fn build_funcs(module: &Module, cache: &ObjectCache, surface: &Surface) {
     build_lifecycle_func(module, cache, surface, LifecycleFunc::Construct);
     build_lifecycle_func(module, cache, surface, LifecycleFunc::Update);
@@ -0,0 +1,534 @@
+use ast::{AudioField, ControlField, ControlType, FormType, OperatorType, UnaryOperation};
+use codegen::data_analyzer::{BlockLayout, SurfaceLayout};
+use codegen::surface::ExtractedVoices;
+use codegen::values::{NumValue, ARRAY_CAPACITY};
+use codegen::{globals, util, BuilderContext, ObjectCache};
+use inkwell::types::VectorType;
+use inkwell::values::{BasicValue, IntValue, PointerValue, VectorValue};
+use inkwell::{FloatPredicate, IntPredicate};
+use mir::block::{Global, Statement};
+use mir::{Block, ConstantValue, NodeData, SurfaceRef};
+
+/// How many voices are updated together. Each value in a voice is kept as one vector of left
+/// channels and one of right channels with a lane for each voice, so with eight lanes an AVX
+/// register holds a channel of every voice in the batch.
+pub const VOICE_LANES: u32 = 8;
+
+// A number with a lane for each voice in the batch, split by channel.
+#[derive(Clone, Copy)]
+struct LaneNum {
+    left: VectorValue,
+    right: VectorValue,
+    form: VectorValue,
+}
+
+fn is_lane_statement(statement: &Statement) -> bool {
+    match statement {
+        Statement::Constant(ConstantValue::Num(_))
+        | Statement::Global(_)
+        | Statement::NumCast { .. }
+        | Statement::NumUnaryOp { .. }
+        | Statement::LoadControl {
+            field: ControlField::Audio(AudioField::Value),
+            ..
+        }
+        | Statement::StoreControl {
+            field: ControlField::Audio(AudioField::Value),
+            ..
+        } => true,
+
+        // pow is a library call that only takes two lanes at a time
+        Statement::NumMathOp { op, .. } => *op != OperatorType::Power,
+        _ => false,
+    }
+}
+
+/// Returns if the voices of an extracted group using this surface can be updated in batches of
+/// `VOICE_LANES`, instead of calling the surface's update function once for each voice. That's
+/// only possible if every node is a block that does nothing but arithmetic on audio controls:
+/// calls, conversions and other controls keep state or branch differently for each voice.
+///
+/// Audio controls have no update function of their own, so the blocks' controls aren't updated,
+/// and control-rate statements run at audio rate alongside everything else.
+pub fn can_run_in_lanes(cache: &ObjectCache, surface: SurfaceRef) -> bool {
+    let surface_mir = match cache.surface_mir(surface) {
+        Some(surface_mir) => surface_mir,
+        None => return false,
+    };
+
+    surface_mir.nodes.iter().all(|node| match &node.data {
+        NodeData::Dummy => true,
+        NodeData::Custom(block_id) => match cache.block_mir(*block_id) {
+            Some(block) => {
+                block
+                    .controls
+                    .iter()
+                    .all(|control| control.control_type == ControlType::Audio)
+                    && block.statements.iter().all(is_lane_statement)
+            }
+            None => false,
+        },
+        NodeData::Group(_) | NodeData::ExtractGroup { .. } => false,
+    })
+}
+
+/// Updates the voices set in `run` a batch of `VOICE_LANES` at a time, skipping batches with no
+/// voices to run. The surface must pass `can_run_in_lanes`.
+pub fn build_update(
+    ctx: &mut BuilderContext,
+    cache: &ObjectCache,
+    voices: &ExtractedVoices,
+    run: IntValue,
+) {
+    let batch_ptr = ctx
+        .allocb
+        .build_alloca(&ctx.context.i32_type(), "batch.ptr");
+    ctx.b
+        .build_store(&batch_ptr, &ctx.context.i32_type().const_int(0, false));
+
+    let check_block = ctx.context.append_basic_block(&ctx.func, "batch.check");
+    let mask_block = ctx.context.append_basic_block(&ctx.func, "batch.mask");
+    let run_block = ctx.context.append_basic_block(&ctx.func, "batch.run");
+    let next_block = ctx.context.append_basic_block(&ctx.func, "batch.next");
+    let end_block = ctx.context.append_basic_block(&ctx.func, "batch.end");
+
+    ctx.b.build_unconditional_branch(&check_block);
+    ctx.b.position_at_end(&check_block);
+
+    let base = ctx.b.build_load(&batch_ptr, "batch").into_int_value();
+    let can_continue_loop = ctx.b.build_int_compare(
+        IntPredicate::ULT,
+        base,
+        ctx.context
+            .i32_type()
+            .const_int(u64::from(ARRAY_CAPACITY), false),
+        "cancontinue",
+    );
+    ctx.b
+        .build_conditional_branch(&can_continue_loop, &mask_block, &end_block);
+    ctx.b.position_at_end(&mask_block);
+
+    let lane_mask = ctx.b.build_and(
+        ctx.b.build_right_shift(run, base, false, ""),
+        ctx.context
+            .i32_type()
+            .const_int((1 << VOICE_LANES) - 1, false),
+        "lanemask",
+    );
+    let has_voices = ctx.b.build_int_compare(
+        IntPredicate::NE,
+        lane_mask,
+        ctx.context.i32_type().const_int(0, false),
+        "hasvoices",
+    );
+    ctx.b
+        .build_conditional_branch(&has_voices, &run_block, &next_block);
+    ctx.b.position_at_end(&run_block);
+
+    build_batch(ctx, cache, voices, base, lane_mask);
+    ctx.b.build_unconditional_branch(&next_block);
+    ctx.b.position_at_end(&next_block);
+
+    let next_base = ctx.b.build_int_nuw_add(
+        base,
+        ctx.context
+            .i32_type()
+            .const_int(u64::from(VOICE_LANES), false),
+        "nextbatch",
+    );
+    ctx.b.build_store(&batch_ptr, &next_base);
+    ctx.b.build_unconditional_branch(&check_block);
+    ctx.b.position_at_end(&end_block);
+}
+
+// The voices in one batch, and where their nodes' pointers are.
+struct Batch<'a> {
+    surface_layout: &'a SurfaceLayout,
+    voice_pointers: Vec<PointerValue>,
+    active: Vec<IntValue>,
+}
+
+fn build_batch(
+    ctx: &mut BuilderContext,
+    cache: &ObjectCache,
+    voices: &ExtractedVoices,
+    base: IntValue,
+    lane_mask: IntValue,
+) {
+    let mut voice_pointers = Vec::new();
+    let mut active = Vec::new();
+    for lane in 0..VOICE_LANES {
+        let lane_index = ctx.context.i32_type().const_int(u64::from(lane), false);
+        let voice = ctx.b.build_int_nuw_add(base, lane_index, "voice");
+        voice_pointers.push(voices.get_voice_pointers(ctx, voice));
+        active.push(util::get_bit(ctx.b, lane_mask, lane_index));
+    }
+
+    let surface_mir = cache.surface_mir(voices.surface).unwrap();
+    let batch = Batch {
+        surface_layout: cache.surface_layout(voices.surface).unwrap(),
+        voice_pointers,
+        active,
+    };
+    for (node_index, node) in surface_mir.nodes.iter().enumerate() {
+        if let NodeData::Custom(block_id) = node.data {
+            build_block(
+                ctx,
+                cache.block_mir(block_id).unwrap(),
+                cache.block_layout(block_id).unwrap(),
+                &batch,
+                node_index,
+            );
+        }
+    }
+}
+
+fn build_block(
+    ctx: &mut BuilderContext,
+    block: &Block,
+    layout: &BlockLayout,
+    batch: &Batch,
+    node_index: usize,
+) {
+    // Controls are read and written through memory, like they are a voice at a time, so a
+    // statement sees anything stored to a control that shares its group.
+    let mut results: Vec<Option<LaneNum>> = Vec::with_capacity(block.statements.len());
+    for statement in &block.statements {
+        let result = match statement {
+            Statement::Constant(ConstantValue::Num(num)) => {
+                let left_val = ctx.context.f32_type().const_float(f64::from(num.left));
+                let right_val = ctx.context.f32_type().const_float(f64::from(num.right));
+                Some(LaneNum {
+                    left: build_float_splat(ctx, &left_val),
+                    right: build_float_splat(ctx, &right_val),
+                    form: build_const_form(ctx, num.form),
+                })
+            }
+            Statement::Global(global) => Some(build_global(ctx, global)),
+            Statement::NumCast { target_form, input } => Some(LaneNum {
+                form: build_const_form(ctx, *target_form),
+                ..results[*input].unwrap()
+            }),
+            Statement::NumUnaryOp { op, input } => {
+                Some(build_unary_op(ctx, op, results[*input].unwrap()))
+            }
+            Statement::NumMathOp { op, lhs, rhs } => Some(build_math_op(
+                ctx,
+                op,
+                results[*lhs].unwrap(),
+                results[*rhs].unwrap(),
+            )),
+            Statement::LoadControl { control, .. } => {
+                let value_ptrs = get_value_ptrs(ctx, layout, batch, node_index, *control);
+                Some(build_gather(ctx, &value_ptrs))
+            }
+            Statement::StoreControl { control, value, .. } => {
+                let value_ptrs = get_value_ptrs(ctx, layout, batch, node_index, *control);
+                build_scatter(ctx, &value_ptrs, &batch.active, results[*value].unwrap());
+                None
+            }
+            _ => panic!("Statement can't be run in lanes"),
+        };
+        results.push(result);
+    }
+}
+
+// Finds the value of a control in each voice of the batch.
+fn get_value_ptrs(
+    ctx: &mut BuilderContext,
+    layout: &BlockLayout,
+    batch: &Batch,
+    node_index: usize,
+    control: usize,
+) -> Vec<NumValue> {
+    let const_zero = ctx.context.i32_type().const_int(0, false);
+    let node_ptr_index = ctx
+        .context
+        .i32_type()
+        .const_int(batch.surface_layout.node_ptr_index(node_index) as u64, false);
+    let control_index = ctx
+        .context
+        .i32_type()
+        .const_int(layout.control_index(control) as u64, false);
+
+    batch
+        .voice_pointers
+        .iter()
+        .map(|voice_pointers| {
+            let value_ptr_ptr = unsafe {
+                ctx.b.build_in_bounds_gep(
+                    voice_pointers,
+                    &[const_zero, node_ptr_index, control_index, const_zero],
+                    "control.value.ptr",
+                )
+            };
+            NumValue::new(
+                ctx.b
+                    .build_load(&value_ptr_ptr, "control.value")
+                    .into_pointer_value(),
+            )
+        }).collect()
+}
+
+fn build_gather(ctx: &mut BuilderContext, values: &[NumValue]) -> LaneNum {
+    let mut left = ctx.context.f32_type().vec_type(VOICE_LANES).get_undef();
+    let mut right = ctx.context.f32_type().vec_type(VOICE_LANES).get_undef();
+    let mut form = ctx.context.i8_type().vec_type(VOICE_LANES).get_undef();
+    for (lane, value) in values.iter().enumerate() {
+        let lane_index = ctx.context.i32_type().const_int(lane as u64, false);
+        let vec = value.get_vec(ctx.b);
+        let left_val = ctx.b.build_extract_element(
+            &vec,
+            &ctx.context.i32_type().const_int(0, false),
+            "left",
+        );
+        let right_val = ctx.b.build_extract_element(
+            &vec,
+            &ctx.context.i32_type().const_int(1, false),
+            "right",
+        );
+        let form_val = value.get_form(ctx.b);
+
+        left = ctx
+            .b
+            .build_insert_element(&left, &left_val, &lane_index, "lanes.left")
+            .into_vector_value();
+        right = ctx
+            .b
+            .build_insert_element(&right, &right_val, &lane_index, "lanes.right")
+            .into_vector_value();
+        form = ctx
+            .b
+            .build_insert_element(&form, &form_val, &lane_index, "lanes.form")
+            .into_vector_value();
+    }
+    LaneNum { left, right, form }
+}
+
+// Voices that aren't running keep the value they had, so their lanes store it back.
+fn build_scatter(
+    ctx: &mut BuilderContext,
+    values: &[NumValue],
+    active: &[IntValue],
+    num: LaneNum,
+) {
+    for (lane, (value, is_active)) in values.iter().zip(active.iter()).enumerate() {
+        let lane_index = ctx.context.i32_type().const_int(lane as u64, false);
+        let left_val = ctx
+            .b
+            .build_extract_element(&num.left, &lane_index, "left");
+        let right_val = ctx
+            .b
+            .build_extract_element(&num.right, &lane_index, "right");
+        let form_val = ctx
+            .b
+            .build_extract_element(&num.form, &lane_index, "form")
+            .into_int_value();
+        let new_vec = ctx
+            .b
+            .build_insert_element(
+                &ctx.b
+                    .build_insert_element(
+                        &ctx.context.f32_type().vec_type(2).get_undef(),
+                        &left_val,
+                        &ctx.context.i32_type().const_int(0, false),
+                        "",
+                    ).into_vector_value(),
+                &right_val,
+                &ctx.context.i32_type().const_int(1, false),
+                "vec",
+            ).into_vector_value();
+
+        let old_vec = value.get_vec(ctx.b);
+        let old_form = value.get_form(ctx.b);
+        let store_vec = ctx
+            .b
+            .build_select(*is_active, new_vec, old_vec, "storevec")
+            .into_vector_value();
+        let store_form = ctx
+            .b
+            .build_select(*is_active, form_val, old_form, "storeform")
+            .into_int_value();
+        value.set_vec(ctx.b, &store_vec);
+        value.set_form(ctx.b, &store_form);
+    }
+}
+
+fn build_splat(ctx: &mut BuilderContext, vec_type: VectorType, val: &BasicValue) -> VectorValue {
+    let mut vec = vec_type.get_undef();
+    for lane in 0..VOICE_LANES {
+        vec = ctx
+            .b
+            .build_insert_element(
+                &vec,
+                val,
+                &ctx.context.i32_type().const_int(u64::from(lane), false),
+                "splat",
+            ).into_vector_value();
+    }
+    vec
+}
+
+fn build_float_splat(ctx: &mut BuilderContext, val: &BasicValue) -> VectorValue {
+    let vec_type = ctx.context.f32_type().vec_type(VOICE_LANES);
+    build_splat(ctx, vec_type, val)
+}
+
+fn build_const_form(ctx: &mut BuilderContext, form: FormType) -> VectorValue {
+    let vec_type = ctx.context.i8_type().vec_type(VOICE_LANES);
+    let form_val = ctx.context.i8_type().const_int(form as u64, false);
+    build_splat(ctx, vec_type, &form_val)
+}
+
+fn build_global(ctx: &mut BuilderContext, global: &Global) -> LaneNum {
+    let vec_ptr = match global {
+        Global::SampleRate => globals::get_sample_rate(ctx.module).as_pointer_value(),
+        Global::BPM => globals::get_bpm(ctx.module).as_pointer_value(),
+    };
+    let vec = ctx.b.build_load(&vec_ptr, "global.vec").into_vector_value();
+    let left_val = ctx.b.build_extract_element(
+        &vec,
+        &ctx.context.i32_type().const_int(0, false),
+        "left",
+    );
+    let right_val = ctx.b.build_extract_element(
+        &vec,
+        &ctx.context.i32_type().const_int(1, false),
+        "right",
+    );
+    LaneNum {
+        left: build_float_splat(ctx, &left_val),
+        right: build_float_splat(ctx, &right_val),
+        form: build_const_form(ctx, FormType::None),
+    }
+}
+
+fn build_unary_op(ctx: &mut BuilderContext, op: &UnaryOperation, num: LaneNum) -> LaneNum {
+    match op {
+        UnaryOperation::Positive => num,
+        UnaryOperation::Negative => LaneNum {
+            left: ctx.b.build_float_neg(&num.left, "lanes.negate"),
+            right: ctx.b.build_float_neg(&num.right, "lanes.negate"),
+            form: num.form,
+        },
+        UnaryOperation::Not => LaneNum {
+            left: build_not(ctx, num.left),
+            right: build_not(ctx, num.right),
+            form: num.form,
+        },
+    }
+}
+
+fn build_not(ctx: &mut BuilderContext, vec: VectorValue) -> VectorValue {
+    let zero = ctx.context.f32_type().const_float(0.);
+    let zero_vec = build_float_splat(ctx, &zero);
+    let int_not = ctx
+        .b
+        .build_float_compare(FloatPredicate::OEQ, vec, zero_vec, "lanes.not.int");
+    ctx.b.build_unsigned_int_to_float(
+        int_not,
+        ctx.context.f32_type().vec_type(VOICE_LANES),
+        "lanes.not",
+    )
+}
+
+// The same operations as `gen_math_op_statement`, applied to each channel.
+fn build_math_op(
+    ctx: &mut BuilderContext,
+    op: &OperatorType,
+    left_num: LaneNum,
+    right_num: LaneNum,
+) -> LaneNum {
+    LaneNum {
+        left: build_channel_op(ctx, op, left_num.left, right_num.left),
+        right: build_channel_op(ctx, op, left_num.right, right_num.right),
+        form: left_num.form,
+    }
+}
+
+fn build_channel_op(
+    ctx: &mut BuilderContext,
+    op: &OperatorType,
+    lhs: VectorValue,
+    rhs: VectorValue,
+) -> VectorValue {
+    match op {
+        OperatorType::Identity => lhs,
+        OperatorType::Add => ctx.b.build_float_add(lhs, rhs, "lanes.add"),
+        OperatorType::Subtract => ctx.b.build_float_sub(lhs, rhs, "lanes.sub"),
+        OperatorType::Multiply => ctx.b.build_float_mul(lhs, rhs, "lanes.mul"),
+        OperatorType::Divide => ctx.b.build_float_div(lhs, rhs, "lanes.divide"),
+        OperatorType::Modulo => ctx.b.build_float_rem(lhs, rhs, "lanes.mod"),
+        OperatorType::Power => panic!("Power can't be run in lanes"),
+        OperatorType::BitwiseAnd
+        | OperatorType::BitwiseOr
+        | OperatorType::BitwiseXor
+        | OperatorType::LogicalAnd
+        | OperatorType::LogicalOr => build_int_op(ctx, op, lhs, rhs),
+        OperatorType::LogicalEqual => build_compare(ctx, FloatPredicate::OEQ, lhs, rhs),
+        OperatorType::LogicalNotEqual => build_compare(ctx, FloatPredicate::ONE, lhs, rhs),
+        OperatorType::LogicalGt => build_compare(ctx, FloatPredicate::OGT, lhs, rhs),
+        OperatorType::LogicalLt => build_compare(ctx, FloatPredicate::OLT, lhs, rhs),
+        OperatorType::LogicalGte => build_compare(ctx, FloatPredicate::OGE, lhs, rhs),
+        OperatorType::LogicalLte => build_compare(ctx, FloatPredicate::OLE, lhs, rhs),
+    }
+}
+
+// Bitwise operators work on 32-bit integers, and logical operators on booleans.
+fn build_int_op(
+    ctx: &mut BuilderContext,
+    op: &OperatorType,
+    lhs: VectorValue,
+    rhs: VectorValue,
+) -> VectorValue {
+    let is_bitwise = match op {
+        OperatorType::BitwiseAnd | OperatorType::BitwiseOr | OperatorType::BitwiseXor => true,
+        _ => false,
+    };
+    let int_type = if is_bitwise {
+        ctx.context.i32_type().vec_type(VOICE_LANES)
+    } else {
+        ctx.context.bool_type().vec_type(VOICE_LANES)
+    };
+    let left_int = ctx
+        .b
+        .build_float_to_signed_int(lhs, int_type, "lanes.int");
+    let right_int = ctx
+        .b
+        .build_float_to_signed_int(rhs, int_type, "lanes.int");
+    let result_int = match op {
+        OperatorType::BitwiseAnd | OperatorType::LogicalAnd => {
+            ctx.b.build_and(left_int, right_int, "lanes.and")
+        }
+        OperatorType::BitwiseOr | OperatorType::LogicalOr => {
+            ctx.b.build_or(left_int, right_int, "lanes.or")
+        }
+        OperatorType::BitwiseXor => ctx.b.build_xor(left_int, right_int, "lanes.xor"),
+        _ => panic!("Not an integer operator"),
+    };
+
+    let float_type = ctx.context.f32_type().vec_type(VOICE_LANES);
+    if is_bitwise {
+        ctx.b
+            .build_signed_int_to_float(result_int, float_type, "lanes.float")
+    } else {
+        ctx.b
+            .build_unsigned_int_to_float(result_int, float_type, "lanes.float")
+    }
+}
+
+fn build_compare(
+    ctx: &mut BuilderContext,
+    predicate: FloatPredicate,
+    lhs: VectorValue,
+    rhs: VectorValue,
+) -> VectorValue {
+    let result_int = ctx
+        .b
+        .build_float_compare(predicate, lhs, rhs, "lanes.compare");
+    ctx.b.build_unsigned_int_to_float(
+        result_int,
+        ctx.context.f32_type().vec_type(VOICE_LANES),
+        "lanes.float",
+    )
+}
@@ -0,0 +1,524 @@
+use codegen::values::{ArrayValue, MidiValue, NumValue, ARRAY_CAPACITY};
+use codegen::{
+    build_context_function, globals, intrinsics, util, BuilderContext, TargetProperties,
+};
+use inkwell::context::Context;
+use inkwell::module::{Linkage, Module};
+use inkwell::types::StructType;
+use inkwell::values::{FunctionValue, IntValue, PointerValue};
+use inkwell::{AddressSpace, FloatPredicate, IntPredicate};
+use mir::{Node, NodeData, Surface, VarType};
+
+/// Registered with the JIT as a builtin, which atomically adds to the slept updates counter.
+pub const ADD_SLEPT_UPDATES_FUNC_NAME: &str = "maxim_add_slept_updates";
+
+// The MIDI event names for note on and note off, see `MidiEventType` in the editor.
+const NOTE_ON_EVENT: u64 = 0;
+const NOTE_OFF_EVENT: u64 = 1;
+
+// Voices in an extracted group that have produced silence for a while after their note has been
+// released are put to sleep, so they don't run until one of their MIDI inputs receives an event.
+// Each group keeps a count of how many samples each voice has been silent for, a bitmap of which
+// voices are asleep, and a bitmap of which voices are holding a note.
+pub fn get_state_type(context: &Context) -> StructType {
+    context.struct_type(
+        &[
+            &context.i32_type().array_type(ARRAY_CAPACITY as u32),
+            &context.i32_type(),
+            &context.i32_type(),
+        ],
+        false,
+    )
+}
+
+/// Adds to the number of voice updates skipped because the voice was asleep. Voices can be run on
+/// several threads at once, so the counter can't be updated directly.
+pub fn get_add_slept_updates_func(module: &Module) -> FunctionValue {
+    util::get_or_create_func(module, ADD_SLEPT_UPDATES_FUNC_NAME, false, &|| {
+        let context = module.get_context();
+        (
+            Linkage::ExternalLinkage,
+            context.void_type().fn_type(
+                &[
+                    &context.i64_type().ptr_type(AddressSpace::Generic),
+                    &context.i64_type(),
+                ],
+                false,
+            ),
+        )
+    })
+}
+
+/// Defines the add function to update the counter directly, for code that runs outside of the
+/// JIT and so only ever runs voices on one thread.
+pub fn build_serial_add_slept_updates_func(module: &Module, target: &TargetProperties) {
+    let func = get_add_slept_updates_func(module);
+    build_context_function(module, func, target, &|ctx: BuilderContext| {
+        let counter_ptr = ctx.func.get_nth_param(0).unwrap().into_pointer_value();
+        let count = ctx.func.get_nth_param(1).unwrap().into_int_value();
+        let counter = ctx.b.build_load(&counter_ptr, "counter").into_int_value();
+        let new_counter = ctx.b.build_int_add(counter, count, "newcounter");
+        ctx.b.build_store(&counter_ptr, &new_counter);
+        ctx.b.build_return(None);
+    });
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum OutputKind {
+    Num,
+    Midi,
+}
+
+/// Returns the kind of each output of an extract group if its voices can sleep. A sleeping voice
+/// can only be woken by a MIDI event, so every input must be MIDI, and we must be able to tell if
+/// every output is silent.
+pub fn get_output_kinds(surface: &Surface, node: &Node) -> Option<Vec<OutputKind>> {
+    let (source_sockets, dest_sockets) = match node.data {
+        NodeData::ExtractGroup {
+            ref source_sockets,
+            ref dest_sockets,
+            ..
+        } => (source_sockets, dest_sockets),
+        _ => return None,
+    };
+    let socket_type = |socket: usize| &surface.groups[node.sockets[socket].group_id].value_type;
+    let midi_array = VarType::new_array(VarType::Midi);
+    let num_array = VarType::new_array(VarType::Num);
+
+    if source_sockets.is_empty()
+        || source_sockets
+            .iter()
+            .any(|&socket| *socket_type(socket) != midi_array)
+    {
+        return None;
+    }
+
+    dest_sockets
+        .iter()
+        .map(|&socket| {
+            let value_type = socket_type(socket);
+            if *value_type == num_array {
+                Some(OutputKind::Num)
+            } else if *value_type == midi_array {
+                Some(OutputKind::Midi)
+            } else {
+                None
+            }
+        }).collect()
+}
+
+fn get_quiet_samples_ptr(
+    ctx: &mut BuilderContext,
+    state_ptr: PointerValue,
+    voice_index: IntValue,
+) -> PointerValue {
+    unsafe {
+        ctx.b.build_in_bounds_gep(
+            &state_ptr,
+            &[
+                ctx.context.i32_type().const_int(0, false),
+                ctx.context.i32_type().const_int(0, false),
+                voice_index,
+            ],
+            "quietsamples.ptr",
+        )
+    }
+}
+
+fn get_array_item(
+    ctx: &mut BuilderContext,
+    socket_pointers: PointerValue,
+    socket_index: usize,
+    voice_index: IntValue,
+) -> PointerValue {
+    let array = ArrayValue::new(
+        ctx.b
+            .build_load(
+                &unsafe {
+                    ctx.b
+                        .build_struct_gep(&socket_pointers, socket_index as u32, "")
+                },
+                "",
+            ).into_pointer_value(),
+    );
+    array.get_item_ptr(ctx.b, voice_index)
+}
+
+pub fn build_reset(ctx: &mut BuilderContext, state_ptr: PointerValue) {
+    ctx.b
+        .build_store(&state_ptr, &get_state_type(ctx.context).const_null());
+}
+
+/// Wakes any sleeping voices that have received MIDI events, and returns the bitmap of voices
+/// that need to be run.
+pub fn build_wake(
+    ctx: &mut BuilderContext,
+    state_ptr: PointerValue,
+    source_pointers: PointerValue,
+    source_count: usize,
+    active_bitmap: IntValue,
+) -> IntValue {
+    let sleeping_ptr = unsafe { ctx.b.build_struct_gep(&state_ptr, 1, "sleeping.ptr") };
+
+    // voices that have been released by their source forget that they were asleep
+    let sleeping = ctx.b.build_load(&sleeping_ptr, "sleeping").into_int_value();
+    let sleeping = ctx.b.build_and(sleeping, active_bitmap, "activesleeping");
+
+    let remaining_ptr = ctx
+        .allocb
+        .build_alloca(&ctx.context.i32_type(), "remainingsleeping.ptr");
+    ctx.b.build_store(&remaining_ptr, &sleeping);
+    let still_sleeping_ptr = ctx
+        .allocb
+        .build_alloca(&ctx.context.i32_type(), "stillsleeping.ptr");
+    ctx.b.build_store(&still_sleeping_ptr, &sleeping);
+
+    let check_block = ctx.context.append_basic_block(&ctx.func, "wake.check");
+    let run_block = ctx.context.append_basic_block(&ctx.func, "wake.run");
+    let end_block = ctx.context.append_basic_block(&ctx.func, "wake.end");
+
+    ctx.b.build_unconditional_branch(&check_block);
+    ctx.b.position_at_end(&check_block);
+    let remaining = ctx
+        .b
+        .build_load(&remaining_ptr, "remainingsleeping")
+        .into_int_value();
+    let can_continue_loop = ctx.b.build_int_compare(
+        IntPredicate::NE,
+        remaining,
+        ctx.context.i32_type().const_int(0, false),
+        "cancontinue",
+    );
+    ctx.b
+        .build_conditional_branch(&can_continue_loop, &run_block, &end_block);
+    ctx.b.position_at_end(&run_block);
+
+    let voice_index = ctx
+        .b
+        .build_call(
+            &intrinsics::cttz_i32(ctx.module),
+            &[&remaining, &ctx.context.bool_type().const_int(1, false)],
+            "voiceindex",
+            false,
+        ).left()
+        .unwrap()
+        .into_int_value();
+    let next_remaining = ctx.b.build_and(
+        remaining,
+        ctx.b
+            .build_int_sub(remaining, ctx.context.i32_type().const_int(1, false), ""),
+        "nextremaining",
+    );
+    ctx.b.build_store(&remaining_ptr, &next_remaining);
+
+    let mut has_events = ctx.context.bool_type().const_int(0, false);
+    for source_index in 0..source_count {
+        let midi = MidiValue::new(get_array_item(
+            ctx,
+            source_pointers,
+            source_index,
+            voice_index,
+        ));
+        let event_count = midi.get_count(ctx.b);
+        let source_has_events = ctx.b.build_int_compare(
+            IntPredicate::NE,
+            event_count,
+            event_count.get_type().const_int(0, false),
+            "hasevents",
+        );
+        has_events = ctx.b.build_or(has_events, source_has_events, "");
+    }
+
+    // a woken voice starts counting silence again, so it isn't put straight back to sleep
+    let quiet_samples_ptr = get_quiet_samples_ptr(ctx, state_ptr, voice_index);
+    let quiet_samples = ctx
+        .b
+        .build_load(&quiet_samples_ptr, "quietsamples")
+        .into_int_value();
+    let new_quiet_samples = ctx.b.build_select(
+        has_events,
+        ctx.context.i32_type().const_int(0, false),
+        quiet_samples,
+        "newquietsamples",
+    );
+    ctx.b.build_store(&quiet_samples_ptr, &new_quiet_samples);
+
+    let still_sleeping = ctx
+        .b
+        .build_load(&still_sleeping_ptr, "stillsleeping")
+        .into_int_value();
+    let woken_sleeping = util::clear_bit(ctx.b, still_sleeping, voice_index);
+    let new_still_sleeping =
+        ctx.b
+            .build_select(has_events, woken_sleeping, still_sleeping, "newstillsleeping");
+    ctx.b.build_store(&still_sleeping_ptr, &new_still_sleeping);
+    ctx.b.build_unconditional_branch(&check_block);
+
+    ctx.b.position_at_end(&end_block);
+    let still_sleeping = ctx
+        .b
+        .build_load(&still_sleeping_ptr, "stillsleeping")
+        .into_int_value();
+    ctx.b.build_store(&sleeping_ptr, &still_sleeping);
+
+    // keep track of how much work sleeping has saved
+    let skipped_count = ctx
+        .b
+        .build_call(
+            &intrinsics::ctpop_i32(ctx.module),
+            &[&still_sleeping],
+            "skippedcount",
+            false,
+        ).left()
+        .unwrap()
+        .into_int_value();
+    let has_skipped = ctx.b.build_int_compare(
+        IntPredicate::NE,
+        skipped_count,
+        ctx.context.i32_type().const_int(0, false),
+        "hasskipped",
+    );
+    let add_block = ctx
+        .context
+        .append_basic_block(&ctx.func, "sleptupdates.add");
+    let added_block = ctx
+        .context
+        .append_basic_block(&ctx.func, "sleptupdates.end");
+    ctx.b
+        .build_conditional_branch(&has_skipped, &add_block, &added_block);
+    ctx.b.position_at_end(&add_block);
+    ctx.b.build_call(
+        &get_add_slept_updates_func(ctx.module),
+        &[
+            &globals::get_slept_updates(ctx.module).as_pointer_value(),
+            &ctx.b
+                .build_int_z_extend(skipped_count, ctx.context.i64_type(), ""),
+        ],
+        "",
+        false,
+    );
+    ctx.b.build_unconditional_branch(&added_block);
+    ctx.b.position_at_end(&added_block);
+
+    ctx.b.build_and(
+        active_bitmap,
+        ctx.b.build_not(&still_sleeping, ""),
+        "runbitmap",
+    )
+}
+
+// Updates whether a voice is holding a note from the note on and off events in its inputs, and
+// returns true if it is.
+fn build_track_held(
+    ctx: &mut BuilderContext,
+    state_ptr: PointerValue,
+    source_pointers: PointerValue,
+    source_count: usize,
+    voice_index: IntValue,
+) -> IntValue {
+    let held_ptr = unsafe { ctx.b.build_struct_gep(&state_ptr, 2, "held.ptr") };
+    let event_index_ptr = ctx
+        .allocb
+        .build_alloca(&ctx.context.i8_type(), "heldevent.ptr");
+
+    for source_index in 0..source_count {
+        let midi = MidiValue::new(get_array_item(
+            ctx,
+            source_pointers,
+            source_index,
+            voice_index,
+        ));
+        let event_count = midi.get_count(ctx.b);
+        ctx.b
+            .build_store(&event_index_ptr, &ctx.context.i8_type().const_int(0, false));
+
+        let check_block = ctx.context.append_basic_block(&ctx.func, "held.check");
+        let run_block = ctx.context.append_basic_block(&ctx.func, "held.run");
+        let end_block = ctx.context.append_basic_block(&ctx.func, "held.end");
+
+        ctx.b.build_unconditional_branch(&check_block);
+        ctx.b.position_at_end(&check_block);
+        let event_index = ctx
+            .b
+            .build_load(&event_index_ptr, "heldevent")
+            .into_int_value();
+        let can_continue_loop = ctx.b.build_int_compare(
+            IntPredicate::ULT,
+            event_index,
+            event_count,
+            "cancontinue",
+        );
+        ctx.b
+            .build_conditional_branch(&can_continue_loop, &run_block, &end_block);
+        ctx.b.position_at_end(&run_block);
+
+        let next_event_index = ctx.b.build_int_add(
+            event_index,
+            ctx.context.i8_type().const_int(1, false),
+            "nextheldevent",
+        );
+        ctx.b.build_store(&event_index_ptr, &next_event_index);
+
+        let event_name = midi.get_event(ctx.b, event_index).get_name(ctx.b);
+        let is_note_on = ctx.b.build_int_compare(
+            IntPredicate::EQ,
+            event_name,
+            event_name.get_type().const_int(NOTE_ON_EVENT, false),
+            "isnoteon",
+        );
+        let is_note_off = ctx.b.build_int_compare(
+            IntPredicate::EQ,
+            event_name,
+            event_name.get_type().const_int(NOTE_OFF_EVENT, false),
+            "isnoteoff",
+        );
+        let held = ctx.b.build_load(&held_ptr, "held").into_int_value();
+        let released_held = ctx
+            .b
+            .build_select(
+                is_note_off,
+                util::clear_bit(ctx.b, held, voice_index),
+                held,
+                "releasedheld",
+            ).into_int_value();
+        let new_held = ctx.b.build_select(
+            is_note_on,
+            util::set_bit(ctx.b, held, voice_index),
+            released_held,
+            "newheld",
+        );
+        ctx.b.build_store(&held_ptr, &new_held);
+        ctx.b.build_unconditional_branch(&check_block);
+
+        ctx.b.position_at_end(&end_block);
+    }
+
+    let held = ctx.b.build_load(&held_ptr, "held").into_int_value();
+    util::get_bit(ctx.b, held, voice_index)
+}
+
+/// Updates the silence count of a voice that has just run from its outputs, putting it to sleep
+/// once it has been silent for long enough. Voices that are holding a note never sleep, since
+/// they might only be quiet until their envelope or an LFO changes.
+pub fn build_track_silence(
+    ctx: &mut BuilderContext,
+    state_ptr: PointerValue,
+    source_pointers: PointerValue,
+    source_count: usize,
+    dest_pointers: PointerValue,
+    output_kinds: &[OutputKind],
+    voice_index: IntValue,
+) {
+    let is_held = build_track_held(ctx, state_ptr, source_pointers, source_count, voice_index);
+
+    let threshold = ctx
+        .b
+        .build_load(
+            &globals::get_sleep_threshold(ctx.module).as_pointer_value(),
+            "sleepthreshold",
+        ).into_float_value();
+    let abs_intrinsic = intrinsics::fabs_v2f32(ctx.module);
+
+    let mut is_silent = ctx.context.bool_type().const_int(1, false);
+    for (dest_index, output_kind) in output_kinds.iter().enumerate() {
+        let item_ptr = get_array_item(ctx, dest_pointers, dest_index, voice_index);
+        let output_silent = match output_kind {
+            OutputKind::Num => {
+                let vec = NumValue::new(item_ptr).get_vec(ctx.b);
+                let abs_vec = ctx
+                    .b
+                    .build_call(&abs_intrinsic, &[&vec], "outputabs", false)
+                    .left()
+                    .unwrap()
+                    .into_vector_value();
+                let left = ctx
+                    .b
+                    .build_extract_element(
+                        &abs_vec,
+                        &ctx.context.i32_type().const_int(0, false),
+                        "left",
+                    ).into_float_value();
+                let right = ctx
+                    .b
+                    .build_extract_element(
+                        &abs_vec,
+                        &ctx.context.i32_type().const_int(1, false),
+                        "right",
+                    ).into_float_value();
+                let left_silent =
+                    ctx.b
+                        .build_float_compare(FloatPredicate::OLT, left, threshold, "leftsilent");
+                let right_silent = ctx.b.build_float_compare(
+                    FloatPredicate::OLT,
+                    right,
+                    threshold,
+                    "rightsilent",
+                );
+                ctx.b.build_and(left_silent, right_silent, "numsilent")
+            }
+            OutputKind::Midi => {
+                let event_count = MidiValue::new(item_ptr).get_count(ctx.b);
+                ctx.b.build_int_compare(
+                    IntPredicate::EQ,
+                    event_count,
+                    event_count.get_type().const_int(0, false),
+                    "midisilent",
+                )
+            }
+        };
+        is_silent = ctx.b.build_and(is_silent, output_silent, "");
+    }
+
+    let quiet_samples_ptr = get_quiet_samples_ptr(ctx, state_ptr, voice_index);
+    let quiet_samples = ctx
+        .b
+        .build_load(&quiet_samples_ptr, "quietsamples")
+        .into_int_value();
+    let new_quiet_samples = ctx
+        .b
+        .build_select(
+            is_silent,
+            ctx.b.build_int_add(
+                quiet_samples,
+                ctx.context.i32_type().const_int(1, false),
+                "",
+            ),
+            ctx.context.i32_type().const_int(0, false),
+            "newquietsamples",
+        ).into_int_value();
+    ctx.b.build_store(&quiet_samples_ptr, &new_quiet_samples);
+
+    let sleep_samples = ctx
+        .b
+        .build_load(
+            &globals::get_sleep_samples(ctx.module).as_pointer_value(),
+            "sleepsamples",
+        ).into_int_value();
+    let can_sleep = ctx.b.build_int_compare(
+        IntPredicate::NE,
+        sleep_samples,
+        ctx.context.i32_type().const_int(0, false),
+        "cansleep",
+    );
+    let is_quiet_enough = ctx.b.build_int_compare(
+        IntPredicate::UGE,
+        new_quiet_samples,
+        sleep_samples,
+        "isquietenough",
+    );
+    let should_sleep = ctx.b.build_and(
+        ctx.b.build_and(can_sleep, is_quiet_enough, ""),
+        ctx.b.build_not(&is_held, ""),
+        "shouldsleep",
+    );
+
+    let sleeping_ptr = unsafe { ctx.b.build_struct_gep(&state_ptr, 1, "sleeping.ptr") };
+    let sleeping = ctx.b.build_load(&sleeping_ptr, "sleeping").into_int_value();
+    let new_sleeping = ctx.b.build_select(
+        should_sleep,
+        util::set_bit(ctx.b, sleeping, voice_index),
+        sleeping,
+        "newsleeping",
+    );
+    ctx.b.build_store(&sleeping_ptr, &new_sleeping);
+}
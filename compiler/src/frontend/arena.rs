@@ -0,0 +1,104 @@
+use codegen::arena::{get_free_map_bytes, MIN_BLOCK_BYTES, SIZE_CLASS_COUNT};
+use std::alloc::{self, Layout};
+use std::ptr;
+
+/// Enough for around a minute of stereo delay at 44.1kHz once buffers are rounded up.
+pub const DEFAULT_ARENA_BYTES: usize = 32 * 1024 * 1024;
+
+/// Matches the layout of `codegen::arena::get_arena_type`.
+#[repr(C)]
+pub struct ArenaState {
+    pub base: *mut u8,
+    pub capacity: u64,
+    pub used: u64,
+    pub heap_allocs: u64,
+    pub free_lists: [*mut u8; SIZE_CLASS_COUNT],
+    pub free_map: *mut u8,
+}
+
+/// Owns the memory that generated code allocates dynamically sized state (like delay buffers)
+/// from, so the audio thread doesn't have to go to the system allocator. The memory is reserved
+/// and touched up front, and is only given back when the arena is dropped.
+#[derive(Debug)]
+pub struct Arena {
+    state: *mut ArenaState,
+    memory: *mut u8,
+    layout: Layout,
+    free_map: *mut u8,
+    free_map_layout: Layout,
+}
+
+impl Arena {
+    /// Gives the arena global at `state` a block of `capacity` bytes to hand out.
+    pub fn new(state: *mut ArenaState, capacity: usize) -> Self {
+        let layout = Layout::from_size_align(capacity.max(1), MIN_BLOCK_BYTES as usize).unwrap();
+        let memory = unsafe { alloc::alloc(layout) };
+        if memory.is_null() {
+            alloc::handle_alloc_error(layout);
+        }
+        let free_map_layout =
+            Layout::from_size_align(get_free_map_bytes(capacity as u64).max(1) as usize, 1)
+                .unwrap();
+        let free_map = unsafe { alloc::alloc_zeroed(free_map_layout) };
+        if free_map.is_null() {
+            alloc::handle_alloc_error(free_map_layout);
+        }
+
+        unsafe {
+            // write every page now so the audio thread doesn't page fault on first use
+            ptr::write_bytes(memory, 0, capacity);
+
+            *state = ArenaState {
+                base: memory,
+                capacity: capacity as u64,
+                used: 0,
+                heap_allocs: 0,
+                free_lists: [ptr::null_mut(); SIZE_CLASS_COUNT],
+                free_map,
+            };
+        }
+
+        Arena {
+            state,
+            memory,
+            layout,
+            free_map,
+            free_map_layout,
+        }
+    }
+
+    /// Returns the number of bytes of the arena that blocks have been handed out from. Freed
+    /// blocks below the last block still in use are kept for reuse, so they still count.
+    pub fn used_bytes(&self) -> u64 {
+        unsafe { (*self.state).used }
+    }
+
+    pub fn capacity_bytes(&self) -> u64 {
+        unsafe { (*self.state).capacity }
+    }
+
+    /// Returns the number of allocations that didn't fit in the arena and went to the system
+    /// allocator instead.
+    pub fn heap_allocs(&self) -> u64 {
+        unsafe { (*self.state).heap_allocs }
+    }
+}
+
+impl Drop for Arena {
+    fn drop(&mut self) {
+        // generated code can't be using the arena any more, but clear it so anything that does
+        // falls back to the heap instead of touching freed memory
+        unsafe {
+            *self.state = ArenaState {
+                base: ptr::null_mut(),
+                capacity: 0,
+                used: 0,
+                heap_allocs: (*self.state).heap_allocs,
+                free_lists: [ptr::null_mut(); SIZE_CLASS_COUNT],
+                free_map: ptr::null_mut(),
+            };
+            alloc::dealloc(self.memory, self.layout);
+            alloc::dealloc(self.free_map, self.free_map_layout);
+        }
+    }
+}
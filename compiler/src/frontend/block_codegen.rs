@@ -0,0 +1,146 @@
+use codegen::{block, data_analyzer, ObjectCache, Optimizer, TargetProperties};
+use inkwell::context::Context;
+use inkwell::module::Module;
+use inkwell::targets::TargetMachine;
+use mir::{Block, BlockRef, Surface, SurfaceRef};
+use std::sync::Arc;
+use std::thread;
+
+// Blocks only depend on their own layout and the library, so each one can be generated and
+// optimized on its own. To do this in parallel, each worker thread has its own LLVM context,
+// target machine and optimizer. The modules are then deployed to the JIT alongside modules from
+// the runtime's own context.
+struct WorkerCache<'a> {
+    context: &'a Context,
+    target: &'a TargetProperties,
+    block: &'a Block,
+    layout: &'a data_analyzer::BlockLayout,
+    version: u64,
+}
+
+impl<'a> ObjectCache for WorkerCache<'a> {
+    fn context(&self) -> &Context {
+        self.context
+    }
+
+    fn target(&self) -> &TargetProperties {
+        self.target
+    }
+
+    fn surface_mir(&self, _id: SurfaceRef) -> Option<&Surface> {
+        None
+    }
+
+    fn surface_layout(&self, _id: SurfaceRef) -> Option<&data_analyzer::SurfaceLayout> {
+        None
+    }
+
+    fn block_mir(&self, id: BlockRef) -> Option<&Block> {
+        if id == self.block.id.id {
+            Some(self.block)
+        } else {
+            None
+        }
+    }
+
+    fn block_layout(&self, id: BlockRef) -> Option<&data_analyzer::BlockLayout> {
+        if id == self.block.id.id {
+            Some(self.layout)
+        } else {
+            None
+        }
+    }
+
+    fn block_version(&self, _id: BlockRef) -> u64 {
+        self.version
+    }
+}
+
+/// The context a worker built its modules in. It has to outlive the modules, so each module is
+/// handed back with a reference to it, and it's dropped along with the last one.
+#[derive(Debug)]
+pub struct WorkerContext(Context);
+
+// A context can only be used from one thread at a time. The context, its modules and any types
+// inside them are only touched by the worker until the modules are handed back, and then only by
+// the thread that owns the runtime, so this is safe.
+unsafe impl Send for WorkerContext {}
+unsafe impl Sync for WorkerContext {}
+
+/// A module built by a worker, and the context it belongs to. The module must be dropped before
+/// the context, so it comes first.
+pub struct WorkerModule {
+    pub module: Module,
+    pub context: Arc<WorkerContext>,
+}
+
+// see WorkerContext
+unsafe impl Send for WorkerModule {}
+
+pub fn worker_count(block_count: usize) -> usize {
+    num_cpus::get().min(block_count).max(1)
+}
+
+fn build_worker_modules(
+    include_ui: bool,
+    min_size: bool,
+    blocks: Vec<(Block, String, u64)>,
+    create_module: fn(&Context, &TargetProperties, &str) -> Module,
+) -> Vec<WorkerModule> {
+    let worker_context = Arc::new(WorkerContext(Context::create()));
+    let context = &worker_context.0;
+    let target = TargetProperties::new(include_ui, min_size, TargetMachine::select());
+    let optimizer = Optimizer::new(&target);
+
+    blocks
+        .iter()
+        .map(|(block, name, version)| {
+            let layout = data_analyzer::build_block_layout(context, block, &target);
+            let cache = WorkerCache {
+                context,
+                target: &target,
+                block,
+                layout: &layout,
+                version: *version,
+            };
+
+            let module = create_module(context, &target, name);
+            block::build_funcs(&module, &cache, block);
+            optimizer.optimize_module(&module);
+            WorkerModule {
+                module,
+                context: worker_context.clone(),
+            }
+        }).collect()
+}
+
+/// Generates and optimizes a module with the given name and version for each block, spread across
+/// `worker_count` threads. The modules are returned in the same order as the blocks, regardless
+/// of which thread built them. Each module belongs to its worker's context, which is kept alive
+/// for as long as the module is.
+pub fn build_parallel(
+    include_ui: bool,
+    min_size: bool,
+    blocks: &[(&Block, String, u64)],
+    worker_count: usize,
+    create_module: fn(&Context, &TargetProperties, &str) -> Module,
+) -> Vec<WorkerModule> {
+    // give each worker a contiguous run of blocks, so the results can be joined back in order
+    let chunk_size = (blocks.len() + worker_count - 1) / worker_count;
+    let workers: Vec<_> = blocks
+        .chunks(chunk_size.max(1))
+        .map(|chunk| {
+            let chunk_blocks: Vec<_> = chunk
+                .iter()
+                .map(|(block, name, version)| (Block::clone(block), name.clone(), *version))
+                .collect();
+            thread::spawn(move || {
+                build_worker_modules(include_ui, min_size, chunk_blocks, create_module)
+            })
+        }).collect();
+
+    workers
+        .into_iter()
+        .flat_map(|worker| worker.join().unwrap())
+        .collect()
+}
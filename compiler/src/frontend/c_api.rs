@@ -1,4 +1,4 @@
-use super::{value_reader, Runtime, Transaction};
+use super::{disk_cache, exporter, value_reader, CommitStats, Player, Runtime, Transaction};
 use ast;
 use codegen;
 use inkwell::{orc, targets};
@@ -15,6 +15,12 @@ pub extern "C" fn maxim_initialize() {
     orc::Orc::link_in_jit();
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn maxim_set_object_cache_directory(c_path: *const std::os::raw::c_char) {
+    let path = std::ffi::CStr::from_ptr(c_path).to_str().unwrap();
+    disk_cache::set_directory(path);
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn maxim_destroy_string(string: *mut std::os::raw::c_char) {
     std::ffi::CString::from_raw(string);
@@ -35,34 +41,109 @@ pub unsafe extern "C" fn maxim_destroy_runtime(runtime: *mut Runtime) {
 }
 
 #[no_mangle]
-pub unsafe extern "C" fn maxim_allocate_id(runtime: *mut Runtime) -> u64 {
-    use mir::IdAllocator;
-    (*runtime).alloc_id()
+pub unsafe extern "C" fn maxim_get_player(runtime: *const Runtime) -> *const Player {
+    (*runtime).player()
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_allocate_id(player: *const Player) -> u64 {
+    (*player).alloc_id()
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_run_update(player: *const Player) {
+    (*player).run_update();
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_run_block(
+    player: *const Player,
+    frames: u32,
+    in_buffers: *const *const f32,
+    out_buffers: *const *mut f32,
+    out_buffer_count: u32,
+) {
+    (*player).run_block(frames, in_buffers, out_buffers, out_buffer_count);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_set_bpm(player: *const Player, bpm: f32) {
+    (*player).set_bpm(bpm);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_get_bpm(player: *const Player) -> f32 {
+    (*player).get_bpm()
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_set_sample_rate(player: *const Player, sample_rate: f32) {
+    (*player).set_sample_rate(sample_rate);
 }
 
 #[no_mangle]
-pub unsafe extern "C" fn maxim_run_update(runtime: *const Runtime) {
-    (*runtime).run_update();
+pub unsafe extern "C" fn maxim_get_sample_rate(player: *const Player) -> f32 {
+    (*player).get_sample_rate()
 }
 
 #[no_mangle]
-pub unsafe extern "C" fn maxim_set_bpm(runtime: *mut Runtime, bpm: f32) {
-    (*runtime).set_bpm(bpm);
+pub unsafe extern "C" fn maxim_set_voice_sleep(runtime: *mut Runtime, threshold: f32, samples: u32) {
+    (*runtime).set_voice_sleep(threshold, samples);
 }
 
 #[no_mangle]
-pub unsafe extern "C" fn maxim_get_bpm(runtime: *const Runtime) -> f32 {
-    (*runtime).get_bpm()
+pub unsafe extern "C" fn maxim_take_slept_voice_updates(runtime: *mut Runtime) -> u64 {
+    (*runtime).take_slept_voice_updates()
 }
 
 #[no_mangle]
-pub unsafe extern "C" fn maxim_set_sample_rate(runtime: *mut Runtime, sample_rate: f32) {
-    (*runtime).set_sample_rate(sample_rate);
+pub unsafe extern "C" fn maxim_get_arena_heap_allocs(runtime: *mut Runtime) -> u64 {
+    (*runtime).arena_heap_allocs()
 }
 
 #[no_mangle]
-pub unsafe extern "C" fn maxim_get_sample_rate(runtime: *const Runtime) -> f32 {
-    (*runtime).get_sample_rate()
+pub unsafe extern "C" fn maxim_set_control_rate_interval(runtime: *mut Runtime, interval: u32) {
+    (*runtime).set_control_rate_interval(interval);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_set_worker_threads(runtime: *mut Runtime, thread_count: u32) {
+    (*runtime).set_worker_threads(thread_count as usize);
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_eval_math(
+    runtime: *mut Runtime,
+    c_name: *const std::os::raw::c_char,
+    precise: bool,
+    a: *const f32,
+    b: *const f32,
+    out: *mut f32,
+    count: usize,
+) -> bool {
+    let name = std::ffi::CStr::from_ptr(c_name).to_str().unwrap();
+    let function = match codegen::math::MathFunction::from_name(name) {
+        Some(function) => function,
+        None => return false,
+    };
+    if function.arg_count() > 1 && b.is_null() {
+        return false;
+    }
+
+    let accuracy = if precise {
+        codegen::math::MathAccuracy::Precise
+    } else {
+        codegen::math::MathAccuracy::Fast
+    };
+    let a_slice = std::slice::from_raw_parts(a, count);
+    let b_slice = if b.is_null() {
+        &[]
+    } else {
+        std::slice::from_raw_parts(b, count)
+    };
+    let out_slice = std::slice::from_raw_parts_mut(out, count);
+    (*runtime).eval_math(function, accuracy, a_slice, b_slice, out_slice);
+    true
 }
 
 #[no_mangle]
@@ -71,6 +152,88 @@ pub unsafe extern "C" fn maxim_commit(runtime: *mut Runtime, transaction: *mut T
     (*runtime).commit(*owned_transaction)
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn maxim_prepare_commit(
+    runtime: *mut Runtime,
+    transaction: *mut Transaction,
+) {
+    let owned_transaction = Box::from_raw(transaction);
+    (*runtime).prepare_commit(*owned_transaction)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_finish_commit(runtime: *mut Runtime) {
+    (*runtime).finish_commit()
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_publish_commit(runtime: *mut Runtime) {
+    (*runtime).publish_commit()
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_wait_for_commit(runtime: *mut Runtime) {
+    (*runtime).wait_for_commit()
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_take_commit_stats(runtime: *mut Runtime) -> CommitStats {
+    (*runtime).take_commit_stats()
+}
+
+/// Exports the committed code to an object file. Returns null on success, otherwise a description
+/// of the error which must be freed with `maxim_destroy_string`. An empty target triple builds for
+/// the host.
+#[no_mangle]
+pub unsafe extern "C" fn maxim_export_object(
+    runtime: *const Runtime,
+    c_target_triple: *const std::os::raw::c_char,
+    c_cpu: *const std::os::raw::c_char,
+    c_features: *const std::os::raw::c_char,
+    min_size: bool,
+    sample_rate: f32,
+    bpm: f32,
+    arena_bytes: u64,
+    c_path: *const std::os::raw::c_char,
+) -> *mut std::os::raw::c_char {
+    let target_triple = std::ffi::CStr::from_ptr(c_target_triple)
+        .to_string_lossy()
+        .into_owned();
+    let config = exporter::ExportConfig {
+        target_triple: if target_triple.is_empty() {
+            None
+        } else {
+            Some(target_triple)
+        },
+        cpu: std::ffi::CStr::from_ptr(c_cpu)
+            .to_string_lossy()
+            .into_owned(),
+        features: std::ffi::CStr::from_ptr(c_features)
+            .to_string_lossy()
+            .into_owned(),
+        min_size,
+        sample_rate,
+        bpm,
+        arena_bytes,
+    };
+    let path = std::ffi::CStr::from_ptr(c_path).to_str().unwrap();
+
+    match exporter::export_object(&*runtime, &config, std::path::Path::new(path)) {
+        Ok(()) => std::ptr::null_mut(),
+        Err(err) => std::ffi::CString::new(err).unwrap().into_raw(),
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_is_surface_changed(runtime: *const Runtime, surface: u64) -> bool {
+    (*runtime).is_surface_changed(surface)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_is_block_changed(runtime: *const Runtime, block: u64) -> bool {
+    (*runtime).is_block_changed(block)
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn maxim_is_node_extracted(
     runtime: *const Runtime,
@@ -154,6 +317,12 @@ pub unsafe extern "C" fn maxim_destroy_transaction(val: *mut Transaction) {
     // box will be dropped here
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn maxim_merge_transaction(target: *mut Transaction, source: *mut Transaction) {
+    let owned_source = Box::from_raw(source);
+    (*target).merge(*owned_source);
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn maxim_print_transaction_to_stdout(val: *const Transaction) {
     println!("{:#?}", *val);
@@ -408,6 +577,39 @@ pub unsafe extern "C" fn maxim_block_clone(block: *const mir::Block) -> *mut mir
     Box::into_raw(Box::new((*block).clone()))
 }
 
+#[no_mangle]
+pub unsafe extern "C" fn maxim_block_freeze_control(
+    block: *mut mir::Block,
+    control: usize,
+    left: f32,
+    right: f32,
+    form: u8,
+) -> bool {
+    let form_type = match ast::FormType::from_u8(form) {
+        Some(form_type) => form_type,
+        None => return false,
+    };
+    pass::freeze_control(
+        &mut *block,
+        control,
+        mir::ConstantNum::new(left, right, form_type),
+    )
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn maxim_block_set_control_static(
+    block: *mut mir::Block,
+    control: usize,
+) -> bool {
+    match (*block).controls.get_mut(control) {
+        Some(block_control) => {
+            block_control.value_static = true;
+            true
+        }
+        None => false,
+    }
+}
+
 #[no_mangle]
 pub unsafe extern "C" fn maxim_error_get_description(
     error: *const CompileError,
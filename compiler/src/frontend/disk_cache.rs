@@ -0,0 +1,113 @@
+use codegen::TargetProperties;
+use mir::{Block, Surface};
+use std::ffi::{CStr, CString};
+use std::os::raw::c_char;
+
+// Modules with a name starting with this are cached on disk by the JIT, so the name must change
+// whenever anything that affects the generated code does.
+const MODULE_PREFIX: &str = "maxim.cache.";
+
+// A hash of the compiler's source, set by the build script. Any change to the compiler gives
+// cached objects new keys, so objects from another build are never loaded.
+const BUILD_ID: &str = env!("MAXIM_BUILD_ID");
+
+extern "C" {
+    fn LLVMAxiomSetObjectCacheDirectory(path: *const c_char);
+    fn LLVMAxiomObjectCacheContains(identifier: *const c_char) -> bool;
+    fn LLVMAxiomObjectCacheHostName() -> *const c_char;
+}
+
+/// Sets the directory compiled objects are stored in. An empty path disables the cache.
+pub fn set_directory(path: &str) {
+    let path = CString::new(path).unwrap();
+    unsafe {
+        LLVMAxiomSetObjectCacheDirectory(path.as_ptr());
+    }
+}
+
+/// Returns true if a compiled object for a module with this name is in the cache. If so, an empty
+/// module with the same name can be deployed instead of building it. The object is loaded by this
+/// call, so it's still there when the module is deployed.
+pub fn contains(module_name: &str) -> bool {
+    let name = CString::new(module_name).unwrap();
+    unsafe { LLVMAxiomObjectCacheContains(name.as_ptr()) }
+}
+
+pub fn module_name(kind: &str, key: u64) -> String {
+    format!("{}{}.{:016x}", MODULE_PREFIX, kind, key)
+}
+
+// FNV-1a. Unlike `DefaultHasher`, this gives the same keys with every version of Rust, and values
+// are written as bytes directly instead of through `Hash`, whose output isn't guaranteed either.
+struct KeyHasher(u64);
+
+impl KeyHasher {
+    fn new() -> Self {
+        KeyHasher(0xcbf2_9ce4_8422_2325)
+    }
+
+    fn write_bytes(&mut self, bytes: &[u8]) {
+        for &byte in bytes {
+            self.0 = (self.0 ^ u64::from(byte)).wrapping_mul(0x0000_0100_0000_01b3);
+        }
+    }
+
+    fn write_u64(&mut self, val: u64) {
+        for byte_index in 0..8 {
+            self.write_bytes(&[(val >> (byte_index * 8)) as u8]);
+        }
+    }
+
+    fn write_bool(&mut self, val: bool) {
+        self.write_bytes(&[val as u8]);
+    }
+
+    // strings are prefixed with their length, so neighbouring strings can't run into each other
+    fn write_str(&mut self, val: &str) {
+        self.write_u64(val.len() as u64);
+        self.write_bytes(val.as_bytes());
+    }
+
+    fn finish(&self) -> u64 {
+        self.0
+    }
+}
+
+fn target_hasher(target: &TargetProperties) -> KeyHasher {
+    // The cache also stores objects in a directory for the host, but the host is included here
+    // too so keys never match objects built for a different machine.
+    let host_name = unsafe { CStr::from_ptr(LLVMAxiomObjectCacheHostName()) };
+    let mut hasher = KeyHasher::new();
+    hasher.write_str(BUILD_ID);
+    hasher.write_str(&target.machine.get_triple().to_string_lossy());
+    hasher.write_str(&host_name.to_string_lossy());
+    hasher.write_bool(target.include_ui);
+    hasher.write_bool(target.min_size);
+    hasher
+}
+
+pub fn lib_key(target: &TargetProperties) -> u64 {
+    target_hasher(target).finish()
+}
+
+pub fn block_key(target: &TargetProperties, block: &Block) -> u64 {
+    let mut hasher = target_hasher(target);
+    hasher.write_str(&format!("{:?}", block));
+    hasher.finish()
+}
+
+/// A surface's code also depends on the layouts of the surfaces and blocks inside it, so their
+/// keys must be included in `dep_keys`.
+pub fn surface_key(target: &TargetProperties, surface: &Surface, dep_keys: &[u64]) -> u64 {
+    let mut hasher = target_hasher(target);
+
+    // the source map is only used by the editor, and isn't ordered
+    hasher.write_u64(surface.id.id);
+    hasher.write_str(&format!("{:?}", surface.groups));
+    hasher.write_str(&format!("{:?}", surface.nodes));
+    hasher.write_u64(dep_keys.len() as u64);
+    for &key in dep_keys {
+        hasher.write_u64(key);
+    }
+    hasher.finish()
+}
@@ -0,0 +1,286 @@
+use super::Runtime;
+use codegen::{
+    arena, block, data_analyzer, globals, parallel, root, surface, util, voice_sleep, ObjectCache,
+    Optimizer, TargetProperties,
+};
+use inkwell::attribute::AttrKind;
+use inkwell::context::Context;
+use inkwell::module::{Linkage, Module};
+use inkwell::targets::{
+    CodeModel, FileType, InitializationConfig, RelocMode, Target, TargetMachine,
+};
+use inkwell::OptimizationLevel;
+use mir::{Block, BlockRef, Surface, SurfaceRef};
+use std::collections::HashMap;
+use std::path::Path;
+
+pub const INIT_FUNC_NAME: &str = "axiom_init";
+pub const GENERATE_FUNC_NAME: &str = "axiom_generate";
+pub const GENERATE_BLOCK_FUNC_NAME: &str = "axiom_generate_block";
+pub const PACKUP_FUNC_NAME: &str = "axiom_packup";
+pub const GET_PORTAL_FUNC_NAME: &str = "axiom_get_portal";
+
+const INITIALIZED_GLOBAL_NAME: &str = "axiom.initialized";
+const SCRATCH_GLOBAL_NAME: &str = "axiom.scratch";
+const SOCKETS_GLOBAL_NAME: &str = "axiom.sockets";
+const PORTALS_GLOBAL_NAME: &str = "axiom.portals";
+const POINTERS_GLOBAL_NAME: &str = "axiom.pointers";
+
+// Only called from the block function, since exported code runs every voice on one thread.
+const VOICES_FUNC_NAME: &str = "axiom.voices";
+
+const EXPORTED_FUNC_NAMES: [&str; 5] = [
+    INIT_FUNC_NAME,
+    GENERATE_FUNC_NAME,
+    GENERATE_BLOCK_FUNC_NAME,
+    PACKUP_FUNC_NAME,
+    GET_PORTAL_FUNC_NAME,
+];
+
+#[derive(Debug, Clone)]
+pub struct ExportConfig {
+    /// The triple to build for, or None to build for the host.
+    pub target_triple: Option<String>,
+    pub cpu: String,
+    pub features: String,
+    pub min_size: bool,
+    pub sample_rate: f32,
+    pub bpm: f32,
+    /// The size of the memory dynamically sized state (like delay buffers) is allocated from.
+    /// Anything that doesn't fit is allocated from the heap.
+    pub arena_bytes: u64,
+}
+
+// Exported code never talks to the editor, so the layouts are rebuilt without UI state. The MIR
+// itself doesn't depend on the target, so it's shared with the runtime.
+struct ExportCache<'a> {
+    context: Context,
+    target: TargetProperties,
+    surface_mirs: HashMap<SurfaceRef, &'a Surface>,
+    surface_layouts: HashMap<SurfaceRef, data_analyzer::SurfaceLayout>,
+    block_mirs: HashMap<BlockRef, &'a Block>,
+    block_layouts: HashMap<BlockRef, data_analyzer::BlockLayout>,
+}
+
+impl<'a> ObjectCache for ExportCache<'a> {
+    fn context(&self) -> &Context {
+        &self.context
+    }
+
+    fn target(&self) -> &TargetProperties {
+        &self.target
+    }
+
+    fn surface_mir(&self, id: SurfaceRef) -> Option<&Surface> {
+        self.surface_mirs.get(&id).map(|surface| *surface)
+    }
+
+    fn surface_layout(&self, id: SurfaceRef) -> Option<&data_analyzer::SurfaceLayout> {
+        self.surface_layouts.get(&id)
+    }
+
+    fn block_mir(&self, id: BlockRef) -> Option<&Block> {
+        self.block_mirs.get(&id).map(|block| *block)
+    }
+
+    fn block_layout(&self, id: BlockRef) -> Option<&data_analyzer::BlockLayout> {
+        self.block_layouts.get(&id)
+    }
+}
+
+fn create_target_machine(config: &ExportConfig) -> Result<TargetMachine, String> {
+    Target::initialize_all(&InitializationConfig::default());
+
+    let triple = match config.target_triple {
+        Some(ref triple) => triple.clone(),
+        None => TargetMachine::get_default_triple()
+            .to_string_lossy()
+            .into_owned(),
+    };
+    let cpu = if config.cpu.is_empty() {
+        "generic"
+    } else {
+        &config.cpu
+    };
+    // LLVM has no size level for code generation, like with -Os and -Oz it's the IR passes and the
+    // function attributes that optimize for size, see `mark_min_size`.
+    let optimization_level = if config.min_size {
+        OptimizationLevel::Default
+    } else {
+        OptimizationLevel::Aggressive
+    };
+
+    let target = Target::from_triple(&triple).map_err(|err| err.to_string())?;
+    target
+        .create_target_machine(
+            &triple,
+            cpu,
+            &config.features,
+            optimization_level,
+            RelocMode::PIC,
+            CodeModel::Default,
+        ).ok_or_else(|| format!("Unable to create a target machine for {}", triple))
+}
+
+// Only the lifecycle functions are visible outside of the object, everything else is made internal
+// so it can't clash with symbols in the host and LLVM is free to inline and remove it.
+fn internalize_module(module: &Module) {
+    let mut next_func = module.get_first_function();
+    while let Some(func) = next_func {
+        next_func = func.get_next_function();
+
+        let is_defined = func.count_basic_blocks() > 0;
+        let is_exported = EXPORTED_FUNC_NAMES
+            .iter()
+            .any(|name| func.get_name().to_bytes() == name.as_bytes());
+        if is_defined && !is_exported {
+            func.set_linkage(Linkage::InternalLinkage);
+        }
+    }
+
+    let mut next_global = module.get_first_global();
+    while let Some(global) = next_global {
+        next_global = global.get_next_global();
+
+        if global.get_initializer().is_some() {
+            global.set_linkage(Linkage::InternalLinkage);
+        }
+    }
+}
+
+// The optimizer runs the -Oz pipeline for a target built with `min_size`, but only functions with
+// the minsize and optsize attributes are compiled for size once they reach code generation. Code
+// generated for blocks and surfaces already has them, this makes sure library functions do too.
+fn mark_min_size(context: &Context, module: &Module) {
+    let mut next_func = module.get_first_function();
+    while let Some(func) = next_func {
+        next_func = func.get_next_function();
+
+        if func.count_basic_blocks() > 0 {
+            func.add_attribute(context.get_enum_attr(AttrKind::MinSize, 0));
+            func.add_attribute(context.get_enum_attr(AttrKind::OptimizeForSize, 0));
+        }
+    }
+}
+
+/// Generates the committed code in a runtime into a single object file at `path`, which exposes
+/// the functions declared in the replayer's `Axiom.h`. The sample rate and BPM are baked in as
+/// constants, since there's no runtime to change them, and the arena is a global in the object.
+/// Controls get the values they were built with, so the runtime should be built with frozen
+/// controls for knob positions to be kept.
+pub fn export_object(runtime: &Runtime, config: &ExportConfig, path: &Path) -> Result<(), String> {
+    let (root, blocks, surfaces) = match runtime.committed_mir() {
+        Some(mir) => mir,
+        None => return Err("There's nothing to export yet".to_string()),
+    };
+
+    let machine = create_target_machine(config)?;
+    let mut cache = ExportCache {
+        context: Context::create(),
+        target: TargetProperties::new(false, config.min_size, machine),
+        surface_mirs: HashMap::new(),
+        surface_layouts: HashMap::new(),
+        block_mirs: HashMap::new(),
+        block_layouts: HashMap::new(),
+    };
+    for &block in &blocks {
+        let layout = data_analyzer::build_block_layout(&cache.context, block, &cache.target);
+        cache.block_layouts.insert(block.id.id, layout);
+        cache.block_mirs.insert(block.id.id, block);
+    }
+    for &surface in &surfaces {
+        cache.surface_mirs.insert(surface.id.id, surface);
+    }
+
+    // surfaces are sorted so the layouts of any surfaces inside have already been built
+    for &surface in &surfaces {
+        let layout = data_analyzer::build_surface_layout(&cache, surface);
+        cache.surface_layouts.insert(surface.id.id, layout);
+    }
+
+    let module = cache.context.create_module("axiom");
+    module.set_target(&cache.target.machine.get_triple().to_string_lossy());
+    module.set_data_layout(&cache.target.machine.get_data().get_data_layout());
+
+    Runtime::build_lib_funcs(&module, &cache.context, &cache.target);
+    arena::build_static_memory(&module, config.arena_bytes);
+    parallel::build_serial_dispatch_func(&module, &cache.target);
+    voice_sleep::build_serial_add_slept_updates_func(&module, &cache.target);
+    for &block in &blocks {
+        block::build_funcs(&module, &cache, block);
+    }
+    for &surface in &surfaces {
+        surface::build_funcs(&module, &cache, surface);
+    }
+
+    let initialized_global =
+        root::build_initialized_global(&module, &cache, 0, INITIALIZED_GLOBAL_NAME);
+    let scratch_global = root::build_scratch_global(&module, &cache, 0, SCRATCH_GLOBAL_NAME);
+    let sockets_global =
+        root::build_sockets_global(&module, root, SOCKETS_GLOBAL_NAME, PORTALS_GLOBAL_NAME);
+    let pointers_global = root::build_pointers_global(
+        &module,
+        &cache,
+        0,
+        POINTERS_GLOBAL_NAME,
+        initialized_global.as_pointer_value(),
+        scratch_global.as_pointer_value(),
+        sockets_global.sockets.as_pointer_value(),
+    );
+    root::build_funcs(
+        &module,
+        &cache,
+        0,
+        INIT_FUNC_NAME,
+        GENERATE_FUNC_NAME,
+        PACKUP_FUNC_NAME,
+        pointers_global.as_pointer_value(),
+    );
+    root::build_update_block_func(
+        &module,
+        &cache,
+        root,
+        GENERATE_BLOCK_FUNC_NAME,
+        GENERATE_FUNC_NAME,
+        VOICES_FUNC_NAME,
+        initialized_global.as_pointer_value(),
+        scratch_global.as_pointer_value(),
+        sockets_global.sockets.as_pointer_value(),
+        pointers_global.as_pointer_value(),
+    );
+    root::build_get_portal_func(
+        &module,
+        &cache,
+        root,
+        GET_PORTAL_FUNC_NAME,
+        sockets_global.socket_ptrs.as_pointer_value(),
+    );
+
+    // Nothing can write to the globals the runtime normally sets, so they become constants that
+    // LLVM can fold. Migrate flags are only set while the runtime is committing.
+    let sample_rate = globals::get_sample_rate(&module);
+    sample_rate.set_initializer(&util::get_vec_spread(&cache.context, config.sample_rate));
+    sample_rate.set_constant(true);
+    let bpm = globals::get_bpm(&module);
+    bpm.set_initializer(&util::get_vec_spread(&cache.context, config.bpm));
+    bpm.set_constant(true);
+    for block in &blocks {
+        let migrate_name =
+            block::get_migrate_global_name(block.id.id, cache.block_version(block.id.id));
+        if let Some(migrate) = module.get_global(&migrate_name) {
+            migrate.set_constant(true);
+        }
+    }
+
+    internalize_module(&module);
+    if config.min_size {
+        mark_min_size(&cache.context, &module);
+    }
+    Optimizer::new(&cache.target).optimize_module(&module);
+
+    cache
+        .target
+        .machine
+        .write_to_file(&module, FileType::Object, path)
+        .map_err(|err| err.to_string())
+}
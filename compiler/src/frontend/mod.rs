@@ -1,12 +1,20 @@
+mod arena;
+mod block_codegen;
 pub mod c_api;
 mod dependency_graph;
+mod disk_cache;
+mod exporter;
 mod jit;
+mod player;
 mod runtime;
+mod state_map;
 pub mod value_reader;
+mod worker_pool;
 
 pub use self::dependency_graph::DependencyGraph;
 pub use self::jit::Jit;
-pub use self::runtime::Runtime;
+pub use self::player::Player;
+pub use self::runtime::{CommitStats, Runtime};
 
 use mir::{Block, BlockRef, Root, Surface, SurfaceRef};
 use std::collections::HashMap;
@@ -37,4 +45,14 @@ impl Transaction {
     pub fn add_block(&mut self, block: Block) {
         self.blocks.insert(block.id.id, block);
     }
+
+    /// Merges a newer transaction into this one. Anything in both transactions is taken from the
+    /// newer one.
+    pub fn merge(&mut self, other: Transaction) {
+        if other.root.is_some() {
+            self.root = other.root;
+        }
+        self.surfaces.extend(other.surfaces);
+        self.blocks.extend(other.blocks);
+    }
 }
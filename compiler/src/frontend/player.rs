@@ -0,0 +1,292 @@
+use super::arena::ArenaState;
+use super::runtime::RuntimePointers;
+use super::state_map::StateCopy;
+use super::worker_pool::WorkerPool;
+use std::cell::UnsafeCell;
+use std::mem;
+use std::os::raw::c_void;
+use std::ptr;
+use std::sync::atomic::{AtomicBool, AtomicU32, AtomicUsize, Ordering};
+use std::thread;
+
+/// Everything the player needs to move from one instance of the root to the next.
+#[derive(Debug)]
+pub struct PlayerSwitch {
+    // The instance to switch to, or None to keep running the current one. Once the switch has been
+    // applied, this holds the instance that was replaced.
+    pub instance: Option<RuntimePointers>,
+
+    // Blocks whose state is moved to the new instance instead of being reconstructed.
+    pub migrate_flags: Vec<*mut bool>,
+    pub state_copies: Vec<StateCopy>,
+
+    // The pool voices are dispatched to, or null to update every voice on the player's thread.
+    pub worker_pool: *const WorkerPool,
+}
+
+/// The part of the runtime that runs the deployed code. It's kept apart from the `Runtime` so the
+/// audio thread never needs a reference to it while a commit is being prepared or finished on
+/// another thread.
+///
+/// The runtime builds a new instance of the root off to the side, and switches to it in three
+/// steps, all of which run on the runtime's thread:
+///  - `prepare` constructs the new instance while the old one keeps running.
+///  - `apply` waits for the block that's running to finish, then copies the kept state across and
+///    swaps the instances. That's only a few copies, so it fits in the gap between blocks.
+///  - `reclaim` destructs the old instance, once it can no longer be running.
+///
+/// The audio thread never waits for any of this. If a block starts while the runtime is between
+/// blocks applying or reclaiming a switch, it plays silence instead.
+#[derive(Debug)]
+pub struct Player {
+    // IDs can be allocated from the UI thread while a commit is being prepared on another thread
+    next_id: AtomicUsize,
+
+    // Set by whichever thread is using the instance: the audio thread while it runs a block, or the
+    // runtime while it's switching instances. Only the thread that set it can touch `instance`.
+    in_block: AtomicBool,
+
+    instance: UnsafeCell<Option<RuntimePointers>>,
+    parallel_pool_ptr: *mut *const c_void,
+
+    // only read to check for heap allocations in debug builds
+    #[cfg_attr(not(debug_assertions), allow(dead_code))]
+    arena_ptr: *const ArenaState,
+
+    // The BPM and sample rate are set from the audio thread while a commit can be in progress, so
+    // they're kept here as bits of an f32 rather than in the runtime.
+    bpm: AtomicU32,
+    sample_rate: AtomicU32,
+    bpm_ptr: *mut c_void,
+    samplerate_ptr: *mut c_void,
+}
+
+// The raw pointers point into the runtime's library globals, which outlive the player, and
+// `instance` is only touched by the thread that has claimed `in_block`.
+unsafe impl Send for Player {}
+unsafe impl Sync for Player {}
+
+impl Player {
+    pub fn new(
+        parallel_pool_ptr: *mut *const c_void,
+        arena_ptr: *const ArenaState,
+        bpm_ptr: *mut c_void,
+        samplerate_ptr: *mut c_void,
+    ) -> Self {
+        let player = Player {
+            next_id: AtomicUsize::new(1),
+            in_block: AtomicBool::new(false),
+            instance: UnsafeCell::new(None),
+            parallel_pool_ptr,
+            arena_ptr,
+            bpm: AtomicU32::new(60f32.to_bits()),
+            sample_rate: AtomicU32::new(44100f32.to_bits()),
+            bpm_ptr,
+            samplerate_ptr,
+        };
+        player.reset_globals();
+        player
+    }
+
+    pub fn alloc_id(&self) -> u64 {
+        self.next_id.fetch_add(1, Ordering::Relaxed) as u64
+    }
+
+    pub fn set_bpm(&self, bpm: f32) {
+        self.bpm.store(bpm.to_bits(), Ordering::Relaxed);
+        Player::set_vector(self.bpm_ptr, bpm);
+    }
+
+    pub fn get_bpm(&self) -> f32 {
+        f32::from_bits(self.bpm.load(Ordering::Relaxed))
+    }
+
+    pub fn set_sample_rate(&self, sample_rate: f32) {
+        self.sample_rate.store(sample_rate.to_bits(), Ordering::Relaxed);
+        Player::set_vector(self.samplerate_ptr, sample_rate);
+    }
+
+    pub fn get_sample_rate(&self) -> f32 {
+        f32::from_bits(self.sample_rate.load(Ordering::Relaxed))
+    }
+
+    /// Writes the BPM and sample rate to the library's globals again, in case deployed code has
+    /// changed them.
+    pub fn reset_globals(&self) {
+        Player::set_vector(self.bpm_ptr, self.get_bpm());
+        Player::set_vector(self.samplerate_ptr, self.get_sample_rate());
+    }
+
+    // The globals are read by generated code as a vector of two floats. Each lane is written
+    // atomically, so the code never reads half of a float.
+    fn set_vector(ptr: *mut c_void, value: f32) {
+        let lanes = ptr as *const AtomicU32;
+        for lane in 0..2 {
+            unsafe {
+                (*lanes.offset(lane)).store(value.to_bits(), Ordering::Relaxed);
+            }
+        }
+    }
+
+    pub unsafe fn run_update(&self) {
+        self.run(|pointers| (pointers.update)());
+    }
+
+    /// Runs the update function `frames` times, reading from and writing to the portal buffers.
+    /// `outputs` holds `output_count` buffers, any of which can be null. If the runtime is switching
+    /// instances, the output buffers are filled with silence instead.
+    pub unsafe fn run_block(
+        &self,
+        frames: u32,
+        inputs: *const *const f32,
+        outputs: *const *mut f32,
+        output_count: u32,
+    ) {
+        let did_run = self.run(|pointers| (pointers.update_block)(frames, inputs, outputs));
+        if !did_run {
+            for output_index in 0..output_count as isize {
+                let output = *outputs.offset(output_index);
+                if !output.is_null() {
+                    ptr::write_bytes(output, 0, frames as usize);
+                }
+            }
+        }
+    }
+
+    // Returns false without running anything if the runtime has claimed the instance.
+    unsafe fn run(&self, update: impl FnOnce(&RuntimePointers)) -> bool {
+        if !self.try_claim() {
+            return false;
+        }
+
+        #[cfg(debug_assertions)]
+        let heap_allocs = (*self.arena_ptr).heap_allocs;
+        if let Some(ref pointers) = *self.instance.get() {
+            update(pointers);
+        }
+        #[cfg(debug_assertions)]
+        self.debug_assert_no_heap_allocs(heap_allocs);
+
+        self.release();
+        true
+    }
+
+    // The update functions run on the audio thread, so in debug builds it's an error for them to
+    // have needed more memory than the arena has.
+    #[cfg(debug_assertions)]
+    unsafe fn debug_assert_no_heap_allocs(&self, heap_allocs_before: u64) {
+        debug_assert_eq!(
+            (*self.arena_ptr).heap_allocs,
+            heap_allocs_before,
+            "Generated code allocated from the heap because the arena is full ({} bytes used)",
+            (*self.arena_ptr).used
+        );
+    }
+
+    /// Constructs the instance a switch moves to. The current instance keeps running while this
+    /// happens, so it must not be called from the audio thread.
+    pub fn prepare(&self, switch: &PlayerSwitch) {
+        let new_pointers = match switch.instance {
+            Some(ref new_pointers) => new_pointers,
+            None => return,
+        };
+
+        // The migrate flags of kept blocks stop the new code from constructing over the state
+        // that's moved in, and the old code from destructing it. Only construct and destruct check
+        // them, so the running instance isn't affected.
+        for &flag in &switch.migrate_flags {
+            unsafe {
+                *flag = true;
+            }
+        }
+        unsafe {
+            (new_pointers.construct)();
+        }
+    }
+
+    /// Switches to the instance given to `prepare`, copying across the state of kept blocks. Once
+    /// this returns, the switch holds the replaced instance, which must be given to `reclaim`.
+    ///
+    /// This waits for the block that's running to finish, and blocks started before it returns
+    /// play silence, so the caller shouldn't be holding anything the audio thread waits for.
+    pub fn apply(&self, switch: &mut PlayerSwitch) {
+        self.claim();
+        unsafe {
+            let instance = &mut *self.instance.get();
+            if let Some(new_pointers) = switch.instance.take() {
+                if let Some(ref old_pointers) = *instance {
+                    StateCopy::apply(
+                        &switch.state_copies,
+                        old_pointers.initialized_ptr,
+                        old_pointers.scratch_ptr,
+                        new_pointers.initialized_ptr,
+                        new_pointers.scratch_ptr,
+                    );
+                }
+                switch.instance = mem::replace(instance, Some(new_pointers));
+            }
+
+            // the function the pool updates voices with moves whenever the root is deployed again
+            if !switch.worker_pool.is_null() {
+                (*switch.worker_pool)
+                    .set_voices_func(instance.as_ref().and_then(|pointers| pointers.voices));
+            }
+            *self.parallel_pool_ptr = switch.worker_pool as *const c_void;
+        }
+        self.release();
+    }
+
+    /// Destructs the instance a switch replaced. Destructing frees memory back to the arena, which
+    /// the running instance allocates from, so this also waits for a gap between blocks.
+    pub fn reclaim(&self, switch: &mut PlayerSwitch) {
+        if let Some(old_pointers) = switch.instance.take() {
+            self.claim();
+            unsafe {
+                (old_pointers.destruct)();
+            }
+            self.release();
+        }
+
+        for &flag in &switch.migrate_flags {
+            unsafe {
+                *flag = false;
+            }
+        }
+    }
+
+    /// Prepares, applies and reclaims a switch, see the functions for each step.
+    pub fn switch(&self, switch: &mut PlayerSwitch) {
+        self.prepare(switch);
+        self.apply(switch);
+        self.reclaim(switch);
+    }
+
+    /// Waits for the instance to stop running, then destructs it. Nothing can run the player
+    /// afterwards.
+    pub fn shutdown(&self) {
+        self.claim();
+        unsafe {
+            *self.parallel_pool_ptr = ptr::null();
+            if let Some(pointers) = (*self.instance.get()).take() {
+                (pointers.destruct)();
+            }
+        }
+    }
+
+    fn try_claim(&self) -> bool {
+        self.in_block
+            .compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed)
+            .is_ok()
+    }
+
+    // Blocks are short, so this only ever spins for as long as one takes.
+    fn claim(&self) {
+        while !self.try_claim() {
+            thread::yield_now();
+        }
+    }
+
+    fn release(&self) {
+        self.in_block.store(false, Ordering::Release);
+    }
+}
@@ -1,44 +1,70 @@
+use super::arena::{Arena, ArenaState, DEFAULT_ARENA_BYTES};
+use super::block_codegen::{self, WorkerContext};
 use super::dependency_graph::DependencyGraph;
+use super::disk_cache;
 use super::jit::{Jit, JitKey};
+use super::player::{Player, PlayerSwitch};
+use super::state_map::{StateKey, StateMap};
+use super::worker_pool::WorkerPool;
 use super::Transaction;
 use codegen::{
-    block, controls, converters, data_analyzer, editor, functions, globals, intrinsics, root,
-    surface, values, ObjectCache, Optimizer, TargetProperties,
+    arena, block, controls, converters, data_analyzer, editor, functions, globals, intrinsics,
+    math, root, surface, values, ObjectCache, Optimizer, TargetProperties,
 };
 use inkwell::context::Context;
 use inkwell::module::Module;
 use mir::{Block, BlockRef, IdAllocator, InternalNodeRef, Root, Surface, SurfaceRef};
 use pass;
-use std::collections::hash_map::Entry;
 use std::collections::{HashMap, HashSet, VecDeque};
+use std::hash::Hash;
 use std::iter;
 use std::iter::FromIterator;
 use std::mem;
 use std::os::raw::c_void;
 use std::ptr;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
 use std::time::{Duration, Instant};
 
 #[derive(Debug)]
 struct RuntimeModule {
     module: Module,
     key: Option<JitKey>,
+    cache_key: u64,
+
+    // The context of a module built on a worker thread, which must be dropped after the module.
+    // Modules built on the runtime's thread use the runtime's context.
+    worker_context: Option<Arc<WorkerContext>>,
 }
 
 impl RuntimeModule {
-    pub fn new(module: Module, key: Option<JitKey>) -> Self {
-        RuntimeModule { module, key }
+    pub fn new(module: Module, key: Option<JitKey>, cache_key: u64) -> Self {
+        RuntimeModule {
+            module,
+            key,
+            cache_key,
+            worker_context: None,
+        }
     }
 }
 
-const INITIALIZED_GLOBAL_NAME: &str = "maxim.runtime.initialized";
-const SCRATCH_GLOBAL_NAME: &str = "maxim.runtime.scratch";
-const SOCKETS_GLOBAL_NAME: &str = "maxim.runtime.sockets";
-const PORTALS_GLOBAL_NAME: &str = "maxim.runtime.portals";
-const POINTERS_GLOBAL_NAME: &str = "maxim.runtime.pointers";
-
-const CONSTRUCT_FUNC_NAME: &str = "maxim.runtime.construct";
-const UPDATE_FUNC_NAME: &str = "maxim.runtime.update";
-const DESTRUCT_FUNC_NAME: &str = "maxim.runtime.destruct";
+const INITIALIZED_GLOBAL_NAME: &str = "initialized";
+const SCRATCH_GLOBAL_NAME: &str = "scratch";
+const SOCKETS_GLOBAL_NAME: &str = "sockets";
+const PORTALS_GLOBAL_NAME: &str = "portals";
+const POINTERS_GLOBAL_NAME: &str = "pointers";
+
+const CONSTRUCT_FUNC_NAME: &str = "construct";
+const UPDATE_FUNC_NAME: &str = "update";
+const UPDATE_BLOCK_FUNC_NAME: &str = "update_block";
+const DESTRUCT_FUNC_NAME: &str = "destruct";
+const VOICES_FUNC_NAME: &str = "voices";
+
+// Each commit builds a new instance of the root, which runs alongside the old one until the player
+// has switched to it, so its symbols are named after the instance.
+fn get_root_symbol_name(instance: u64, name: &str) -> String {
+    format!("maxim.runtime.{}.{}", instance, name)
+}
 
 const CONVERT_NUM_FUNC_NAME: &str = "maxim.editor.convert_num";
 
@@ -46,6 +72,12 @@ const CONVERT_NUM_FUNC_NAME: &str = "maxim.editor.convert_num";
 struct LibraryPointers {
     samplerate_ptr: *mut c_void,
     bpm_ptr: *mut c_void,
+    sleep_threshold_ptr: *mut f32,
+    sleep_samples_ptr: *mut u32,
+    slept_updates_ptr: *mut u64,
+    control_rate_interval_ptr: *mut u32,
+    arena_ptr: *mut ArenaState,
+    parallel_pool_ptr: *mut *const c_void,
     convert_num: unsafe extern "C" fn(*mut c_void, i8, *const c_void),
 }
 
@@ -58,46 +90,89 @@ impl LibraryPointers {
         let bpm_ptr_address = jit.get_symbol_address(globals::BPM_GLOBAL_NAME) as usize;
         assert_ne!(bpm_ptr_address, 0);
 
+        let sleep_threshold_address =
+            jit.get_symbol_address(globals::SLEEP_THRESHOLD_GLOBAL_NAME) as usize;
+        assert_ne!(sleep_threshold_address, 0);
+
+        let sleep_samples_address =
+            jit.get_symbol_address(globals::SLEEP_SAMPLES_GLOBAL_NAME) as usize;
+        assert_ne!(sleep_samples_address, 0);
+
+        let slept_updates_address =
+            jit.get_symbol_address(globals::SLEPT_UPDATES_GLOBAL_NAME) as usize;
+        assert_ne!(slept_updates_address, 0);
+
+        let control_rate_interval_address =
+            jit.get_symbol_address(globals::CONTROL_RATE_INTERVAL_GLOBAL_NAME) as usize;
+        assert_ne!(control_rate_interval_address, 0);
+
+        let arena_address = jit.get_symbol_address(arena::ARENA_GLOBAL_NAME) as usize;
+        assert_ne!(arena_address, 0);
+
+        let parallel_pool_address =
+            jit.get_symbol_address(globals::PARALLEL_POOL_GLOBAL_NAME) as usize;
+        assert_ne!(parallel_pool_address, 0);
+
         let convert_num_address = jit.get_symbol_address(CONVERT_NUM_FUNC_NAME) as usize;
         assert_ne!(convert_num_address, 0);
 
         LibraryPointers {
             samplerate_ptr: samplerate_ptr_address as *mut c_void,
             bpm_ptr: bpm_ptr_address as *mut c_void,
+            sleep_threshold_ptr: sleep_threshold_address as *mut f32,
+            sleep_samples_ptr: sleep_samples_address as *mut u32,
+            slept_updates_ptr: slept_updates_address as *mut u64,
+            control_rate_interval_ptr: control_rate_interval_address as *mut u32,
+            arena_ptr: arena_address as *mut ArenaState,
+            parallel_pool_ptr: parallel_pool_address as *mut *const c_void,
             convert_num: unsafe { mem::transmute(convert_num_address) },
         }
     }
 }
 
-#[derive(Debug)]
-struct RuntimePointers {
-    initialized_ptr: *mut c_void,
-    scratch_ptr: *mut c_void,
-    sockets_ptr: *mut c_void,
-    portals_ptr: *mut c_void,
-    pointers_ptr: *mut c_void,
-    construct: unsafe extern "C" fn(),
-    update: unsafe extern "C" fn(),
-    destruct: unsafe extern "C" fn(),
+/// The functions and memory of one instance of the root.
+#[derive(Debug, Clone, Copy)]
+pub struct RuntimePointers {
+    pub initialized_ptr: *mut c_void,
+    pub scratch_ptr: *mut c_void,
+    pub sockets_ptr: *mut c_void,
+    pub portals_ptr: *mut c_void,
+    pub pointers_ptr: *mut c_void,
+    pub construct: unsafe extern "C" fn(),
+    pub update: unsafe extern "C" fn(),
+    pub update_block: unsafe extern "C" fn(u32, *const *const f32, *const *mut f32),
+    pub destruct: unsafe extern "C" fn(),
+
+    // Updates a voice for a chunk of frames on the worker pool, if the root has voices that can be
+    // spread across it, see `parallel::VoiceSplit`.
+    pub voices: Option<unsafe extern "C" fn(u32)>,
 }
 
 impl RuntimePointers {
-    pub fn new(jit: &Jit) -> Self {
-        let construct_address = jit.get_symbol_address(CONSTRUCT_FUNC_NAME) as usize;
+    pub fn new(jit: &Jit, instance: u64) -> Self {
+        let get_address =
+            |name: &str| jit.get_symbol_address(&get_root_symbol_name(instance, name)) as usize;
+
+        let construct_address = get_address(CONSTRUCT_FUNC_NAME);
         assert_ne!(construct_address, 0);
 
-        let update_address = jit.get_symbol_address(UPDATE_FUNC_NAME) as usize;
+        let update_address = get_address(UPDATE_FUNC_NAME);
         assert_ne!(update_address, 0);
 
-        let destruct_address = jit.get_symbol_address(DESTRUCT_FUNC_NAME) as usize;
+        let update_block_address = get_address(UPDATE_BLOCK_FUNC_NAME);
+        assert_ne!(update_block_address, 0);
+
+        let destruct_address = get_address(DESTRUCT_FUNC_NAME);
         assert_ne!(destruct_address, 0);
 
+        let voices_address = get_address(VOICES_FUNC_NAME);
+
         // pointers can be null when they're pointing to empty data
-        let initialized_ptr_address = jit.get_symbol_address(INITIALIZED_GLOBAL_NAME) as usize;
-        let scratch_ptr_address = jit.get_symbol_address(SCRATCH_GLOBAL_NAME) as usize;
-        let sockets_ptr_address = jit.get_symbol_address(SOCKETS_GLOBAL_NAME) as usize;
-        let portals_ptr_address = jit.get_symbol_address(PORTALS_GLOBAL_NAME) as usize;
-        let pointers_ptr_address = jit.get_symbol_address(POINTERS_GLOBAL_NAME) as usize;
+        let initialized_ptr_address = get_address(INITIALIZED_GLOBAL_NAME);
+        let scratch_ptr_address = get_address(SCRATCH_GLOBAL_NAME);
+        let sockets_ptr_address = get_address(SOCKETS_GLOBAL_NAME);
+        let portals_ptr_address = get_address(PORTALS_GLOBAL_NAME);
+        let pointers_ptr_address = get_address(POINTERS_GLOBAL_NAME);
 
         RuntimePointers {
             initialized_ptr: initialized_ptr_address as *mut c_void,
@@ -107,14 +182,54 @@ impl RuntimePointers {
             pointers_ptr: pointers_ptr_address as *mut c_void,
             construct: unsafe { mem::transmute(construct_address) },
             update: unsafe { mem::transmute(update_address) },
+            update_block: unsafe { mem::transmute(update_block_address) },
             destruct: unsafe { mem::transmute(destruct_address) },
+            voices: if voices_address == 0 {
+                None
+            } else {
+                Some(unsafe { mem::transmute(voices_address) })
+            },
         }
     }
 }
 
+/// Time spent in each phase of the commits made since the stats were last taken.
+#[repr(C)]
+#[derive(Debug, Default, Clone, Copy)]
+pub struct CommitStats {
+    pub commit_count: u32,
+    pub patch_seconds: f64,
+    pub codegen_seconds: f64,
+    pub deploy_seconds: f64,
+}
+
+// A commit that has been patched and built, but not yet deployed to the JIT.
+#[derive(Debug, Default)]
+struct PendingCommit {
+    // Blocks and surfaces with modules that haven't been deployed yet.
+    block_ids: Vec<BlockRef>,
+    surface_ids: Vec<SurfaceRef>,
+
+    // Deployed modules that have been replaced or garbage collected. They stay in the JIT until
+    // the player has stopped running them.
+    removed_blocks: HashMap<BlockRef, RuntimeModule>,
+    removed_surfaces: HashMap<SurfaceRef, RuntimeModule>,
+
+    // Surfaces whose MIR is in the commit. `surface_ids` also contains the surfaces above them,
+    // which are rebuilt but haven't actually changed.
+    changed_surface_ids: HashSet<SurfaceRef>,
+}
+
+// A commit that has been deployed, waiting to be handed to the player.
+#[derive(Debug)]
+struct StagedCommit {
+    switch: Box<PlayerSwitch>,
+    pointers: RuntimePointers,
+    removed_keys: Vec<JitKey>,
+}
+
 #[derive(Debug)]
 pub struct Runtime {
-    next_id: u64,
     context: Context,
     target: TargetProperties,
     pub optimizer: Optimizer,
@@ -126,11 +241,30 @@ pub struct Runtime {
     block_layouts: HashMap<BlockRef, data_analyzer::BlockLayout>,
     block_modules: HashMap<BlockRef, RuntimeModule>,
     graph: DependencyGraph,
+    // dropped before the JIT, since it points into the library's globals
+    arena: Arena,
+    // The heap allocations that have already been logged, see `report_heap_allocs`.
+    reported_heap_allocs: u64,
+    worker_pool: Option<Box<WorkerPool>>,
     jit: Jit,
     library_pointers: LibraryPointers,
+    player: Arc<Player>,
+
+    // The instance the player was last given, and the number of the last one built.
     runtime_pointers: Option<RuntimePointers>,
-    bpm: f32,
-    sample_rate: f32,
+    root_instance: u64,
+
+    pending_commit: Option<PendingCommit>,
+    staged_commit: Option<StagedCommit>,
+
+    // The switch the player has just applied, which holds the instance it replaced, and the code
+    // that instance ran. Both are freed by `wait_for_commit`.
+    published_commit: Option<(Box<PlayerSwitch>, Vec<JitKey>)>,
+    state_map: StateMap,
+    commit_stats: CommitStats,
+    sleep_threshold: f32,
+    sleep_samples: u32,
+    control_rate_interval: u32,
 }
 
 impl Runtime {
@@ -140,18 +274,30 @@ impl Runtime {
         let root_module = Runtime::create_module(&context, &target, "root");
         let jit = Jit::new();
 
-        // deploy the library to the JIT
-        let library_module = Runtime::codegen_lib(&context, &target);
-        optimizer.optimize_module(&library_module);
+        // deploy the library to the JIT, it only needs to be built if it isn't in the cache
+        let library_name = disk_cache::module_name("lib", disk_cache::lib_key(&target));
+        let library_module = if disk_cache::contains(&library_name) {
+            Runtime::create_module(&context, &target, &library_name)
+        } else {
+            let module = Runtime::codegen_lib(&context, &target, &library_name);
+            optimizer.optimize_module(&module);
+            module
+        };
         jit.deploy(&library_module);
         let library_pointers = LibraryPointers::new(&jit);
+        let arena = Arena::new(library_pointers.arena_ptr, DEFAULT_ARENA_BYTES);
+        let player = Arc::new(Player::new(
+            library_pointers.parallel_pool_ptr,
+            library_pointers.arena_ptr,
+            library_pointers.bpm_ptr,
+            library_pointers.samplerate_ptr,
+        ));
 
         Runtime {
-            next_id: 1,
             context,
             target,
             optimizer,
-            root: (Root::new(Vec::new()), RuntimeModule::new(root_module, None)),
+            root: (Root::new(Vec::new()), RuntimeModule::new(root_module, None, 0)),
             surface_mirs: HashMap::new(),
             surface_layouts: HashMap::new(),
             surface_modules: HashMap::new(),
@@ -159,11 +305,22 @@ impl Runtime {
             block_layouts: HashMap::new(),
             block_modules: HashMap::new(),
             graph: DependencyGraph::new(),
+            arena,
+            reported_heap_allocs: 0,
+            worker_pool: None,
             jit,
             library_pointers,
+            player,
             runtime_pointers: None,
-            bpm: 60.,
-            sample_rate: 44100.,
+            root_instance: 0,
+            pending_commit: None,
+            staged_commit: None,
+            published_commit: None,
+            state_map: StateMap::default(),
+            commit_stats: CommitStats::default(),
+            sleep_threshold: globals::DEFAULT_SLEEP_THRESHOLD,
+            sleep_samples: globals::DEFAULT_SLEEP_SAMPLES,
+            control_rate_interval: globals::DEFAULT_CONTROL_RATE_INTERVAL,
         }
     }
 
@@ -174,14 +331,21 @@ impl Runtime {
         module
     }
 
-    fn codegen_lib(context: &Context, target: &TargetProperties) -> Module {
-        let module = Runtime::create_module(context, target, "lib");
-        controls::build_funcs(&module, target);
-        converters::build_funcs(&module);
-        functions::build_funcs(&module, &target);
-        intrinsics::build_intrinsics(&module);
-        globals::build_globals(&module);
-        values::MidiValue::initialize(&module, context);
+    /// Builds the functions and globals that generated code for blocks and surfaces calls into.
+    pub fn build_lib_funcs(module: &Module, context: &Context, target: &TargetProperties) {
+        controls::build_funcs(module, target);
+        converters::build_funcs(module);
+        functions::build_funcs(module, target);
+        intrinsics::build_intrinsics(module);
+        math::build_funcs(module);
+        arena::build_funcs(module, target);
+        globals::build_globals(module);
+        values::MidiValue::initialize(module, context);
+    }
+
+    fn codegen_lib(context: &Context, target: &TargetProperties, name: &str) -> Module {
+        let module = Runtime::create_module(context, target, name);
+        Runtime::build_lib_funcs(&module, context, target);
         editor::build_convert_num_func(&module, &target, CONVERT_NUM_FUNC_NAME);
         module
     }
@@ -230,23 +394,39 @@ impl Runtime {
     }
 
     fn deploy_module(jit: &Jit, module: &mut RuntimeModule) {
-        // if the module already has a key, remove it
-        if let Some(key) = module.key {
-            jit.remove(key);
+        if module.key.is_none() {
+            module.key = Some(jit.deploy(&module.module));
         }
-        let key = jit.deploy(&module.module);
-        module.key = Some(key);
     }
 
-    fn remove_module(jit: &Jit, module: &mut RuntimeModule) {
-        if let Some(key) = module.key {
-            jit.remove(key);
-            module.key = None;
+    // Makes way for a new build of a block or surface. Deployed modules are kept until the player
+    // has stopped running them, and if one of them is the same build, it's brought back instead.
+    // Returns false if there's already a module for the build, so nothing needs to be generated.
+    fn retire_module<K: Hash + Eq + Copy>(
+        modules: &mut HashMap<K, RuntimeModule>,
+        removed_modules: &mut HashMap<K, RuntimeModule>,
+        id: K,
+        cache_key: u64,
+    ) -> bool {
+        if modules.get(&id).map(|module| module.cache_key) == Some(cache_key) {
+            return false;
+        }
+
+        if let Some(old_module) = modules.remove(&id) {
+            if old_module.key.is_some() {
+                removed_modules.insert(id, old_module);
+            }
+        }
+        if removed_modules.get(&id).map(|module| module.cache_key) == Some(cache_key) {
+            modules.insert(id, removed_modules.remove(&id).unwrap());
+            return false;
         }
+        true
     }
 
     fn optimize_blocks<'b>(&self, blocks: impl IntoIterator<Item = &'b mut Block>) {
         for block in blocks.into_iter() {
+            pass::fold_constants(block);
             pass::remove_dead_code(block);
         }
     }
@@ -289,7 +469,10 @@ impl Runtime {
         }
     }
 
-    fn patch_transaction(&mut self, transaction: Transaction) -> (Vec<BlockRef>, Vec<SurfaceRef>) {
+    fn patch_transaction(
+        &mut self,
+        transaction: Transaction,
+    ) -> (Vec<BlockRef>, Vec<SurfaceRef>, Vec<SurfaceRef>) {
         let surfaces =
             self.optimize_surfaces(transaction.surfaces.into_iter().map(|(_, surface)| surface));
         let mut blocks: Vec<_> = transaction
@@ -330,82 +513,164 @@ impl Runtime {
         // remove orphaned objects
         self.garbage_collect();
 
-        (new_block_ids, sorted_surfaces)
+        (new_block_ids, new_surface_ids, sorted_surfaces)
     }
 
     fn codegen_blocks(&mut self, block_ids: &[BlockRef]) {
+        // Symbols are named after the cache key, so the new code can be deployed alongside the old
+        // code. Blocks whose key hasn't changed keep the module that's already there.
+        let mut new_blocks = Vec::new();
         for &block_id in block_ids {
-            let block = &self.block_mirs[&block_id];
+            let cache_key = disk_cache::block_key(&self.target, &self.block_mirs[&block_id]);
+            let pending = self.pending_commit.get_or_insert_with(PendingCommit::default);
+            if Runtime::retire_module(
+                &mut self.block_modules,
+                &mut pending.removed_blocks,
+                block_id,
+                cache_key,
+            ) {
+                new_blocks.push((block_id, cache_key));
+            }
+        }
 
-            let module_id = if let Entry::Occupied(old_module) = self.block_modules.entry(block_id)
-            {
-                old_module.get().key
-            } else {
-                None
-            };
+        let mut build_ids = Vec::new();
+        for &(block_id, cache_key) in &new_blocks {
+            let name = disk_cache::module_name("block", cache_key);
+
+            // Blocks that are in the object cache don't need to be built, the JIT loads the
+            // compiled object instead of the empty module.
+            if !disk_cache::contains(&name) {
+                build_ids.push(block_id);
+            }
 
-            let module = RuntimeModule::new(
-                Runtime::create_module(
-                    &self.context,
-                    &self.target,
-                    &format!("block.{}.{}", block.id.id, block.id.debug_name),
-                ),
-                module_id,
+            let module = Runtime::create_module(&self.context, &self.target, &name);
+            self.block_modules
+                .insert(block_id, RuntimeModule::new(module, None, cache_key));
+        }
+        let worker_count = block_codegen::worker_count(build_ids.len());
+
+        // blocks are independent of each other, so if there are enough of them we build them on
+        // several threads
+        if worker_count > 1 {
+            let build_blocks: Vec<_> = build_ids
+                .iter()
+                .map(|id| {
+                    let cache_key = self.block_modules[id].cache_key;
+                    (
+                        &self.block_mirs[id],
+                        disk_cache::module_name("block", cache_key),
+                        cache_key,
+                    )
+                }).collect();
+            let built_modules = block_codegen::build_parallel(
+                self.target.include_ui,
+                self.target.min_size,
+                &build_blocks,
+                worker_count,
+                Runtime::create_module,
             );
-            block::build_funcs(&module.module, self, block);
-            self.optimizer.optimize_module(&module.module);
-            self.block_modules.insert(block_id, module);
+            for (id, built_module) in build_ids.iter().zip(built_modules.into_iter()) {
+                let runtime_module = self.block_modules.get_mut(id).unwrap();
+                runtime_module.module = built_module.module;
+                runtime_module.worker_context = Some(built_module.context);
+            }
+        } else {
+            for id in &build_ids {
+                let module = &self.block_modules[id].module;
+                block::build_funcs(module, self, &self.block_mirs[id]);
+                self.optimizer.optimize_module(module);
+            }
         }
     }
 
     fn codegen_surfaces(&mut self, surface_ids: &[SurfaceRef]) {
         for &surface_id in surface_ids {
-            let surface = &self.surface_mirs[&surface_id];
-
-            let module_id =
-                if let Entry::Occupied(old_module) = self.surface_modules.entry(surface_id) {
-                    old_module.get().key
-                } else {
-                    None
-                };
-
-            let module = RuntimeModule::new(
-                Runtime::create_module(
-                    &self.context,
-                    &self.target,
-                    &format!("surface.{}.{}", surface.id.id, surface.id.debug_name),
-                ),
-                module_id,
-            );
-            surface::build_funcs(&module.module, self, surface);
-            self.optimizer.optimize_module(&module.module);
-            self.surface_modules.insert(surface_id, module);
+            // surfaces are sorted so the modules of everything inside have already been built
+            let cache_key = {
+                let deps = self.graph.get_surface_deps(surface_id).unwrap();
+                let dep_keys: Vec<_> = deps
+                    .depends_on_surfaces
+                    .iter()
+                    .map(|dep| self.surface_modules[dep].cache_key)
+                    .chain(
+                        deps.depends_on_blocks
+                            .iter()
+                            .map(|dep| self.block_modules[dep].cache_key),
+                    ).collect();
+                disk_cache::surface_key(&self.target, &self.surface_mirs[&surface_id], &dep_keys)
+            };
+
+            let pending = self.pending_commit.get_or_insert_with(PendingCommit::default);
+            if !Runtime::retire_module(
+                &mut self.surface_modules,
+                &mut pending.removed_surfaces,
+                surface_id,
+                cache_key,
+            ) {
+                continue;
+            }
+
+            let module_name = disk_cache::module_name("surface", cache_key);
+            let module = Runtime::create_module(&self.context, &self.target, &module_name);
+            self.surface_modules
+                .insert(surface_id, RuntimeModule::new(module, None, cache_key));
+            if !disk_cache::contains(&module_name) {
+                let module = &self.surface_modules[&surface_id].module;
+                surface::build_funcs(module, self, &self.surface_mirs[&surface_id]);
+                self.optimizer.optimize_module(module);
+            }
         }
     }
 
-    fn codegen_root(&self, root: &Root) -> Module {
+    fn codegen_root(&self, root: &Root, instance: u64) -> Module {
         let module = Runtime::create_module(&self.context, &self.target, "root");
-        let initialized_global =
-            root::build_initialized_global(&module, self, 0, INITIALIZED_GLOBAL_NAME);
-        let scratch_global = root::build_scratch_global(&module, self, 0, SCRATCH_GLOBAL_NAME);
-        let sockets_global =
-            root::build_sockets_global(&module, root, SOCKETS_GLOBAL_NAME, PORTALS_GLOBAL_NAME);
+        let initialized_global = root::build_initialized_global(
+            &module,
+            self,
+            0,
+            &get_root_symbol_name(instance, INITIALIZED_GLOBAL_NAME),
+        );
+        let scratch_global = root::build_scratch_global(
+            &module,
+            self,
+            0,
+            &get_root_symbol_name(instance, SCRATCH_GLOBAL_NAME),
+        );
+        let sockets_global = root::build_sockets_global(
+            &module,
+            root,
+            &get_root_symbol_name(instance, SOCKETS_GLOBAL_NAME),
+            &get_root_symbol_name(instance, PORTALS_GLOBAL_NAME),
+        );
         let pointers_global = root::build_pointers_global(
             &module,
             self,
             0,
-            POINTERS_GLOBAL_NAME,
+            &get_root_symbol_name(instance, POINTERS_GLOBAL_NAME),
             initialized_global.as_pointer_value(),
             scratch_global.as_pointer_value(),
             sockets_global.sockets.as_pointer_value(),
         );
+        let update_func_name = get_root_symbol_name(instance, UPDATE_FUNC_NAME);
         root::build_funcs(
             &module,
             self,
             0,
-            CONSTRUCT_FUNC_NAME,
-            UPDATE_FUNC_NAME,
-            DESTRUCT_FUNC_NAME,
+            &get_root_symbol_name(instance, CONSTRUCT_FUNC_NAME),
+            &update_func_name,
+            &get_root_symbol_name(instance, DESTRUCT_FUNC_NAME),
+            pointers_global.as_pointer_value(),
+        );
+        root::build_update_block_func(
+            &module,
+            self,
+            root,
+            &get_root_symbol_name(instance, UPDATE_BLOCK_FUNC_NAME),
+            &update_func_name,
+            &get_root_symbol_name(instance, VOICES_FUNC_NAME),
+            initialized_global.as_pointer_value(),
+            scratch_global.as_pointer_value(),
+            sockets_global.sockets.as_pointer_value(),
             pointers_global.as_pointer_value(),
         );
         self.optimizer.optimize_module(&module);
@@ -420,7 +685,9 @@ impl Runtime {
         self.codegen_blocks(new_block_ids);
         self.codegen_surfaces(affected_surfaces);
 
-        self.root.1.module = self.codegen_root(&self.root.0);
+        // the root is always rebuilt, so the last instance built is the one that gets deployed
+        self.root_instance += 1;
+        self.root.1.module = self.codegen_root(&self.root.0, self.root_instance);
     }
 
     fn deploy_transaction(&mut self, block_ids: &[BlockRef], affected_surfaces: &[SurfaceRef]) {
@@ -430,12 +697,21 @@ impl Runtime {
         for surface in affected_surfaces {
             Runtime::deploy_module(&self.jit, self.surface_modules.get_mut(surface).unwrap());
         }
-
         Runtime::deploy_module(&self.jit, &mut self.root.1);
-        self.runtime_pointers = Some(RuntimePointers::new(&self.jit));
     }
 
+    /// Prepares, finishes, publishes and waits for a commit, see the functions for each step.
     pub fn commit(&mut self, transaction: Transaction) {
+        self.prepare_commit(transaction);
+        self.finish_commit();
+        self.publish_commit();
+        self.wait_for_commit();
+    }
+
+    /// Patches, generates and optimizes the modules for a transaction without touching anything
+    /// the currently deployed code uses. The commit takes effect once it's been finished,
+    /// published and waited for.
+    pub fn prepare_commit(&mut self, transaction: Transaction) {
         // if the transaction is empty, early exit
         if transaction.surfaces.is_empty()
             && transaction.blocks.is_empty()
@@ -444,82 +720,248 @@ impl Runtime {
             return;
         }
 
-        // run destructors on old data before beginning
-        if let Some(ref pointers) = self.runtime_pointers {
-            unsafe {
-                (pointers.destruct)();
-            }
-        }
-
         let patch_start = Instant::now();
-        let (new_block_ids, affected_surfaces) = self.patch_transaction(transaction);
-        println!(
-            "Patch took {}s",
-            precise_duration_seconds(&patch_start.elapsed())
-        );
+        let (new_block_ids, new_surface_ids, affected_surfaces) =
+            self.patch_transaction(transaction);
+        let patch_seconds = precise_duration_seconds(&patch_start.elapsed());
+        println!("Patch took {}s", patch_seconds);
+        self.commit_stats.patch_seconds += patch_seconds;
 
         let codegen_start = Instant::now();
         self.codegen_transaction(&new_block_ids, &affected_surfaces);
-        println!(
-            "Codegen took {}s",
-            precise_duration_seconds(&codegen_start.elapsed())
-        );
+        let codegen_seconds = precise_duration_seconds(&codegen_start.elapsed());
+        println!("Codegen took {}s", codegen_seconds);
+        self.commit_stats.codegen_seconds += codegen_seconds;
+
+        let pending = self.pending_commit.get_or_insert_with(PendingCommit::default);
+        pending.changed_surface_ids.extend(new_surface_ids);
+        for block_id in new_block_ids {
+            if !pending.block_ids.contains(&block_id) {
+                pending.block_ids.push(block_id);
+            }
+        }
+        for surface_id in affected_surfaces {
+            if !pending.surface_ids.contains(&surface_id) {
+                pending.surface_ids.push(surface_id);
+            }
+        }
+
+        // Modules that were garbage collected may have been regenerated by a later transaction,
+        // and modules that haven't changed are kept as they are.
+        let block_modules = &self.block_modules;
+        let surface_modules = &self.surface_modules;
+        pending
+            .block_ids
+            .retain(|id| block_modules.get(id).map_or(false, |module| module.key.is_none()));
+        pending
+            .surface_ids
+            .retain(|id| surface_modules.get(id).map_or(false, |module| module.key.is_none()));
+    }
+
+    /// Deploys the code built by `prepare_commit` to the JIT, next to the code that's running.
+    /// Nothing the player uses is touched, so this can be called while it's running. The new
+    /// instance of the root can be used once it's been published with `publish_commit`.
+    pub fn finish_commit(&mut self) {
+        // commits are handed to the player in order
+        self.publish_commit();
+        self.wait_for_commit();
+
+        let mut pending = if let Some(pending) = self.pending_commit.take() {
+            pending
+        } else {
+            return;
+        };
 
         let deploy_start = Instant::now();
-        self.deploy_transaction(&new_block_ids, &affected_surfaces);
-        println!(
-            "Deploy took {}s",
-            precise_duration_seconds(&deploy_start.elapsed())
-        );
+        let old_root_key = self.root.1.key.take();
+        self.deploy_transaction(&pending.block_ids, &pending.surface_ids);
+        let pointers = RuntimePointers::new(&self.jit, self.root_instance);
+        let deploy_seconds = precise_duration_seconds(&deploy_start.elapsed());
+        println!("Deploy took {}s", deploy_seconds);
+        self.commit_stats.deploy_seconds += deploy_seconds;
+        self.commit_stats.commit_count += 1;
+
+        // Blocks that haven't changed and are still in the tree keep their state, including
+        // function state like delay buffers. They share their code between the old and new
+        // instances, so setting their migrate flags stops the old instance from destructing the
+        // state and the new one from constructing over it.
+        let new_state_map = StateMap::build(self, 0);
+        let migrate_blocks: Vec<_> = if self.runtime_pointers.is_some() {
+            self.state_map
+                .matching_blocks(&new_state_map)
+                .into_iter()
+                .filter(|block| !pending.block_ids.contains(block))
+                .map(|block| {
+                    let flag_name =
+                        block::get_migrate_global_name(block, self.block_version(block));
+                    (block, self.jit.get_symbol_address(&flag_name) as *mut bool)
+                }).filter(|(_, flag)| !flag.is_null())
+                .collect()
+        } else {
+            Vec::new()
+        };
+
+        // Group values in surfaces that have changed are left for the editor to restore.
+        let state_copies = self.state_map.plan_copies(&new_state_map, |key| match key {
+            StateKey::Group(surface, _) => !pending.changed_surface_ids.contains(surface),
+            StateKey::BlockScratch(block) | StateKey::BlockShared(block) => migrate_blocks
+                .iter()
+                .any(|(migrate_block, _)| migrate_block == block),
+        });
+        self.state_map = new_state_map;
+
+        let removed_keys = pending
+            .removed_blocks
+            .drain()
+            .filter_map(|(_, module)| module.key)
+            .chain(
+                pending
+                    .removed_surfaces
+                    .drain()
+                    .filter_map(|(_, module)| module.key),
+            ).chain(old_root_key)
+            .collect();
 
         // reset the BPM and sample rate
-        Runtime::set_vector(self.library_pointers.bpm_ptr, self.bpm);
-        Runtime::set_vector(self.library_pointers.samplerate_ptr, self.sample_rate);
+        self.player.reset_globals();
+        self.set_voice_sleep(self.sleep_threshold, self.sleep_samples);
+        self.set_control_rate_interval(self.control_rate_interval);
+
+        // The new instance is constructed here, off the audio thread, while the old one keeps
+        // running. The worker pool is filled in when the commit is published, in case it's
+        // changed by then.
+        let switch = Box::new(PlayerSwitch {
+            instance: Some(pointers),
+            migrate_flags: migrate_blocks.into_iter().map(|(_, flag)| flag).collect(),
+            state_copies,
+            worker_pool: ptr::null(),
+        });
+        self.player.prepare(&switch);
+        self.staged_commit = Some(StagedCommit {
+            switch,
+            pointers,
+            removed_keys,
+        });
+    }
 
-        if let Some(ref pointers) = self.runtime_pointers {
-            // run the new constructor
-            unsafe {
-                (pointers.construct)();
-            }
+    /// Switches the player to the instance deployed and constructed by `finish_commit`, between
+    /// two blocks. This only copies the state that's kept and swaps pointers, so it can be done
+    /// while changing anything else the audio thread reads at the same time. `get_root_ptr` and
+    /// `get_portal_ptr` point into the new instance from now on.
+    pub fn publish_commit(&mut self) {
+        let mut staged = if let Some(staged) = self.staged_commit.take() {
+            staged
+        } else {
+            return;
+        };
+
+        staged.switch.worker_pool = self.worker_pool_ptr();
+
+        self.runtime_pointers = Some(staged.pointers);
+        self.player.apply(&mut staged.switch);
+        self.published_commit = Some((staged.switch, staged.removed_keys));
+    }
+
+    /// Destructs the instance replaced by `publish_commit`, then removes the code it ran from the
+    /// JIT. This should be done after anything the audio thread could be waiting for is released.
+    pub fn wait_for_commit(&mut self) {
+        let (mut switch, removed_keys) = if let Some(published) = self.published_commit.take() {
+            published
+        } else {
+            return;
+        };
+
+        self.player.reclaim(&mut switch);
+        for key in removed_keys {
+            self.jit.remove(key);
+        }
+        self.report_heap_allocs();
+    }
+
+    // Generated code falls back to the heap on the audio thread once the arena is full, which
+    // still works but can glitch, so it's logged here rather than where it happens.
+    fn report_heap_allocs(&mut self) {
+        let heap_allocs = self.arena.heap_allocs();
+        if heap_allocs > self.reported_heap_allocs {
+            eprintln!(
+                "Arena is full, {} blocks were allocated from the heap ({} of {} bytes used)",
+                heap_allocs - self.reported_heap_allocs,
+                self.arena.used_bytes(),
+                self.arena.capacity_bytes()
+            );
+            self.reported_heap_allocs = heap_allocs;
+        }
+    }
+
+    /// Returns the time spent committing since the last call, and resets it.
+    pub fn take_commit_stats(&mut self) -> CommitStats {
+        mem::replace(&mut self.commit_stats, CommitStats::default())
+    }
+
+    /// Returns true if the surface has changed in the commit that's waiting to be finished, so any
+    /// state in it won't be kept.
+    pub fn is_surface_changed(&self, surface: SurfaceRef) -> bool {
+        match self.pending_commit {
+            Some(ref pending) => pending.changed_surface_ids.contains(&surface),
+            None => false,
+        }
+    }
+
+    /// Returns true if the block has changed in the commit that's waiting to be finished, so any
+    /// state in it won't be kept.
+    pub fn is_block_changed(&self, block: BlockRef) -> bool {
+        match self.pending_commit {
+            Some(ref pending) => pending.block_ids.contains(&block),
+            None => false,
         }
     }
 
-    /// Remove any objects that aren't referenced by others (and aren't the root).
+    /// Remove any objects that aren't referenced by others (and aren't the root). The deployed code
+    /// for removed objects is kept in the JIT until the player has stopped running it.
     pub fn garbage_collect(&mut self) {
-        let graph = &self.graph;
-        let surface_mirs = &mut self.surface_mirs;
-        let surface_layouts = &mut self.surface_layouts;
-        let block_mirs = &mut self.block_mirs;
-        let block_layouts = &mut self.block_layouts;
-        let jit = &self.jit;
+        let removed_surfaces: Vec<_> = self
+            .surface_modules
+            .keys()
+            .cloned()
+            .filter(|&key| self.graph.get_surface_deps(key).is_none())
+            .collect();
+        let removed_blocks: Vec<_> = self
+            .block_modules
+            .keys()
+            .cloned()
+            .filter(|&key| self.graph.get_block_deps(key).is_none())
+            .collect();
+        let pending = self.pending_commit.get_or_insert_with(PendingCommit::default);
 
         // we can now remove any objects that don't exist in the graph
-        self.surface_modules.retain(|&key, module| {
-            if graph.get_surface_deps(key).is_some() {
-                true
-            } else {
-                surface_mirs.remove(&key);
-                surface_layouts.remove(&key);
-                Runtime::remove_module(jit, module);
-                false
+        for key in removed_surfaces {
+            self.surface_mirs.remove(&key);
+            self.surface_layouts.remove(&key);
+            let module = self.surface_modules.remove(&key).unwrap();
+            if module.key.is_some() {
+                pending.removed_surfaces.insert(key, module);
             }
-        });
-        self.block_modules.retain(|&key, module| {
-            if graph.get_block_deps(key).is_some() {
-                true
-            } else {
-                block_mirs.remove(&key);
-                block_layouts.remove(&key);
-                Runtime::remove_module(jit, module);
-                false
+        }
+        for key in removed_blocks {
+            self.block_mirs.remove(&key);
+            self.block_layouts.remove(&key);
+            let module = self.block_modules.remove(&key).unwrap();
+            if module.key.is_some() {
+                pending.removed_blocks.insert(key, module);
             }
-        });
+        }
     }
 
-    pub unsafe fn run_update(&self) {
-        if let Some(ref pointers) = self.runtime_pointers {
-            (pointers.update)();
-        }
+    /// Returns the part of the runtime that runs the deployed code. It can be used from the audio
+    /// thread without locking anything, and lives as long as the runtime.
+    pub fn player(&self) -> *const Player {
+        &*self.player
+    }
+
+    /// Returns the number of allocations generated code has made from the system allocator
+    /// because the arena was full.
+    pub fn arena_heap_allocs(&self) -> u64 {
+        self.arena.heap_allocs()
     }
 
     pub fn get_root_ptr(&self) -> *mut c_void {
@@ -539,30 +981,129 @@ impl Runtime {
         }
     }
 
-    fn set_vector(ptr: *mut c_void, value: f32) {
-        let vec_ptr = ptr as *mut (f32, f32);
+    /// Returns the root, blocks and surfaces of everything that has been committed, or None if
+    /// the root surface hasn't been committed yet. Surfaces are ordered so that each comes after
+    /// any surfaces it contains.
+    pub fn committed_mir(&self) -> Option<(&Root, Vec<&Block>, Vec<&Surface>)> {
+        if !self.surface_mirs.contains_key(&0) {
+            return None;
+        }
+
+        let surface_ids = HashSet::from_iter(self.surface_mirs.keys().cloned());
+        let mut sorted_surfaces = self.graph.get_sorted_surfaces(&surface_ids);
+        sorted_surfaces.reverse();
+
+        Some((
+            &self.root.0,
+            self.block_mirs.values().collect(),
+            sorted_surfaces
+                .iter()
+                .map(|id| &self.surface_mirs[id])
+                .collect(),
+        ))
+    }
+
+    /// Sets how quiet the outputs of a voice in an extracted group must be, and for how many
+    /// samples, before it's put to sleep until it gets a MIDI event. Zero samples disables sleeping.
+    pub fn set_voice_sleep(&mut self, threshold: f32, samples: u32) {
+        self.sleep_threshold = threshold;
+        self.sleep_samples = samples;
         unsafe {
-            (*vec_ptr).0 = value;
-            (*vec_ptr).1 = value;
+            *self.library_pointers.sleep_threshold_ptr = threshold;
+            *self.library_pointers.sleep_samples_ptr = samples;
         }
     }
 
-    pub fn set_bpm(&mut self, bpm: f32) {
-        self.bpm = bpm;
-        Runtime::set_vector(self.library_pointers.bpm_ptr, bpm);
+    /// Returns the number of voice updates that have been skipped because the voice was asleep
+    /// since the last call, and resets it.
+    pub fn take_slept_voice_updates(&mut self) -> u64 {
+        // generated code adds to the counter atomically, since voices can run on several threads
+        let slept_updates =
+            unsafe { &*(self.library_pointers.slept_updates_ptr as *const AtomicU64) };
+        slept_updates.swap(0, Ordering::Relaxed)
+    }
+
+    /// Sets the most samples that code depending only on control values, globals and MIDI notes
+    /// can go without being re-run after one of them changes. An interval of one keeps every
+    /// change sample-accurate, and zero is treated as one.
+    pub fn set_control_rate_interval(&mut self, interval: u32) {
+        self.control_rate_interval = interval.max(1);
+        unsafe {
+            *self.library_pointers.control_rate_interval_ptr = self.control_rate_interval;
+        }
     }
 
-    pub fn get_bpm(&self) -> f32 {
-        self.bpm
+    /// Sets how many worker threads the voices of extracted groups are spread across, on top of the
+    /// thread the runtime is updated from. Zero updates every voice on that thread.
+    pub fn set_worker_threads(&mut self, thread_count: usize) {
+        let current_count = self
+            .worker_pool
+            .as_ref()
+            .map(|pool| pool.thread_count())
+            .unwrap_or(0);
+        if thread_count == current_count {
+            return;
+        }
+
+        // the player has to stop using the old pool before it's dropped
+        self.publish_commit();
+        self.wait_for_commit();
+        let old_pool = mem::replace(
+            &mut self.worker_pool,
+            if thread_count == 0 {
+                None
+            } else {
+                Some(Box::new(WorkerPool::new(thread_count)))
+            },
+        );
+        self.player.switch(&mut PlayerSwitch {
+            instance: None,
+            migrate_flags: Vec::new(),
+            state_copies: Vec::new(),
+            worker_pool: self.worker_pool_ptr(),
+        });
+        drop(old_pool);
     }
 
-    pub fn set_sample_rate(&mut self, sample_rate: f32) {
-        self.sample_rate = sample_rate;
-        Runtime::set_vector(self.library_pointers.samplerate_ptr, sample_rate);
+    fn worker_pool_ptr(&self) -> *const WorkerPool {
+        match self.worker_pool {
+            Some(ref pool) => &**pool as *const WorkerPool,
+            None => ptr::null(),
+        }
     }
 
-    pub fn get_sample_rate(&self) -> f32 {
-        self.sample_rate
+    /// Runs one of the runtime library's math functions over `a` (and `b`, for two-argument
+    /// functions) and writes the results to `out`. This goes through the same JIT-compiled code
+    /// that blocks call, so it can be used to check accuracy and speed against libm.
+    pub fn eval_math(
+        &self,
+        function: math::MathFunction,
+        accuracy: math::MathAccuracy,
+        a: &[f32],
+        b: &[f32],
+        out: &mut [f32],
+    ) {
+        type MathArrayFunc = unsafe extern "C" fn(*const f32, *const f32, *mut f32, u32);
+        let func_address = self
+            .jit
+            .get_symbol_address(&math::get_array_func_name(function, accuracy));
+        let func: MathArrayFunc = unsafe { mem::transmute(func_address as usize) };
+
+        // the functions work on pairs of values, so an odd value at the end is padded out
+        let pair_count = out.len() / 2;
+        let pairs_len = pair_count * 2;
+        unsafe {
+            func(a.as_ptr(), b.as_ptr(), out.as_mut_ptr(), pair_count as u32);
+        }
+        if pairs_len < out.len() {
+            let tail_a = [a[pairs_len], 0.];
+            let tail_b = [b.get(pairs_len).cloned().unwrap_or(0.), 0.];
+            let mut tail_out = [0.; 2];
+            unsafe {
+                func(tail_a.as_ptr(), tail_b.as_ptr(), tail_out.as_mut_ptr(), 1);
+            }
+            out[pairs_len] = tail_out[0];
+        }
     }
 
     pub fn is_node_extracted(&self, surface: SurfaceRef, node: usize) -> bool {
@@ -629,23 +1170,35 @@ impl ObjectCache for Runtime {
     fn block_layout(&self, id: BlockRef) -> Option<&data_analyzer::BlockLayout> {
         self.block_layouts.get(&id)
     }
+
+    fn surface_version(&self, id: SurfaceRef) -> u64 {
+        self.surface_modules
+            .get(&id)
+            .map(|module| module.cache_key)
+            .unwrap_or(0)
+    }
+
+    fn block_version(&self, id: BlockRef) -> u64 {
+        self.block_modules
+            .get(&id)
+            .map(|module| module.cache_key)
+            .unwrap_or(0)
+    }
 }
 
 impl IdAllocator for Runtime {
     fn alloc_id(&mut self) -> u64 {
-        let take_id = self.next_id;
-        self.next_id += 1;
-        take_id
+        self.player.alloc_id()
     }
 }
 
 impl Drop for Runtime {
     fn drop(&mut self) {
-        if let Some(ref pointers) = self.runtime_pointers {
-            unsafe {
-                (pointers.destruct)();
-            }
-        }
+        // the instance has to be destructed before the JIT and arena are dropped, including one
+        // that's been constructed but not published yet
+        self.publish_commit();
+        self.wait_for_commit();
+        self.player.shutdown();
     }
 }
 
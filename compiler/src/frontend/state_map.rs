@@ -0,0 +1,275 @@
+use codegen::{data_analyzer, ObjectCache};
+use inkwell::targets::TargetData;
+use inkwell::types::StructType;
+use mir::{BlockRef, NodeData, SurfaceRef, ValueGroupSource};
+use std::collections::HashMap;
+use std::os::raw::c_void;
+use std::ptr;
+
+// State that can be carried over between commits by copying it into the new runtime's memory.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum StateKey {
+    // The value of a group in a surface, which contains the values of controls on the surface.
+    Group(SurfaceRef, usize),
+
+    // The scratch data of a block, including function state. This can own memory, so it must be
+    // moved instead of copied: the block mustn't be destructed or constructed when it's migrated.
+    BlockScratch(BlockRef),
+
+    // The shared data of the controls in a block, e.g. the curves in a graph control.
+    BlockShared(BlockRef),
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum StateMemory {
+    Initialized,
+    Scratch,
+}
+
+#[derive(Debug, Clone, Copy)]
+pub struct StateRegion {
+    pub memory: StateMemory,
+    pub offset: u64,
+    pub size: u64,
+}
+
+#[derive(Debug, Clone, Copy)]
+struct SurfaceOffsets {
+    initialized: u64,
+    scratch: u64,
+    shared: u64,
+}
+
+/// Locations of relocatable state in the runtime's memory. Each surface and block is only used
+/// once in the tree, so its state can be found by ID.
+#[derive(Debug, Default)]
+pub struct StateMap {
+    regions: HashMap<StateKey, StateRegion>,
+}
+
+/// A region of state to copy from one runtime's memory to another's.
+#[derive(Debug, Clone, Copy)]
+pub struct StateCopy {
+    from: StateRegion,
+    to: StateRegion,
+}
+
+fn element_offset(target_data: &TargetData, struct_type: &StructType, index: usize) -> u64 {
+    target_data
+        .offset_of_element(struct_type, index as u32)
+        .unwrap()
+}
+
+fn region_ptr(region: &StateRegion, initialized: *mut c_void, scratch: *mut c_void) -> *mut u8 {
+    let base = match region.memory {
+        StateMemory::Initialized => initialized,
+        StateMemory::Scratch => scratch,
+    };
+    if base.is_null() {
+        ptr::null_mut()
+    } else {
+        unsafe { (base as *mut u8).offset(region.offset as isize) }
+    }
+}
+
+impl StateMap {
+    pub fn build(cache: &ObjectCache, root_surface: SurfaceRef) -> Self {
+        let mut map = StateMap::default();
+        if let Some(root_layout) = cache.surface_layout(root_surface) {
+            // the root surface's shared data is stored after the scratch, see `build_scratch_global`
+            let target_data = cache.target().machine.get_data();
+            let virtual_scratch = cache.context().struct_type(
+                &[&root_layout.scratch_struct, &root_layout.shared_struct],
+                false,
+            );
+            let offsets = SurfaceOffsets {
+                initialized: 0,
+                scratch: 0,
+                shared: element_offset(&target_data, &virtual_scratch, 1),
+            };
+            map.add_surface(cache, &target_data, root_surface, offsets);
+        }
+        map
+    }
+
+    fn add_surface(
+        &mut self,
+        cache: &ObjectCache,
+        target_data: &TargetData,
+        surface: SurfaceRef,
+        offsets: SurfaceOffsets,
+    ) {
+        let surface_mir = cache.surface_mir(surface).unwrap();
+        let layout = cache.surface_layout(surface).unwrap();
+        let initialized_type = layout.initialized_const.get_type();
+
+        // groups are laid out in the same order as `build_surface_layout`
+        let mut scratch_index = 0;
+        let mut initialized_index = 0;
+        for (group_index, group) in surface_mir.groups.iter().enumerate() {
+            let (memory, base, struct_type, index) = match group.source {
+                ValueGroupSource::None => {
+                    scratch_index += 1;
+                    (
+                        StateMemory::Scratch,
+                        offsets.scratch,
+                        &layout.scratch_struct,
+                        scratch_index - 1,
+                    )
+                }
+                ValueGroupSource::Default(_) => {
+                    initialized_index += 1;
+                    (
+                        StateMemory::Initialized,
+                        offsets.initialized,
+                        &initialized_type,
+                        initialized_index - 1,
+                    )
+                }
+
+                // socket groups are stored in the parent surface
+                ValueGroupSource::Socket(_) => continue,
+            };
+
+            let field_type = struct_type.get_field_type_at_index(index as u32).unwrap();
+            self.regions.insert(
+                StateKey::Group(surface, group_index),
+                StateRegion {
+                    memory,
+                    offset: base + element_offset(target_data, struct_type, index),
+                    size: target_data.get_abi_size(&field_type),
+                },
+            );
+        }
+
+        for (node_index, node) in surface_mir.nodes.iter().enumerate() {
+            let node_scratch = offsets.scratch
+                + element_offset(
+                    target_data,
+                    &layout.scratch_struct,
+                    layout.node_scratch_index(node_index),
+                );
+            let node_shared = offsets.shared
+                + element_offset(
+                    target_data,
+                    &layout.shared_struct,
+                    layout.node_shared_index(node_index),
+                );
+
+            match node.data {
+                NodeData::Custom(block) => {
+                    self.add_block(cache, target_data, block, node_scratch, node_shared)
+                }
+                NodeData::Group(subsurface) => {
+                    // group nodes store the surface's shared data after its scratch data
+                    let subsurface_layout = cache.surface_layout(subsurface).unwrap();
+                    let node_scratch_type = cache.context().struct_type(
+                        &[
+                            &subsurface_layout.scratch_struct,
+                            &subsurface_layout.shared_struct,
+                        ],
+                        false,
+                    );
+                    let sub_offsets = SurfaceOffsets {
+                        initialized: offsets.initialized
+                            + element_offset(
+                                target_data,
+                                &initialized_type,
+                                layout.node_initialized_index(node_index),
+                            ),
+                        scratch: node_scratch,
+                        shared: node_scratch + element_offset(target_data, &node_scratch_type, 1),
+                    };
+                    self.add_surface(cache, target_data, subsurface, sub_offsets);
+                }
+
+                // Extracted surfaces are regenerated with new IDs whenever their parent changes,
+                // and voices aren't worth keeping anyway.
+                NodeData::ExtractGroup { .. } | NodeData::Dummy => {}
+            }
+        }
+    }
+
+    fn add_block(
+        &mut self,
+        cache: &ObjectCache,
+        target_data: &TargetData,
+        block: BlockRef,
+        scratch: u64,
+        shared: u64,
+    ) {
+        let layout = cache.block_layout(block).unwrap();
+        self.regions.insert(
+            StateKey::BlockScratch(block),
+            StateRegion {
+                memory: StateMemory::Scratch,
+                offset: scratch,
+                size: target_data.get_abi_size(&layout.scratch_struct),
+            },
+        );
+        self.regions.insert(
+            StateKey::BlockShared(block),
+            StateRegion {
+                memory: StateMemory::Scratch,
+                offset: shared,
+                size: target_data.get_abi_size(&layout.shared_struct),
+            },
+        );
+    }
+
+    /// Returns the blocks that are in both maps and take up the same space, so their state can be
+    /// moved from one to the other.
+    pub fn matching_blocks(&self, other: &StateMap) -> Vec<BlockRef> {
+        self.regions
+            .iter()
+            .filter_map(|(key, region)| match key {
+                StateKey::BlockScratch(block) => match other.regions.get(key) {
+                    Some(other_region) if other_region.size == region.size => Some(*block),
+                    _ => None,
+                },
+                _ => None,
+            }).collect()
+    }
+
+    /// Returns the regions of state that can be copied from memory laid out with this map into
+    /// memory laid out with `new_map`, skipping anything `is_kept` returns false for. Regions are
+    /// only copied if they still exist and are the same size. The copies are planned up front so
+    /// they can be made on the audio thread without allocating.
+    pub fn plan_copies(
+        &self,
+        new_map: &StateMap,
+        is_kept: impl Fn(&StateKey) -> bool,
+    ) -> Vec<StateCopy> {
+        self.regions
+            .iter()
+            .filter(|(key, region)| region.size > 0 && is_kept(key))
+            .filter_map(|(key, region)| match new_map.regions.get(key) {
+                Some(new_region) if new_region.size == region.size => Some(StateCopy {
+                    from: *region,
+                    to: *new_region,
+                }),
+                _ => None,
+            }).collect()
+    }
+}
+
+impl StateCopy {
+    /// Copies each region from one runtime's memory to another's.
+    pub unsafe fn apply(
+        copies: &[StateCopy],
+        from_initialized: *mut c_void,
+        from_scratch: *mut c_void,
+        to_initialized: *mut c_void,
+        to_scratch: *mut c_void,
+    ) {
+        for copy in copies {
+            let src = region_ptr(&copy.from, from_initialized, from_scratch);
+            let dest = region_ptr(&copy.to, to_initialized, to_scratch);
+            if src.is_null() || dest.is_null() {
+                continue;
+            }
+
+            ptr::copy_nonoverlapping(src, dest, copy.from.size as usize);
+        }
+    }
+}
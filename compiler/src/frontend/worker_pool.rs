@@ -0,0 +1,219 @@
+use std::hint;
+use std::mem;
+use std::os::raw::c_void;
+use std::sync::atomic::{AtomicBool, AtomicU32, AtomicU64, AtomicUsize, Ordering};
+use std::sync::Arc;
+use std::thread;
+use std::time::{Duration, Instant};
+
+// Once no voices have been dispatched for this long, workers park until the next dispatch instead
+// of spinning. The root dispatches once per chunk, so this only needs to cover the gap between
+// chunks in a block, not the gap between blocks.
+const IDLE_SPIN_TIME: Duration = Duration::from_micros(200);
+
+type ParallelDispatchFunc = unsafe extern "C" fn(*const c_void, u32) -> u8;
+type VoicesFunc = unsafe extern "C" fn(u32);
+
+extern "C" {
+    fn LLVMAxiomSetParallelDispatch(dispatch: ParallelDispatchFunc);
+}
+
+// The chunk of voices that's currently being updated, shared between the thread that dispatched it
+// and the workers.
+#[derive(Debug)]
+struct PoolState {
+    // Set while voices are being dispatched. Voices dispatched from another runtime thread at the
+    // same time are updated on the calling thread instead.
+    busy: AtomicBool,
+    stop: AtomicBool,
+
+    // The low 32 bits are the voices that haven't been claimed by a thread yet, and the high 32
+    // bits count the chunks that have been dispatched, so a thread that's fallen behind can't
+    // claim a voice from a later chunk.
+    claims: AtomicU64,
+
+    // Voices that haven't finished updating yet.
+    running: AtomicU32,
+
+    // The current root's function that updates one voice for a chunk, or zero if it has none.
+    voices_func: AtomicUsize,
+
+    // Set by each worker before it parks, so dispatching only unparks workers that need it.
+    parked: Vec<AtomicBool>,
+}
+
+impl PoolState {
+    // Claims and updates voices from the given chunk until there are none left to claim.
+    unsafe fn run_claimed(&self, job: u64) -> bool {
+        let mut claims = self.claims.load(Ordering::Acquire);
+        if claims >> 32 != job {
+            return false;
+        }
+
+        // this is only changed between blocks, when nothing is being dispatched
+        let voices_func: VoicesFunc = mem::transmute(self.voices_func.load(Ordering::Relaxed));
+
+        let mut ran_voice = false;
+        while claims >> 32 == job && claims as u32 != 0 {
+            let voice = (claims as u32).trailing_zeros();
+            let next_claims = claims & !(1 << voice);
+            match self.claims.compare_exchange_weak(
+                claims,
+                next_claims,
+                Ordering::Acquire,
+                Ordering::Acquire,
+            ) {
+                Ok(_) => {
+                    voices_func(voice);
+                    self.running.fetch_sub(1, Ordering::Release);
+                    ran_voice = true;
+                    claims = next_claims;
+                }
+                Err(actual_claims) => claims = actual_claims,
+            }
+        }
+        ran_voice
+    }
+}
+
+/// A pool of threads that the voices of an extracted group in the root can be updated on, so
+/// large polyphonic patches can use more than one core. The root hands the pool a chunk of frames
+/// at a time, see `parallel::VoiceSplit`. Voices are handed out one at a time to whichever thread
+/// asks first, including the thread that dispatched them, and the dispatching thread waits for
+/// them all to finish before carrying on with the rest of the graph.
+///
+/// Workers spin for a short while after each chunk so the next one in the block doesn't have to
+/// wake them, then park until they're needed again. Nothing is allocated or locked when
+/// dispatching.
+#[derive(Debug)]
+pub struct WorkerPool {
+    state: Arc<PoolState>,
+    workers: Vec<thread::JoinHandle<()>>,
+}
+
+impl WorkerPool {
+    pub fn new(thread_count: usize) -> Self {
+        unsafe {
+            LLVMAxiomSetParallelDispatch(dispatch);
+        }
+
+        let state = Arc::new(PoolState {
+            busy: AtomicBool::new(false),
+            stop: AtomicBool::new(false),
+            claims: AtomicU64::new(0),
+            running: AtomicU32::new(0),
+            voices_func: AtomicUsize::new(0),
+            parked: (0..thread_count).map(|_| AtomicBool::new(false)).collect(),
+        });
+        let workers = (0..thread_count)
+            .map(|index| {
+                let worker_state = state.clone();
+                thread::Builder::new()
+                    .name(format!("maxim worker {}", index))
+                    .spawn(move || run_worker(&worker_state, index))
+                    .unwrap()
+            }).collect();
+
+        WorkerPool { state, workers }
+    }
+
+    pub fn thread_count(&self) -> usize {
+        self.workers.len()
+    }
+
+    /// Sets the function voices are updated with, which moves whenever a new root is deployed.
+    /// With no function, every voice is updated on the dispatching thread.
+    ///
+    /// Nothing can be dispatching while this is called, so it's only done between blocks.
+    pub fn set_voices_func(&self, voices_func: Option<VoicesFunc>) {
+        self.state.voices_func.store(
+            voices_func.map(|func| func as usize).unwrap_or(0),
+            Ordering::Relaxed,
+        );
+    }
+}
+
+impl Drop for WorkerPool {
+    fn drop(&mut self) {
+        self.state.stop.store(true, Ordering::SeqCst);
+        for worker in self.workers.drain(..) {
+            worker.thread().unpark();
+            worker.join().unwrap();
+        }
+    }
+}
+
+fn run_worker(state: &PoolState, index: usize) {
+    let parked = &state.parked[index];
+    let mut last_work = Instant::now();
+    let mut idle_spins = 0u32;
+
+    while !state.stop.load(Ordering::Relaxed) {
+        let claims = state.claims.load(Ordering::Acquire);
+        if claims as u32 != 0 && unsafe { state.run_claimed(claims >> 32) } {
+            last_work = Instant::now();
+            idle_spins = 0;
+            continue;
+        }
+
+        // reading the clock is slower than a spin, so only check it every so often
+        idle_spins = idle_spins.wrapping_add(1);
+        if idle_spins % 256 != 0 || last_work.elapsed() < IDLE_SPIN_TIME {
+            hint::spin_loop();
+            continue;
+        }
+
+        // Dispatching stores the claims before checking the flag, and this sets the flag before
+        // checking the claims, so either the chunk is seen here or the worker is unparked.
+        parked.store(true, Ordering::SeqCst);
+        if state.claims.load(Ordering::SeqCst) as u32 == 0 && !state.stop.load(Ordering::SeqCst) {
+            thread::park();
+        }
+        parked.store(false, Ordering::Relaxed);
+        last_work = Instant::now();
+    }
+}
+
+// Called by generated code through the JIT's `maxim_parallel_dispatch` builtin.
+unsafe extern "C" fn dispatch(pool: *const c_void, voices: u32) -> u8 {
+    let pool = &*(pool as *const WorkerPool);
+    let state = &*pool.state;
+    if state.voices_func.load(Ordering::Relaxed) == 0 {
+        return 0;
+    }
+
+    if state
+        .busy
+        .compare_exchange(false, true, Ordering::Acquire, Ordering::Relaxed)
+        .is_err()
+    {
+        return 0;
+    }
+
+    state.running.store(voices.count_ones(), Ordering::Relaxed);
+    let job = ((state.claims.load(Ordering::Relaxed) >> 32) + 1) & 0xFFFF_FFFF;
+    state
+        .claims
+        .store((job << 32) | u64::from(voices), Ordering::SeqCst);
+
+    // only wake as many parked workers as there are voices for them to take
+    let mut wake_count = voices.count_ones().saturating_sub(1);
+    for (worker, parked) in pool.workers.iter().zip(state.parked.iter()) {
+        if wake_count == 0 {
+            break;
+        }
+        if parked.swap(false, Ordering::SeqCst) {
+            worker.thread().unpark();
+        }
+        wake_count -= 1;
+    }
+
+    // work through the voices here too, so nothing waits on a worker that's still waking up
+    state.run_claimed(job);
+    while state.running.load(Ordering::Acquire) != 0 {
+        hint::spin_loop();
+    }
+
+    state.busy.store(false, Ordering::Release);
+    1
+}
@@ -1,5 +1,6 @@
 extern crate divrem;
 extern crate inkwell;
+extern crate num_cpus;
 extern crate ordered_float;
 extern crate regex;
 
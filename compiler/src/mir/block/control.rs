@@ -6,6 +6,10 @@ pub struct Control {
     pub control_type: ControlType,
     pub value_written: bool,
     pub value_read: bool,
+
+    // Set when nothing outside the block can change the value while it runs: the control isn't
+    // connected or exposed, so only the editor writes to it between buffers.
+    pub value_static: bool,
 }
 
 impl Control {
@@ -20,6 +24,7 @@ impl Control {
             control_type,
             value_written,
             value_read,
+            value_static: false,
         }
     }
 }
@@ -146,6 +146,42 @@ impl Function {
         self.data().var_arg
     }
 
+    /// Pure functions keep no state between calls, so calling one with the same arguments always
+    /// gives the same result.
+    pub fn is_pure(&self) -> bool {
+        match self {
+            Function::Cos
+            | Function::Sin
+            | Function::Log
+            | Function::Log2
+            | Function::Log10
+            | Function::Sqrt
+            | Function::Ceil
+            | Function::Floor
+            | Function::Abs
+            | Function::Tan
+            | Function::Acos
+            | Function::Asin
+            | Function::Atan
+            | Function::Atan2
+            | Function::Hypot
+            | Function::ToRad
+            | Function::ToDeg
+            | Function::Clamp
+            | Function::CopySign
+            | Function::Pan
+            | Function::Left
+            | Function::Right
+            | Function::Swap
+            | Function::Combine
+            | Function::Mix
+            | Function::Sequence
+            | Function::Min
+            | Function::Max => true,
+            _ => false,
+        }
+    }
+
     pub fn required_args(&self) -> Vec<ParamType> {
         self.arg_types()
             .into_iter()
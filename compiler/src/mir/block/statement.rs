@@ -63,6 +63,25 @@ impl Statement {
         Statement::Constant(ConstantValue::Tuple(tuple))
     }
 
+    /// Returns the indexes of the statements this statement reads from.
+    pub fn refs(&self) -> Vec<usize> {
+        match self {
+            Statement::Constant(_) | Statement::Global(_) | Statement::LoadControl { .. } => {
+                Vec::new()
+            }
+            Statement::NumConvert { input, .. } => vec![*input],
+            Statement::NumCast { input, .. } => vec![*input],
+            Statement::NumUnaryOp { input, .. } => vec![*input],
+            Statement::NumMathOp { lhs, rhs, .. } => vec![*lhs, *rhs],
+            Statement::Extract { tuple, .. } => vec![*tuple],
+            Statement::Combine { indexes } => indexes.clone(),
+            Statement::CallFunc { args, varargs, .. } => {
+                args.iter().chain(varargs.iter()).cloned().collect()
+            }
+            Statement::StoreControl { value, .. } => vec![*value],
+        }
+    }
+
     pub fn has_side_effect(&self) -> bool {
         match self {
             Statement::Constant(_)
@@ -0,0 +1,79 @@
+use ast::UNDEF_SOURCE_RANGE;
+use mir::block::Statement;
+use mir::{Block, ConstantValue};
+use util::constant_propagate;
+
+/// Replaces statements whose inputs are all constant with the value they evaluate to. Blocks are
+/// already folded while they're lowered, so this only finds anything new once controls have been
+/// frozen. Statements that are no longer referenced are left for `remove_dead_code` to clean up.
+pub fn fold_constants(block: &mut Block) {
+    // statements only refer to ones before them, so a single pass folds whole chains
+    for index in 0..block.statements.len() {
+        if let Some(folded) = fold_statement(&block.statements, &block.statements[index]) {
+            block.statements[index] = Statement::Constant(folded);
+        }
+    }
+}
+
+fn get_constant(statements: &[Statement], index: usize) -> Option<&ConstantValue> {
+    match &statements[index] {
+        Statement::Constant(value) => Some(value),
+        _ => None,
+    }
+}
+
+fn fold_statement(statements: &[Statement], statement: &Statement) -> Option<ConstantValue> {
+    let get_num = |index: usize| get_constant(statements, index).and_then(|val| val.as_num());
+
+    match statement {
+        Statement::NumCast { target_form, input } => Some(ConstantValue::Num(
+            constant_propagate::const_cast(get_num(*input)?, *target_form),
+        )),
+        Statement::NumUnaryOp { op, input } => Some(ConstantValue::Num(
+            constant_propagate::const_unary_op(get_num(*input)?, *op),
+        )),
+        Statement::NumMathOp { op, lhs, rhs } => Some(ConstantValue::Num(
+            constant_propagate::const_math_op(get_num(*lhs)?, get_num(*rhs)?, *op),
+        )),
+        Statement::Extract { tuple, index } => match get_constant(statements, *tuple)? {
+            ConstantValue::Tuple(tuple_val) => {
+                constant_propagate::const_extract(tuple_val, *index, &UNDEF_SOURCE_RANGE)
+                    .ok()
+                    .cloned()
+            }
+            _ => None,
+        },
+        Statement::Combine { indexes } => {
+            let values: Option<Vec<_>> = indexes
+                .iter()
+                .map(|index| get_constant(statements, *index).cloned())
+                .collect();
+            Some(ConstantValue::Tuple(constant_propagate::const_combine(
+                values?,
+            )))
+        }
+        Statement::CallFunc {
+            function,
+            args,
+            varargs,
+        } => {
+            let const_args: Option<Vec<_>> = args
+                .iter()
+                .map(|index| get_constant(statements, *index).cloned())
+                .collect();
+            let const_varargs: Option<Vec<_>> = varargs
+                .iter()
+                .map(|index| get_constant(statements, *index).cloned())
+                .collect();
+
+            // lowering has already checked the argument types, so folding can't fail here
+            constant_propagate::const_call(
+                function,
+                &const_args?,
+                &const_varargs?,
+                &UNDEF_SOURCE_RANGE,
+            )?.ok()
+        }
+        _ => None,
+    }
+}
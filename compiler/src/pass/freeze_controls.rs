@@ -0,0 +1,36 @@
+use ast::{AudioField, ControlField, ControlType};
+use mir::block::Statement;
+use mir::{Block, ConstantNum, ConstantValue};
+
+/// Replaces every read of a num control's value with a constant, so anything computed from it
+/// can be folded. Controls the block writes to can't be frozen, since their value changes while
+/// the block runs, and false is returned without changing anything.
+///
+/// The control is kept so the block's layout doesn't change, it just isn't read any more.
+pub fn freeze_control(block: &mut Block, control: usize, value: ConstantNum) -> bool {
+    let can_freeze = match block.controls.get(control) {
+        Some(block_control) => {
+            block_control.control_type == ControlType::Audio && !block_control.value_written
+        }
+        None => false,
+    };
+    if !can_freeze {
+        return false;
+    }
+
+    for statement in &mut block.statements {
+        let is_frozen_load = match statement {
+            Statement::LoadControl {
+                control: load_control,
+                field: ControlField::Audio(AudioField::Value),
+            } => *load_control == control,
+            _ => false,
+        };
+
+        if is_frozen_load {
+            *statement = Statement::Constant(ConstantValue::Num(value.clone()));
+        }
+    }
+
+    true
+}
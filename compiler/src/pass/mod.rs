@@ -1,4 +1,6 @@
 mod flatten_groups;
+mod fold_constants;
+mod freeze_controls;
 mod group_extracted;
 mod lower_ast;
 mod order_nodes;
@@ -8,6 +10,8 @@ mod remove_dead_groups;
 mod remove_dead_sockets;
 
 pub use self::flatten_groups::flatten_groups;
+pub use self::fold_constants::fold_constants;
+pub use self::freeze_controls::freeze_control;
 pub use self::group_extracted::group_extracted;
 pub use self::lower_ast::lower_ast;
 pub use self::order_nodes::order_nodes;
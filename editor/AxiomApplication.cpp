@@ -37,4 +37,7 @@ AxiomApplication::AxiomApplication() : QApplication(argc, argv) {
 
     // ensure the data path exists
     QDir().mkpath(dataPath);
+
+    // compiled modules are cached in the data path, so unchanged modules load faster next time
+    MaximFrontend::maxim_set_object_cache_directory(QDir(dataPath).filePath("cache").toStdString().c_str());
 }
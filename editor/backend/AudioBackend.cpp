@@ -120,7 +120,7 @@ void AudioBackend::setSampleRate(float sampleRate) {
 }
 
 void AudioBackend::queueMidiEvent(uint64_t deltaFrames, size_t portalId, AxiomBackend::MidiEvent event) {
-    queuedEvents.push_back({deltaFrames, portalId, event});
+    queuedEvents.push(generatedSamples + deltaFrames, portalId, event);
 }
 
 void AudioBackend::clearMidi(size_t portalId) {
@@ -129,34 +129,46 @@ void AudioBackend::clearMidi(size_t portalId) {
 
 void AudioBackend::clearNotes(size_t portalId) {}
 
+void AudioBackend::queuePreviewEvent(size_t portalId, AxiomBackend::MidiEvent event) {
+    // frame 0 has always passed, so the event is input at the start of the next block
+    previewEvents.push(0, portalId, event);
+}
+
+uint64_t AudioBackend::droppedMidiEvents() const {
+    return queuedEvents.droppedCount() + previewEvents.droppedCount();
+}
+
 std::lock_guard<std::mutex> AudioBackend::lockRuntime() {
     return _editor->window()->project()->mainRoot().lockRuntime();
 }
 
-uint64_t AudioBackend::beginGenerate() {
-    // decrement all deltaFrames from last time
-    for (auto &event : queuedEvents) {
-        if (event.deltaFrames > generatedSamples) {
-            event.deltaFrames -= generatedSamples;
-        } else {
-            event.deltaFrames = 0;
-        }
+std::unique_lock<std::mutex> AudioBackend::tryLockRuntime() {
+    return _editor->window()->project()->mainRoot().tryLockRuntime();
+}
 
-        if (event.deltaFrames == 0) {
-            (*getMidiPortal(event.portalId))->pushEvent(event.event);
+uint64_t AudioBackend::inputDueEvents(MidiEventQueue &queue) {
+    while (auto queued = queue.peek()) {
+        if (queued->frame > generatedSamples) {
+            return queued->frame - generatedSamples;
+        }
 
-            // note: deque doesn't invalidate iterators when removing items from start or end, so this is safe to do.
-            queuedEvents.pop_front();
+        auto portal = getMidiPortal(queued->portalId);
+        if (portal && !(*portal)->pushEvent(queued->event)) {
+            // the portal is full for this sample, so leave the event queued and try again on the next one
+            return 1;
         }
+        queue.pop();
     }
-    generatedSamples = 0;
+
+    return UINT64_MAX;
+}
+
+uint64_t AudioBackend::beginGenerate() {
+    auto previewFrames = inputDueEvents(previewEvents);
+    auto queuedFrames = inputDueEvents(queuedEvents);
 
     // return number of samples to next event
-    if (queuedEvents.empty()) {
-        return UINT64_MAX;
-    } else {
-        return queuedEvents[0].deltaFrames;
-    }
+    return std::min(previewFrames, queuedFrames);
 }
 
 void AudioBackend::generate() {
@@ -164,6 +176,45 @@ void AudioBackend::generate() {
     _editor->window()->runtime()->runUpdate();
 }
 
+void AudioBackend::setPortalBuffers(size_t portalId, float *left, float *right) {
+    if (portalId >= portalSockets.size()) return;
+
+    auto bufferIndex = portalSockets[portalId] * 2;
+    switch (currentPortals[portalId].type) {
+    case PortalType::INPUT:
+        blockInputs[bufferIndex] = left;
+        blockInputs[bufferIndex + 1] = right;
+        break;
+    case PortalType::OUTPUT:
+        blockOutputs[bufferIndex] = left;
+        blockOutputs[bufferIndex + 1] = right;
+        break;
+    case PortalType::AUTOMATION:
+        break;
+    }
+}
+
+void AudioBackend::clearPortalBuffers() {
+    std::fill(blockInputs.begin(), blockInputs.end(), nullptr);
+    std::fill(blockOutputs.begin(), blockOutputs.end(), nullptr);
+}
+
+void AudioBackend::generateBlock(uint64_t frames) {
+    if (frames == 0) return;
+
+    generatedSamples += frames;
+    _editor->window()->runtime()->runBlock((uint32_t) frames, blockInputs.data(), blockOutputs.data(),
+                                           blockOutputs.size());
+
+    // advance the bound buffers so the next block continues where this one finished
+    for (auto &input : blockInputs) {
+        if (input) input += frames;
+    }
+    for (auto &output : blockOutputs) {
+        if (output) output += frames;
+    }
+}
+
 void AudioBackend::previewEvent(AxiomBackend::MidiEvent event) {}
 
 void AudioBackend::automationValueChanged(size_t portalId, AxiomBackend::NumValue value) {}
@@ -174,8 +225,8 @@ bool AudioBackend::canFiddleAutomation() const {
 
 void AudioBackend::internalUpdateConfiguration() {
     std::vector<ConfigurationPortal> newPortals;
-    assert(_editor->window()->project()->rootSurface()->compileMeta());
-    auto &compileMeta = *_editor->window()->project()->rootSurface()->compileMeta();
+    assert(_editor->window()->project()->rootSurface()->runtimeCompileMeta());
+    auto &compileMeta = *_editor->window()->project()->rootSurface()->runtimeCompileMeta();
 
     for (const auto &surfacePortal : compileMeta.portals) {
         PortalType newType;
@@ -209,10 +260,19 @@ void AudioBackend::internalUpdateConfiguration() {
     // update the value pointers
     portalValues.clear();
     portalValues.reserve(newPortals.size());
+    portalSockets.clear();
+    portalSockets.reserve(newPortals.size());
+    size_t socketCount = 0;
     for (const auto &newPortal : newPortals) {
         portalValues.push_back(_editor->window()->runtime()->getPortalPtr(newPortal._key));
+        portalSockets.push_back(newPortal._key);
+        socketCount = std::max(socketCount, newPortal._key + 1);
     }
 
+    // socket indices may have moved, so any bound buffers are no longer valid
+    blockInputs.assign(socketCount * 2, nullptr);
+    blockOutputs.assign(socketCount * 2, nullptr);
+
     // no point continuing if the portals are the same
     if (hasCurrent && newPortals == currentPortals) {
         return;
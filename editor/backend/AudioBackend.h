@@ -1,13 +1,13 @@
 #pragma once
 
 #include <QtCore/QByteArray>
-#include <deque>
 #include <functional>
 #include <mutex>
 #include <optional>
 
 #include "../model/Value.h"
 #include "AudioConfiguration.h"
+#include "MidiEventQueue.h"
 
 class AxiomEditor;
 
@@ -56,18 +56,31 @@ namespace AxiomBackend {
             std::optional<std::function<void(QDataStream &, uint32_t)>> deserializeCustomCallback = std::nullopt);
 
         // Queues a MIDI event to be input in a certain number of samples time. Should be called from the audio thread.
+        // Events should be queued in order of `deltaFrames`, and are dropped if too many are waiting to be input.
         // You should call clearMidi after the first generated sample (at least) to clear the MIDI portals that had
         // data queued.
         void queueMidiEvent(uint64_t deltaFrames, size_t portalId, MidiEvent event);
         void clearMidi(size_t portalId);
 
+        // Queues a MIDI event to be input as soon as possible. Unlike `queueMidiEvent`, this should be called from the
+        // UI thread, and doesn't need the runtime to be locked.
+        void queuePreviewEvent(size_t portalId, MidiEvent event);
+
+        // Returns the number of MIDI events that have been dropped because too many were queued at once.
+        uint64_t droppedMidiEvents() const;
+
         // Clears all pressed MIDI keys. Should be called from the audio thread.
         void clearNotes(size_t portalId);
 
-        // Locks the runtime. The runtime should always be locked when `generate` is called. May block if the runtime
-        // is being rebuilt.
+        // Locks the runtime. The runtime should always be locked when `generate` is called. New builds are deployed and
+        // swapped in without the lock, which is only held by the editor while the portals are updated to point into a
+        // new build. That still means waiting on the UI thread, so the audio thread should use `tryLockRuntime`.
         std::lock_guard<std::mutex> lockRuntime();
 
+        // Locks the runtime if the editor isn't holding it. Check `owns_lock` on the result: if the runtime couldn't be
+        // locked, nothing should be generated, and the audio thread should output silence instead of waiting.
+        std::unique_lock<std::mutex> tryLockRuntime();
+
         // Signals that you're about to start a batch of `generate` calls. The value returned signals the max number of
         // samples (i.e `generate` calls) until you should call `beginGenerate` again. This is used, for example, for
         // the internal queuing of MIDI events. Should be called from the audio thread.
@@ -78,6 +91,20 @@ namespace AxiomBackend {
         // be written to. Should be called from the audio thread. Make sure the runtime is locked when calling!
         void generate();
 
+        // Binds planar sample buffers to an audio input or output portal, to be streamed by `generateBlock`. Pass
+        // nullptr to unbind the portal. The bound pointers are advanced past every frame that is generated, so they
+        // should be bound again at the start of each host buffer. Should be called from the audio thread.
+        void setPortalBuffers(size_t portalId, float *left, float *right);
+
+        // Unbinds the buffers from all portals. Should be called from the audio thread.
+        void clearPortalBuffers();
+
+        // Simulates the internal graph `frames` times, reading input portals from and writing output portals to the
+        // buffers bound with `setPortalBuffers`. This is much cheaper than calling `generate` for each sample.
+        // `frames` should not be larger than the value returned by `beginGenerate`. Should be called from the audio
+        // thread. Make sure the runtime is locked when calling!
+        void generateBlock(uint64_t frames);
+
         // To be implemented by the audio backend, called from the UI thread when the IO configuration changes.
         // Note that this is not always called when the runtime is rebuilt, only if the rebuild results in a change in
         // configuration. The runtime will be locked while in this method.
@@ -115,20 +142,21 @@ namespace AxiomBackend {
         size_t internalRemapPortal(uint64_t id);
 
     private:
-        struct QueuedEvent {
-            uint64_t deltaFrames;
-            size_t portalId;
-            MidiEvent event;
-        };
-
         bool hasCurrent = false;
         std::vector<ConfigurationPortal> currentPortals;
 
         AxiomEditor *_editor;
         std::vector<void *> portalValues;
+        std::vector<size_t> portalSockets;
+        std::vector<const float *> blockInputs;
+        std::vector<float *> blockOutputs;
+
+        // events from the host are queued on the audio thread and previews on the UI thread, so they're kept apart to
+        // give each queue a single producer
+        MidiEventQueue queuedEvents;
+        MidiEventQueue previewEvents;
+        uint64_t generatedSamples = 0;
 
-        // todo: use a circular buffer instead of a deque here
-        std::deque<QueuedEvent> queuedEvents;
-        size_t generatedSamples = 0;
+        uint64_t inputDueEvents(MidiEventQueue &queue);
     };
 }
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "../model/Value.h"
+
+namespace AxiomBackend {
+
+    // A fixed-size queue of MIDI events ordered by the frame they're due on. One thread can push while another pops
+    // without locking, and nothing is allocated after construction, so it's safe to use from the audio thread.
+    class MidiEventQueue {
+    public:
+        static constexpr size_t CAPACITY = 1024;
+
+        struct QueuedEvent {
+            uint64_t frame;
+            size_t portalId;
+            AxiomModel::MidiEventValue event;
+        };
+
+        // Queues an event to be input on `frame`. Should only be called from the producer thread.
+        // Events are expected in order: one due before the last queued event is moved to the same frame, so the queue
+        // never needs sorting. If the queue is full the new event is dropped and counted, and false is returned.
+        bool push(uint64_t frame, size_t portalId, AxiomModel::MidiEventValue event) {
+            auto currentTail = tail.load(std::memory_order_relaxed);
+            if (currentTail - head.load(std::memory_order_acquire) >= CAPACITY) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            if (frame < lastFrame) frame = lastFrame;
+            lastFrame = frame;
+
+            events[currentTail & (CAPACITY - 1)] = {frame, portalId, event};
+            tail.store(currentTail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Returns the earliest queued event, or nullptr if the queue is empty. Should only be called from the consumer
+        // thread.
+        const QueuedEvent *peek() const {
+            auto currentHead = head.load(std::memory_order_relaxed);
+            if (currentHead == tail.load(std::memory_order_acquire)) return nullptr;
+            return &events[currentHead & (CAPACITY - 1)];
+        }
+
+        // Removes the event returned by `peek`. Should only be called from the consumer thread.
+        void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+        // Returns the number of events that have been dropped because the queue was full.
+        uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+    private:
+        static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Queue capacity must be a power of two");
+
+        std::array<QueuedEvent, CAPACITY> events;
+        std::atomic<size_t> head{0};
+        std::atomic<size_t> tail{0};
+        std::atomic<uint64_t> dropped{0};
+        uint64_t lastFrame = 0;
+    };
+}
@@ -0,0 +1,139 @@
+#include "HeadlessRenderer.h"
+
+#include <QtCore/QFile>
+#include <algorithm>
+#include <cmath>
+
+#include "../../model/ModelRoot.h"
+#include "../../model/Project.h"
+#include "../../model/objects/RootSurface.h"
+#include "../../model/serialize/ProjectSerializer.h"
+
+using namespace AxiomBackend;
+
+// the JIT-compiled block function is called with at most this many frames at a time
+static constexpr uint64_t MAX_BLOCK_SIZE = 4096;
+
+HeadlessRenderer::HeadlessRenderer(float sampleRate, float bpm) : _sampleRate(sampleRate), _runtime(false, false) {
+    _runtime.setSampleRate(sampleRate);
+    _runtime.setBpm(bpm);
+}
+
+HeadlessRenderer::~HeadlessRenderer() = default;
+
+bool HeadlessRenderer::load(const QString &path, QString &error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = "Couldn't open " + path + ": " + file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    uint32_t readVersion = 0;
+    _project = AxiomModel::ProjectSerializer::deserialize(stream, &readVersion, [](AxiomModel::Library *) {},
+                                                          [path](QDataStream &, uint32_t) { return path; });
+    file.close();
+
+    if (!_project) {
+        if (readVersion) {
+            error = path + " was created with an incompatible version of Axiom (expected version between " +
+                    QString::number(AxiomModel::ProjectSerializer::minSchemaVersion) + " and " +
+                    QString::number(AxiomModel::ProjectSerializer::schemaVersion) +
+                    ", actual version: " + QString::number(readVersion) + ")";
+        } else {
+            error = path + " is an invalid project file (bad magic header)";
+        }
+        return false;
+    }
+
+    _project->mainRoot().setFreezeControls(_freezeControls);
+    _project->mainRoot().attachRuntime(&_runtime);
+
+    auto &compileMeta = _project->rootSurface()->runtimeCompileMeta();
+    _midiInputSocket.reset();
+    _audioOutputSocket.reset();
+    size_t socketCount = 0;
+    if (compileMeta) {
+        for (const auto &portal : compileMeta->portals) {
+            socketCount = std::max(socketCount, portal.socketIndex + 1);
+
+            if (!_midiInputSocket && portal.portalType == AxiomModel::PortalControl::PortalType::INPUT &&
+                portal.valueType == AxiomModel::ConnectionWire::WireType::MIDI) {
+                _midiInputSocket = portal.socketIndex;
+            } else if (!_audioOutputSocket && portal.portalType == AxiomModel::PortalControl::PortalType::OUTPUT &&
+                       portal.valueType == AxiomModel::ConnectionWire::WireType::NUM) {
+                _audioOutputSocket = portal.socketIndex;
+            }
+        }
+    }
+
+    _blockInputs.assign(socketCount * 2, nullptr);
+    _blockOutputs.assign(socketCount * 2, nullptr);
+    return true;
+}
+
+void HeadlessRenderer::loadTransaction(MaximCompiler::Transaction transaction, size_t socketCount,
+                                       std::optional<size_t> midiInputSocket,
+                                       std::optional<size_t> audioOutputSocket) {
+    _runtime.commit(std::move(transaction));
+
+    _midiInputSocket = midiInputSocket;
+    _audioOutputSocket = audioOutputSocket;
+    _blockInputs.assign(socketCount * 2, nullptr);
+    _blockOutputs.assign(socketCount * 2, nullptr);
+}
+
+void HeadlessRenderer::setEvents(std::vector<AxiomBackend::TimedMidiEvent> events) {
+    _events = std::move(events);
+    _nextEvent = 0;
+    _position = 0;
+}
+
+void HeadlessRenderer::render(uint64_t frames, float *left, float *right) {
+    auto midiValue = _midiInputSocket ? (MidiValue *) _runtime.getPortalPtr(*_midiInputSocket) : nullptr;
+
+    uint64_t processPos = 0;
+    while (processPos < frames) {
+        // send everything that's due on this frame
+        auto hasEvents = false;
+        while (_nextEvent < _events.size() &&
+               (uint64_t) std::llround(_events[_nextEvent].time * _sampleRate) <= _position) {
+            if (midiValue) midiValue->pushEvent(_events[_nextEvent].event);
+            _nextEvent++;
+            hasEvents = true;
+        }
+
+        // MIDI events are only visible for a single sample
+        if (hasEvents) {
+            generateBlock(1, left + processPos, right + processPos);
+            if (midiValue) midiValue->count = 0;
+            processPos++;
+            _position++;
+            continue;
+        }
+
+        // render up until the next event without interruption
+        auto endProcessPos = frames;
+        if (_nextEvent < _events.size()) {
+            auto nextEventPos = (uint64_t) std::llround(_events[_nextEvent].time * _sampleRate);
+            endProcessPos = std::min(endProcessPos, processPos + (nextEventPos - _position));
+        }
+        endProcessPos = std::min(endProcessPos, processPos + MAX_BLOCK_SIZE);
+
+        generateBlock(endProcessPos - processPos, left + processPos, right + processPos);
+        _position += endProcessPos - processPos;
+        processPos = endProcessPos;
+    }
+}
+
+void HeadlessRenderer::generateBlock(uint64_t frames, float *left, float *right) {
+    if (!_audioOutputSocket) {
+        std::fill(left, left + frames, 0.f);
+        std::fill(right, right + frames, 0.f);
+    } else {
+        _blockOutputs[*_audioOutputSocket * 2] = left;
+        _blockOutputs[*_audioOutputSocket * 2 + 1] = right;
+    }
+
+    _runtime.runBlock((uint32_t) frames, _blockInputs.data(), _blockOutputs.data(), _blockOutputs.size());
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "../../compiler/interface/Runtime.h"
+#include "MidiFile.h"
+
+namespace AxiomModel {
+    class Project;
+}
+
+namespace AxiomBackend {
+
+    // Loads a project into its own runtime and renders it without an editor or audio device attached, so it can run
+    // as fast as the machine allows. MIDI events go to the project's first MIDI input portal, and audio is read from
+    // its first audio output portal.
+    class HeadlessRenderer {
+    public:
+        HeadlessRenderer(float sampleRate, float bpm);
+
+        ~HeadlessRenderer();
+
+        bool load(const QString &path, QString &error);
+
+        // Bakes the values of controls that can't change while rendering into the code of projects loaded after this
+        // is called. See `ModelRoot::setFreezeControls`.
+        void setFreezeControls(bool freezeControls) { _freezeControls = freezeControls; }
+
+        // Commits a transaction that was built without a project, with the sockets to use for MIDI input and audio
+        // output given directly.
+        void loadTransaction(MaximCompiler::Transaction transaction, size_t socketCount,
+                             std::optional<size_t> midiInputSocket, std::optional<size_t> audioOutputSocket);
+
+        MaximCompiler::Runtime &runtime() { return _runtime; }
+
+        bool hasMidiInput() const { return _midiInputSocket.has_value(); }
+
+        bool hasAudioOutput() const { return _audioOutputSocket.has_value(); }
+
+        float sampleRate() const { return _sampleRate; }
+
+        uint64_t position() const { return _position; }
+
+        // Events must be sorted by time. Rendering restarts from the first event, but the project state isn't reset.
+        void setEvents(std::vector<TimedMidiEvent> events);
+
+        // Renders the next `frames` samples into the left and right buffers, sending any events that are due.
+        void render(uint64_t frames, float *left, float *right);
+
+    private:
+        float _sampleRate;
+        MaximCompiler::Runtime _runtime;
+        std::unique_ptr<AxiomModel::Project> _project;
+        bool _freezeControls = false;
+
+        std::optional<size_t> _midiInputSocket;
+        std::optional<size_t> _audioOutputSocket;
+        std::vector<const float *> _blockInputs;
+        std::vector<float *> _blockOutputs;
+
+        std::vector<TimedMidiEvent> _events;
+        size_t _nextEvent = 0;
+        uint64_t _position = 0;
+
+        void generateBlock(uint64_t frames, float *left, float *right);
+    };
+}
@@ -0,0 +1,310 @@
+#include "MidiFile.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QTextStream>
+#include <algorithm>
+
+using namespace AxiomBackend;
+
+namespace {
+
+    struct TrackEvent {
+        uint64_t tick;
+        bool isTempo;
+        uint32_t tempo;
+        MidiEvent event;
+    };
+
+    class ByteReader {
+    public:
+        ByteReader(const char *data, size_t size) : data((const uint8_t *) data), size(size) {}
+
+        bool atEnd() const { return pos >= size; }
+
+        size_t remaining() const { return size - pos; }
+
+        bool readByte(uint8_t &out) {
+            if (pos >= size) return false;
+            out = data[pos++];
+            return true;
+        }
+
+        bool peekByte(uint8_t &out) const {
+            if (pos >= size) return false;
+            out = data[pos];
+            return true;
+        }
+
+        bool readBigEndian(size_t bytes, uint32_t &out) {
+            if (remaining() < bytes) return false;
+            out = 0;
+            for (size_t i = 0; i < bytes; i++) {
+                out = (out << 8) | data[pos++];
+            }
+            return true;
+        }
+
+        bool readVarLength(uint32_t &out) {
+            out = 0;
+            for (int i = 0; i < 4; i++) {
+                uint8_t byte;
+                if (!readByte(byte)) return false;
+                out = (out << 7) | (byte & 0x7F);
+                if (!(byte & 0x80)) return true;
+            }
+            return false;
+        }
+
+        bool skip(size_t bytes) {
+            if (remaining() < bytes) return false;
+            pos += bytes;
+            return true;
+        }
+
+        const uint8_t *current() const { return data + pos; }
+
+    private:
+        const uint8_t *data;
+        size_t size;
+        size_t pos = 0;
+    };
+
+    bool readTrack(ByteReader reader, std::vector<TrackEvent> &events) {
+        uint64_t tick = 0;
+        uint8_t runningStatus = 0;
+
+        while (!reader.atEnd()) {
+            uint32_t delta;
+            if (!reader.readVarLength(delta)) return false;
+            tick += delta;
+
+            uint8_t status;
+            if (!reader.peekByte(status)) return false;
+            if (status & 0x80) {
+                reader.skip(1);
+            } else if (runningStatus) {
+                status = runningStatus;
+            } else {
+                return false;
+            }
+
+            if (status == 0xFF) {
+                // meta event, we only care about tempo changes and the end of the track
+                uint8_t metaType;
+                uint32_t length;
+                if (!reader.readByte(metaType) || !reader.readVarLength(length)) return false;
+                if (metaType == 0x2F) return true;
+                if (metaType == 0x51 && length == 3) {
+                    uint32_t tempo;
+                    if (!reader.readBigEndian(3, tempo)) return false;
+                    events.push_back({tick, true, tempo, {}});
+                } else if (!reader.skip(length)) {
+                    return false;
+                }
+                continue;
+            }
+            if (status == 0xF0 || status == 0xF7) {
+                // sysex, skip the payload
+                uint32_t length;
+                if (!reader.readVarLength(length) || !reader.skip(length)) return false;
+                continue;
+            }
+
+            runningStatus = status;
+            auto eventType = (uint8_t)(status & 0xF0);
+            auto dataLength = eventType == 0xC0 || eventType == 0xD0 ? 1 : 2;
+            uint8_t data1 = 0, data2 = 0;
+            if (!reader.readByte(data1) || (dataLength == 2 && !reader.readByte(data2))) return false;
+
+            MidiEvent remappedEvent;
+            remappedEvent.channel = (uint8_t)(status & 0x0F);
+
+            switch (eventType) {
+            case 0x80: // note off
+                remappedEvent.event = MidiEventType::NOTE_OFF;
+                remappedEvent.note = data1;
+                break;
+            case 0x90: // note on, with a velocity of zero meaning note off
+                remappedEvent.event = data2 ? MidiEventType::NOTE_ON : MidiEventType::NOTE_OFF;
+                remappedEvent.note = data1;
+                remappedEvent.param = (uint8_t)(data2 * 2); // MIDI velocity is 0-127, we need 0-255
+                break;
+            case 0xA0: // polyphonic aftertouch
+                remappedEvent.event = MidiEventType::POLYPHONIC_AFTERTOUCH;
+                remappedEvent.note = data1;
+                remappedEvent.param = (uint8_t)(data2 * 2); // MIDI aftertouch pressure is 0-127, we need 0-255
+                break;
+            case 0xD0: // channel aftertouch
+                remappedEvent.event = MidiEventType::CHANNEL_AFTERTOUCH;
+                remappedEvent.param = (uint8_t)(data1 * 2); // MIDI aftertouch pressure is 0-127, we need 0-255
+                break;
+            case 0xE0: // pitch wheel
+            {
+                remappedEvent.event = MidiEventType::PITCH_WHEEL;
+
+                // Pitch is 0-0x3FFF stored across the two bytes, we need 0-255
+                auto pitch = ((uint16_t) data2 << 7) | (uint16_t) data1;
+                remappedEvent.param = (uint8_t)(pitch / 16383.f * 255.f);
+                break;
+            }
+            default:
+                // control changes and program changes aren't supported by MIDI portals
+                continue;
+            }
+
+            events.push_back({tick, false, 0, remappedEvent});
+        }
+
+        // tracks without an end-of-track event are accepted
+        return true;
+    }
+
+    int parseNote(const QString &str) {
+        bool isNumber;
+        auto number = str.toInt(&isNumber);
+        if (isNumber) return number >= 0 && number <= 127 ? number : -1;
+
+        static const QRegularExpression noteRegex("^([a-gA-G])([#b]?)(-?[0-9]+)$");
+        auto match = noteRegex.match(str);
+        if (!match.hasMatch()) return -1;
+
+        static const int semitones[] = {9, 11, 0, 2, 4, 5, 7}; // a, b, c, d, e, f, g
+        auto note = semitones[match.captured(1).toLower()[0].unicode() - 'a'];
+        if (match.captured(2) == "#") note++;
+        if (match.captured(2) == "b") note--;
+
+        // C4 is middle C (MIDI note 60)
+        note += (match.captured(3).toInt() + 1) * 12;
+        return note >= 0 && note <= 127 ? note : -1;
+    }
+}
+
+bool AxiomBackend::readMidiFile(const QString &path, std::vector<TimedMidiEvent> &events, QString &error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = "Couldn't open " + path + ": " + file.errorString();
+        return false;
+    }
+    auto fileData = file.readAll();
+    ByteReader reader(fileData.constData(), (size_t) fileData.size());
+
+    uint32_t division = 0;
+    bool hasHeader = false;
+    std::vector<TrackEvent> trackEvents;
+    while (reader.remaining() >= 8) {
+        auto chunkId = QByteArray((const char *) reader.current(), 4);
+        uint32_t chunkLength;
+        reader.skip(4);
+        reader.readBigEndian(4, chunkLength);
+        if (reader.remaining() < chunkLength) {
+            error = "Unexpected end of file in " + path;
+            return false;
+        }
+
+        ByteReader chunkReader((const char *) reader.current(), chunkLength);
+        reader.skip(chunkLength);
+
+        if (chunkId == "MThd") {
+            uint32_t format, trackCount;
+            if (!chunkReader.readBigEndian(2, format) || !chunkReader.readBigEndian(2, trackCount) ||
+                !chunkReader.readBigEndian(2, division)) {
+                error = "Invalid MIDI header in " + path;
+                return false;
+            }
+            if (format > 1) {
+                error = "Unsupported MIDI file format " + QString::number(format) + " in " + path;
+                return false;
+            }
+            hasHeader = true;
+        } else if (chunkId == "MTrk") {
+            if (!hasHeader || !readTrack(chunkReader, trackEvents)) {
+                error = "Invalid MIDI track in " + path;
+                return false;
+            }
+        }
+    }
+
+    if (!hasHeader || division == 0) {
+        error = path + " is not a MIDI file";
+        return false;
+    }
+
+    // events from different tracks are interleaved by tick, keeping the order within a tick stable
+    std::stable_sort(trackEvents.begin(), trackEvents.end(),
+                     [](const TrackEvent &a, const TrackEvent &b) { return a.tick < b.tick; });
+
+    // SMPTE divisions have a fixed tick length, otherwise it depends on the current tempo (default 120 BPM)
+    double secondsPerTick;
+    bool isSmpte = (division & 0x8000) != 0;
+    if (isSmpte) {
+        auto framesPerSecond = -(int8_t)(division >> 8);
+        auto ticksPerFrame = division & 0xFF;
+        secondsPerTick = 1. / (framesPerSecond * ticksPerFrame);
+    } else {
+        secondsPerTick = 500000. / 1000000. / division;
+    }
+
+    uint64_t lastTick = 0;
+    double currentTime = 0;
+    for (const auto &trackEvent : trackEvents) {
+        currentTime += (trackEvent.tick - lastTick) * secondsPerTick;
+        lastTick = trackEvent.tick;
+
+        if (trackEvent.isTempo) {
+            if (!isSmpte) secondsPerTick = trackEvent.tempo / 1000000. / division;
+        } else {
+            events.push_back({currentTime, trackEvent.event});
+        }
+    }
+
+    return true;
+}
+
+bool AxiomBackend::readNoteScript(const QString &path, std::vector<TimedMidiEvent> &events, QString &error) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        error = "Couldn't open " + path + ": " + file.errorString();
+        return false;
+    }
+
+    QTextStream stream(&file);
+    size_t lineNumber = 0;
+    while (!stream.atEnd()) {
+        auto line = stream.readLine().trimmed();
+        lineNumber++;
+        if (line.isEmpty() || line.startsWith('#')) continue;
+
+        auto parts = line.split(QRegularExpression("\\s+"));
+        auto lineError = [&]() {
+            error = path + ":" + QString::number(lineNumber) + ": expected `<start> <duration> <note> [velocity]`";
+            return false;
+        };
+        if (parts.size() < 3 || parts.size() > 4) return lineError();
+
+        bool startOk, durationOk, velocityOk = true;
+        auto start = parts[0].toDouble(&startOk);
+        auto duration = parts[1].toDouble(&durationOk);
+        auto note = parseNote(parts[2]);
+        auto velocity = parts.size() > 3 ? parts[3].toInt(&velocityOk) : 100;
+        if (!startOk || !durationOk || start < 0 || duration < 0 || note < 0 || !velocityOk || velocity < 0 ||
+            velocity > 127) {
+            return lineError();
+        }
+
+        MidiEvent noteOn;
+        noteOn.event = MidiEventType::NOTE_ON;
+        noteOn.note = (uint8_t) note;
+        noteOn.param = (uint8_t)(velocity * 2);
+        events.push_back({start, noteOn});
+
+        MidiEvent noteOff;
+        noteOff.event = MidiEventType::NOTE_OFF;
+        noteOff.note = (uint8_t) note;
+        events.push_back({start + duration, noteOff});
+    }
+
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TimedMidiEvent &a, const TimedMidiEvent &b) { return a.time < b.time; });
+    return true;
+}
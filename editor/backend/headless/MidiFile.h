@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QtCore/QString>
+#include <vector>
+
+#include "../AudioBackend.h"
+
+namespace AxiomBackend {
+
+    struct TimedMidiEvent {
+        double time;
+        MidiEvent event;
+    };
+
+    // Reads the channel events out of a Standard MIDI File (format 0 or 1), with their times converted to seconds
+    // using the file's tempo map. Events from all tracks are merged and sorted by time. Event parameters are scaled
+    // to the 0-255 range used by MIDI portals, the same as the VST backend does.
+    bool readMidiFile(const QString &path, std::vector<TimedMidiEvent> &events, QString &error);
+
+    // Reads a simple note script, where each non-empty line is `<start> <duration> <note> [velocity]`. Times are in
+    // seconds, notes are either MIDI note numbers or names like `C4` or `F#3`, and velocity is 0-127 (default 100).
+    // Lines starting with `#` are ignored.
+    bool readNoteScript(const QString &path, std::vector<TimedMidiEvent> &events, QString &error);
+}
@@ -0,0 +1,224 @@
+#include "StressPatch.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#include "../../compiler/interface/Block.h"
+#include "../../compiler/interface/ControlRef.h"
+#include "../../compiler/interface/Error.h"
+#include "../../compiler/interface/RootRef.h"
+#include "../../compiler/interface/SurfaceRef.h"
+#include "../../compiler/interface/ValueGroupSource.h"
+#include "../../compiler/interface/VarType.h"
+
+using namespace AxiomBackend;
+using namespace MaximCompiler;
+
+namespace {
+
+    struct BlockControl {
+        QString name;
+        bool isWritten;
+        bool isRead;
+        bool isExtractor;
+    };
+
+    class StressPatchBuilder {
+    public:
+        StressPatchBuilder(Runtime &runtime, Transaction &transaction)
+            : runtime(runtime), transaction(transaction) {}
+
+        uint64_t buildBlock(const QString &name, const QString &code) {
+            auto id = runtime.nextId();
+            Block block;
+            Error error;
+            if (!Block::compile(id, name, code, &block, &error)) {
+                std::cerr << "Failed to compile stress block " << name.toStdString() << ": "
+                          << error.getDescription().toStdString() << std::endl;
+                abort();
+            }
+
+            std::vector<BlockControl> controls;
+            for (size_t i = 0; i < block.controlCount(); i++) {
+                auto control = block.getControl(i);
+                controls.push_back({control.getName(), control.getIsWritten(), control.getIsRead(),
+                                    control.getType() == ControlType::AudioExtract ||
+                                        control.getType() == ControlType::MidiExtract});
+            }
+            blockControls.insert(id, std::move(controls));
+
+            transaction.buildBlock(std::move(block));
+            return id;
+        }
+
+        void addBlockNode(SurfaceRef &surface, uint64_t blockId, const QHash<QString, size_t> &groups) {
+            auto node = surface.addCustomNode(blockId);
+            for (const auto &control : blockControls[blockId]) {
+                assert(groups.contains(control.name));
+                node.addValueSocket(groups[control.name], control.isWritten, control.isRead, control.isExtractor);
+            }
+        }
+
+        // Builds the chain of processing nodes, reading from the note and gate groups and writing to the output
+        // group. Any groups the chain needs are added after `nextGroup`.
+        void buildChain(SurfaceRef &surface, size_t noteGroup, size_t gateGroup, size_t outputGroup, size_t nextGroup,
+                        size_t nodeCount) {
+            auto silenceGroup = nextGroup++;
+            surface.addValueGroup(VarType::ofControl(ControlType::Audio), ValueGroupSource::none());
+
+            auto inputGroup = silenceGroup;
+            for (size_t i = 0; i < nodeCount; i++) {
+                auto isLast = i == nodeCount - 1;
+                auto chainGroup = isLast ? outputGroup : nextGroup++;
+                if (!isLast) {
+                    surface.addValueGroup(VarType::ofControl(ControlType::Audio), ValueGroupSource::none());
+                }
+
+                addBlockNode(surface, getChainBlock(i),
+                             {{"in", inputGroup}, {"out", chainGroup}, {"note", noteGroup}, {"gate", gateGroup}});
+                inputGroup = chainGroup;
+            }
+        }
+
+        // Builds a surface with note, gate and output sockets, which either contains the chain or another level of
+        // nesting. Surface references are invalidated when another surface is added to the transaction, so inner
+        // surfaces are always built first.
+        uint64_t buildNestedSurface(size_t depth, size_t nodeCount) {
+            auto nestedId = depth > 1 ? buildNestedSurface(depth - 1, nodeCount) : 0;
+
+            auto id = runtime.nextId();
+            auto surface = transaction.buildSurface(id, "Nested " + QString::number(depth));
+            surface.addValueGroup(VarType::ofControl(ControlType::Audio), ValueGroupSource::socket(0));
+            surface.addValueGroup(VarType::ofControl(ControlType::Audio), ValueGroupSource::socket(1));
+            surface.addValueGroup(VarType::ofControl(ControlType::Audio), ValueGroupSource::socket(2));
+
+            if (nestedId) {
+                addNestedNode(surface, nestedId, 0, 1, 2);
+            } else {
+                buildChain(surface, 0, 1, 2, 3, nodeCount);
+            }
+            return id;
+        }
+
+        void addNestedNode(SurfaceRef &surface, uint64_t nestedId, size_t noteGroup, size_t gateGroup,
+                           size_t outputGroup) {
+            auto node = surface.addGroupNode(nestedId);
+            node.addValueSocket(noteGroup, false, true, false);
+            node.addValueSocket(gateGroup, false, true, false);
+            node.addValueSocket(outputGroup, true, false, false);
+        }
+
+        uint64_t buildVoiceSurface(size_t index, const StressPatchOptions &options) {
+            auto nestedId =
+                options.nestingDepth > 0 ? buildNestedSurface(options.nestingDepth, options.nodesPerVoice) : 0;
+
+            auto id = runtime.nextId();
+            auto surface = transaction.buildSurface(id, "Voice " + QString::number(index));
+
+            // sockets: MIDI input, audio output and gate output
+            surface.addValueGroup(VarType::ofControl(ControlType::Midi), ValueGroupSource::socket(0));
+            surface.addValueGroup(VarType::ofControl(ControlType::Audio), ValueGroupSource::socket(1));
+            surface.addValueGroup(VarType::ofControl(ControlType::Audio), ValueGroupSource::socket(2));
+
+            // note, velocity and aftertouch
+            surface.addValueGroup(VarType::ofControl(ControlType::Audio), ValueGroupSource::none());
+            surface.addValueGroup(VarType::ofControl(ControlType::Audio), ValueGroupSource::none());
+            surface.addValueGroup(VarType::ofControl(ControlType::Audio), ValueGroupSource::none());
+
+            addBlockNode(surface, getNoteBlock(),
+                         {{"in", 0}, {"gate", 2}, {"note", 3}, {"velocity", 4}, {"aftertouch", 5}});
+
+            if (nestedId) {
+                addNestedNode(surface, nestedId, 3, 2, 1);
+            } else {
+                buildChain(surface, 3, 2, 1, 6, options.nodesPerVoice);
+            }
+            return id;
+        }
+
+        void buildRoot(const StressPatchOptions &options) {
+            auto root = transaction.buildRoot();
+            root.addSocket(VarType::ofControl(ControlType::Midi));
+            root.addSocket(VarType::ofControl(ControlType::Audio));
+
+            std::vector<uint64_t> voiceSurfaces;
+            for (size_t i = 0; i < options.extractedGroups; i++) {
+                voiceSurfaces.push_back(buildVoiceSurface(i, options));
+            }
+
+            auto surface = transaction.buildSurface(0, "Root");
+            surface.addValueGroup(VarType::ofControl(ControlType::Midi), ValueGroupSource::socket(STRESS_MIDI_SOCKET));
+            surface.addValueGroup(VarType::ofControl(ControlType::Audio),
+                                  ValueGroupSource::socket(STRESS_OUTPUT_SOCKET));
+
+            QStringList mixInputs;
+            QHash<QString, size_t> mixGroups{{"out", 1}};
+            size_t nextGroup = 2;
+            for (size_t i = 0; i < options.extractedGroups; i++) {
+                auto voicesGroup = nextGroup++;
+                auto activeGroup = nextGroup++;
+                auto audioGroup = nextGroup++;
+                surface.addValueGroup(VarType::ofControl(ControlType::MidiExtract), ValueGroupSource::none());
+                surface.addValueGroup(VarType::ofControl(ControlType::AudioExtract), ValueGroupSource::none());
+                surface.addValueGroup(VarType::ofControl(ControlType::AudioExtract), ValueGroupSource::none());
+
+                addBlockNode(surface, getVoicesBlock(), {{"in", 0}, {"voices", voicesGroup}, {"active", activeGroup}});
+
+                auto voiceNode = surface.addGroupNode(voiceSurfaces[i]);
+                voiceNode.addValueSocket(voicesGroup, false, true, false);
+                voiceNode.addValueSocket(audioGroup, true, false, false);
+                voiceNode.addValueSocket(activeGroup, true, false, false);
+
+                auto mixName = "a" + QString::number(i);
+                mixInputs.push_back("mixdown(" + mixName + ":num[])");
+                mixGroups.insert(mixName, audioGroup);
+            }
+
+            auto mixBlock = buildBlock("Mix", "out:num = (" + mixInputs.join(" + ") + ") * 0.1");
+            addBlockNode(surface, mixBlock, mixGroups);
+        }
+
+    private:
+        Runtime &runtime;
+        Transaction &transaction;
+        QHash<uint64_t, std::vector<BlockControl>> blockControls;
+
+        uint64_t voicesBlock = 0;
+        uint64_t noteBlock = 0;
+        std::vector<uint64_t> chainBlocks;
+
+        uint64_t getVoicesBlock() {
+            if (!voicesBlock) voicesBlock = buildBlock("Voices", "voices:midi[] = voices(in:midi, active:num[])");
+            return voicesBlock;
+        }
+
+        uint64_t getNoteBlock() {
+            if (!noteBlock) {
+                noteBlock = buildBlock("Note", "(gate:num, note:num, velocity:num, aftertouch:num) = note(in:midi)");
+            }
+            return noteBlock;
+        }
+
+        // Each position in the chain gets its own block, so codegen scales with the chain length like a real patch
+        // would. The blocks are shared between voice groups.
+        uint64_t getChainBlock(size_t index) {
+            while (chainBlocks.size() <= index) {
+                auto cutoff = QString::number(500 + chainBlocks.size() * 250);
+                chainBlocks.push_back(buildBlock(
+                    "Chain " + QString::number(chainBlocks.size()),
+                    "out:num = lowBqFilter(in:num + sawOsc(note:num -> [freq]) * gate:num * 0.2, " + cutoff + ", 0.7)"));
+            }
+            return chainBlocks[index];
+        }
+    };
+}
+
+Transaction AxiomBackend::buildStressPatch(MaximCompiler::Runtime &runtime, const StressPatchOptions &options) {
+    Transaction transaction;
+    StressPatchBuilder builder(runtime, transaction);
+    builder.buildRoot(options);
+    return transaction;
+}
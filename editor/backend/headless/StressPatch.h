@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+#include "../../compiler/interface/Runtime.h"
+#include "../../compiler/interface/Transaction.h"
+
+namespace AxiomBackend {
+
+    struct StressPatchOptions {
+        // custom nodes chained together in each voice
+        size_t nodesPerVoice = 8;
+
+        // group surfaces wrapped around each voice's chain
+        size_t nestingDepth = 0;
+
+        // separate voice groups, each with their own voices node and chain
+        size_t extractedGroups = 1;
+    };
+
+    // the root sockets of a stress patch
+    static constexpr size_t STRESS_MIDI_SOCKET = 0;
+    static constexpr size_t STRESS_OUTPUT_SOCKET = 1;
+    static constexpr size_t STRESS_SOCKET_COUNT = 2;
+
+    // Builds a synthetic patch directly as MIR, so the runtime can be stressed in ways the example projects don't.
+    // Each extracted group splits the MIDI input into voices, and each voice runs a chain of oscillator and filter
+    // nodes. The groups are mixed down to the audio output.
+    MaximCompiler::Transaction buildStressPatch(MaximCompiler::Runtime &runtime, const StressPatchOptions &options);
+}
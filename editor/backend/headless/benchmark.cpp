@@ -0,0 +1,587 @@
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QTextStream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "../../compiler/interface/Block.h"
+#include "../../compiler/interface/ControlRef.h"
+#include "../../compiler/interface/Error.h"
+#include "../../compiler/interface/Frontend.h"
+#include "../../compiler/interface/RootRef.h"
+#include "../../compiler/interface/SurfaceRef.h"
+#include "../../compiler/interface/ValueGroupSource.h"
+#include "../../compiler/interface/VarType.h"
+#include "HeadlessRenderer.h"
+#include "StressPatch.h"
+
+using namespace AxiomBackend;
+
+struct BenchmarkCase {
+    QString name;
+    QString source;
+
+    // loads the patch into the renderer, returning false if it can't be loaded
+    std::function<bool(HeadlessRenderer &, QString &)> load;
+};
+
+struct BenchmarkResult {
+    QString name;
+    QString source;
+    MaximFrontend::CommitStats commitStats;
+    double loadSeconds;
+    uint64_t frames;
+    std::vector<double> runSeconds;
+
+    // voice updates skipped because the voice was asleep, averaged over the runs
+    uint64_t sleptVoiceUpdates;
+
+    // delay buffers and other dynamically sized state that didn't fit in the runtime's arena
+    uint64_t arenaHeapAllocs;
+    uint64_t peakMemoryBytes;
+
+    double bestSeconds() const { return *std::min_element(runSeconds.begin(), runSeconds.end()); }
+
+    double meanSeconds() const {
+        double total = 0;
+        for (auto seconds : runSeconds) total += seconds;
+        return total / runSeconds.size();
+    }
+};
+
+// Returns the peak resident memory of the process so far. This only ever increases, so to measure a single case in
+// isolation it should be run on its own with `--case`.
+static uint64_t getPeakMemoryBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return (uint64_t) counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (uint64_t) usage.ru_maxrss;
+#else
+    return (uint64_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// Builds the fixed MIDI pattern every case is driven with: a chord of `voiceCount` notes that's retriggered every
+// second, so voices are allocated and released throughout the run.
+static std::vector<TimedMidiEvent> buildBenchmarkEvents(double lengthSeconds, size_t voiceCount) {
+    std::vector<TimedMidiEvent> events;
+    for (double time = 0; time < lengthSeconds; time += 1) {
+        for (size_t voice = 0; voice < voiceCount; voice++) {
+            auto note = (uint8_t)(36 + (voice * 7) % 60);
+
+            MidiEvent noteOn;
+            noteOn.event = MidiEventType::NOTE_ON;
+            noteOn.note = note;
+            noteOn.param = 200;
+            events.push_back({time, noteOn});
+
+            MidiEvent noteOff;
+            noteOff.event = MidiEventType::NOTE_OFF;
+            noteOff.note = note;
+            events.push_back({time + 0.8, noteOff});
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TimedMidiEvent &a, const TimedMidiEvent &b) { return a.time < b.time; });
+    return events;
+}
+
+static BenchmarkCase projectCase(const QString &path) {
+    return {QFileInfo(path).completeBaseName(), path,
+            [path](HeadlessRenderer &renderer, QString &error) { return renderer.load(path, error); }};
+}
+
+static BenchmarkCase stressCase(const QString &name, StressPatchOptions options) {
+    auto source = QString("stress: %1 nodes per voice, %2 nesting, %3 extracted groups")
+                      .arg(options.nodesPerVoice)
+                      .arg(options.nestingDepth)
+                      .arg(options.extractedGroups);
+    return {name, source, [options](HeadlessRenderer &renderer, QString &) {
+                auto transaction = buildStressPatch(renderer.runtime(), options);
+                renderer.loadTransaction(std::move(transaction), STRESS_SOCKET_COUNT, STRESS_MIDI_SOCKET,
+                                         STRESS_OUTPUT_SOCKET);
+                return true;
+            }};
+}
+
+static bool runCase(const BenchmarkCase &benchmarkCase, float sampleRate, uint32_t controlRateInterval,
+                    uint32_t workerThreads, bool freezeControls, double lengthSeconds, size_t runCount,
+                    const std::vector<TimedMidiEvent> &events, BenchmarkResult &result) {
+    HeadlessRenderer renderer(sampleRate, 120);
+    renderer.runtime().setControlRateInterval(controlRateInterval);
+    renderer.runtime().setWorkerThreads(workerThreads);
+    renderer.setFreezeControls(freezeControls);
+    QString error;
+
+    auto loadStart = std::chrono::steady_clock::now();
+    if (!benchmarkCase.load(renderer, error)) {
+        std::cerr << benchmarkCase.name.toStdString() << ": " << error.toStdString() << std::endl;
+        return false;
+    }
+    result.loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+    result.commitStats = renderer.runtime().takeCommitStats();
+
+    result.name = benchmarkCase.name;
+    result.source = benchmarkCase.source;
+    result.frames = (uint64_t) std::llround(lengthSeconds * sampleRate);
+
+    std::vector<float> left(result.frames), right(result.frames);
+
+    // render once without timing, so the first run doesn't include page faults from touching new memory
+    renderer.setEvents(events);
+    renderer.render(result.frames, left.data(), right.data());
+    renderer.runtime().takeSleptVoiceUpdates();
+
+    for (size_t run = 0; run < runCount; run++) {
+        renderer.setEvents(events);
+        auto renderStart = std::chrono::steady_clock::now();
+        renderer.render(result.frames, left.data(), right.data());
+        result.runSeconds.push_back(
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count());
+    }
+
+    result.sleptVoiceUpdates = renderer.runtime().takeSleptVoiceUpdates() / runCount;
+    result.arenaHeapAllocs = renderer.runtime().arenaHeapAllocs();
+    result.peakMemoryBytes = getPeakMemoryBytes();
+    return true;
+}
+
+enum class ErrorKind { Absolute, Relative };
+
+struct MathLimit {
+    ErrorKind kind;
+    double fast, precise;
+};
+
+struct MathCase {
+    const char *name;
+    std::function<double(double, double)> reference;
+    double minA, maxA;
+    double minB, maxB;
+    MathLimit limit;
+};
+
+struct MathSpecialCase {
+    const char *name;
+    float a, b;
+    float expected;
+};
+
+static bool isSpecialResultOk(float result, float expected) {
+    if (std::isnan(expected)) return std::isnan(result);
+    if (std::isinf(expected) || expected == 0) return result == expected;
+    return std::abs(result - expected) <= 1e-3f * std::max(1.f, std::abs(expected));
+}
+
+// Compares the runtime library's math functions against libm over typical argument ranges, printing the worst error
+// and the time taken per value for both accuracies. Returns false if any error is over its limit, or if NaNs,
+// infinities or denormals don't give the expected result.
+static bool runMathBenchmark(size_t runCount) {
+    const size_t valueCount = 1 << 16;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+
+    // results can be large near the ends of the tan, exp and pow ranges, so those are limited by relative error
+    std::vector<MathCase> mathCases = {
+        {"sin", [](double a, double) { return std::sin(a); }, -100, 100, 0, 0, {ErrorKind::Absolute, 3e-4, 2e-5}},
+        {"cos", [](double a, double) { return std::cos(a); }, -100, 100, 0, 0, {ErrorKind::Absolute, 3e-4, 3e-5}},
+        {"tan", [](double a, double) { return std::tan(a); }, -1.5, 1.5, 0, 0, {ErrorKind::Relative, 3e-4, 1e-5}},
+        {"exp", [](double a, double) { return std::exp(a); }, -80, 80, 0, 0, {ErrorKind::Relative, 1e-4, 1e-5}},
+        {"exp2", [](double a, double) { return std::exp2(a); }, -120, 120, 0, 0, {ErrorKind::Relative, 1e-4, 1e-6}},
+        {"log", [](double a, double) { return std::log(a); }, 1e-6, 1e6, 0, 0, {ErrorKind::Absolute, 1.5e-4, 3e-6}},
+        {"log2", [](double a, double) { return std::log2(a); }, 1e-6, 1e6, 0, 0, {ErrorKind::Absolute, 2e-4, 3e-6}},
+        {"log10", [](double a, double) { return std::log10(a); }, 1e-6, 1e6, 0, 0,
+         {ErrorKind::Absolute, 6e-5, 2e-6}},
+        {"pow", [](double a, double b) { return std::pow(a, b); }, 1e-3, 100, -4, 4,
+         {ErrorKind::Relative, 6e-4, 3e-6}},
+        {"tanh", [](double a, double) { return std::tanh(a); }, -10, 10, 0, 0, {ErrorKind::Absolute, 6e-5, 5e-7}}};
+
+    // angles from 2^23 turns up can't have a fraction, so their sine is zero
+    std::vector<MathSpecialCase> specialCases = {
+        {"sin", nan, 0, nan},
+        {"sin", inf, 0, nan},
+        {"sin", -inf, 0, nan},
+        {"sin", 1e30f, 0, 0},
+        {"cos", nan, 0, nan},
+        {"cos", -inf, 0, nan},
+        {"exp2", nan, 0, nan},
+        {"exp2", inf, 0, inf},
+        {"exp2", -inf, 0, 0},
+        {"exp2", 1e30f, 0, inf},
+        {"exp2", -1e30f, 0, 0},
+        {"exp", nan, 0, nan},
+        {"log2", nan, 0, nan},
+        {"log2", inf, 0, inf},
+        {"log2", 0, 0, -inf},
+        {"log2", -1, 0, nan},
+        {"log2", std::ldexp(1.f, -140), 0, -140},
+        {"log2", std::ldexp(1.f, -149), 0, -149},
+        {"log2", std::ldexp(1.5f, -135), 0, (float) (std::log2(1.5) - 135)},
+        {"log", std::ldexp(1.f, -140), 0, (float) (-140 * std::log(2.))},
+        {"pow", -2, 3, -8},
+        {"pow", -2, 0.5f, nan},
+        {"pow", -2, 1e30f, inf},
+        {"pow", -0.5f, 1e30f, 0},
+        {"pow", 2, nan, nan},
+        {"pow", nan, 0, 1},
+        {"pow", 1, nan, 1},
+        {"pow", 0, -1, inf},
+        {"tanh", nan, 0, nan},
+        {"tanh", inf, 0, 1},
+        {"tanh", -inf, 0, -1}};
+
+    bool isOk = true;
+    MaximCompiler::Runtime runtime(false, false);
+    std::vector<float> a(valueCount), b(valueCount), out(valueCount);
+    for (const auto &mathCase : mathCases) {
+        for (size_t i = 0; i < valueCount; i++) {
+            auto t = i / (double) (valueCount - 1);
+            a[i] = (float) (mathCase.minA + (mathCase.maxA - mathCase.minA) * t);
+            b[i] = (float) (mathCase.minB + (mathCase.maxB - mathCase.minB) * (1 - t));
+        }
+
+        for (auto precise : {false, true}) {
+            double bestSeconds = INFINITY;
+            for (size_t run = 0; run < runCount; run++) {
+                auto start = std::chrono::steady_clock::now();
+                runtime.evalMath(mathCase.name, precise, a.data(), b.data(), out.data(), valueCount);
+                auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                bestSeconds = std::min(bestSeconds, seconds);
+            }
+
+            double maxAbsError = 0, maxRelError = 0;
+            for (size_t i = 0; i < valueCount; i++) {
+                auto expected = mathCase.reference(a[i], b[i]);
+                auto absError = std::abs(out[i] - expected);
+                maxAbsError = std::max(maxAbsError, absError);
+                if (std::abs(expected) > 1e-6) maxRelError = std::max(maxRelError, absError / std::abs(expected));
+            }
+
+            auto error = mathCase.limit.kind == ErrorKind::Absolute ? maxAbsError : maxRelError;
+            auto limit = precise ? mathCase.limit.precise : mathCase.limit.fast;
+            auto isInLimit = error <= limit;
+            isOk = isOk && isInLimit;
+
+            std::cout << "  " << mathCase.name << (precise ? " precise" : " fast") << ": max abs error "
+                      << maxAbsError << ", max rel error " << maxRelError << ", "
+                      << bestSeconds * 1e9 / valueCount << " ns/value" << std::endl;
+            if (!isInLimit) {
+                std::cout << "    FAILED: " << (mathCase.limit.kind == ErrorKind::Absolute ? "abs" : "rel")
+                          << " error is over the limit of " << limit << std::endl;
+            }
+        }
+
+        auto libmStart = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < valueCount; i++) {
+            out[i] = (float) mathCase.reference(a[i], b[i]);
+        }
+        auto libmSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - libmStart).count();
+        std::cout << "  " << mathCase.name << " libm: " << libmSeconds * 1e9 / valueCount << " ns/value" << std::endl;
+    }
+
+    size_t failedSpecialCount = 0;
+    for (const auto &specialCase : specialCases) {
+        for (auto precise : {false, true}) {
+            float result;
+            runtime.evalMath(specialCase.name, precise, &specialCase.a, &specialCase.b, &result, 1);
+            if (isSpecialResultOk(result, specialCase.expected)) continue;
+
+            failedSpecialCount++;
+            std::cout << "  FAILED: " << specialCase.name << (precise ? " precise" : " fast") << "("
+                      << specialCase.a << ", " << specialCase.b << ") gave " << result << ", expected "
+                      << specialCase.expected << std::endl;
+        }
+    }
+    std::cout << "  " << specialCases.size() * 2 - failedSpecialCount << "/" << specialCases.size() * 2
+              << " special values correct" << std::endl;
+
+    return isOk && failedSpecialCount == 0;
+}
+
+// Renders a block that converts a knob's value from beats to a frequency, and changes the BPM between two blocks. The
+// knob never changes, so this fails if the conversion is cached at control rate and keeps the old BPM.
+static bool runTempoCheck(uint32_t controlRateInterval) {
+    HeadlessRenderer renderer(44100, 60);
+    auto &runtime = renderer.runtime();
+    runtime.setControlRateInterval(controlRateInterval);
+
+    auto blockId = runtime.nextId();
+    MaximCompiler::Block block;
+    MaximCompiler::Error error;
+    if (!MaximCompiler::Block::compile(blockId, "Tempo", "out:num = [freq] (1b + knob:num)", &block, &error)) {
+        std::cout << "  FAILED: couldn't compile the tempo block: " << error.getDescription().toStdString()
+                  << std::endl;
+        return false;
+    }
+
+    MaximCompiler::Transaction transaction;
+    auto root = transaction.buildRoot();
+    root.addSocket(MaximCompiler::VarType::ofControl(MaximCompiler::ControlType::Audio));
+
+    auto surface = transaction.buildSurface(0, "Root");
+    surface.addValueGroup(MaximCompiler::VarType::ofControl(MaximCompiler::ControlType::Audio),
+                          MaximCompiler::ValueGroupSource::socket(0));
+    surface.addValueGroup(MaximCompiler::VarType::ofControl(MaximCompiler::ControlType::Audio),
+                          MaximCompiler::ValueGroupSource::none());
+    auto node = surface.addCustomNode(blockId);
+    for (size_t i = 0; i < block.controlCount(); i++) {
+        auto control = block.getControl(i);
+        auto isKnob = control.getName() == "knob";
+        if (isKnob) block.setControlStatic(i);
+        node.addValueSocket(isKnob ? 1 : 0, control.getIsWritten(), control.getIsRead(), false);
+    }
+    transaction.buildBlock(std::move(block));
+    renderer.loadTransaction(std::move(transaction), 1, std::nullopt, 0);
+
+    const uint64_t frames = 64;
+    std::vector<float> left(frames), right(frames);
+    bool isOk = true;
+    for (auto bpm : {60.f, 120.f}) {
+        runtime.setBpm(bpm);
+        renderer.render(frames, left.data(), right.data());
+
+        auto expected = bpm / 60;
+        auto result = left[frames - 1];
+        std::cout << "  " << bpm << " BPM: 1 beat is " << result << " Hz" << std::endl;
+        if (std::abs(result - expected) > 1e-4f) {
+            std::cout << "    FAILED: expected " << expected << " Hz" << std::endl;
+            isOk = false;
+        }
+    }
+    return isOk;
+}
+
+static QJsonObject resultToJson(const BenchmarkResult &result, float sampleRate) {
+    auto &stats = result.commitStats;
+    auto audioSeconds = result.frames / (double) sampleRate;
+    return QJsonObject{
+        {"name", result.name},
+        {"source", result.source},
+        {"compile",
+         QJsonObject{{"commits", (qint64) stats.commitCount},
+                     {"patch_seconds", stats.patchSeconds},
+                     {"codegen_seconds", stats.codegenSeconds},
+                     {"deploy_seconds", stats.deploySeconds},
+                     {"load_seconds", result.loadSeconds}}},
+        {"render",
+         QJsonObject{{"frames", (qint64) result.frames},
+                     {"runs", (qint64) result.runSeconds.size()},
+                     {"ns_per_sample", result.bestSeconds() * 1e9 / result.frames},
+                     {"mean_ns_per_sample", result.meanSeconds() * 1e9 / result.frames},
+                     {"realtime_factor", audioSeconds / result.bestSeconds()},
+                     {"slept_voice_updates", (qint64) result.sleptVoiceUpdates},
+                     {"arena_heap_allocs", (qint64) result.arenaHeapAllocs}}},
+        {"peak_memory_bytes", (qint64) result.peakMemoryBytes}};
+}
+
+static QString resultsToCsv(const std::vector<BenchmarkResult> &results, float sampleRate) {
+    QString csv;
+    QTextStream stream(&csv);
+    stream << "name,commits,patch_seconds,codegen_seconds,deploy_seconds,load_seconds,frames,runs,ns_per_sample,"
+              "mean_ns_per_sample,realtime_factor,slept_voice_updates,arena_heap_allocs,peak_memory_bytes\n";
+    for (const auto &result : results) {
+        auto &stats = result.commitStats;
+        stream << '"' << result.name << "\"," << stats.commitCount << ',' << stats.patchSeconds << ','
+               << stats.codegenSeconds << ',' << stats.deploySeconds << ',' << result.loadSeconds << ','
+               << result.frames << ',' << result.runSeconds.size() << ','
+               << result.bestSeconds() * 1e9 / result.frames << ',' << result.meanSeconds() * 1e9 / result.frames
+               << ',' << result.frames / (double) sampleRate / result.bestSeconds() << ','
+               << result.sleptVoiceUpdates << ',' << result.arenaHeapAllocs << ',' << result.peakMemoryBytes
+               << '\n';
+    }
+    return csv;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication application(argc, argv);
+    QCoreApplication::setApplicationName("Axiom");
+    QCoreApplication::setApplicationVersion(AXIOM_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks compiling and rendering the example projects and synthetic stress "
+                                     "patches.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("projects", "Extra projects (.axp) to benchmark.", "[projects...]");
+
+    QCommandLineOption outputOption({"o", "output"}, "File to write results to.", "file", "benchmark.json");
+    QCommandLineOption formatOption({"f", "format"}, "Results format: `json` or `csv`.", "format", "json");
+    QCommandLineOption caseOption({"c", "case"}, "Only run the named case. Can be given multiple times.", "name");
+    QCommandLineOption lengthOption({"l", "length"}, "Length of audio to render per run, in seconds.", "seconds",
+                                    "10");
+    QCommandLineOption runsOption({"n", "runs"}, "Number of timed runs per case.", "count", "3");
+    QCommandLineOption voicesOption({"v", "voices"}, "Notes played at once by the MIDI pattern.", "count", "8");
+    QCommandLineOption sampleRateOption({"r", "sample-rate"}, "Sample rate to render at.", "rate", "44100");
+    QCommandLineOption controlRateOption("control-rate",
+                                         "Most samples between updates of code that only depends on controls.",
+                                         "samples", "1");
+    QCommandLineOption threadsOption({"t", "threads"},
+                                     "Worker threads to spread voices across, on top of the rendering thread.",
+                                     "count", "0");
+    QCommandLineOption freezeOption("freeze-controls",
+                                    "Bake the values of controls that aren't connected or exposed into the code of "
+                                    "projects.");
+    QCommandLineOption mathOption("math", "Check the accuracy and speed of the math library instead of running cases.");
+    QCommandLineOption tempoOption("tempo",
+                                   "Check that tempo-based conversions follow BPM changes instead of running cases.");
+    QCommandLineOption examplesOption("examples", "Directory containing the example projects.", "dir",
+                                      AXIOM_EXAMPLES_DIR);
+    parser.addOptions({outputOption, formatOption, caseOption, lengthOption, runsOption, voicesOption,
+                       sampleRateOption, controlRateOption, threadsOption, freezeOption, mathOption,
+                       tempoOption, examplesOption});
+    parser.process(application);
+
+    bool lengthOk, runsOk, voicesOk, sampleRateOk, controlRateOk, threadsOk;
+    auto lengthSeconds = parser.value(lengthOption).toDouble(&lengthOk);
+    auto runCount = parser.value(runsOption).toUInt(&runsOk);
+    auto voiceCount = parser.value(voicesOption).toUInt(&voicesOk);
+    auto sampleRate = parser.value(sampleRateOption).toFloat(&sampleRateOk);
+    auto controlRateInterval = parser.value(controlRateOption).toUInt(&controlRateOk);
+    auto workerThreads = parser.value(threadsOption).toUInt(&threadsOk);
+    auto freezeControls = parser.isSet(freezeOption);
+    if (!lengthOk || lengthSeconds <= 0 || !runsOk || runCount == 0 || !voicesOk || !sampleRateOk ||
+        sampleRate <= 0 || !controlRateOk || controlRateInterval == 0) {
+        std::cerr << "Length, runs, voices, sample rate and control rate must be positive numbers" << std::endl;
+        return 1;
+    }
+    if (!threadsOk) {
+        std::cerr << "Threads must be a number" << std::endl;
+        return 1;
+    }
+
+    auto format = parser.value(formatOption);
+    if (format != "json" && format != "csv") {
+        std::cerr << "Unknown results format " << format.toStdString() << std::endl;
+        return 1;
+    }
+
+    // the object cache isn't enabled, so every case pays the full cost of code generation
+    MaximFrontend::maxim_initialize();
+
+    if (parser.isSet(mathOption)) {
+        std::cout << "Running math library" << std::endl;
+        return runMathBenchmark(runCount) ? 0 : 1;
+    }
+    if (parser.isSet(tempoOption)) {
+        std::cout << "Running tempo check" << std::endl;
+        return runTempoCheck(controlRateInterval) ? 0 : 1;
+    }
+
+    std::vector<BenchmarkCase> cases;
+    QDir examplesDir(parser.value(examplesOption));
+    for (const auto &example : examplesDir.entryList({"*.axp"}, QDir::Files, QDir::Name)) {
+        cases.push_back(projectCase(examplesDir.filePath(example)));
+    }
+    for (const auto &project : parser.positionalArguments()) {
+        cases.push_back(projectCase(project));
+    }
+
+    StressPatchOptions voicesStress;
+    cases.push_back(stressCase("stress voices", voicesStress));
+
+    StressPatchOptions nodesStress;
+    nodesStress.nodesPerVoice = 64;
+    cases.push_back(stressCase("stress nodes", nodesStress));
+
+    StressPatchOptions nestingStress;
+    nestingStress.nodesPerVoice = 4;
+    nestingStress.nestingDepth = 16;
+    cases.push_back(stressCase("stress nesting", nestingStress));
+
+    StressPatchOptions extractedStress;
+    extractedStress.nodesPerVoice = 4;
+    extractedStress.extractedGroups = 16;
+    cases.push_back(stressCase("stress extracted", extractedStress));
+
+    auto onlyCases = parser.values(caseOption);
+    if (!onlyCases.empty()) {
+        cases.erase(std::remove_if(cases.begin(), cases.end(),
+                                   [&onlyCases](const BenchmarkCase &benchmarkCase) {
+                                       return !onlyCases.contains(benchmarkCase.name);
+                                   }),
+                    cases.end());
+    }
+    if (cases.empty()) {
+        std::cerr << "No cases to run" << std::endl;
+        return 1;
+    }
+
+    auto events = buildBenchmarkEvents(lengthSeconds, voiceCount);
+    std::vector<BenchmarkResult> results;
+    for (const auto &benchmarkCase : cases) {
+        std::cout << "Running " << benchmarkCase.name.toStdString() << std::endl;
+
+        BenchmarkResult result;
+        if (!runCase(benchmarkCase, sampleRate, controlRateInterval, workerThreads, freezeControls, lengthSeconds,
+                     runCount, events, result)) {
+            return 1;
+        }
+
+        auto &stats = result.commitStats;
+        std::cout << "  compile: patch " << stats.patchSeconds << " s, codegen " << stats.codegenSeconds
+                  << " s, deploy " << stats.deploySeconds << " s" << std::endl;
+        std::cout << "  render: " << result.bestSeconds() * 1e9 / result.frames << " ns/sample, "
+                  << result.frames / (double) sampleRate / result.bestSeconds() << "x real-time, "
+                  << result.sleptVoiceUpdates << " slept voice updates, " << result.arenaHeapAllocs
+                  << " arena heap allocs" << std::endl;
+        std::cout << "  peak memory: " << result.peakMemoryBytes / (1024 * 1024) << " MiB" << std::endl;
+        results.push_back(std::move(result));
+    }
+
+    QByteArray output;
+    if (format == "json") {
+        QJsonArray resultsJson;
+        for (const auto &result : results) {
+            resultsJson.push_back(resultToJson(result, sampleRate));
+        }
+
+        QJsonObject root{{"version", QCoreApplication::applicationVersion()},
+                         {"sample_rate", sampleRate},
+                         {"control_rate_interval", (qint64) controlRateInterval},
+                         {"worker_threads", (qint64) workerThreads},
+                         {"freeze_controls", freezeControls},
+                         {"length_seconds", lengthSeconds},
+                         {"voices", (qint64) voiceCount},
+                         {"results", resultsJson}};
+        output = QJsonDocument(root).toJson();
+    } else {
+        output = resultsToCsv(results, sampleRate).toUtf8();
+    }
+
+    auto outputPath = parser.value(outputOption);
+    QFile outputFile(outputPath);
+    if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        std::cerr << "Couldn't open " << outputPath.toStdString() << ": " << outputFile.errorString().toStdString()
+                  << std::endl;
+        return 1;
+    }
+    outputFile.write(output);
+    outputFile.close();
+
+    std::cout << "Results written to " << outputPath.toStdString() << std::endl;
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QtEndian>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "../../compiler/interface/Frontend.h"
+#include "HeadlessRenderer.h"
+#include "MidiFile.h"
+
+using namespace AxiomBackend;
+
+// how long to keep rendering after the last event, if no length is given
+static constexpr double DEFAULT_TAIL_SECONDS = 2;
+
+// how long to render a project with no events, if no length is given
+static constexpr double DEFAULT_LENGTH_SECONDS = 10;
+
+static void appendUint16(QByteArray &data, uint16_t value) {
+    value = qToLittleEndian(value);
+    data.append((const char *) &value, sizeof(value));
+}
+
+static void appendUint32(QByteArray &data, uint32_t value) {
+    value = qToLittleEndian(value);
+    data.append((const char *) &value, sizeof(value));
+}
+
+static QByteArray interleave(const std::vector<float> &left, const std::vector<float> &right) {
+    QByteArray data;
+    data.reserve((int) (left.size() * 2 * sizeof(float)));
+    for (size_t i = 0; i < left.size(); i++) {
+        for (auto sample : {left[i], right[i]}) {
+            uint32_t bits;
+            memcpy(&bits, &sample, sizeof(bits));
+            appendUint32(data, bits);
+        }
+    }
+    return data;
+}
+
+static QByteArray buildWavHeader(uint32_t sampleRate, uint32_t dataSize) {
+    const uint16_t channelCount = 2;
+    const uint16_t bitsPerSample = 32;
+    const uint16_t blockAlign = channelCount * bitsPerSample / 8;
+
+    QByteArray header;
+    header.append("RIFF");
+    appendUint32(header, 36 + dataSize);
+    header.append("WAVE");
+
+    header.append("fmt ");
+    appendUint32(header, 16);
+    appendUint16(header, 3); // IEEE float
+    appendUint16(header, channelCount);
+    appendUint32(header, sampleRate);
+    appendUint32(header, sampleRate * blockAlign);
+    appendUint16(header, blockAlign);
+    appendUint16(header, bitsPerSample);
+
+    header.append("data");
+    appendUint32(header, dataSize);
+    return header;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication application(argc, argv);
+    QCoreApplication::setApplicationName("Axiom");
+    QCoreApplication::setApplicationVersion(AXIOM_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders an Axiom project to an audio file, without opening the editor.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("project", "The project (.axp) to render.");
+    parser.addPositionalArgument("output", "The file to write audio to.");
+
+    QCommandLineOption midiOption({"m", "midi"}, "Send the notes in a MIDI file to the project.", "file");
+    QCommandLineOption notesOption({"n", "notes"},
+                                   "Send the notes in a script to the project. Each line is "
+                                   "`<start> <duration> <note> [velocity]`, with times in seconds.",
+                                   "file");
+    QCommandLineOption lengthOption({"l", "length"}, "Length of audio to render in seconds.", "seconds");
+    QCommandLineOption sampleRateOption({"r", "sample-rate"}, "Sample rate to render at.", "rate", "44100");
+    QCommandLineOption bpmOption({"b", "bpm"}, "Tempo the project sees, in beats per minute.", "bpm", "120");
+    QCommandLineOption formatOption({"f", "format"},
+                                    "Output format: `wav` (32-bit float) or `raw` (interleaved 32-bit float). "
+                                    "Defaults to the output file's extension.",
+                                    "format");
+    QCommandLineOption freezeOption("freeze-controls",
+                                    "Bake the values of controls that aren't connected or exposed into the code.");
+    parser.addOptions(
+        {midiOption, notesOption, lengthOption, sampleRateOption, bpmOption, formatOption, freezeOption});
+    parser.process(application);
+
+    auto positionalArgs = parser.positionalArguments();
+    if (positionalArgs.size() != 2) {
+        parser.showHelp(1);
+    }
+    auto projectPath = positionalArgs[0];
+    auto outputPath = positionalArgs[1];
+
+    bool sampleRateOk, bpmOk;
+    auto sampleRate = parser.value(sampleRateOption).toFloat(&sampleRateOk);
+    auto bpm = parser.value(bpmOption).toFloat(&bpmOk);
+    if (!sampleRateOk || sampleRate <= 0 || !bpmOk || bpm <= 0) {
+        std::cerr << "Sample rate and BPM must be positive numbers" << std::endl;
+        return 1;
+    }
+
+    auto format = parser.isSet(formatOption) ? parser.value(formatOption)
+                                             : (outputPath.endsWith(".raw", Qt::CaseInsensitive) ? "raw" : "wav");
+    if (format != "wav" && format != "raw") {
+        std::cerr << "Unknown output format " << format.toStdString() << std::endl;
+        return 1;
+    }
+
+    QString error;
+    std::vector<TimedMidiEvent> events;
+    if (parser.isSet(midiOption) && !readMidiFile(parser.value(midiOption), events, error)) {
+        std::cerr << error.toStdString() << std::endl;
+        return 1;
+    }
+    if (parser.isSet(notesOption)) {
+        std::vector<TimedMidiEvent> scriptEvents;
+        if (!readNoteScript(parser.value(notesOption), scriptEvents, error)) {
+            std::cerr << error.toStdString() << std::endl;
+            return 1;
+        }
+        events.insert(events.end(), scriptEvents.begin(), scriptEvents.end());
+        std::stable_sort(events.begin(), events.end(),
+                         [](const TimedMidiEvent &a, const TimedMidiEvent &b) { return a.time < b.time; });
+    }
+
+    double lengthSeconds = events.empty() ? DEFAULT_LENGTH_SECONDS : events.back().time + DEFAULT_TAIL_SECONDS;
+    if (parser.isSet(lengthOption)) {
+        bool lengthOk;
+        lengthSeconds = parser.value(lengthOption).toDouble(&lengthOk);
+        if (!lengthOk || lengthSeconds < 0) {
+            std::cerr << "Length must be a positive number of seconds" << std::endl;
+            return 1;
+        }
+    }
+    auto frameCount = (uint64_t) std::llround(lengthSeconds * sampleRate);
+
+    MaximFrontend::maxim_initialize();
+
+    // share the editor's object cache, so projects that have been opened before load faster
+    auto dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    MaximFrontend::maxim_set_object_cache_directory(QDir(dataPath).filePath("cache").toStdString().c_str());
+
+    HeadlessRenderer renderer(sampleRate, bpm);
+    renderer.setFreezeControls(parser.isSet(freezeOption));
+    auto loadStart = std::chrono::steady_clock::now();
+    if (!renderer.load(projectPath, error)) {
+        std::cerr << error.toStdString() << std::endl;
+        return 1;
+    }
+    auto loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+    std::cout << "Loaded " << projectPath.toStdString() << " in " << loadSeconds << " s" << std::endl;
+
+    if (!renderer.hasAudioOutput()) {
+        std::cerr << "Warning: the project has no audio output, the output will be silent" << std::endl;
+    }
+    if (!events.empty() && !renderer.hasMidiInput()) {
+        std::cerr << "Warning: the project has no MIDI input, notes will be ignored" << std::endl;
+    }
+
+    std::vector<float> left(frameCount), right(frameCount);
+    renderer.setEvents(std::move(events));
+
+    auto renderStart = std::chrono::steady_clock::now();
+    renderer.render(frameCount, left.data(), right.data());
+    auto renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+
+    std::cout << "Rendered " << frameCount << " samples in " << renderSeconds << " s";
+    if (renderSeconds > 0) {
+        std::cout << " (" << (uint64_t)(frameCount / renderSeconds) << " samples/s, "
+                  << (frameCount / sampleRate) / renderSeconds << "x real-time)";
+    }
+    std::cout << std::endl;
+
+    QFile outputFile(outputPath);
+    if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        std::cerr << "Couldn't open " << outputPath.toStdString() << ": " << outputFile.errorString().toStdString()
+                  << std::endl;
+        return 1;
+    }
+    auto sampleData = interleave(left, right);
+    if (format == "wav") {
+        outputFile.write(buildWavHeader((uint32_t) sampleRate, (uint32_t) sampleData.size()));
+    }
+    outputFile.write(sampleData);
+    outputFile.close();
+
+    return 0;
+}
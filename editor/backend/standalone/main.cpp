@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include "../../AxiomApplication.h"
@@ -51,8 +52,7 @@ public:
 
     void previewEvent(AxiomBackend::MidiEvent event) override {
         if (midiInputPortal == -1) return;
-        auto lock = lockRuntime();
-        queueMidiEvent(0, (size_t) midiInputPortal, event);
+        queuePreviewEvent((size_t) midiInputPortal, event);
     }
 
 #ifdef PORTAUDIO
@@ -70,27 +70,41 @@ public:
         auto backend = (StandaloneAudioBackend *) userData;
         uint64_t processPos = 0;
 
-        auto outputNums = (float *) outputBuffer;
+        // the stream is non-interleaved, so we get a separate buffer for each channel
+        auto outputChannels = (float **) outputBuffer;
+
+        // The editor holds the runtime lock while it points the portals at new code. Rather than waiting for it, this
+        // buffer is left silent.
+        auto lock = backend->tryLockRuntime();
+        if (!lock.owns_lock()) {
+            std::fill(outputChannels[0], outputChannels[0] + framesPerBuffer, 0.f);
+            std::fill(outputChannels[1], outputChannels[1] + framesPerBuffer, 0.f);
+            return 0;
+        }
 
         auto sampleFrames64 = (uint64_t) framesPerBuffer;
         while (processPos < sampleFrames64) {
-            auto lock = backend->lockRuntime();
-            auto sampleAmount = backend->beginGenerate();
+            auto sampleAmount = std::min(backend->beginGenerate(), sampleFrames64 - processPos);
+            // an event due on this sample still needs the sample generated, so always make progress
+            if (sampleAmount == 0) sampleAmount = 1;
             auto endProcessPos = processPos + sampleAmount;
-            if (endProcessPos > sampleFrames64) endProcessPos = sampleFrames64;
-
-            for (auto i = processPos; i < endProcessPos; i++) {
-                backend->generate();
 
-                if (backend->outputPortal) {
-                    auto outputNum = **backend->outputPortal;
-                    *outputNums++ = outputNum.left;
-                    *outputNums++ = outputNum.right;
-                }
+            backend->clearPortalBuffers();
+            if (backend->outputPortal) {
+                backend->setPortalBuffers((size_t) backend->audioOutputPortal, outputChannels[0] + processPos,
+                                          outputChannels[1] + processPos);
+            } else {
+                std::fill(outputChannels[0] + processPos, outputChannels[0] + endProcessPos, 0.f);
+                std::fill(outputChannels[1] + processPos, outputChannels[1] + endProcessPos, 0.f);
+            }
 
-                if (backend->midiInputPortal != -1 && i == processPos) {
-                    backend->clearMidi((size_t) backend->midiInputPortal);
-                }
+            // MIDI events are only visible for the first sample of the block
+            backend->generateBlock(1);
+            if (backend->midiInputPortal != -1) {
+                backend->clearMidi((size_t) backend->midiInputPortal);
+            }
+            if (sampleAmount > 1) {
+                backend->generateBlock(sampleAmount - 1);
             }
 
             processPos = endProcessPos;
@@ -107,7 +121,8 @@ public:
         checkError(Pa_OpenDefaultStream(&stream,
                                         0, // no inputs
                                         2, // stereo output
-                                        paFloat32, 44100, paFramesPerBufferUnspecified, paCallback, this));
+                                        paFloat32 | paNonInterleaved, 44100, paFramesPerBufferUnspecified,
+                                        paCallback, this));
         checkError(Pa_StartStream(stream));
     }
 
@@ -1,5 +1,7 @@
 #include "AxiomVstPlugin.h"
 
+#include <algorithm>
+
 using namespace AxiomBackend;
 
 AxiomCommon::LazyInitializer<AxiomApplication> application;
@@ -44,47 +46,56 @@ void AxiomVstPlugin::processReplacing(float **inputs, float **outputs, VstInt32
         backend.setBpm((float) timeInfo->tempo);
     }
 
+    // The editor holds the runtime lock while it points the portals at new code. Rather than waiting for it, this
+    // buffer is left silent.
+    auto lock = backend.tryLockRuntime();
+    if (!lock.owns_lock()) {
+        for (VstInt32 outputIndex = 0; outputIndex < cEffect.numOutputs; outputIndex++) {
+            std::fill(outputs[outputIndex], outputs[outputIndex] + sampleFrames, 0.f);
+        }
+        return;
+    }
+
     auto sampleFrames64 = (uint64_t) sampleFrames;
     uint64_t processPos = 0;
     while (processPos < sampleFrames64) {
-        auto lock = backend.lockRuntime();
-        auto sampleAmount = backend.beginGenerate();
+        auto sampleAmount = std::min(backend.beginGenerate(), sampleFrames64 - processPos);
+        // an event due on this sample still needs the sample generated, so always make progress
+        if (sampleAmount == 0) sampleAmount = 1;
         auto endProcessPos = processPos + sampleAmount;
-        if (endProcessPos > sampleFrames64) endProcessPos = sampleFrames64;
-
-        for (auto i = processPos; i < endProcessPos; i++) {
-            for (size_t inputIndex = 0; inputIndex < expectedInputCount; inputIndex++) {
-                const auto &input = backend.audioInputs[inputIndex];
-                if (input) {
-                    auto &inputNum = **input->value;
-                    inputNum.left = inputs[inputIndex * 2][i];
-                    inputNum.right = inputs[inputIndex * 2 + 1][i];
-                    inputNum.form = AxiomBackend::NumForm::OSCILLATOR;
-                }
-            }
 
-            backend.generate();
-
-            for (size_t outputIndex = 0; outputIndex < expectedOutputCount; outputIndex++) {
-                const auto &output = backend.audioOutputs[outputIndex];
-                auto leftIndex = outputIndex * 2;
-                auto rightIndex = leftIndex + 1;
-
-                if (output) {
-                    auto outputNum = **output->value;
-                    outputs[leftIndex][i] = outputNum.left;
-                    outputs[rightIndex][i] = outputNum.right;
-                } else {
-                    outputs[leftIndex][i] = 0;
-                    outputs[rightIndex][i] = 0;
-                }
+        // the portals might have changed since the last block, so bind the host buffers every time
+        backend.clearPortalBuffers();
+        for (size_t inputIndex = 0; inputIndex < expectedInputCount; inputIndex++) {
+            const auto &input = backend.audioInputs[inputIndex];
+            if (input) {
+                backend.setPortalBuffers(input->portalIndex, inputs[inputIndex * 2] + processPos,
+                                         inputs[inputIndex * 2 + 1] + processPos);
             }
-
-            if (backend.midiInputPortal != -1 && i == processPos) {
-                backend.clearMidi((size_t) backend.midiInputPortal);
+        }
+        for (size_t outputIndex = 0; outputIndex < expectedOutputCount; outputIndex++) {
+            const auto &output = backend.audioOutputs[outputIndex];
+            auto leftIndex = outputIndex * 2;
+            auto rightIndex = leftIndex + 1;
+
+            if (output) {
+                backend.setPortalBuffers(output->portalIndex, outputs[leftIndex] + processPos,
+                                         outputs[rightIndex] + processPos);
+            } else {
+                std::fill(outputs[leftIndex] + processPos, outputs[leftIndex] + endProcessPos, 0.f);
+                std::fill(outputs[rightIndex] + processPos, outputs[rightIndex] + endProcessPos, 0.f);
             }
         }
 
+        // MIDI events are only visible for the first sample of the block
+        backend.generateBlock(1);
+        if (backend.midiInputPortal != -1) {
+            backend.clearMidi((size_t) backend.midiInputPortal);
+        }
+        if (sampleAmount > 1) {
+            backend.generateBlock(sampleAmount - 1);
+        }
+
         processPos = endProcessPos;
     }
 
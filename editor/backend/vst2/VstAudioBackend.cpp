@@ -64,8 +64,7 @@ std::string VstAudioBackend::getPortalLabel(size_t portalIndex) const {
 
 void VstAudioBackend::previewEvent(AxiomBackend::MidiEvent event) {
     if (midiInputPortal == -1) return;
-    auto lock = lockRuntime();
-    queueMidiEvent(0, (size_t) midiInputPortal, event);
+    queuePreviewEvent((size_t) midiInputPortal, event);
 }
 
 void VstAudioBackend::automationValueChanged(size_t portalId, AxiomBackend::NumValue value) {
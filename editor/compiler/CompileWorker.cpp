@@ -0,0 +1,92 @@
+#include "CompileWorker.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QMetaObject>
+
+#include "interface/Runtime.h"
+
+using namespace MaximCompiler;
+
+CompileWorker::CompileWorker(MaximCompiler::Runtime *runtime, std::function<void()> preparedCallback)
+    : runtime(runtime), preparedCallback(std::move(preparedCallback)), self(std::make_shared<CompileWorker *>(this)),
+      thread(&CompileWorker::run, this) {}
+
+CompileWorker::~CompileWorker() {
+    {
+        std::lock_guard lock(mutex);
+        isStopping = true;
+    }
+    condition.notify_all();
+    thread.join();
+}
+
+void CompileWorker::queue(MaximCompiler::Transaction transaction) {
+    {
+        std::lock_guard lock(mutex);
+        if (queuedTransaction) {
+            queuedTransaction->merge(std::move(transaction));
+        } else {
+            queuedTransaction = std::move(transaction);
+        }
+    }
+    condition.notify_all();
+}
+
+std::optional<Transaction> CompileWorker::takeQueued() {
+    std::unique_lock lock(mutex);
+    condition.wait(lock, [this]() { return !isBuilding; });
+
+    std::optional<Transaction> result;
+    result.swap(queuedTransaction);
+    return result;
+}
+
+bool CompileWorker::hasPrepared() {
+    std::lock_guard lock(mutex);
+    return isPrepared;
+}
+
+uint64_t CompileWorker::preparedGeneration() {
+    std::lock_guard lock(mutex);
+    return builtGeneration;
+}
+
+void CompileWorker::finished() {
+    {
+        std::lock_guard lock(mutex);
+        isPrepared = false;
+    }
+    condition.notify_all();
+}
+
+void CompileWorker::run() {
+    std::unique_lock lock(mutex);
+    while (true) {
+        // only start building once the last build has been committed, so builds can keep merging in the meantime
+        condition.wait(lock, [this]() { return isStopping || (queuedTransaction && !isPrepared); });
+        if (isStopping) return;
+
+        auto transaction = std::move(*queuedTransaction);
+        queuedTransaction.reset();
+        isBuilding = true;
+        auto generation = transaction.generation();
+
+        lock.unlock();
+        runtime->prepareCommit(std::move(transaction));
+        lock.lock();
+
+        isBuilding = false;
+        isPrepared = true;
+        builtGeneration = generation;
+        condition.notify_all();
+
+        std::weak_ptr<CompileWorker *> weakSelf = self;
+        QMetaObject::invokeMethod(QCoreApplication::instance(),
+                                  [weakSelf]() {
+                                      if (auto worker = weakSelf.lock()) {
+                                          (*worker)->preparedCallback();
+                                      }
+                                  },
+                                  Qt::QueuedConnection);
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "interface/Transaction.h"
+
+namespace MaximCompiler {
+
+    class Runtime;
+
+    // Builds transactions on a background thread with `Runtime::prepareCommit`, so the UI thread doesn't stall while
+    // LLVM runs. Transactions queued while a build is running are merged together and built at once.
+    // Once a build is done, `preparedCallback` is invoked on the UI thread, which should call `Runtime::finishCommit`,
+    // publish and wait for the new code, and then call `finished` to let the next build begin.
+    class CompileWorker {
+    public:
+        CompileWorker(Runtime *runtime, std::function<void()> preparedCallback);
+
+        ~CompileWorker();
+
+        // Queues a transaction to be built. Should be called from the UI thread.
+        void queue(Transaction transaction);
+
+        // Waits for any running build to complete, and takes the transaction waiting to be built, if any. Use this
+        // before building a transaction on the UI thread, so transactions are still committed in order. Should be
+        // called from the UI thread.
+        std::optional<Transaction> takeQueued();
+
+        // Returns true if a build is complete and waiting for `finishCommit` to be called.
+        bool hasPrepared();
+
+        // The generation of the transaction that was last built, see `Transaction::generation`.
+        uint64_t preparedGeneration();
+
+        // Signals that the prepared build has been committed. Should be called from the UI thread.
+        void finished();
+
+    private:
+        Runtime *runtime;
+        std::function<void()> preparedCallback;
+
+        // used to ignore callbacks that were posted to the UI thread after the worker was destroyed
+        std::shared_ptr<CompileWorker *> self;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::optional<Transaction> queuedTransaction;
+        bool isBuilding = false;
+        bool isPrepared = false;
+        uint64_t builtGeneration = 0;
+        bool isStopping = false;
+        std::thread thread;
+
+        void run();
+    };
+}
@@ -242,7 +242,7 @@ void SurfaceMirBuilder::build(MaximCompiler::Transaction *transaction, AxiomMode
                 continue;
             }
 
-            customNode->setCompileMeta(AxiomModel::NodeCompileMeta(nodeIndex));
+            customNode->setCompileMeta(AxiomModel::NodeCompileMeta(nodeIndex, transaction->generation()));
             auto mirNode = mir.addCustomNode(customNode->getRuntimeId());
 
             // we need a sorted list of controls
@@ -265,7 +265,7 @@ void SurfaceMirBuilder::build(MaximCompiler::Transaction *transaction, AxiomMode
 
             nodeIndex++;
         } else if (auto groupNode = dynamic_cast<AxiomModel::GroupNode *>(node)) {
-            groupNode->setCompileMeta(AxiomModel::NodeCompileMeta(nodeIndex));
+            groupNode->setCompileMeta(AxiomModel::NodeCompileMeta(nodeIndex, transaction->generation()));
             auto groupSurface = *groupNode->nodes().value();
             auto mirNode = mir.addGroupNode(groupSurface->getRuntimeId());
             auto &portalControlGroups = groupSurface->compileMeta()->portals;
@@ -299,7 +299,7 @@ void SurfaceMirBuilder::build(MaximCompiler::Transaction *transaction, AxiomMode
             }
         }
 
-        rootSurface->setCompileMeta(AxiomModel::RootSurfaceCompileMeta(std::move(portals)));
+        rootSurface->setCompileMeta(AxiomModel::RootSurfaceCompileMeta(std::move(portals), transaction->generation()));
 
         return;
     }
@@ -32,3 +32,11 @@ ControlRef Block::getControl(size_t index) const {
 Block Block::clone() const {
     return Block(MaximFrontend::maxim_block_clone(get()));
 }
+
+bool Block::freezeControl(size_t index, const AxiomModel::NumValue &value) {
+    return MaximFrontend::maxim_block_freeze_control(get(), index, value.left, value.right, (uint8_t) value.form);
+}
+
+bool Block::setControlStatic(size_t index) {
+    return MaximFrontend::maxim_block_set_control_static(get(), index);
+}
@@ -6,6 +6,7 @@
 #include "ControlRef.h"
 #include "Error.h"
 #include "OwnedObject.h"
+#include "editor/model/Value.h"
 
 namespace MaximCompiler {
 
@@ -24,5 +25,14 @@ namespace MaximCompiler {
         ControlRef getControl(size_t index) const;
 
         Block clone() const;
+
+        // Bakes `value` into the block in place of reads from the control, so code depending on it can be constant
+        // folded. Returns false if the control can't be frozen because the block writes to it, or if the value's form
+        // isn't valid.
+        bool freezeControl(size_t index, const AxiomModel::NumValue &value);
+
+        // Marks the control as only being changed by the editor between buffers, so code depending on it can be run at
+        // control rate. Controls that are connected or exposed can be driven every sample and mustn't be marked.
+        bool setControlStatic(size_t index);
     };
 }
@@ -9,6 +9,7 @@ namespace MaximFrontend {
 
     using MaximRuntime = void;
     using MaximRuntimeRef = MaximRuntime;
+    using MaximPlayer = void;
 
     using MaximTransaction = void;
     using MaximTransactionRef = MaximTransaction;
@@ -45,18 +46,36 @@ namespace MaximFrontend {
         void *ui;
     };
 
+    struct CommitStats {
+        uint32_t commitCount;
+        double patchSeconds;
+        double codegenSeconds;
+        double deploySeconds;
+    };
+
     extern "C" {
     void maxim_initialize();
+    void maxim_set_object_cache_directory(const char *path);
 
     MaximRuntime *maxim_create_runtime(bool includeUi, bool minSize);
     void maxim_destroy_runtime(MaximRuntime *);
 
-    uint64_t maxim_allocate_id(MaximRuntimeRef *runtime);
-    void maxim_run_update(MaximRuntimeRef *runtime);
-    void maxim_set_bpm(MaximRuntimeRef *runtime, float bpm);
-    float maxim_get_bpm(MaximRuntimeRef *runtime);
-    void maxim_set_sample_rate(MaximRuntimeRef *runtime, float sample_rate);
-    float maxim_get_sample_rate(MaximRuntimeRef *runtime);
+    MaximPlayer *maxim_get_player(MaximRuntimeRef *runtime);
+    uint64_t maxim_allocate_id(MaximPlayer *player);
+    void maxim_run_update(MaximPlayer *player);
+    void maxim_run_block(MaximPlayer *player, uint32_t frames, const float *const *in_buffers,
+                         float *const *out_buffers, uint32_t out_buffer_count);
+    void maxim_set_bpm(MaximPlayer *player, float bpm);
+    float maxim_get_bpm(MaximPlayer *player);
+    void maxim_set_sample_rate(MaximPlayer *player, float sample_rate);
+    float maxim_get_sample_rate(MaximPlayer *player);
+    void maxim_set_voice_sleep(MaximRuntimeRef *runtime, float threshold, uint32_t samples);
+    uint64_t maxim_take_slept_voice_updates(MaximRuntimeRef *runtime);
+    uint64_t maxim_get_arena_heap_allocs(MaximRuntimeRef *runtime);
+    void maxim_set_control_rate_interval(MaximRuntimeRef *runtime, uint32_t interval);
+    void maxim_set_worker_threads(MaximRuntimeRef *runtime, uint32_t thread_count);
+    bool maxim_eval_math(MaximRuntimeRef *runtime, const char *name, bool precise, const float *a, const float *b,
+                         float *out, size_t count);
     bool maxim_is_node_extracted(MaximRuntimeRef *runtime, uint64_t surface, size_t node);
     void maxim_convert_num(MaximRuntimeRef *runtime, void *result, uint8_t targetForm, const void *input);
 
@@ -74,6 +93,7 @@ namespace MaximFrontend {
     MaximTransaction *maxim_create_transaction();
     void maxim_destroy_transaction(MaximTransaction *);
     void maxim_print_transaction_to_stdout(MaximTransactionRef *);
+    void maxim_merge_transaction(MaximTransactionRef *target, MaximTransaction *source);
 
     MaximVarType *maxim_vartype_num();
     MaximVarType *maxim_vartype_midi();
@@ -110,6 +130,8 @@ namespace MaximFrontend {
                              MaximError **fail_error_out);
     void maxim_destroy_block(MaximBlock *);
     MaximBlock *maxim_block_clone(MaximBlockRef *);
+    bool maxim_block_freeze_control(MaximBlockRef *block, size_t control, float left, float right, uint8_t form);
+    bool maxim_block_set_control_static(MaximBlockRef *block, size_t control);
 
     const char *maxim_error_get_description(MaximErrorRef *);
     SourceRange maxim_error_get_range(MaximErrorRef *);
@@ -123,6 +145,16 @@ namespace MaximFrontend {
     bool maxim_control_get_read(MaximBlockControlRef *control);
 
     void maxim_commit(MaximRuntimeRef *runtime, MaximTransaction *transaction);
+    void maxim_prepare_commit(MaximRuntimeRef *runtime, MaximTransaction *transaction);
+    void maxim_finish_commit(MaximRuntimeRef *runtime);
+    void maxim_publish_commit(MaximRuntimeRef *runtime);
+    void maxim_wait_for_commit(MaximRuntimeRef *runtime);
+    CommitStats maxim_take_commit_stats(MaximRuntimeRef *runtime);
+    char *maxim_export_object(MaximRuntimeRef *runtime, const char *targetTriple, const char *cpu,
+                              const char *features, bool minSize, float sampleRate, float bpm, uint64_t arenaBytes,
+                              const char *path);
+    bool maxim_is_surface_changed(MaximRuntimeRef *runtime, uint64_t surface);
+    bool maxim_is_block_changed(MaximRuntimeRef *runtime, uint64_t block);
 
     size_t maxim_get_function_table_size();
     const char *maxim_get_function_table_entry(size_t index);
@@ -5,59 +5,150 @@
 using namespace MaximCompiler;
 
 Runtime::Runtime(bool includeUi, bool minSize)
-    : OwnedObject(MaximFrontend::maxim_create_runtime(includeUi, minSize), &MaximFrontend::maxim_destroy_runtime) {}
+    : OwnedObject(MaximFrontend::maxim_create_runtime(includeUi, minSize), &MaximFrontend::maxim_destroy_runtime),
+      player(MaximFrontend::maxim_get_player(get())), mutex(std::make_unique<std::mutex>()) {}
 
 uint64_t Runtime::nextId() {
-    return MaximFrontend::maxim_allocate_id(get());
+    return MaximFrontend::maxim_allocate_id(player);
 }
 
 void Runtime::runUpdate() {
-    MaximFrontend::maxim_run_update(get());
+    MaximFrontend::maxim_run_update(player);
+}
+
+void Runtime::runBlock(uint32_t frames, const float *const *inputBuffers, float *const *outputBuffers,
+                       size_t outputCount) {
+    MaximFrontend::maxim_run_block(player, frames, inputBuffers, outputBuffers, (uint32_t) outputCount);
 }
 
 void Runtime::setBpm(float bpm) {
-    MaximFrontend::maxim_set_bpm(get(), bpm);
+    MaximFrontend::maxim_set_bpm(player, bpm);
 }
 
 float Runtime::getBpm() {
-    return MaximFrontend::maxim_get_bpm(get());
+    return MaximFrontend::maxim_get_bpm(player);
 }
 
 void Runtime::setSampleRate(float sampleRate) {
-    MaximFrontend::maxim_set_sample_rate(get(), sampleRate);
+    MaximFrontend::maxim_set_sample_rate(player, sampleRate);
 }
 
 float Runtime::getSampleRate() {
-    return MaximFrontend::maxim_get_sample_rate(get());
+    return MaximFrontend::maxim_get_sample_rate(player);
+}
+
+void Runtime::setVoiceSleep(float threshold, uint32_t samples) {
+    std::lock_guard lock(*mutex);
+    MaximFrontend::maxim_set_voice_sleep(get(), threshold, samples);
+}
+
+uint64_t Runtime::takeSleptVoiceUpdates() {
+    std::lock_guard lock(*mutex);
+    return MaximFrontend::maxim_take_slept_voice_updates(get());
+}
+
+uint64_t Runtime::arenaHeapAllocs() {
+    std::lock_guard lock(*mutex);
+    return MaximFrontend::maxim_get_arena_heap_allocs(get());
+}
+
+void Runtime::setControlRateInterval(uint32_t interval) {
+    std::lock_guard lock(*mutex);
+    MaximFrontend::maxim_set_control_rate_interval(get(), interval);
+}
+
+void Runtime::setWorkerThreads(uint32_t threadCount) {
+    std::lock_guard lock(*mutex);
+    MaximFrontend::maxim_set_worker_threads(get(), threadCount);
+}
+
+bool Runtime::evalMath(const QString &name, bool precise, const float *a, const float *b, float *out, size_t count) {
+    std::lock_guard lock(*mutex);
+    return MaximFrontend::maxim_eval_math(get(), name.toUtf8().constData(), precise, a, b, out, count);
 }
 
 void Runtime::commit(MaximCompiler::Transaction transaction) {
+    std::lock_guard lock(*mutex);
     MaximFrontend::maxim_commit(get(), transaction.release());
 }
 
+void Runtime::prepareCommit(MaximCompiler::Transaction transaction) {
+    std::lock_guard lock(*mutex);
+    MaximFrontend::maxim_prepare_commit(get(), transaction.release());
+}
+
+void Runtime::finishCommit() {
+    std::lock_guard lock(*mutex);
+    MaximFrontend::maxim_finish_commit(get());
+}
+
+void Runtime::publishCommit() {
+    std::lock_guard lock(*mutex);
+    MaximFrontend::maxim_publish_commit(get());
+}
+
+void Runtime::waitForCommit() {
+    std::lock_guard lock(*mutex);
+    MaximFrontend::maxim_wait_for_commit(get());
+}
+
+MaximFrontend::CommitStats Runtime::takeCommitStats() {
+    std::lock_guard lock(*mutex);
+    return MaximFrontend::maxim_take_commit_stats(get());
+}
+
+bool Runtime::exportObject(const ExportSettings &settings, const QString &path, QString &error) {
+    std::lock_guard lock(*mutex);
+    auto errorStr = MaximFrontend::maxim_export_object(
+        get(), settings.targetTriple.toStdString().c_str(), settings.cpu.toStdString().c_str(),
+        settings.features.toStdString().c_str(), settings.minSize, settings.sampleRate, settings.bpm,
+        settings.arenaBytes, path.toStdString().c_str());
+    if (!errorStr) return true;
+
+    error = QString::fromUtf8(errorStr);
+    MaximFrontend::maxim_destroy_string(errorStr);
+    return false;
+}
+
+bool Runtime::isSurfaceChanged(uint64_t surface) {
+    std::lock_guard lock(*mutex);
+    return MaximFrontend::maxim_is_surface_changed(get(), surface);
+}
+
+bool Runtime::isBlockChanged(uint64_t block) {
+    std::lock_guard lock(*mutex);
+    return MaximFrontend::maxim_is_block_changed(get(), block);
+}
+
 bool Runtime::isNodeExtracted(uint64_t surface, size_t node) {
+    std::lock_guard lock(*mutex);
     return MaximFrontend::maxim_is_node_extracted(get(), surface, node);
 }
 
 AxiomModel::NumValue Runtime::convertNum(AxiomModel::FormType targetForm, const AxiomModel::NumValue &value) {
+    std::lock_guard lock(*mutex);
     AxiomModel::NumValue result;
     MaximFrontend::maxim_convert_num(get(), &result, (uint8_t) targetForm, &value);
     return result;
 }
 
 void *Runtime::getPortalPtr(size_t portal) {
+    std::lock_guard lock(*mutex);
     return MaximFrontend::maxim_get_portal_ptr(get(), portal);
 }
 
 void *Runtime::getRootPtr() {
+    std::lock_guard lock(*mutex);
     return MaximFrontend::maxim_get_root_ptr(get());
 }
 
 void *Runtime::getNodePtr(uint64_t surface, void *surfacePtr, size_t node) {
+    std::lock_guard lock(*mutex);
     return MaximFrontend::maxim_get_node_ptr(get(), surface, surfacePtr, node);
 }
 
 uint32_t *Runtime::getExtractedBitmaskPtr(uint64_t surface, void *surfacePtr, size_t node) {
+    std::lock_guard lock(*mutex);
     return MaximFrontend::maxim_get_extracted_bitmask_ptr(get(), surface, surfacePtr, node);
 }
 
@@ -70,5 +161,6 @@ void *Runtime::getBlockPtr(void *nodePtr) {
 }
 
 MaximFrontend::ControlPointers Runtime::getControlPtrs(uint64_t block, void *blockPtr, size_t control) {
+    std::lock_guard lock(*mutex);
     return MaximFrontend::maxim_get_control_ptrs(get(), block, blockPtr, control);
 }
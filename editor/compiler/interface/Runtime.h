@@ -1,19 +1,46 @@
 #pragma once
 
+#include <QtCore/QString>
+#include <memory>
+#include <mutex>
+
 #include "OwnedObject.h"
 #include "Transaction.h"
 #include "editor/model/Value.h"
 
 namespace MaximCompiler {
 
+    struct ExportSettings {
+        // An empty triple exports for the machine the editor is running on
+        QString targetTriple;
+        QString cpu;
+        QString features;
+        bool minSize = false;
+        float sampleRate = 44100;
+        float bpm = 60;
+        // Memory for delay buffers is allocated from a static buffer of this size in the exported object, anything that
+        // doesn't fit is allocated from the heap
+        uint64_t arenaBytes = 32 * 1024 * 1024;
+    };
+
+    // Commits can be prepared on a worker thread while the UI thread uses the runtime, so every call that touches the
+    // runtime's compiler state takes a lock, and waits while a commit is being prepared. The calls the audio thread
+    // makes (`runUpdate`, `runBlock` and the BPM and sample rate) go through the runtime's player instead, and never
+    // wait.
     class Runtime : public OwnedObject {
     public:
         Runtime(bool includeUi, bool minSize);
 
         uint64_t nextId();
 
+        // `runUpdate` and `runBlock` can be called from the audio thread while a commit is being prepared, finished or
+        // published on another thread, and never wait for it. If new code is being switched to when they're called,
+        // they do nothing, and `runBlock` fills the `outputCount` buffers in `outputBuffers` with silence.
         void runUpdate();
 
+        void runBlock(uint32_t frames, const float *const *inputBuffers, float *const *outputBuffers,
+                      size_t outputCount);
+
         void setBpm(float bpm);
 
         float getBpm();
@@ -22,8 +49,63 @@ namespace MaximCompiler {
 
         float getSampleRate();
 
+        // Voices in polyphonic groups whose outputs stay below `threshold` for `samples` samples after their note has
+        // been released are put to sleep until they receive a MIDI event. Zero samples disables sleeping.
+        void setVoiceSleep(float threshold, uint32_t samples);
+
+        // Returns the number of voice updates skipped by sleeping since the last call, and resets it.
+        uint64_t takeSleptVoiceUpdates();
+
+        // Number of times generated code has had to allocate from the heap because the runtime's preallocated arena
+        // was full. Ideally always zero, since these allocations can happen on the audio thread.
+        uint64_t arenaHeapAllocs();
+
+        // Code that only depends on control values, globals and MIDI notes is re-run at most once every `interval`
+        // samples. One keeps every change sample-accurate.
+        void setControlRateInterval(uint32_t interval);
+
+        // Spreads the voices of extracted groups across this many worker threads, on top of the thread the runtime is
+        // run from. Groups containing delays, graphs, rolls or scopes always run on the calling thread. Zero (the
+        // default) disables the workers.
+        void setWorkerThreads(uint32_t threadCount);
+
+        // Runs one of the JIT math functions (e.g. "sin", "pow") over `count` values. `b` is only read by two-argument
+        // functions and can be null otherwise. Returns false if there is no function with that name.
+        bool evalMath(const QString &name, bool precise, const float *a, const float *b, float *out, size_t count);
+
         void commit(Transaction transaction);
 
+        // Builds a transaction without affecting the running code, so it can be called without the model's runtime lock
+        // held. The changes are applied in `finishCommit`.
+        void prepareCommit(Transaction transaction);
+
+        // Deploys any transactions built by `prepareCommit` next to the running code. The new code isn't run until
+        // it's been published.
+        void finishCommit();
+
+        // Hands the code deployed by `finishCommit` to the audio thread, which switches to it at the start of its next
+        // update. This doesn't block, and `getPortalPtr` and `getRootPtr` point into the new code afterwards, so the
+        // backend's portals can be updated at the same time.
+        void publishCommit();
+
+        // Waits for the audio thread to switch to the published code, then frees the code it replaced. If nothing is
+        // running the runtime, it's switched on this thread instead. Values written through the new pointers before
+        // this returns may be overwritten when the new code is constructed.
+        void waitForCommit();
+
+        // Returns the time spent in each commit phase since the last call, and resets it.
+        MaximFrontend::CommitStats takeCommitStats();
+
+        // Builds the committed code into an object file that can be linked into the replayer. Returns false and sets
+        // `error` if the export failed.
+        bool exportObject(const ExportSettings &settings, const QString &path, QString &error);
+
+        // Returns true if the surface or block has changed in the commit waiting for `finishCommit`. State in other
+        // surfaces and blocks is kept by the runtime, so only controls in changed ones need to be saved and restored.
+        bool isSurfaceChanged(uint64_t surface);
+
+        bool isBlockChanged(uint64_t block);
+
         bool isNodeExtracted(uint64_t surface, size_t node);
 
         AxiomModel::NumValue convertNum(AxiomModel::FormType targetForm, const AxiomModel::NumValue &value);
@@ -41,5 +123,9 @@ namespace MaximCompiler {
         void *getBlockPtr(void *nodePtr);
 
         MaximFrontend::ControlPointers getControlPtrs(uint64_t block, void *blockPtr, size_t control);
+
+    private:
+        void *player;
+        std::unique_ptr<std::mutex> mutex;
     };
 }
@@ -1,5 +1,7 @@
 #include "Transaction.h"
 
+#include <algorithm>
+
 #include "Frontend.h"
 
 using namespace MaximCompiler;
@@ -19,6 +21,11 @@ void Transaction::buildBlock(MaximCompiler::Block block) {
     MaximFrontend::maxim_build_block(get(), block.release());
 }
 
+void Transaction::merge(MaximCompiler::Transaction other) {
+    _generation = std::max(_generation, other._generation);
+    MaximFrontend::maxim_merge_transaction(get(), other.release());
+}
+
 void Transaction::printToStdout() const {
     MaximFrontend::maxim_print_transaction_to_stdout(get());
 }
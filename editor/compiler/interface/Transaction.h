@@ -19,6 +19,18 @@ namespace MaximCompiler {
 
         void buildBlock(Block block);
 
+        // Merges a newer transaction into this one, replacing any surfaces, blocks or root it also contains.
+        void merge(Transaction other);
+
+        // Used by the model to tell which objects' compile meta matches the running code, since objects can be rebuilt
+        // while an older transaction is still waiting to be committed. Merged transactions take the newest generation.
+        uint64_t generation() const { return _generation; }
+
+        void setGeneration(uint64_t generation) { _generation = generation; }
+
         void printToStdout() const;
+
+    private:
+        uint64_t _generation = 0;
     };
 }
@@ -1,15 +1,23 @@
 #include "ConnectionWire.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "../util.h"
 #include "grid/GridSurface.h"
 
 using namespace AxiomModel;
 
+// what the router charges for each step of a route, see `Grid::findPath`
+static constexpr float EMPTY_CELL_COST = 1;
+static constexpr float FILLED_CELL_COST = 10;
+static constexpr float DIR_CHANGE_COST = 4;
+
 ConnectionWire::ConnectionWire(AxiomModel::GridSurface *grid, WireGrid *wireGrid, WireType wireType,
                                const QPointF &startPos, const QPointF &endPos)
     : _grid(grid), _wireGrid(wireGrid), _wireType(wireType), _startPos(startPos), _endPos(endPos) {
-    _grid->gridChanged.connectTo(this, &ConnectionWire::updateRoute);
-    _wireGrid->gridChanged.connectTo(this, &ConnectionWire::updateLineIndices);
+    _grid->gridChanged.connectTo(this, &ConnectionWire::gridChanged);
+    _wireGrid->gridChanged.connectTo(this, &ConnectionWire::wireGridChanged);
     updateRoute();
 }
 
@@ -21,7 +29,7 @@ void ConnectionWire::setStartPos(const QPointF &startPos) {
     if (startPos != _startPos) {
         _startPos = startPos;
         startPosChanged(startPos);
-        updateRoute();
+        invalidateRoute();
     }
 }
 
@@ -29,7 +37,7 @@ void ConnectionWire::setEndPos(const QPointF &endPos) {
     if (endPos != _endPos) {
         _endPos = endPos;
         endPosChanged(endPos);
-        updateRoute();
+        invalidateRoute();
     }
 }
 
@@ -100,17 +108,81 @@ void ConnectionWire::updateEnabled() {
     }
 }
 
+void ConnectionWire::invalidateRoute() {
+    // the ends can move many times in a frame while dragging, so wait for the grid to be flushed before routing
+    _isRouteDirty = true;
+    _grid->setDirty();
+}
+
+void ConnectionWire::gridChanged(const ChangedRegion &changedRegion) {
+    // without a route, any freed cell could be the one that lets the ends connect
+    if (_isRouteDirty || _route.empty() || changedRegion.intersects(_routeBounds)) {
+        updateRoute();
+    }
+}
+
+void ConnectionWire::wireGridChanged(const ChangedRegion &changedRegion) {
+    if (_areLineIndicesDirty || changedRegion.intersects(_routeBounds)) {
+        updateLineIndices();
+    }
+}
+
 void ConnectionWire::updateRoute() {
-    clearWireGrid(_route);
-    _route = _grid->grid().findPath(QPoint(_startPos.x(), _startPos.y()), QPoint(_endPos.x(), _endPos.y()), 1, 10, 4);
-    setWireGrid(_route);
+    _isRouteDirty = false;
+    auto newRoute =
+        _grid->grid().findPath(QPoint(_startPos.x(), _startPos.y()), QPoint(_endPos.x(), _endPos.y()),
+                               EMPTY_CELL_COST, FILLED_CELL_COST, DIR_CHANGE_COST);
+
+    // leaving the wire grid alone if the route is the same means other wires don't need to update either
+    if (newRoute != _route) {
+        clearWireGrid(_route);
+        _route = std::move(newRoute);
+        setWireGrid(_route);
+        _areLineIndicesDirty = true;
+    }
+    _routeBounds = getRouteBounds();
 }
 
 void ConnectionWire::updateLineIndices() {
+    _areLineIndicesDirty = false;
     _lineIndices = getLineIndices(_route);
     routeChanged(_route, _lineIndices);
 }
 
+QRect ConnectionWire::getRouteBounds() const {
+    // A cheaper route costs less than this one, and every step costs at least one, so it's shorter than this route's
+    // cost. Each cell a route strays outside the box between the ends adds two steps over the Manhattan distance, so a
+    // cheaper route can't go further out than the difference, and neither can this one. Changes outside these bounds
+    // can't make a cheaper route possible, or block this one.
+    auto startPos = QPoint(_startPos.x(), _startPos.y());
+    auto endPos = QPoint(_endPos.x(), _endPos.y());
+    auto distance = (endPos - startPos).manhattanLength();
+    auto margin = std::max(0, (int) std::ceil(getRouteCost() - distance));
+    return AxiomUtil::makeRect(startPos, endPos).adjusted(-margin, -margin, margin, margin);
+}
+
+float ConnectionWire::getRouteCost() const {
+    float cost = 0;
+    auto lastDir = QPoint(0, 0);
+    for (size_t routeIndex = 1; routeIndex < _route.size(); routeIndex++) {
+        auto lastPoint = _route[routeIndex - 1];
+        auto currentPoint = _route[routeIndex];
+        auto delta = currentPoint - lastPoint;
+        auto dir = QPoint((delta.x() > 0) - (delta.x() < 0), (delta.y() > 0) - (delta.y() < 0));
+
+        // the first step counts as a change of direction too
+        if (dir != lastDir) cost += DIR_CHANGE_COST;
+        lastDir = dir;
+
+        auto pos = lastPoint;
+        while (pos != currentPoint) {
+            pos += dir;
+            cost += _grid->grid().getCell(pos) ? FILLED_CELL_COST : EMPTY_CELL_COST;
+        }
+    }
+    return cost;
+}
+
 void ConnectionWire::setWireGrid(const std::deque<QPoint> &route) {
     for (size_t routeIndex = 1; routeIndex < route.size(); routeIndex++) {
         auto lastPoint = route[routeIndex - 1];
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QtCore/QPointF>
+#include <QtCore/QRect>
 #include <deque>
 
 #include "WireGrid.h"
@@ -77,6 +78,12 @@ namespace AxiomModel {
         QPointF _endPos;
         std::deque<QPoint> _route;
         std::vector<LineIndex> _lineIndices;
+
+        // the cells the route passes through or could be shortened through, so grid changes outside of them can be
+        // ignored
+        QRect _routeBounds;
+        bool _isRouteDirty = false;
+        bool _areLineIndicesDirty = false;
         ActiveState activeState = ActiveState::NONE;
         bool _startActive = false;
         bool _endActive = false;
@@ -85,10 +92,20 @@ namespace AxiomModel {
         bool _endEnabled = true;
         bool _enabled = true;
 
+        void invalidateRoute();
+
+        void gridChanged(const ChangedRegion &changedRegion);
+
+        void wireGridChanged(const ChangedRegion &changedRegion);
+
         void updateRoute();
 
         void updateLineIndices();
 
+        QRect getRouteBounds() const;
+
+        float getRouteCost() const;
+
         void updateActive();
 
         void updateEnabled();
@@ -10,10 +10,9 @@ LibraryEntry::LibraryEntry(QString name, const QUuid &baseUuid, const QUuid &mod
                            std::unique_ptr<AxiomModel::ModelRoot> root)
     : _name(std::move(name)), _baseUuid(baseUuid), _modificationUuid(modificationUuid),
       _modificationDateTime(modificationDateTime), _tags(std::move(tags)), _root(std::move(root)) {
-    auto rootSurfaces = findChildren(_root->nodeSurfaces().sequence(), QUuid());
+    auto rootSurfaces = findChildren<ModuleSurface *>(_root->pool(), QUuid());
     assert(rootSurfaces.size() == 1);
-    _rootSurface = dynamic_cast<ModuleSurface *>(*AxiomCommon::takeAt(rootSurfaces, 0));
-    assert(_rootSurface);
+    _rootSurface = *AxiomCommon::takeAt(rootSurfaces, 0);
     _rootSurface->setEntry(this);
 
     _root->history().stackChanged.connectTo(this, &LibraryEntry::modified);
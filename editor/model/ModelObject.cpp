@@ -11,13 +11,31 @@
 
 using namespace AxiomModel;
 
+static size_t getDepth(ModelRoot *root, const QUuid &parentUuid) {
+    // parents are always added to the pool before their children, so the parent's depth is already known
+    auto parent = root->pool().sequence().sequence().find(parentUuid);
+    if (!parent) return 0;
+
+    auto parentObj = dynamic_cast<ModelObject *>(*parent);
+    return parentObj ? parentObj->depth() + 1 : 0;
+}
+
 ModelObject::ModelObject(ModelType modelType, const QUuid &uuid, const QUuid &parentUuid, ModelRoot *root)
-    : PoolObject(uuid, parentUuid, &root->pool()), _modelType(modelType), _root(root) {}
+    : PoolObject(uuid, parentUuid, &root->pool()), _modelType(modelType), _root(root),
+      _depth(getDepth(root, parentUuid)) {
+    // new objects haven't been built yet
+    setDirty();
+}
 
 AxiomCommon::BoxedSequence<ModelObject *> ModelObject::links() {
     return AxiomCommon::boxSequence(AxiomCommon::blank<ModelObject *>());
 }
 
+void ModelObject::setDirty() {
+    _isDirty = true;
+    _root->markDirty(this);
+}
+
 void ModelObject::remove() {
     removed();
     PoolObject::remove();
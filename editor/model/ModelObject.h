@@ -29,12 +29,19 @@ namespace AxiomModel {
 
         ModelRoot *root() const { return _root; }
 
+        // The number of ancestors the object has, used to build children before their parents.
+        size_t depth() const { return _depth; }
+
         virtual QString debugName() = 0;
 
         bool isDirty() const { return _isDirty; }
 
         void clearDirty() { _isDirty = false; }
 
+        // Marks the object to be built on the next compile, and queues it in the root so only dirty objects need to
+        // be visited.
+        void setDirty();
+
         virtual void saveState() {}
 
         virtual void restoreState() {}
@@ -47,12 +54,10 @@ namespace AxiomModel {
 
         void remove() override;
 
-    protected:
-        void setDirty() { _isDirty = true; }
-
     private:
         ModelType _modelType;
         ModelRoot *_root;
-        bool _isDirty = true;
+        size_t _depth;
+        bool _isDirty = false;
     };
 }
@@ -1,21 +1,51 @@
 #include "ModelRoot.h"
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <vector>
 
 #include "../backend/AudioBackend.h"
 #include "IdentityReferenceMapper.h"
 #include "ModelObject.h"
 #include "PoolOperators.h"
 #include "Project.h"
+#include "editor/compiler/CompileWorker.h"
 #include "editor/compiler/interface/Runtime.h"
 #include "objects/Connection.h"
+#include "objects/Control.h"
 #include "objects/ControlSurface.h"
+#include "objects/CustomNode.h"
+#include "objects/GroupNode.h"
+#include "objects/GroupSurface.h"
 #include "objects/Node.h"
 #include "objects/RootSurface.h"
 
 using namespace AxiomModel;
 
+// Returns true if the runtime won't keep the state of a control in the pending commit, because the block or a surface
+// it's stored in has changed.
+static bool isControlStateChanged(MaximCompiler::Runtime *runtime, Control *control) {
+    auto node = control->surface()->node();
+
+    // extracted surfaces aren't kept between commits
+    if (node->isExtracted()) return true;
+
+    if (auto customNode = dynamic_cast<CustomNode *>(node)) {
+        if (runtime->isBlockChanged(customNode->getRuntimeId())) return true;
+    }
+
+    // values are stored in the surface the node is in, or a surface above it if the control is exposed
+    NodeSurface *surface = node->surface();
+    while (true) {
+        if (runtime->isSurfaceChanged(surface->getRuntimeId())) return true;
+
+        auto groupSurface = dynamic_cast<GroupSurface *>(surface);
+        if (!groupSurface) return false;
+        surface = groupSurface->node()->surface();
+    }
+}
+
 ModelRoot::ModelRoot()
     : _nodeSurfaces(AxiomCommon::dynamicCastWatch<NodeSurface *>(_pool.sequence())),
       _nodes(AxiomCommon::dynamicCastWatch<Node *>(_pool.sequence())),
@@ -25,47 +55,95 @@ ModelRoot::ModelRoot()
     _history.stackChanged.connectTo(this, &ModelRoot::compileDirtyItems);
 }
 
+ModelRoot::~ModelRoot() = default;
+
 RootSurface *ModelRoot::rootSurface() {
-    auto rootSurfaces = findChildren(nodeSurfaces().sequence(), QUuid());
+    auto rootSurfaces = findChildren<RootSurface *>(_pool, QUuid());
     assert(rootSurfaces.size() == 1);
-    auto rootSurface = dynamic_cast<RootSurface *>(*takeAt(rootSurfaces, 0));
-    assert(rootSurface);
-    return rootSurface;
+    return *takeAt(rootSurfaces, 0);
 }
 
 void ModelRoot::attachRuntime(MaximCompiler::Runtime *runtime) {
     _runtime = runtime;
+    _compileWorker =
+        std::make_unique<MaximCompiler::CompileWorker>(_runtime, [this]() { applyPreparedTransaction(); });
 
-    MaximCompiler::Transaction buildTransaction;
+    auto buildTransaction = createTransaction();
     rootSurface()->attachRuntime(_runtime, &buildTransaction);
     applyTransaction(std::move(buildTransaction));
 
     // clear the dirty state of everything, since we've just compiled them
-    auto poolSequence = pool().sequence().sequence();
-    for (const auto &obj : poolSequence) {
-        if (auto modelObj = dynamic_cast<ModelObject *>(obj)) {
+    for (const auto &dirtyObject : _dirtyObjects) {
+        auto obj = pool().sequence().sequence().find(dirtyObject.second);
+        if (!obj) continue;
+
+        if (auto modelObj = dynamic_cast<ModelObject *>(*obj)) {
             modelObj->clearDirty();
         }
     }
+    _dirtyObjects.clear();
 }
 
 std::lock_guard<std::mutex> ModelRoot::lockRuntime() {
     return std::lock_guard(_runtimeLock);
 }
 
+std::unique_lock<std::mutex> ModelRoot::tryLockRuntime() {
+    return std::unique_lock(_runtimeLock, std::try_to_lock);
+}
+
 void ModelRoot::setHistory(AxiomModel::HistoryList history) {
     _history = std::move(history);
     _history.stackChanged.connectTo(this, &ModelRoot::compileDirtyItems);
 }
 
+void ModelRoot::setFreezeControls(bool freezeControls) {
+    if (_freezeControls == freezeControls) return;
+
+    _freezeControls = freezeControls;
+
+    // blocks are built with the current setting when a runtime is attached
+    if (_runtime) {
+        markStaleBlocksDirty();
+        compileDirtyItems();
+    }
+}
+
+void ModelRoot::markStaleBlocksDirty() {
+    for (const auto &customNode : AxiomCommon::dynamicCast<CustomNode *>(nodes().sequence())) {
+        if (customNode->hasStaleControls()) {
+            customNode->setDirty();
+        }
+    }
+}
+
+void ModelRoot::markDirty(ModelObject *obj) {
+    _dirtyObjects.emplace(obj->depth(), obj->uuid());
+}
+
+MaximCompiler::Transaction ModelRoot::createTransaction() {
+    MaximCompiler::Transaction transaction;
+    transaction.setGeneration(++_lastGeneration);
+    return transaction;
+}
+
 void ModelRoot::applyDirtyItemsTo(MaximCompiler::Transaction *transaction) {
     auto startTime = std::chrono::high_resolution_clock::now();
 
-    // iterate over pool items in reverse order, since we need to compile children before parents
+    // connecting or exposing a control, or changing a frozen value, doesn't mark its block dirty, so check if any
+    // blocks need to be rebuilt
+    markStaleBlocksDirty();
+
+    // the dirty set is ordered deepest first, since we need to compile children before parents
     size_t dirtyItemCount = 0;
-    const auto &poolObjects = pool().objects();
-    for (auto rit = poolObjects.rbegin(); rit < poolObjects.rend(); rit++) {
-        auto obj = dynamic_cast<ModelObject *>(rit->get());
+    while (!_dirtyObjects.empty()) {
+        auto uuid = _dirtyObjects.begin()->second;
+        _dirtyObjects.erase(_dirtyObjects.begin());
+
+        auto poolObj = pool().sequence().sequence().find(uuid);
+        if (!poolObj) continue;
+
+        auto obj = dynamic_cast<ModelObject *>(*poolObj);
         if (obj && obj->isDirty()) {
             obj->clearDirty();
             obj->build(transaction);
@@ -80,33 +158,91 @@ void ModelRoot::applyDirtyItemsTo(MaximCompiler::Transaction *transaction) {
 }
 
 void ModelRoot::compileDirtyItems() {
-    MaximCompiler::Transaction transaction;
+    auto transaction = createTransaction();
     applyDirtyItemsTo(&transaction);
-    applyTransaction(std::move(transaction));
+
+    // Build the transaction in the background so the editor stays responsive, it'll be committed once it's ready.
+    if (_compileWorker) {
+        _compileWorker->queue(std::move(transaction));
+    } else {
+        applyTransaction(std::move(transaction));
+    }
 
     modified();
 }
 
 void ModelRoot::applyTransaction(MaximCompiler::Transaction transaction) {
-    auto lock = lockRuntime();
+    // Building the transaction doesn't touch the running code, so the audio thread can keep going while it happens.
+    // We only need to lock the runtime to swap the new code in.
+    if (_compileWorker) {
+        // make sure anything the worker has been given is committed first, so transactions are applied in order
+        if (auto queued = _compileWorker->takeQueued()) {
+            queued->merge(std::move(transaction));
+            transaction = std::move(*queued);
+        }
+        if (_compileWorker->hasPrepared()) {
+            commitPrepared(_compileWorker->preparedGeneration());
+        }
+    }
 
+    auto generation = transaction.generation();
     if (_runtime) {
-        auto allObjects = AxiomCommon::dynamicCast<ModelObject *>(_pool.sequence().sequence());
-        for (const auto &obj : allObjects) {
-            obj->saveState();
+        _runtime->prepareCommit(std::move(transaction));
+    }
+
+    commitPrepared(generation);
+}
+
+void ModelRoot::applyPreparedTransaction() {
+    // the transaction might have already been committed by a call to applyTransaction
+    if (_compileWorker && _compileWorker->hasPrepared()) {
+        commitPrepared(_compileWorker->preparedGeneration());
+    }
+}
+
+void ModelRoot::commitPrepared(uint64_t generation) {
+    // Objects rebuilt in transactions that are still queued have compile meta that doesn't match the code being
+    // deployed, so they're skipped below. Their pointers are updated when their own transaction is committed.
+    _committedGeneration = std::max(_committedGeneration, generation);
+
+    if (_runtime) {
+        // The runtime keeps the state of anything that hasn't changed, so only controls in changed surfaces or blocks
+        // need to be saved and restored.
+        std::vector<Control *> changedControls;
+        for (const auto &control : controls().sequence()) {
+            if (control->surface()->node()->isCommitted() && isControlStateChanged(_runtime, control)) {
+                control->saveState();
+                changedControls.push_back(control);
+            }
         }
 
-        _runtime->commit(std::move(transaction));
+        // The new code is deployed and swapped in next to the running code, so the audio thread keeps running while
+        // this happens. The lock is only held to update the backend's portals along with the code they point into.
+        _runtime->finishCommit();
+        {
+            auto lock = lockRuntime();
+            _runtime->publishCommit();
+            configurationChanged();
+        }
+        _runtime->waitForCommit();
+
         rootSurface()->updateRuntimePointers(_runtime, _runtime->getRootPtr());
+        rootSurface()->updateRuntimeCompileMeta();
 
-        for (const auto &obj : allObjects) {
-            obj->restoreState();
+        for (const auto &control : changedControls) {
+            control->restoreState();
         }
+    } else {
+        auto lock = lockRuntime();
+        configurationChanged();
     }
 
-    configurationChanged();
+    if (_compileWorker) {
+        _compileWorker->finished();
+    }
 }
 
 void ModelRoot::destroy() {
+    _compileWorker.reset();
     _pool.destroy();
 }
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <set>
 
 #include "HistoryList.h"
 #include "Pool.h"
@@ -10,6 +12,8 @@
 
 namespace MaximCompiler {
     class Runtime;
+
+    class CompileWorker;
 }
 
 namespace AxiomModel {
@@ -48,6 +52,8 @@ namespace AxiomModel {
 
         ModelRoot();
 
+        ~ModelRoot() override;
+
         RootSurface *rootSurface();
 
         Pool &pool() { return _pool; }
@@ -74,17 +80,46 @@ namespace AxiomModel {
 
         std::lock_guard<std::mutex> lockRuntime();
 
+        // Locks the runtime if nothing else holds it. The returned lock doesn't own the mutex if it was busy.
+        std::unique_lock<std::mutex> tryLockRuntime();
+
         void setHistory(HistoryList history);
 
+        // When enabled, the values of num controls that can only be changed from the editor (those that aren't
+        // connected or exposed) are baked into blocks as constants, so the math depending on them can be folded away.
+        // Changing a frozen control rebuilds its block on the next compile, which is slow compared to writing the
+        // value, so this is meant for rendering and exporting rather than live editing.
+        bool freezeControls() const { return _freezeControls; }
+
+        void setFreezeControls(bool freezeControls);
+
+        // Queues an object to be built by the next applyDirtyItemsTo. Called by ModelObject::setDirty.
+        void markDirty(ModelObject *obj);
+
+        // Creates a transaction to build objects into, with the next generation. Transactions are committed in the
+        // order they're created.
+        MaximCompiler::Transaction createTransaction();
+
+        // Returns true if the transaction with the given generation has been committed, so any compile meta set while
+        // building it matches the code the runtime is running.
+        bool isGenerationCommitted(uint64_t generation) const { return generation <= _committedGeneration; }
+
         void applyDirtyItemsTo(MaximCompiler::Transaction *transaction);
 
         void compileDirtyItems();
 
         void applyTransaction(MaximCompiler::Transaction transaction);
 
+        void applyPreparedTransaction();
+
         void destroy();
 
     private:
+        // Objects waiting to be built, deepest first so children are built before their parents. Objects are looked up
+        // by UUID when they're built, so ones that have been removed since they were queued are skipped. This is
+        // declared before the pool since removing objects can mark others dirty.
+        std::set<std::pair<size_t, QUuid>, std::greater<>> _dirtyObjects;
+
         Pool _pool;
         HistoryList _history;
         ModelRootCollection<NodeSurface *> _nodeSurfaces;
@@ -95,5 +130,13 @@ namespace AxiomModel {
 
         std::mutex _runtimeLock;
         MaximCompiler::Runtime *_runtime = nullptr;
+        std::unique_ptr<MaximCompiler::CompileWorker> _compileWorker;
+        bool _freezeControls = false;
+        uint64_t _lastGeneration = 0;
+        uint64_t _committedGeneration = 0;
+
+        void commitPrepared(uint64_t generation);
+
+        void markStaleBlocksDirty();
     };
 }
@@ -4,12 +4,35 @@
 
 using namespace AxiomModel;
 
-static PoolObject *deref(std::unique_ptr<PoolObject> *obj) {
-    return obj->get();
+static std::optional<PoolObject *> deref(std::unique_ptr<PoolObject> *obj) {
+    if (*obj) {
+        return obj->get();
+    }
+    return std::nullopt;
+}
+
+static std::optional<PoolObject *> derefChild(PoolObject **obj) {
+    if (*obj) {
+        return *obj;
+    }
+    return std::nullopt;
+}
+
+static PoolObject *slotObject(const std::unique_ptr<PoolObject> &slot) {
+    return slot.get();
+}
+
+static PoolObject *slotObject(PoolObject *slot) {
+    return slot;
 }
 
+Pool::ChildList::ChildList()
+    : sequence(
+          BaseChildSequence(indexSequence(AxiomCommon::filterMap(AxiomCommon::iter(&objects), derefChild), &index),
+                            AxiomCommon::BaseWatchEvents<PoolObject *>())) {}
+
 Pool::Pool()
-    : _sequence(BaseSequence(indexSequence(AxiomCommon::map(AxiomCommon::iter(&_objects), deref), &index),
+    : _sequence(BaseSequence(indexSequence(AxiomCommon::filterMap(AxiomCommon::iter(&_objects), deref), &index),
                              AxiomCommon::BaseWatchEvents<PoolObject *>())) {}
 
 Pool::~Pool() {
@@ -17,32 +40,100 @@ Pool::~Pool() {
 }
 
 PoolObject *Pool::registerObj(std::unique_ptr<AxiomModel::PoolObject> obj) {
+    compactSlots(_objects, _emptySlots, &PoolObject::_poolIndex);
+    obj->_poolIndex = _objects.size();
     _objects.push_back(std::move(obj));
     auto ptr = _objects.back().get();
     index.insert(ptr->uuid(), ptr);
+
+    auto childList = getChildList(ptr->parentUuid());
+    compactSlots(childList->objects, childList->emptySlots, &PoolObject::_childIndex);
+    ptr->_childIndex = childList->objects.size();
+    childList->objects.push_back(ptr);
+    childList->index.insert(ptr->uuid(), ptr);
+
     _sequence.events().itemAdded()(ptr);
+    childList->sequence.events().itemAdded()(ptr);
     return ptr;
 }
 
 std::unique_ptr<PoolObject> Pool::removeObj(AxiomModel::PoolObject *obj) {
-    // find and remove the object from the owned pool
-    auto ownedIndex = AxiomUtil::findUnique(_objects.begin(), _objects.end(), obj);
-    assert(ownedIndex != _objects.end());
-
-    // move the object out of the array
-    auto ownedObj = std::move(*ownedIndex);
-    _objects.erase(ownedIndex);
+    // empty the object's slot instead of erasing it, so removing is constant time and doesn't move anything else
+    assert(obj->_poolIndex < _objects.size() && _objects[obj->_poolIndex].get() == obj);
+    auto ownedObj = std::move(_objects[obj->_poolIndex]);
+    _emptySlots++;
     index.remove(ownedObj->uuid());
 
+    auto childList = getChildList(ownedObj->parentUuid());
+    assert(obj->_childIndex < childList->objects.size() && childList->objects[obj->_childIndex] == obj);
+    childList->objects[obj->_childIndex] = nullptr;
+    childList->emptySlots++;
+    childList->index.remove(ownedObj->uuid());
+
     // trigger itemRemoved after removing from the pool, so it can't be iterated over
     _sequence.events().itemRemoved()(ownedObj.get());
+    childList->sequence.events().itemRemoved()(ownedObj.get());
+
+    // children are removed before their parent, so nothing can be watching the object's own list any more
+    auto ownList = _children.find(ownedObj->uuid());
+    if (ownList != _children.end() && ownList->second->index.isEmpty()) {
+        _children.erase(ownList);
+    }
 
     return ownedObj;
 }
 
+Pool::ChildSequence Pool::children(const QUuid &parentUuid) {
+    return AxiomCommon::refWatchSequence(&getChildList(parentUuid)->sequence);
+}
+
 void Pool::destroy() {
     // objects are always sorted as a heap, so we're guaranteed to never remove an object before its parent here
-    while (!_objects.empty()) {
-        _objects.front()->remove();
+    for (size_t i = 0; i < _objects.size(); i++) {
+        if (_objects[i]) {
+            _objects[i]->remove();
+        }
+    }
+    _objects.clear();
+    _emptySlots = 0;
+}
+
+Pool::ChildList *Pool::getChildList(const QUuid &parentUuid) {
+    auto &childList = _children[parentUuid];
+    if (!childList) {
+        childList = std::make_unique<ChildList>();
+    }
+    return childList.get();
+}
+
+void Pool::removeUuids(const std::vector<QUuid> &uuids) {
+    for (const auto &uuid : uuids) {
+        auto obj = index.find(uuid);
+        if (obj != index.end()) {
+            obj.value()->remove();
+        }
+    }
+}
+
+template<class Slot>
+void Pool::compactSlots(std::vector<Slot> &slots, size_t &emptySlots, size_t PoolObject::*slotIndex) {
+    // only compact once at least half of the slots are empty, so the cost is spread over the removals that emptied
+    // them
+    if (emptySlots == 0 || emptySlots < slots.size() / 2) {
+        return;
+    }
+
+    // move the remaining objects down over the empty slots, keeping them in order
+    size_t nextSlot = 0;
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (!slots[i]) continue;
+
+        slotObject(slots[i])->*slotIndex = nextSlot;
+        if (i != nextSlot) {
+            slots[nextSlot] = std::move(slots[i]);
+        }
+        nextSlot++;
     }
+    slots.resize(nextSlot);
+    emptySlots = 0;
 }
@@ -2,6 +2,8 @@
 
 #include <QtCore/QUuid>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "IndexedSequence.h"
@@ -16,11 +18,19 @@ namespace AxiomModel {
     class Pool {
         using IterSequence = AxiomCommon::IterSequence<std::vector<std::unique_ptr<PoolObject>>>;
         using BaseSequence = AxiomCommon::BaseWatchSequence<
-            IndexedSequence<AxiomCommon::MapSequence<IterSequence, PoolObject *(*) (std::unique_ptr<PoolObject> *)>>,
+            IndexedSequence<AxiomCommon::FilterMapSequence<
+                IterSequence, std::optional<PoolObject *> (*) (std::unique_ptr<PoolObject> *)>>,
+            AxiomCommon::BaseWatchEvents<PoolObject *>>;
+
+        using ChildIterSequence = AxiomCommon::IterSequence<std::vector<PoolObject *>>;
+        using BaseChildSequence = AxiomCommon::BaseWatchSequence<
+            IndexedSequence<
+                AxiomCommon::FilterMapSequence<ChildIterSequence, std::optional<PoolObject *> (*) (PoolObject **)>>,
             AxiomCommon::BaseWatchEvents<PoolObject *>>;
 
     public:
         using Sequence = AxiomCommon::RefWatchSequence<BaseSequence>;
+        using ChildSequence = AxiomCommon::RefWatchSequence<BaseChildSequence>;
 
         Pool();
 
@@ -30,15 +40,57 @@ namespace AxiomModel {
 
         std::unique_ptr<PoolObject> removeObj(PoolObject *obj);
 
+        // Objects are stored in the order they were added, so parents always come before their children. Removing an
+        // object leaves an empty slot behind until the storage is next compacted, so slots can be null.
         const std::vector<std::unique_ptr<PoolObject>> &objects() const { return _objects; }
 
         Sequence sequence() { return AxiomCommon::refWatchSequence(&_sequence); }
 
+        // Returns the objects whose parent is `parentUuid`, in the order they were added. The events only fire for
+        // those objects, so watching the children of one object doesn't cost anything when others change.
+        ChildSequence children(const QUuid &parentUuid);
+
+        // Calls remove() on each of the objects in order. Objects that have already been removed along with an earlier
+        // one, like the children of a removed object, are skipped, so a whole subtree can be removed by passing it in
+        // with parents first.
+        template<class Objects>
+        void removeAll(Objects objects) {
+            std::vector<QUuid> uuids;
+            for (const auto &obj : objects) {
+                uuids.push_back(obj->uuid());
+            }
+            removeUuids(uuids);
+        }
+
         void destroy();
 
     private:
+        struct UuidHash {
+            size_t operator()(const QUuid &uuid) const { return qHash(uuid); }
+        };
+
+        struct ChildList {
+            std::vector<PoolObject *> objects;
+            size_t emptySlots = 0;
+            QHash<QUuid, PoolObject *> index;
+            BaseChildSequence sequence;
+
+            ChildList();
+        };
+
         std::vector<std::unique_ptr<PoolObject>> _objects;
+        size_t _emptySlots = 0;
         QHash<QUuid, PoolObject *> index;
         BaseSequence _sequence;
+
+        // Lists are kept at a stable address, since child sequences reference them, until the parent is removed.
+        std::unordered_map<QUuid, std::unique_ptr<ChildList>, UuidHash> _children;
+
+        ChildList *getChildList(const QUuid &parentUuid);
+
+        void removeUuids(const std::vector<QUuid> &uuids);
+
+        template<class Slot>
+        static void compactSlots(std::vector<Slot> &slots, size_t &emptySlots, size_t PoolObject::*slotIndex);
     };
 }
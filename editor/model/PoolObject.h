@@ -21,10 +21,16 @@ namespace AxiomModel {
         virtual void remove();
 
     private:
+        friend class Pool;
+
         QUuid _uuid;
 
         QUuid _parentUuid;
 
         Pool *_pool;
+
+        // where the object is stored in the pool and in its parent's child list, so it can be removed without a search
+        size_t _poolIndex = 0;
+        size_t _childIndex = 0;
     };
 }
@@ -4,6 +4,7 @@
 #include <QtCore/QUuid>
 
 #include "../util.h"
+#include "Pool.h"
 #include "common/NamedLambda.h"
 #include "common/WatchSequenceOperators.h"
 
@@ -107,37 +108,22 @@ namespace AxiomModel {
             }));
     }
 
-    struct FindChildrenLambdaData {
-        QUuid uuid;
-    };
-
-    template<class FindSequence>
-    using FindChildrenLambda = AxiomCommon::FilterLambda<typename FindSequence::value_type &, FindChildrenLambdaData>;
-
-    template<class FindSequence>
-    using FindChildrenGenerator = AxiomCommon::FilterGenerator<FindSequence, FindChildrenLambda<FindSequence>>;
-
-    template<class FindSequence>
-    using FindChildrenSequence = AxiomCommon::Sequence<FindChildrenGenerator<FindSequence>>;
+    template<class Output>
+    using FindChildrenSequence = AxiomCommon::CastSequence<Output, Pool::ChildSequence::Sequence>;
 
-    template<class FindSequence>
-    using FindChildrenWatchSequence = AxiomCommon::WatchSequence<FindChildrenSequence<typename FindSequence::Sequence>,
-                                                                 typename FindSequence::Events>;
+    template<class Output>
+    using FindChildrenWatchSequence = AxiomCommon::CastWatchSequence<Output, Pool::ChildSequence>;
 
-    template<class FindSequence>
-    FindChildrenSequence<FindSequence> findChildren(FindSequence items, QUuid parentUuid) {
-        FindChildrenLambdaData lambdaData = {parentUuid};
-        return AxiomCommon::filter(
-            std::move(items), FindChildrenLambda<FindSequence>(lambdaData, [](FindChildrenLambdaData &data,
-                                                                              typename FindSequence::value_type &item) {
-                return item->parentUuid() == data.uuid;
-            }));
+    // Children are looked up from the pool's index of objects by parent, so only the parent's children are visited
+    // instead of every object in the pool.
+    template<class Output>
+    FindChildrenSequence<Output> findChildren(Pool &pool, const QUuid &parentUuid) {
+        return AxiomCommon::dynamicCast<Output>(std::move(pool.children(parentUuid).sequence()));
     }
 
-    template<class FindSequence>
-    FindChildrenWatchSequence<FindSequence> findChildrenWatch(FindSequence items, QUuid parentUuid) {
-        return AxiomCommon::WatchSequence(findChildren(std::move(items.sequence()), parentUuid),
-                                          std::move(items.events()));
+    template<class Output>
+    FindChildrenWatchSequence<Output> findChildrenWatch(Pool &pool, const QUuid &parentUuid) {
+        return AxiomCommon::dynamicCastWatch<Output>(pool.children(parentUuid));
     }
 
     template<class S>
@@ -107,11 +107,14 @@ void Project::addRootListeners() {
 }
 
 void Project::rootModified() {
-    if (!linkedFile().isEmpty() || !backend()->doesSaveInternally()) {
+    if (!linkedFile().isEmpty() || !backend() || !backend()->doesSaveInternally()) {
         setIsDirty(true);
     }
 }
 
 void Project::rootConfigurationChanged() {
-    backend()->internalUpdateConfiguration();
+    // projects rendered offline aren't attached to a backend
+    if (backend()) {
+        backend()->internalUpdateConfiguration();
+    }
 }
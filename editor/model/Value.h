@@ -60,7 +60,7 @@ namespace AxiomModel {
     };
 
     struct MidiValue {
-        static constexpr size_t MAX_EVENTS = 32;
+        static constexpr size_t MAX_EVENTS = 16;
 
         uint8_t count = 0;
         MidiEventValue events[MAX_EVENTS];
@@ -75,11 +75,12 @@ namespace AxiomModel {
 
         bool operator!=(const MidiValue &other) const { return !(*this == other); }
 
-        void pushEvent(const MidiEventValue &event) {
-            if (count >= MAX_EVENTS) return;
+        bool pushEvent(const MidiEventValue &event) {
+            if (count >= MAX_EVENTS) return false;
 
             events[count] = event;
             count++;
+            return true;
         }
     };
 }
@@ -1,6 +1,7 @@
 #include "WireGrid.h"
 
 #include <algorithm>
+#include <utility>
 
 #include "../util.h"
 
@@ -72,6 +73,7 @@ void WireGrid::addRegion(QRect region, AxiomModel::ConnectionWire *wire) {
     else
         unreachable;
 
+    _changedRegion.add(region);
     for (auto x = region.left(); x <= region.right(); x++) {
         for (auto y = region.top(); y <= region.bottom(); y++) {
             addPoint(QPoint(x, y), wire, direction);
@@ -80,6 +82,7 @@ void WireGrid::addRegion(QRect region, AxiomModel::ConnectionWire *wire) {
 }
 
 void WireGrid::removeRegion(QRect region, AxiomModel::ConnectionWire *wire) {
+    _changedRegion.add(region);
     for (auto x = region.left(); x <= region.right(); x++) {
         for (auto y = region.top(); y <= region.bottom(); y++) {
             removePoint(QPoint(x, y), wire);
@@ -130,7 +133,7 @@ LineIndex WireGrid::getRegionIndex(QRect region, AxiomModel::ConnectionWire *wir
 
 void WireGrid::tryFlush() {
     if (_isDirty) {
-        gridChanged();
         _isDirty = false;
+        gridChanged(std::exchange(_changedRegion, ChangedRegion()));
     }
 }
@@ -7,6 +7,7 @@
 
 #include "common/Event.h"
 #include "common/TrackedObject.h"
+#include "grid/ChangedRegion.h"
 
 inline uint qHash(const QPoint &);
 
@@ -23,7 +24,8 @@ namespace AxiomModel {
     public:
         enum class Direction { HORIZONTAL, VERTICAL };
 
-        AxiomCommon::Event<> gridChanged;
+        // fired with the cells that have had wires added or removed since the last flush
+        AxiomCommon::Event<const ChangedRegion &> gridChanged;
 
         void addPoint(QPoint point, ConnectionWire *wire, Direction direction);
 
@@ -45,6 +47,7 @@ namespace AxiomModel {
 
         QHash<QPoint, CellLists> cells;
 
+        ChangedRegion _changedRegion;
         bool _isDirty = false;
     };
 }
@@ -27,22 +27,9 @@ void DeleteObjectAction::forward(bool) {
     QDataStream stream(&_buffer, QIODevice::WriteOnly);
     ModelObjectSerializer::serializeChunk(stream, QUuid(), sortedItems);
 
-    // We can't just iterate over a collection of ModelObjects and call remove() on them,
-    // as objects also delete their children.
-    // Instead, we build a list of UUIDs to delete, create a Sequence of them, and iterate
-    // until that's empty.
-    // We'll also need a list of parent UUIDs to build transactions later, so we can do that here.
-    QSet<QUuid> usedIds;
-    for (const auto &itm : sortedItems) {
-        usedIds.insert(itm->uuid());
-    }
-    auto itemsToDelete =
-        findAll(AxiomCommon::dynamicCast<ModelObject *>(root()->pool().sequence().sequence()), usedIds);
-
-    // remove all items
-    while (!itemsToDelete.empty()) {
-        (*itemsToDelete.begin())->remove();
-    }
+    // We can't just iterate over the ModelObjects and call remove() on them, as objects also delete their children.
+    // The items are sorted with parents first though, so the pool can skip any that have already been removed.
+    root()->pool().removeAll(std::move(sortedItems));
 }
 
 void DeleteObjectAction::backward() {
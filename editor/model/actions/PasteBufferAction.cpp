@@ -88,7 +88,5 @@ void PasteBufferAction::backward() {
 
     _usedUuids.clear();
 
-    while (!objs.empty()) {
-        (*objs.begin())->remove();
-    }
+    root()->pool().removeAll(std::move(collected));
 }
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QtCore/QRect>
+#include <vector>
+
+namespace AxiomModel {
+
+    // The cells of a grid that have changed since it was last flushed, so anything depending on the grid can check if
+    // it's affected instead of assuming it is. Once too many areas have been added they're merged into one, so the list
+    // stays small if nothing is flushing the grid.
+    class ChangedRegion {
+    public:
+        static constexpr size_t MAX_RECTS = 32;
+
+        const std::vector<QRect> &rects() const { return _rects; }
+
+        bool isEmpty() const { return _rects.empty(); }
+
+        void add(QRect rect) {
+            if (rect.isEmpty()) return;
+
+            if (_rects.size() < MAX_RECTS) {
+                _rects.push_back(rect);
+                return;
+            }
+
+            for (const auto &existingRect : _rects) {
+                rect = rect.united(existingRect);
+            }
+            _rects.clear();
+            _rects.push_back(rect);
+        }
+
+        bool intersects(QRect rect) const {
+            for (const auto &existingRect : _rects) {
+                if (existingRect.intersects(rect)) return true;
+            }
+            return false;
+        }
+
+        void clear() { _rects.clear(); }
+
+    private:
+        std::vector<QRect> _rects;
+    };
+}
@@ -4,18 +4,26 @@
 
 #include <QtCore/QPoint>
 #include <QtCore/QSize>
+#include <algorithm>
+#include <array>
+#include <climits>
 #include <cmath>
+#include <cstdint>
 #include <memory>
 #include <queue>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+
+#include "ChangedRegion.h"
 
 namespace std {
     template<>
     struct hash<QPoint> {
         std::size_t operator()(const QPoint &p) const {
-            return std::hash<int>()(p.x()) ^ (std::hash<int>()(p.y()) >> 1);
+            // keep all of both coordinates, since xor-ing them together makes nearby points collide
+            return std::hash<uint64_t>()((uint64_t)(uint32_t) p.x() << 32 | (uint32_t) p.y());
         }
     };
 }
@@ -42,13 +50,16 @@ namespace AxiomModel {
                 return false;
             }
 
-            for (auto dx = 0; dx < size.width(); dx++) {
-                for (auto dy = 0; dy < size.height(); dy++) {
-                    auto checkP = pos + QPoint(dx, dy);
-                    auto found = getCell(checkP);
-                    if (found && found != ignore) {
+            // check a row at a time, split where the row crosses into another tile
+            for (auto y = pos.y(); y < bp.y(); y++) {
+                int64_t x = pos.x();
+                while (x < bp.x()) {
+                    auto tileEnd = (x | TILE_MASK) + 1;
+                    auto spanEnd = std::min((int64_t) bp.x(), tileEnd);
+                    if (!isSpanAvailable(QPoint((int) x, y), (int) (spanEnd - x), ignore)) {
                         return false;
                     }
+                    x = spanEnd;
                 }
             }
             return true;
@@ -146,25 +157,22 @@ namespace AxiomModel {
         T *getCell(QPoint pos) const {
             if (!isInsideRect(pos)) return nullptr;
 
-            auto cell = cells.find(pos);
-            if (cell == cells.end()) return nullptr;
-            return cell->second;
+            auto tile = findTile(getTilePos(pos));
+            if (!tile) return nullptr;
+            return tile->items[getCellIndex(pos)];
         }
 
         void setCell(QPoint pos, T *item) {
-            if (!isInsideRect(pos)) return;
-
-            if (item == nullptr)
-                cells.erase(pos);
-            else
-                cells.emplace(pos, item);
+            changed.add(QRect(pos, QSize(1, 1)));
+            writeCell(pos, item);
         }
 
         void setRect(QPoint pos, QSize size, T *item) {
+            changed.add(QRect(pos, size));
             for (auto dx = 0; dx < size.width(); dx++) {
                 for (auto dy = 0; dy < size.height(); dy++) {
                     auto checkP = pos + QPoint(dx, dy);
-                    setCell(checkP, item);
+                    writeCell(checkP, item);
                 }
             }
         }
@@ -174,6 +182,9 @@ namespace AxiomModel {
             setRect(newPos, newSize, item);
         }
 
+        // Returns the cells that have been set since this was last called, and starts recording again.
+        ChangedRegion takeChanged() { return std::exchange(changed, ChangedRegion()); }
+
     private:
         // for breadth-first search, sorting in the list of potential jumps
         class NearestAvailablePos {
@@ -214,6 +225,93 @@ namespace AxiomModel {
             VisitedCell(QPoint from, float cost) : from(from), cost(cost) {}
         };
 
-        std::unordered_map<QPoint, T *> cells;
+        static constexpr int TILE_SHIFT = 6;
+        static constexpr int TILE_SIZE = 1 << TILE_SHIFT;
+        static constexpr int TILE_MASK = TILE_SIZE - 1;
+
+        // A square of cells stored densely, with a bit for each filled cell in a row so areas can be checked for
+        // items a row at a time. Tiles are only allocated while they have something in them.
+        struct Tile {
+            std::array<T *, TILE_SIZE * TILE_SIZE> items{};
+            std::array<uint64_t, TILE_SIZE> rows{};
+            size_t count = 0;
+        };
+
+        std::unordered_map<QPoint, std::unique_ptr<Tile>> tiles;
+        ChangedRegion changed;
+
+        // searches tend to look at cells near each other, so the last tile looked up is kept to skip the hash lookup
+        mutable QPoint lastTilePos;
+        mutable Tile *lastTile = nullptr;
+        mutable bool hasLastTile = false;
+
+        static QPoint getTilePos(QPoint pos) { return QPoint(pos.x() >> TILE_SHIFT, pos.y() >> TILE_SHIFT); }
+
+        static size_t getCellIndex(QPoint pos) {
+            return (size_t)(pos.y() & TILE_MASK) * TILE_SIZE + (size_t)(pos.x() & TILE_MASK);
+        }
+
+        Tile *findTile(QPoint tilePos) const {
+            if (hasLastTile && tilePos == lastTilePos) return lastTile;
+
+            auto tile = tiles.find(tilePos);
+            lastTilePos = tilePos;
+            lastTile = tile == tiles.end() ? nullptr : tile->second.get();
+            hasLastTile = true;
+            return lastTile;
+        }
+
+        // Checks a span of cells in one row of a tile, which is a single mask test unless there's an item to ignore.
+        bool isSpanAvailable(QPoint start, int width, const T *ignore) const {
+            auto tile = findTile(getTilePos(start));
+            if (!tile) return true;
+
+            auto localX = start.x() & TILE_MASK;
+            auto widthMask = width >= TILE_SIZE ? ~(uint64_t) 0 : ((uint64_t) 1 << width) - 1;
+            auto filled = tile->rows[start.y() & TILE_MASK] & (widthMask << localX);
+            if (!filled) return true;
+            if (!ignore) return false;
+
+            auto rowStart = (size_t)(start.y() & TILE_MASK) * TILE_SIZE;
+            for (auto x = localX; x < localX + width; x++) {
+                if ((filled >> x) & 1 && tile->items[rowStart + x] != ignore) return false;
+            }
+            return true;
+        }
+
+        void writeCell(QPoint pos, T *item) {
+            if (!isInsideRect(pos)) return;
+
+            auto tilePos = getTilePos(pos);
+            auto tile = findTile(tilePos);
+            if (!tile) {
+                if (!item) return;
+
+                auto &newTile = tiles[tilePos];
+                newTile = std::make_unique<Tile>();
+                tile = newTile.get();
+                hasLastTile = false;
+            }
+
+            // a filled cell has to be cleared before something else can be put in it, the first item placed there is
+            // kept otherwise
+            auto &cell = tile->items[getCellIndex(pos)];
+            auto &row = tile->rows[pos.y() & TILE_MASK];
+            auto cellBit = (uint64_t) 1 << (pos.x() & TILE_MASK);
+            if (cell && !item) {
+                cell = nullptr;
+                row &= ~cellBit;
+                tile->count--;
+            } else if (!cell && item) {
+                cell = item;
+                row |= cellBit;
+                tile->count++;
+            }
+
+            if (tile->count == 0) {
+                tiles.erase(tilePos);
+                hasLastTile = false;
+            }
+        }
     };
 }
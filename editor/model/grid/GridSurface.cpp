@@ -74,15 +74,16 @@ void GridSurface::setDirty() {
     if (_deferDirty) {
         _isDirty = true;
     } else {
-        gridChanged();
         _isDirty = false;
+        gridChanged(_grid.takeChanged());
     }
 }
 
 void GridSurface::tryFlush() {
     if (_isDirty) {
-        gridChanged();
+        // listeners can change the grid again while it's flushing, which is kept for the next flush
         _isDirty = false;
+        gridChanged(_grid.takeChanged());
     }
 }
 
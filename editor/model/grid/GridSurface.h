@@ -26,7 +26,7 @@ namespace AxiomModel {
 
         AxiomCommon::Event<GridItem *> itemAdded;
         AxiomCommon::Event<bool> hasSelectionChanged;
-        AxiomCommon::Event<> gridChanged;
+        AxiomCommon::Event<const ChangedRegion &> gridChanged;
 
         GridSurface(BoxedItemCollection view, bool deferDirty, QPoint minRect = QPoint(INT_MIN, INT_MIN),
                     QPoint maxRect = QPoint(INT_MAX, INT_MAX));
@@ -62,6 +62,8 @@ namespace AxiomModel {
 
         void finishDragging();
 
+        // Fires gridChanged with the cells that have changed since the last flush, or waits for the next tryFlush if
+        // dirtying is deferred.
         void setDirty();
 
         void tryFlush();
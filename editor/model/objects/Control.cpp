@@ -26,12 +26,12 @@ Control::Control(AxiomModel::Control::ControlType controlType, AxiomModel::Conne
       ModelObject(ModelType::CONTROL, uuid, parentUuid, root),
       _surface(find(root->controlSurfaces().sequence(), parentUuid)), _controlType(controlType), _wireType(wireType),
       _name(std::move(name)), _showName(showName), _exposerUuid(exposerUuid), _exposingUuid(exposingUuid),
-      _connections(AxiomCommon::boxWatchSequence(AxiomCommon::filterWatch(root->connections(),
-                                                                          [uuid](Connection *const &connection) {
-                                                                              return connection->controlAUuid() ==
-                                                                                         uuid ||
-                                                                                     connection->controlBUuid() == uuid;
-                                                                          }))),
+      // connections are stored in the surface that the control's node is in, so only those need to be watched
+      _connections(AxiomCommon::boxWatchSequence(AxiomCommon::filterWatch(
+          findChildrenWatch<Connection *>(root->pool(), _surface->node()->parentUuid()),
+          [uuid](Connection *const &connection) {
+              return connection->controlAUuid() == uuid || connection->controlBUuid() == uuid;
+          }))),
       _connectedControls(AxiomCommon::boxWatchSequence(AxiomCommon::filterMapWatch(
           AxiomCommon::refWatchSequence(&_connections), [uuid](Connection *const &connection) -> std::optional<QUuid> {
               if (connection->controlAUuid() == uuid) return connection->controlBUuid();
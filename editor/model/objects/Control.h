@@ -119,8 +119,6 @@ namespace AxiomModel {
 
         void setRuntimePointers(std::optional<MaximFrontend::ControlPointers> runtimePointers) {
             _runtimePointers = std::move(runtimePointers);
-
-            restoreState();
         }
 
     private:
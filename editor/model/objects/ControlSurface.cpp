@@ -9,7 +9,7 @@ using namespace AxiomModel;
 ControlSurface::ControlSurface(const QUuid &uuid, const QUuid &parentUuid, AxiomModel::ModelRoot *root)
     : ModelObject(ModelType::CONTROL_SURFACE, uuid, parentUuid, root),
       _node(find(root->nodes().sequence(), parentUuid)),
-      _controls(cacheSequence(findChildrenWatch(root->controls(), uuid))),
+      _controls(cacheSequence(findChildrenWatch<Control *>(root->pool(), uuid))),
       _grid(AxiomCommon::boxWatchSequence(AxiomCommon::staticCastWatch<GridItem *>(_controls.asRef())), false,
             QPoint(0, 0)) {
     _node->sizeChanged.connectTo(this, &ControlSurface::setSize);
@@ -34,10 +34,7 @@ QString ControlSurface::debugName() {
 }
 
 void ControlSurface::remove() {
-    auto controls = findChildren(root()->controls().sequence(), uuid());
-    while (!controls.empty()) {
-        (*controls.begin())->remove();
-    }
+    root()->pool().removeAll(findChildren<Control *>(root()->pool(), uuid()));
     ModelObject::remove();
 }
 
@@ -15,7 +15,7 @@ namespace AxiomModel {
 
     class ControlSurface : public ModelObject {
     public:
-        using ChildCollection = CachedSequence<FindChildrenWatchSequence<ModelRoot::ControlCollection>>;
+        using ChildCollection = CachedSequence<FindChildrenWatchSequence<Control *>>;
 
         AxiomCommon::Event<bool> controlsOnTopRowChanged;
 
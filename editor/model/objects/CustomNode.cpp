@@ -97,9 +97,12 @@ void CustomNode::attachRuntime(MaximCompiler::Runtime *runtime, MaximCompiler::T
     }
 }
 
-void CustomNode::updateRuntimePointers(MaximCompiler::Runtime *runtime, void *surfacePtr) {
-    if (!_compiledBlock) return;
+bool CustomNode::isCommitted() const {
+    // the block has to be committed too, since the control indices come from it
+    return _compiledBlock && Node::isCommitted() && root()->isGenerationCommitted(_builtGeneration);
+}
 
+void CustomNode::updateRuntimePointers(MaximCompiler::Runtime *runtime, void *surfacePtr) {
     Node::updateRuntimePointers(runtime, surfacePtr);
 
     auto nodePtr = runtime->getNodePtr(surface()->getRuntimeId(), surfacePtr, compileMeta()->mirIndex);
@@ -113,13 +116,69 @@ void CustomNode::updateRuntimePointers(MaximCompiler::Runtime *runtime, void *su
     });
 }
 
+void CustomNode::clearRuntimePointers() {
+    Node::clearRuntimePointers();
+
+    controls().then([](ControlSurface *controlSurface) {
+        for (const auto &control : controlSurface->controls().sequence()) {
+            control->setRuntimePointers(std::nullopt);
+        }
+    });
+}
+
 const std::optional<CustomNodeError> &CustomNode::compileError() const {
     return _compileError;
 }
 
 void CustomNode::build(MaximCompiler::Transaction *transaction) {
     if (!_compiledBlock) return;
-    transaction->buildBlock(_compiledBlock->clone());
+
+    auto block = _compiledBlock->clone();
+    _builtGeneration = transaction->generation();
+    _builtStaticControls = staticControls();
+    _builtFrozenControls = frozenControls();
+    for (auto staticControl : _builtStaticControls) {
+        block.setControlStatic(staticControl);
+    }
+    for (const auto &frozenControl : _builtFrozenControls) {
+        block.freezeControl(frozenControl.index, frozenControl.value);
+    }
+    transaction->buildBlock(std::move(block));
+}
+
+std::vector<size_t> CustomNode::staticControls() {
+    std::vector<size_t> result;
+    for (auto numControl : staticNumControls()) {
+        result.push_back(numControl->compileMeta()->index);
+    }
+    return result;
+}
+
+std::vector<FrozenControl> CustomNode::frozenControls() {
+    std::vector<FrozenControl> result;
+    if (!root()->freezeControls()) return result;
+
+    for (auto numControl : staticNumControls()) {
+        result.push_back(FrozenControl{numControl->compileMeta()->index, numControl->value()});
+    }
+    return result;
+}
+
+std::vector<NumControl *> CustomNode::staticNumControls() {
+    std::vector<NumControl *> result;
+    if (!controls().value()) return result;
+
+    // only the editor can change a control that isn't connected or exposed: a connected control's value comes from
+    // somewhere else, and an exposed one can be connected or automated from the group it's exposed to
+    for (const auto &control : (*controls().value())->controls().sequence()) {
+        auto numControl = dynamic_cast<NumControl *>(control);
+        if (!numControl || !numControl->compileMeta() || numControl->compileMeta()->writtenTo) continue;
+        if (!numControl->exposerUuid().isNull() || !numControl->connectedControls().sequence().empty()) continue;
+
+        result.push_back(numControl);
+    }
+
+    return result;
 }
 
 struct NewControl {
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <optional>
+#include <vector>
 
 #include "Node.h"
+#include "../Value.h"
 #include "common/Event.h"
 #include "editor/compiler/interface/Block.h"
 
@@ -10,6 +12,8 @@ namespace AxiomModel {
 
     class Control;
 
+    class NumControl;
+
     class SetCodeAction;
 
     struct CustomNodeError {
@@ -20,6 +24,15 @@ namespace AxiomModel {
             : message(std::move(message)), sourceRange(sourceRange) {}
     };
 
+    struct FrozenControl {
+        size_t index;
+        NumValue value;
+
+        bool operator==(const FrozenControl &other) const { return index == other.index && value == other.value; }
+
+        bool operator!=(const FrozenControl &other) const { return !(*this == other); }
+    };
+
     class CustomNode : public Node {
     public:
         static constexpr float minPanelHeight = 40;
@@ -60,14 +73,30 @@ namespace AxiomModel {
 
         void attachRuntime(MaximCompiler::Runtime *runtime, MaximCompiler::Transaction *transaction) override;
 
+        bool isCommitted() const override;
+
         void updateRuntimePointers(MaximCompiler::Runtime *runtime, void *surfacePtr) override;
 
+        void clearRuntimePointers() override;
+
         bool hasValidBlock() const { return static_cast<bool>(_compiledBlock); }
 
         const std::optional<CustomNodeError> &compileError() const;
 
         void build(MaximCompiler::Transaction *transaction) override;
 
+        // Returns the indices of the controls that only the editor can change, which the block reads at control rate.
+        std::vector<size_t> staticControls();
+
+        // Returns the controls whose values should be baked into the block, if the root is freezing controls.
+        std::vector<FrozenControl> frozenControls();
+
+        // Returns true if the block needs to be rebuilt because the static or frozen controls have changed since it was
+        // built.
+        bool hasStaleControls() {
+            return staticControls() != _builtStaticControls || frozenControls() != _builtFrozenControls;
+        }
+
     private:
         QString _code;
         bool _isPanelOpen;
@@ -79,11 +108,16 @@ namespace AxiomModel {
         std::optional<MaximCompiler::Block> _compiledBlock;
         std::optional<MaximCompiler::Block> _stagingBlock;
         std::optional<CustomNodeError> _compileError;
+        std::vector<size_t> _builtStaticControls;
+        std::vector<FrozenControl> _builtFrozenControls;
+        uint64_t _builtGeneration = 0;
 
         void updateControls(SetCodeAction *action);
 
         void surfaceControlAdded(Control *control);
 
         void buildCode();
+
+        std::vector<NumControl *> staticNumControls();
     };
 }
@@ -43,6 +43,17 @@ void GroupNode::updateRuntimePointers(MaximCompiler::Runtime *runtime, void *sur
     });
 }
 
+void GroupNode::clearRuntimePointers() {
+    Node::clearRuntimePointers();
+
+    nodes().then([](GroupSurface *subsurface) { subsurface->clearRuntimePointers(); });
+    controls().then([](ControlSurface *controlSurface) {
+        for (const auto &control : controlSurface->controls().sequence()) {
+            control->setRuntimePointers(std::nullopt);
+        }
+    });
+}
+
 void GroupNode::remove() {
     if (nodes().value()) (*nodes().value())->remove();
     Node::remove();
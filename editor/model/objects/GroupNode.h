@@ -27,6 +27,8 @@ namespace AxiomModel {
 
         void updateRuntimePointers(MaximCompiler::Runtime *runtime, void *surfacePtr) override;
 
+        void clearRuntimePointers() override;
+
         void remove() override;
 
     private:
@@ -139,11 +139,17 @@ void Node::doSizeAction() {
     }
 }
 
+bool Node::isCommitted() const {
+    return compileMeta() && root()->isGenerationCommitted(compileMeta()->generation);
+}
+
 void Node::updateRuntimePointers(MaximCompiler::Runtime *runtime, void *surfacePtr) {
-    if (compileMeta()) {
-        setExtracted(runtime->isNodeExtracted(surface()->getRuntimeId(), compileMeta()->mirIndex));
-        _activeBitmap = runtime->getExtractedBitmaskPtr(surface()->getRuntimeId(), surfacePtr, compileMeta()->mirIndex);
-    }
+    setExtracted(runtime->isNodeExtracted(surface()->getRuntimeId(), compileMeta()->mirIndex));
+    _activeBitmap = runtime->getExtractedBitmaskPtr(surface()->getRuntimeId(), surfacePtr, compileMeta()->mirIndex);
+}
+
+void Node::clearRuntimePointers() {
+    _activeBitmap = nullptr;
 }
 
 void Node::doRuntimeUpdate() {
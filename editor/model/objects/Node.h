@@ -20,7 +20,10 @@ namespace AxiomModel {
     struct NodeCompileMeta {
         size_t mirIndex;
 
-        explicit NodeCompileMeta(size_t mirIndex) : mirIndex(mirIndex) {}
+        // the generation of the transaction the node's surface was built in
+        uint64_t generation;
+
+        NodeCompileMeta(size_t mirIndex, uint64_t generation) : mirIndex(mirIndex), generation(generation) {}
     };
 
     class Node : public GridItem, public ModelObject {
@@ -79,8 +82,15 @@ namespace AxiomModel {
 
         void setCompileMeta(std::optional<NodeCompileMeta> compileMeta) { _compileMeta = std::move(compileMeta); }
 
+        // Returns true if the node has been built in a transaction that has been committed, so its compile meta
+        // matches the code the runtime is running and its runtime pointers can be updated.
+        virtual bool isCommitted() const;
+
         virtual void updateRuntimePointers(MaximCompiler::Runtime *runtime, void *surfacePtr);
 
+        // Clears any pointers into the runtime, for when the node's compile meta doesn't match the running code.
+        virtual void clearRuntimePointers();
+
         void doRuntimeUpdate() override;
 
         void remove() override;
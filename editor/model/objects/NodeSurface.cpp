@@ -14,8 +14,8 @@ using namespace AxiomModel;
 NodeSurface::NodeSurface(const QUuid &uuid, const QUuid &parentUuid, QPointF pan, float zoom,
                          AxiomModel::ModelRoot *root)
     : ModelObject(ModelType::NODE_SURFACE, uuid, parentUuid, root),
-      _nodes(cacheSequence(findChildrenWatch(root->nodes(), uuid))),
-      _connections(cacheSequence(findChildrenWatch(root->connections(), uuid))),
+      _nodes(cacheSequence(findChildrenWatch<Node *>(root->pool(), uuid))),
+      _connections(cacheSequence(findChildrenWatch<Connection *>(root->pool(), uuid))),
       _grid(AxiomCommon::boxWatchSequence(AxiomCommon::staticCastWatch<GridItem *>(_nodes.asRef())), true), _pan(pan),
       _zoom(zoom) {
     _nodes.events().itemAdded().connectTo(this, &NodeSurface::nodeAdded);
@@ -84,7 +84,17 @@ void NodeSurface::attachRuntime(MaximCompiler::Runtime *runtime, MaximCompiler::
 
 void NodeSurface::updateRuntimePointers(MaximCompiler::Runtime *runtime, void *surfacePtr) {
     for (const auto &node : nodes().sequence()) {
-        node->updateRuntimePointers(runtime, surfacePtr);
+        if (node->isCommitted()) {
+            node->updateRuntimePointers(runtime, surfacePtr);
+        } else {
+            node->clearRuntimePointers();
+        }
+    }
+}
+
+void NodeSurface::clearRuntimePointers() {
+    for (const auto &node : nodes().sequence()) {
+        node->clearRuntimePointers();
     }
 }
 
@@ -108,14 +118,8 @@ void NodeSurface::doRuntimeUpdate() {
 }
 
 void NodeSurface::remove() {
-    auto nodes = findChildren(root()->nodes().sequence(), uuid());
-    while (!nodes.empty()) {
-        (*nodes.begin())->remove();
-    }
-    auto connections = findChildren(root()->connections().sequence(), uuid());
-    while (!connections.empty()) {
-        (*connections.begin())->remove();
-    }
+    root()->pool().removeAll(findChildren<Node *>(root()->pool(), uuid()));
+    root()->pool().removeAll(findChildren<Connection *>(root()->pool(), uuid()));
     ModelObject::remove();
 }
 
@@ -24,8 +24,8 @@ namespace AxiomModel {
 
     class NodeSurface : public ModelObject {
     public:
-        using ChildCollection = CachedSequence<FindChildrenWatchSequence<ModelRoot::NodeCollection>>;
-        using ConnectionCollection = CachedSequence<FindChildrenWatchSequence<ModelRoot::ConnectionCollection>>;
+        using ChildCollection = CachedSequence<FindChildrenWatchSequence<Node *>>;
+        using ConnectionCollection = CachedSequence<FindChildrenWatchSequence<Connection *>>;
 
         AxiomCommon::Event<const QString &> nameChanged;
         AxiomCommon::Event<const QPointF &> panChanged;
@@ -69,6 +69,8 @@ namespace AxiomModel {
 
         void updateRuntimePointers(MaximCompiler::Runtime *runtime, void *surfacePtr);
 
+        void clearRuntimePointers();
+
         void build(MaximCompiler::Transaction *transaction) override;
 
         void doRuntimeUpdate() override;
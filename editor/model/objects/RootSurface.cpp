@@ -1,5 +1,7 @@
 #include "RootSurface.h"
 
+#include "../ModelRoot.h"
+
 using namespace AxiomModel;
 
 RootSurface::RootSurface(const QUuid &uuid, QPointF pan, float zoom, size_t nextPortalId, AxiomModel::ModelRoot *root)
@@ -8,3 +10,17 @@ RootSurface::RootSurface(const QUuid &uuid, QPointF pan, float zoom, size_t next
 QString RootSurface::debugName() {
     return "RootSurface";
 }
+
+void RootSurface::setCompileMeta(std::optional<AxiomModel::RootSurfaceCompileMeta> compileMeta) {
+    if (compileMeta) {
+        _pendingCompileMeta.push_back(*compileMeta);
+    }
+    _compileMeta = std::move(compileMeta);
+}
+
+void RootSurface::updateRuntimeCompileMeta() {
+    while (!_pendingCompileMeta.empty() && root()->isGenerationCommitted(_pendingCompileMeta.front().generation)) {
+        _runtimeCompileMeta = std::move(_pendingCompileMeta.front());
+        _pendingCompileMeta.pop_front();
+    }
+}
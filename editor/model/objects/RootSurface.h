@@ -1,5 +1,6 @@
 #pragma once
 
+#include <deque>
 #include <vector>
 
 #include "../ConnectionWire.h"
@@ -23,7 +24,11 @@ namespace AxiomModel {
     struct RootSurfaceCompileMeta {
         std::vector<RootSurfacePortal> portals;
 
-        explicit RootSurfaceCompileMeta(std::vector<RootSurfacePortal> portals) : portals(std::move(portals)) {}
+        // the generation of the transaction the surface was built in
+        uint64_t generation;
+
+        RootSurfaceCompileMeta(std::vector<RootSurfacePortal> portals, uint64_t generation)
+            : portals(std::move(portals)), generation(generation) {}
     };
 
     class RootSurface : public NodeSurface {
@@ -42,9 +47,15 @@ namespace AxiomModel {
 
         const std::optional<RootSurfaceCompileMeta> &compileMeta() const { return _compileMeta; }
 
-        void setCompileMeta(std::optional<RootSurfaceCompileMeta> compileMeta) {
-            _compileMeta = std::move(compileMeta);
-        }
+        void setCompileMeta(std::optional<RootSurfaceCompileMeta> compileMeta);
+
+        // The compile meta from the newest committed build, which matches the portals of the code the runtime is
+        // running. This can be older than `compileMeta` while builds are waiting to be committed.
+        const std::optional<RootSurfaceCompileMeta> &runtimeCompileMeta() const { return _runtimeCompileMeta; }
+
+        // Moves compile meta from builds that have been committed into `runtimeCompileMeta`. Called by the model root
+        // after each commit.
+        void updateRuntimeCompileMeta();
 
         uint64_t nextPortalId() const { return _nextPortalId; }
 
@@ -52,6 +63,8 @@ namespace AxiomModel {
 
     private:
         std::optional<RootSurfaceCompileMeta> _compileMeta;
+        std::optional<RootSurfaceCompileMeta> _runtimeCompileMeta;
+        std::deque<RootSurfaceCompileMeta> _pendingCompileMeta;
         uint64_t _nextPortalId;
     };
 }
@@ -206,10 +206,7 @@ std::unique_ptr<PortalControl> ControlSerializer::deserializePortal(
     if (version >= 5) {
         stream >> portalId;
     } else {
-        portalId =
-            (*takeAt(AxiomCommon::dynamicCast<RootSurface *>(findChildren(root->nodeSurfaces().sequence(), QUuid())),
-                     0))
-                ->takePortalId();
+        portalId = (*takeAt(findChildren<RootSurface *>(root->pool(), QUuid()), 0))->takePortalId();
     }
 
     return PortalControl::create(uuid, parentUuid, pos, size, selected, std::move(name), showName, exposerUuid,
@@ -325,10 +325,7 @@ std::unique_ptr<CreatePortalNodeAction>
     if (version >= 5) {
         stream >> nextPortalId;
     } else {
-        nextPortalId =
-            (*takeAt(AxiomCommon::dynamicCast<RootSurface *>(findChildren(root->nodeSurfaces().sequence(), QUuid())),
-                     0))
-                ->takePortalId();
+        nextPortalId = (*takeAt(findChildren<RootSurface *>(root->pool(), QUuid()), 0))->takePortalId();
     }
 
     return CreatePortalNodeAction::create(uuid, parentUuid, pos, std::move(name), controlsUuid,
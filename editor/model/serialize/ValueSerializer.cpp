@@ -1,5 +1,7 @@
 #include "ValueSerializer.h"
 
+#include <algorithm>
+
 using namespace AxiomModel;
 
 void ValueSerializer::serializeNum(const AxiomModel::NumValue &val, QDataStream &stream) {
@@ -56,10 +58,18 @@ MidiValue ValueSerializer::deserializeMidi(QDataStream &stream, uint32_t version
         stream >> dummy;
     }
 
+    uint8_t storedCount;
+    stream >> storedCount;
+
+    // older projects could store more events than fit now, the extra ones still need to be read to keep the stream
+    // aligned
     MidiValue val;
-    stream >> val.count;
-    for (uint8_t i = 0; i < val.count; i++) {
-        val.events[i] = deserializeMidiEvent(stream, version);
+    for (uint8_t i = 0; i < storedCount; i++) {
+        auto event = deserializeMidiEvent(stream, version);
+        if (i < MidiValue::MAX_EVENTS) {
+            val.events[i] = event;
+        }
     }
+    val.count = (uint8_t) std::min((size_t) storedCount, MidiValue::MAX_EVENTS);
     return val;
 }
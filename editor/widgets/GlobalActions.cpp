@@ -40,7 +40,6 @@ void GlobalActions::setupActions() {
     fileSave = makeAction("&Save", QKeySequence::Save);
     fileSaveAs = makeAction("&Save As...", QKeySequence::SaveAs);
     fileExport = makeAction("&Export...");
-    fileExport->setEnabled(false);
     fileQuit = makeAction("&Quit", QKeySequence::Quit);
 
     editUndo = makeAction("&Undo", QKeySequence::Undo);
@@ -6,6 +6,7 @@
 #include "../surface/NodeSurfaceCanvas.h"
 #include "editor/model/ConnectionWire.h"
 #include "editor/model/WireGrid.h"
+#include "editor/model/grid/GridSurface.h"
 
 using namespace AxiomGui;
 using namespace AxiomModel;
@@ -20,6 +21,7 @@ WireItem::WireItem(QObject *parent, AxiomModel::ConnectionWire *wire) : QObject(
 
     setBrush(Qt::NoBrush);
 
+    wire->grid()->tryFlush();
     wire->wireGrid()->tryFlush();
     updateRoute(wire->route(), wire->lineIndices());
     setIsActive(wire->active());
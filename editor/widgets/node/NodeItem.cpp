@@ -255,7 +255,7 @@ void NodeItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event) {
     event->accept();
 
     auto copyableItems =
-        AxiomCommon::filter(AxiomModel::findChildren(node->root()->nodes().sequence(), node->parentUuid()),
+        AxiomCommon::filter(AxiomModel::findChildren<Node *>(node->root()->pool(), node->parentUuid()),
                             [](Node *const &node) { return node->isCopyable(); });
 
     QMenu menu;
@@ -0,0 +1,130 @@
+#include "ExportWindow.h"
+
+#include <QtGui/QDoubleValidator>
+#include <QtGui/QIcon>
+#include <QtWidgets/QComboBox>
+#include <QtWidgets/QDialogButtonBox>
+#include <QtWidgets/QFileDialog>
+#include <QtWidgets/QGridLayout>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QLineEdit>
+#include <QtWidgets/QMessageBox>
+#include <QtWidgets/QPushButton>
+
+#include "editor/util.h"
+
+using namespace AxiomGui;
+
+ExportWindow::ExportWindow(const QString &defaultPath)
+    : QDialog(nullptr, Qt::WindowTitleHint | Qt::WindowSystemMenuHint | Qt::WindowCloseButtonHint) {
+    setWindowTitle(tr("Export"));
+    setStyleSheet(AxiomUtil::loadStylesheet(":/styles/SaveModuleWindow.qss"));
+    setWindowIcon(QIcon(":/application.ico"));
+
+    setFixedSize(400, 450);
+
+    auto mainLayout = new QGridLayout();
+
+    mainLayout->setContentsMargins(0, 0, 0, 0);
+    mainLayout->setMargin(10);
+
+    auto addLabel = [this, mainLayout](const QString &text, int row) {
+        auto label = new QLabel(text, this);
+        label->setObjectName("save-label");
+        mainLayout->addWidget(label, row, 0, 1, 2);
+    };
+
+    addLabel(tr("Target triple: (empty for this computer)"), 0);
+    tripleInput = new QLineEdit(this);
+    tripleInput->setPlaceholderText("x86_64-pc-windows-msvc");
+    mainLayout->addWidget(tripleInput, 1, 0, 1, 2);
+
+    addLabel(tr("CPU:"), 2);
+    cpuInput = new QLineEdit(this);
+    cpuInput->setPlaceholderText("generic");
+    mainLayout->addWidget(cpuInput, 3, 0, 1, 2);
+
+    addLabel(tr("Optimize for:"), 4);
+    optimizeInput = new QComboBox(this);
+    optimizeInput->addItem(tr("Speed"));
+    optimizeInput->addItem(tr("Size"));
+    mainLayout->addWidget(optimizeInput, 5, 0, 1, 2);
+
+    // the replayer can't change these once the project is exported
+    auto numberValidator = new QDoubleValidator(this);
+    numberValidator->setBottom(0);
+    addLabel(tr("Sample rate:"), 6);
+    sampleRateInput = new QLineEdit("44100", this);
+    sampleRateInput->setValidator(numberValidator);
+    mainLayout->addWidget(sampleRateInput, 7, 0, 1, 2);
+
+    addLabel(tr("BPM:"), 8);
+    bpmInput = new QLineEdit("60", this);
+    bpmInput->setValidator(numberValidator);
+    mainLayout->addWidget(bpmInput, 9, 0, 1, 2);
+
+    addLabel(tr("Delay memory (MB):"), 10);
+    arenaInput = new QLineEdit("32", this);
+    arenaInput->setValidator(numberValidator);
+    mainLayout->addWidget(arenaInput, 11, 0, 1, 2);
+
+    addLabel(tr("Output:"), 12);
+    pathInput = new QLineEdit(defaultPath, this);
+    mainLayout->addWidget(pathInput, 13, 0);
+    auto browseButton = new QPushButton(tr("Browse..."), this);
+    mainLayout->addWidget(browseButton, 13, 1);
+
+    mainLayout->setRowStretch(14, 1);
+
+    auto buttonBox = new QDialogButtonBox();
+    auto okButton = buttonBox->addButton(tr("Export"), QDialogButtonBox::AcceptRole);
+    okButton->setDefault(true);
+    auto cancelButton = buttonBox->addButton(QDialogButtonBox::Cancel);
+    mainLayout->addWidget(buttonBox, 15, 0, 1, 2);
+
+    setLayout(mainLayout);
+
+    connect(browseButton, &QPushButton::clicked, this, &ExportWindow::browseOutput);
+    connect(okButton, &QPushButton::clicked, this, &ExportWindow::validateAndAccept);
+    connect(cancelButton, &QPushButton::clicked, this, &ExportWindow::reject);
+}
+
+MaximCompiler::ExportSettings ExportWindow::enteredSettings() const {
+    MaximCompiler::ExportSettings settings;
+    settings.targetTriple = tripleInput->text().trimmed();
+    settings.cpu = cpuInput->text().trimmed();
+    settings.minSize = optimizeInput->currentIndex() == 1;
+    settings.sampleRate = sampleRateInput->text().toFloat();
+    settings.bpm = bpmInput->text().toFloat();
+    settings.arenaBytes = (uint64_t) (arenaInput->text().toDouble() * 1024 * 1024);
+    return settings;
+}
+
+QString ExportWindow::enteredPath() const {
+    return pathInput->text();
+}
+
+void ExportWindow::browseOutput() {
+    auto selectedFile = QFileDialog::getSaveFileName(this, "Export", pathInput->text(),
+                                                     tr("Object files (*.o *.obj);;All files (*.*)"));
+    if (!selectedFile.isNull()) {
+        pathInput->setText(selectedFile);
+    }
+}
+
+void ExportWindow::validateAndAccept() {
+    auto settings = enteredSettings();
+    if (settings.sampleRate <= 0 || settings.bpm <= 0) {
+        QMessageBox(QMessageBox::Critical, "Failed to export", "The sample rate and BPM must be positive numbers.",
+                    QMessageBox::Ok)
+            .exec();
+        return;
+    }
+    if (enteredPath().isEmpty()) {
+        QMessageBox(QMessageBox::Critical, "Failed to export", "Choose a file to export to.", QMessageBox::Ok)
+            .exec();
+        return;
+    }
+
+    accept();
+}
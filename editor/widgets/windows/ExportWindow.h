@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QtWidgets/QDialog>
+
+#include "editor/compiler/interface/Runtime.h"
+
+class QComboBox;
+class QLineEdit;
+
+namespace AxiomGui {
+
+    class ExportWindow : public QDialog {
+    Q_OBJECT
+
+    public:
+        explicit ExportWindow(const QString &defaultPath);
+
+        MaximCompiler::ExportSettings enteredSettings() const;
+
+        QString enteredPath() const;
+
+    private slots:
+
+        void browseOutput();
+
+        void validateAndAccept();
+
+    private:
+
+        QLineEdit *tripleInput;
+        QLineEdit *cpuInput;
+        QComboBox *optimizeInput;
+        QLineEdit *sampleRateInput;
+        QLineEdit *bpmInput;
+        QLineEdit *arenaInput;
+        QLineEdit *pathInput;
+    };
+
+}
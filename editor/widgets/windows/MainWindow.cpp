@@ -3,6 +3,7 @@
 #include <QIODevice>
 #include <QStandardPaths>
 #include <QtCore/QDateTime>
+#include <QtCore/QFileInfo>
 #include <QtCore/QStandardPaths>
 #include <QtCore/QStringBuilder>
 #include <QtCore/QTimer>
@@ -21,6 +22,7 @@
 #include "../modulebrowser/ModuleBrowserPanel.h"
 #include "../surface/NodeSurfacePanel.h"
 #include "AboutWindow.h"
+#include "ExportWindow.h"
 #include "editor/AxiomApplication.h"
 #include "editor/backend/AudioBackend.h"
 #include "editor/model/Library.h"
@@ -252,8 +254,8 @@ void MainWindow::setProject(std::unique_ptr<AxiomModel::Project> project) {
     _project->mainRoot().attachRuntime(runtime());
 
     // find root surface and show it
-    auto defaultSurface =
-        AxiomCommon::getFirst(AxiomModel::findChildrenWatch(_project->mainRoot().nodeSurfaces(), QUuid()));
+    auto defaultSurface = AxiomCommon::getFirst(
+        AxiomModel::findChildrenWatch<AxiomModel::NodeSurface *>(_project->mainRoot().pool(), QUuid()));
     assert(defaultSurface->value());
     auto surfacePanel = showSurface(nullptr, *defaultSurface->value(), false, true);
 
@@ -479,13 +481,27 @@ void MainWindow::openProject() {
 }
 
 void MainWindow::exportProject() {
-    /*project()->rootSurface()->saveValue();
-    MaximRuntime::Exporter exporter(runtime->ctx(), &runtime->libModule());
-    exporter.addRuntime(runtime, "definition");
-    std::error_code err;
-    llvm::raw_fd_ostream dest("output.o", err, llvm::sys::fs::F_None);
-    exporter.exportObject(dest, 2, 2);
-    project()->rootSurface()->restoreValue();*/
+    auto defaultPath = _project->linkedFile().isEmpty()
+                           ? QString("output.o")
+                           : QFileInfo(_project->linkedFile()).completeBaseName() + ".o";
+    ExportWindow exportWindow(defaultPath);
+    if (exportWindow.exec() != QDialog::Accepted) return;
+
+    // The exported code starts from the values controls were built with, so rebuild everything with frozen controls to
+    // bake in the current knob positions. This also makes sure any background builds have been committed.
+    auto &root = _project->mainRoot();
+    auto wasFrozen = root.freezeControls();
+    root.setFreezeControls(true);
+    auto transaction = root.createTransaction();
+    _project->rootSurface()->attachRuntime(runtime(), &transaction);
+    root.applyTransaction(std::move(transaction));
+
+    QString error;
+    if (!runtime()->exportObject(exportWindow.enteredSettings(), exportWindow.enteredPath(), error)) {
+        QMessageBox(QMessageBox::Critical, "Failed to export", error, QMessageBox::Ok).exec();
+    }
+
+    root.setFreezeControls(wasFrozen);
 }
 
 void MainWindow::importLibrary() {
@@ -3,8 +3,14 @@
 
 #include "AxiomCommon.h"
 
+// the sample rate and BPM are baked into exported code, these must match the values it was exported with. Define them
+// before including this header (or pass them to the compiler) if the project wasn't exported with the defaults.
+#ifndef AXIOM_SAMPLERATE
 #define AXIOM_SAMPLERATE 44100
+#endif
+#ifndef AXIOM_BPM
 #define AXIOM_BPM 60
+#endif
 
 #define AXIOM_INPUT_PORTAL 0
 #define AXIOM_OUTPUT_PORTAL 1
@@ -16,11 +22,21 @@ void __cdecl axiom_init();
 void __cdecl axiom_packup();
 void __cdecl axiom_generate();
 
+// Runs axiom_generate `frames` times. Each buffer array has a left and right pointer for each portal, number portals
+// with non-null input buffers are read from them before each frame and ones with non-null output buffers are written
+// to them after each frame.
+void __cdecl axiom_generate_block(uint32_t frames, const float *const *inputs, float *const *outputs);
+
 void *__cdecl axiom_get_portal(uint32_t id);
 
-void __cdecl axiom_midi_push(AxiomMidi *midi, AxiomMidiEvent event);
 #ifdef __cplusplus
 }
 #endif
 
+static inline void axiom_midi_push(AxiomMidi *midi, AxiomMidiEvent event) {
+    if (midi->event_count < AXIOM_MIDI_EVENT_COUNT) {
+        midi->events[midi->event_count++] = event;
+    }
+}
+
 #endif
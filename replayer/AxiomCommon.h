@@ -25,9 +25,11 @@ typedef struct {
     uint8_t param;
 } AxiomMidiEvent;
 
+#define AXIOM_MIDI_EVENT_COUNT 16
+
 typedef struct {
     uint8_t event_count;
-    AxiomMidiEvent events[16];
+    AxiomMidiEvent events[AXIOM_MIDI_EVENT_COUNT];
 } AxiomMidi;
 
 #endif